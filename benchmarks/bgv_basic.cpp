@@ -12,8 +12,10 @@
 
 #include <benchmark/benchmark.h>
 #include <iostream>
+#include <vector>
 
 #include <helib/helib.h>
+#include <helib/ResiduePool.h>
 
 #include "bgv_common.h"
 
@@ -87,6 +89,70 @@ static void decrypting_ciphertexts(benchmark::State& state, Meta& meta)
   std::cout << "Decryptions performed = " << state.iterations() << std::endl;
 }
 
+// Residue buffers taken from the pool or the system per iteration
+static void reportBuffers(benchmark::State& state,
+                          const helib::ResiduePool::Counters& before)
+{
+  helib::ResiduePool::Counters after = helib::ResiduePool::getCounters();
+  state.counters["buffers"] =
+      benchmark::Counter((after.allocations - before.allocations) +
+                             (after.hits - before.hits),
+                         benchmark::Counter::kAvgIterations);
+  state.counters["allocations"] =
+      benchmark::Counter(after.allocations - before.allocations,
+                         benchmark::Counter::kAvgIterations);
+}
+
+static void evaluating_expressions_with_temporaries(benchmark::State& state,
+                                                    Meta& meta)
+{
+  helib::Ptxt<helib::BGV> ptxt1(meta.data->context);
+  helib::Ptxt<helib::BGV> ptxt2(meta.data->context);
+  helib::Ptxt<helib::BGV> ptxt3(meta.data->context);
+
+  ptxt1.random();
+  ptxt2.random();
+  ptxt3.random();
+
+  helib::Ctxt ctxt1(meta.data->publicKey);
+  helib::Ctxt ctxt2(meta.data->publicKey);
+  helib::Ctxt ctxt3(meta.data->publicKey);
+
+  meta.data->publicKey.Encrypt(ctxt1, ptxt1);
+  meta.data->publicKey.Encrypt(ctxt2, ptxt2);
+  meta.data->publicKey.Encrypt(ctxt3, ptxt3);
+
+  // Only the first operator copies, the others work in the temporary
+  helib::ResiduePool::Counters before = helib::ResiduePool::getCounters();
+  for (auto _ : state) {
+    helib::Ctxt result = ctxt1 * ctxt2 + ctxt3 - ctxt1;
+    benchmark::DoNotOptimize(result);
+  }
+  reportBuffers(state, before);
+  std::cout << "Expressions evaluated = " << state.iterations() << std::endl;
+}
+
+static void growing_a_vector_of_ciphertexts(benchmark::State& state,
+                                            Meta& meta)
+{
+  helib::Ptxt<helib::BGV> ptxt(meta.data->context);
+  ptxt.random();
+
+  helib::Ctxt ctxt(meta.data->publicKey);
+  meta.data->publicKey.Encrypt(ctxt, ptxt);
+
+  // Reallocations of the vector move the ciphertexts instead of copying them
+  helib::ResiduePool::Counters before = helib::ResiduePool::getCounters();
+  for (auto _ : state) {
+    std::vector<helib::Ctxt> ctxts;
+    for (long i = 0; i < 16; i++)
+      ctxts.push_back(ctxt);
+    benchmark::DoNotOptimize(ctxts.data());
+  }
+  reportBuffers(state, before);
+  std::cout << "Vectors grown = " << state.iterations() << std::endl;
+}
+
 Meta fn;
 Params tiny_params(/*m=*/257, /*p=*/2, /*r=*/1, /*L=*/5800);
 BENCHMARK_CAPTURE(adding_two_ciphertexts, tiny_params, fn(tiny_params))
@@ -101,6 +167,16 @@ BENCHMARK_CAPTURE(encrypting_ciphertexts, tiny_params, fn(tiny_params))
 BENCHMARK_CAPTURE(decrypting_ciphertexts, tiny_params, fn(tiny_params))
     ->Unit(benchmark::kMillisecond)
     ->Iterations(200);
+BENCHMARK_CAPTURE(evaluating_expressions_with_temporaries,
+                  tiny_params,
+                  fn(tiny_params))
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(200);
+BENCHMARK_CAPTURE(growing_a_vector_of_ciphertexts,
+                  tiny_params,
+                  fn(tiny_params))
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(200);
 
 Params small_params(/*m=*/8009, /*p=*/2, /*r=*/1, /*L=*/5800);
 BENCHMARK_CAPTURE(adding_two_ciphertexts, small_params, fn(small_params))
@@ -115,6 +191,11 @@ BENCHMARK_CAPTURE(encrypting_ciphertexts, small_params, fn(small_params))
 BENCHMARK_CAPTURE(decrypting_ciphertexts, small_params, fn(small_params))
     ->Unit(benchmark::kMillisecond)
     ->Iterations(200);
+BENCHMARK_CAPTURE(evaluating_expressions_with_temporaries,
+                  small_params,
+                  fn(small_params))
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(200);
 
 Params big_params(/*m=*/32003, /*p=*/2, /*r=*/1, /*L=*/5800);
 BENCHMARK_CAPTURE(adding_two_ciphertexts, big_params, fn(big_params))
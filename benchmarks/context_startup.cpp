@@ -0,0 +1,119 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+
+// Startup time of a worker: building a context from the parameters, reading
+// it with readFrom (which recomputes the tables) and reading a snapshot.
+
+#include <benchmark/benchmark.h>
+#include <sstream>
+
+#include <helib/helib.h>
+#include "bgv_common.h"
+
+namespace {
+
+static helib::Context buildContext(const Params& params)
+{
+  return helib::ContextBuilder<helib::BGV>()
+      .m(params.m)
+      .p(params.p)
+      .r(params.r)
+      .bits(params.L)
+      .gens(params.gens)
+      .ords(params.ords)
+      .build();
+}
+
+static void building_the_context(benchmark::State& state, Params& params)
+{
+  for (auto _ : state) {
+    helib::Context context = buildContext(params);
+    ::benchmark::DoNotOptimize(context);
+  }
+}
+
+static void reading_the_context(benchmark::State& state, Params& params)
+{
+  std::stringstream ss;
+  buildContext(params).writeTo(ss);
+  const std::string data = ss.str();
+
+  for (auto _ : state) {
+    std::istringstream in(data);
+    helib::Context context = helib::Context::readFrom(in);
+    ::benchmark::DoNotOptimize(context);
+  }
+}
+
+static void reading_a_context_snapshot(benchmark::State& state, Params& params)
+{
+  std::stringstream ss;
+  buildContext(params).writeSnapshotTo(ss);
+  const std::string data = ss.str();
+  state.counters["bytes"] = data.size();
+
+  for (auto _ : state) {
+    std::istringstream in(data);
+    helib::Context context = helib::Context::readSnapshotFrom(in);
+    ::benchmark::DoNotOptimize(context);
+  }
+}
+
+Params tiny_params(/*m =*/31 * 41,
+                   /*p =*/2,
+                   /*r =*/1,
+                   /*bits =*/580,
+                   /*gens =*/std::vector<long>{1026, 249},
+                   /*ords =*/std::vector<long>{30, -2});
+BENCHMARK_CAPTURE(building_the_context, tiny_params, tiny_params)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(10);
+BENCHMARK_CAPTURE(reading_the_context, tiny_params, tiny_params)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(10);
+BENCHMARK_CAPTURE(reading_a_context_snapshot, tiny_params, tiny_params)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(10);
+
+Params small_params(/*m =*/31775,
+                    /*p =*/2,
+                    /*r =*/1,
+                    /*bits =*/580,
+                    /*gens =*/std::vector<long>{6976, 24806},
+                    /*ords =*/std::vector<long>{40, 30});
+BENCHMARK_CAPTURE(building_the_context, small_params, small_params)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(reading_the_context, small_params, small_params)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(reading_a_context_snapshot, small_params, small_params)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+
+Params big_params(/*m =*/35113,
+                  /*p =*/2,
+                  /*r =*/1,
+                  /*bits =*/580,
+                  /*gens =*/std::vector<long>{16134, 8548},
+                  /*ords =*/std::vector<long>{36, 24});
+BENCHMARK_CAPTURE(building_the_context, big_params, big_params)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(reading_the_context, big_params, big_params)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+BENCHMARK_CAPTURE(reading_a_context_snapshot, big_params, big_params)
+    ->Unit(benchmark::kMillisecond)
+    ->Iterations(1);
+
+} // namespace
@@ -0,0 +1,127 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_BASECONVERTER_H
+#define HELIB_BASECONVERTER_H
+/**
+ * @file BaseConverter.h
+ * @brief Fast RNS base extension between two sets of primes of a Context
+ **/
+#include <vector>
+
+#include <NTL/sp_arith.h>
+
+#include <helib/IndexSet.h>
+
+namespace helib {
+
+class Context;
+
+/**
+ * @class BaseConverter
+ * @brief Extends integers given by their residues modulo the primes of one
+ * IndexSet to their residues modulo the primes of another, using only
+ * single-precision arithmetic.
+ *
+ * Let Q = q_1*...*q_k be the product of the source primes and
+ * Q_i = Q/q_i. An integer x is recovered from its residues x_i as
+ *
+ *     x = sum_i y_i*Q_i - v*Q,   where y_i = x_i*Q_i^{-1} mod q_i
+ *
+ * and v = round(sum_i y_i/q_i) for the balanced representative of x mod Q,
+ * the one in (-Q/2,Q/2). Reducing this identity modulo a target prime p
+ * only needs the tables Q_i^{-1} mod q_i, Q_i mod p and Q mod p, so the
+ * conversion never forms x itself. The sum that gives v is computed in
+ * long double. It can only be off when x is within about k times the long
+ * double precision of +-Q/2 (relative to Q), and then the result is x-+Q
+ * instead, which is just as small.
+ *
+ * The tables depend only on the two sets of primes. Context keeps a cache
+ * of converters, see Context::getBaseConverter.
+ **/
+class BaseConverter
+{
+public:
+  /**
+   * @brief Tables to also reduce the lifts modulo an arbitrary t > 1, which
+   * need not be prime (e.g., a plaintext space p^r)
+   **/
+  struct AuxModulus
+  {
+    long t = 0;
+    NTL::sp_ReduceStruct red;
+    std::vector<long> qHatModT; // Q_i mod t
+    long QModT = 0;             // Q mod t
+  };
+
+  /**
+   * @brief Constructor
+   * @param context The context that the primes belong to.
+   * @param from The source primes, must not be empty.
+   * @param to The target primes, must be disjoint from from.
+   **/
+  BaseConverter(const Context& context,
+                const IndexSet& from,
+                const IndexSet& to);
+
+  const IndexSet& getFrom() const { return from; }
+  const IndexSet& getTo() const { return to; }
+
+  //! @brief Prepare the tables for reducing the lifts modulo t
+  AuxModulus auxModulus(long t) const;
+
+  /**
+   * @brief Base extension of n integers.
+   * @param out Receives getTo().card() rows, out[r*outStride + h] is the
+   * h'th integer modulo the r'th prime of getTo(), in [0,p).
+   * @param outStride The distance between the rows of out.
+   * @param in Holds getFrom().card() rows, in[r*inStride + h] is the h'th
+   * integer modulo the r'th prime of getFrom(), in [0,q).
+   * @param inStride The distance between the rows of in.
+   * @param n The number of integers.
+   * @param frac If not null, frac[h] is set to x_h/Q, where x_h is the
+   * balanced representative of the h'th integer.
+   * @param aux If not null, outAux[h] is set to x_h mod aux->t, in [0,t).
+   * @param outAux See aux.
+   * @note The integers are processed in parallel (NTL_EXEC_RANGE).
+   **/
+  void convert(long* out,
+               long outStride,
+               const long* in,
+               long inStride,
+               long n,
+               double* frac = nullptr,
+               const AuxModulus* aux = nullptr,
+               long* outAux = nullptr) const;
+
+private:
+  IndexSet from, to;
+
+  // the source primes q_i, Q_i^{-1} mod q_i and 1/q_i
+  std::vector<long> q;
+  std::vector<long> qHatInv;
+  std::vector<NTL::mulmod_precon_t> qHatInvPrecon;
+  std::vector<long double> qRecip;
+
+  // the target primes p_j, and the tables for reducing modulo p_j
+  std::vector<long> p;
+  std::vector<NTL::sp_ReduceStruct> pRed;
+  std::vector<long> QModP;
+  std::vector<NTL::mulmod_precon_t> QModPPrecon;
+
+  // qHatModP[j*k + i] = Q_i mod p_j
+  std::vector<long> qHatModP;
+  std::vector<NTL::mulmod_precon_t> qHatModPPrecon;
+};
+
+} // namespace helib
+
+#endif // ifndef HELIB_BASECONVERTER_H
@@ -16,10 +16,13 @@
  * @brief Supports forward and backward length-m FFT transformations
  *
  * This is a wrapper around the bluesteinFFT routines, for one modulus q.
+ * When m is a power of two it uses instead the native NTT from NTT.h
+ * (or NTL's own FFT, if the native NTT is disabled).
  **/
 #include <helib/NumbTh.h>
 #include <helib/PAlgebra.h>
 #include <helib/bluestein.h>
+#include <helib/NTT.h>
 #include <helib/ClonedPtr.h>
 
 namespace helib {
@@ -73,6 +76,9 @@ class Cmodulus
   // PhimX modulo q, for faster division w/ remainder
   CopiedPtr<zz_pXModulus1> phimx;
 
+  // Native negacyclic NTT, only set when m is a power of two
+  CopiedPtr<NegacyclicNTT> ntt;
+
   // Allocate memory and compute roots
   void privateInit(const PAlgebra&, long rt);
 
@@ -94,8 +100,10 @@ public:
    * @brief Constructor
    * @note Specify m and q, and optionally also the root if q == 0, then the
    * current context is used
+   * @note If m is a power of two and nativeNTT is set, the transforms use
+   * NegacyclicNTT rather than NTL's FFT. Both produce the same results.
    */
-  Cmodulus(const PAlgebra& zms, long qq, long rt);
+  Cmodulus(const PAlgebra& zms, long qq, long rt, bool nativeNTT = true);
 
   //! Copy assignment operator
   Cmodulus& operator=(const Cmodulus& other);
@@ -109,6 +117,8 @@ public:
   NTL::mulmod_t getQInv() const { return qinv; }
   long getRoot() const { return root; }
   const zz_pXModulus1& getPhimX() const { return *phimx; }
+  //! @brief Whether the transforms use the native NTT (m a power of two)
+  bool usesNativeNTT() const { return bool(ntt); }
 
   //! @brief Restore NTL's current modulus
   void restoreModulus() const { context.restore(); }
@@ -121,12 +131,18 @@ public:
   // y = FFT(x)
   void FFT(NTL::vec_long& y, const zzX& x) const;
 
-  // auxiliary routine used by above two routines
-  void FFT_aux(NTL::vec_long& y, NTL::zz_pX& tmp) const;
+  // Same as above, but y points to phi(m) pre-allocated longs
+  void FFT(long* y, const NTL::ZZX& x) const;
+  void FFT(long* y, const zzX& x) const;
+
+  // auxiliary routine used by above routines
+  void FFT_aux(long* y, NTL::zz_pX& tmp) const;
 
   // expects zp context to be set externally
   // x = FFT^{-1}(y)
   void iFFT(NTL::zz_pX& x, const NTL::vec_long& y) const;
+  // Same as above, but y points to phi(m) longs
+  void iFFT(NTL::zz_pX& x, const long* y) const;
 
   // returns thread-local scratch space
   // DIRT: this zz_pX is used for several zz_p moduli,
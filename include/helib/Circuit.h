@@ -0,0 +1,183 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_CIRCUIT_H
+#define HELIB_CIRCUIT_H
+/**
+ * @file Circuit.h
+ * @brief Deferred evaluation of a circuit of ciphertext operations.
+ **/
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+#include <helib/Ctxt.h>
+#include <helib/EncryptedArray.h>
+
+namespace helib {
+
+/**
+ * @class Circuit
+ * @brief Records operations on ciphertexts into a DAG, then evaluates it.
+ *
+ * Instead of operating on a Ctxt directly, the operations are recorded on
+ * nodes, and evaluate() computes the requested outputs from the inputs:
+ * \code
+ *   Circuit circuit(publicKey);
+ *   Circuit::Node x = circuit.input(), y = circuit.input();
+ *   Circuit::Node z = circuit.add(circuit.mult(x, y), circuit.rotate(x, 1));
+ *   std::vector<Ctxt> results;
+ *   circuit.evaluate(results, {ctxtX, ctxtY}, {z});
+ * \endcode
+ * Recording lets the circuit simplify itself before anything is computed:
+ *  - Common subexpressions: recording the same operation on the same nodes
+ *    (up to the order of the operands of add and mult) returns the existing
+ *    node.
+ *  - Rotations of rotations are merged into one rotation (and rotations by
+ *    a multiple of the number of slots are dropped). When an algebra has a
+ *    single dimension, the rotations of the same node are hoisted, see
+ *    HoistedCtxt.
+ *  - Only the operations that the outputs depend on are evaluated, and the
+ *    intermediate ciphertexts are freed after their last use.
+ *
+ * The operations are evaluated in waves: a wave holds the operations whose
+ * operands were all computed by the earlier waves, so they are independent.
+ * With at least as many operations in a wave as NTL threads, each thread
+ * evaluates its share of the wave; smaller waves are evaluated one operation
+ * at a time, with the threads used inside each operation. The reCrypt
+ * operations of a wave go through PubKey::reCryptBatch together.
+ * Modulus switching is left to the Ctxt operations, which already choose
+ * the primes of each product (see Ctxt::multLowLvl).
+ *
+ * A circuit can be evaluated any number of times, also concurrently.
+ **/
+class Circuit
+{
+public:
+  //! @brief A value of the circuit: an input, or the result of an operation
+  typedef long Node;
+
+  //! @brief A plaintext constant of the circuit, see constant()
+  typedef long Constant;
+
+  //! @brief The operations of the circuit
+  enum class Op
+  {
+    INPUT,
+    ADD,
+    SUB,
+    NEGATE,
+    MULT,
+    ROTATE,
+    ADD_CONST,
+    MUL_CONST,
+    MUL_INT,
+    RECRYPT
+  };
+
+  //! @brief The cost of evaluating some outputs, see analyze()
+  struct Stats
+  {
+    long operations = 0;      // operations evaluated
+    long multiplications = 0; // ciphertext-ciphertext products
+    long rotations = 0;       // after merging
+    long recryptions = 0;
+    // One key switch per product and at least one per rotation: rotations
+    // along several dimensions, or along bad ones, take more
+    long keySwitches = 0;
+    long depth = 0; // multiplicative depth, starting over at each reCrypt
+    long waves = 0; // rounds of independent operations
+  };
+
+  //! @brief A circuit on ciphertexts encrypted under pubKey
+  explicit Circuit(const PubKey& pubKey);
+
+  Circuit(const Circuit&) = delete;
+  Circuit& operator=(const Circuit&) = delete;
+
+  //! @brief A new input, the inputs of evaluate() are in this order
+  Node input();
+
+  //! @brief Register a plaintext constant, of the context of the key
+  Constant constant(const PtxtArray& value);
+
+  ///@{
+  //! @name Operations
+  //! These only record the operation and return its result.
+  Node add(Node a, Node b);
+  Node sub(Node a, Node b);
+  Node negate(Node a);
+  Node mult(Node a, Node b);
+  //! @brief Rotate by k slots, as EncryptedArray::rotate
+  Node rotate(Node a, long k);
+  Node addConstant(Node a, Constant c);
+  Node multByConstant(Node a, Constant c);
+  //! @brief Multiply by the integer c (not a Constant index)
+  Node multByInteger(Node a, long c);
+  //! @brief Bootstrap, the key must be bootstrappable
+  Node reCrypt(Node a);
+  ///@}
+
+  //! @brief Number of inputs
+  long numInputs() const { return nInputs; }
+
+  //! @brief Number of nodes, inputs included
+  long size() const { return nodes.size(); }
+
+  //! @brief The operation that computes node a
+  Op op(Node a) const;
+
+  //! @brief What evaluate() would do to compute outputs
+  Stats analyze(const std::vector<Node>& outputs) const;
+
+  /**
+   * @brief Evaluate the circuit.
+   * @param results Set to the values of outputs, in order.
+   * @param inputs The values of the inputs, encrypted under the key of the
+   * circuit.
+   * @param outputs The nodes to compute.
+   **/
+  void evaluate(std::vector<Ctxt>& results,
+                const std::vector<Ctxt>& inputs,
+                const std::vector<Node>& outputs) const;
+
+private:
+  struct NodeData
+  {
+    Op op;
+    Node a;     // first operand, -1 for an input
+    Node b;     // second operand, -1 for unary operations
+    long param; // rotation amount, constant index or integer
+  };
+
+  const PubKey& pubKey;
+  const EncryptedArray& ea;
+  long nInputs = 0;
+  std::vector<NodeData> nodes;
+  std::vector<PtxtArray> constants;
+
+  // The nodes by (op, a, b, param), to find common subexpressions
+  std::map<std::tuple<Op, Node, Node, long>, Node> known;
+
+  Node make(Op op, Node a, Node b = -1, long param = 0);
+  void checkNode(Node a) const;
+
+  // The wave of each node that the outputs depend on, -1 for the others
+  std::vector<long> schedule(const std::vector<Node>& outputs) const;
+
+  // Set result to node n, given its first operand in result
+  void apply(Node n, Ctxt& result, const Ctxt* second) const;
+};
+
+} // namespace helib
+
+#endif // ifndef HELIB_CIRCUIT_H
@@ -15,6 +15,8 @@
  * @file Context.h
  * @brief Keeps the parameters of an instance of the cryptosystem
  **/
+#include <array>
+#include <map>
 #include <optional>
 #include <helib/PAlgebra.h>
 #include <helib/CModulus.h>
@@ -26,6 +28,7 @@
 #include <helib/range.h>
 #include <helib/scheme.h>
 #include <helib/JsonWrapper.h>
+#include <helib/multicore.h>
 
 #include <NTL/Lazy.h>
 
@@ -88,6 +91,26 @@ long FindM(long k,
 
 class EncryptedArray;
 struct PolyModRing;
+class BaseConverter;
+
+/**
+ * @brief How the noise added by key switching and modulus switching is
+ * accounted for in `Ctxt::getNoiseBound()`, see
+ * `Context::setNoiseEstimation`.
+ **/
+enum class NoiseEstimation
+{
+  //! The canonical-embedding norm of the added terms is computed exactly
+  //! (one complex FFT per digit / ciphertext part). This is the default.
+  EXACT,
+  //! A high-probability bound on that norm is used instead, which costs
+  //! nothing to compute.
+  BOUND,
+  //! The added noise is not accounted for. Noise bounds then underestimate
+  //! the actual noise, so this is only suitable for circuits whose levels
+  //! are planned in advance.
+  OFF
+};
 
 // Forward declaration of ContextBuilder
 template <typename SCHEME>
@@ -110,6 +133,7 @@ private:
 
   // For serialization.
   struct SerializableContent;
+  struct Snapshot;
 
   // Cmodulus objects for the different primes
   // The implementation assumes that the list of
@@ -150,6 +174,19 @@ private:
 
   double scale; // default = 10
 
+  // Use the native NTT in the Cmodulus objects when m is a power of two
+  // (default = true). This is only a performance setting, the results of
+  // all the transforms are the same either way.
+  bool nativeNTT = true;
+
+  // How key switching and modulus switching estimate the noise they add
+  // (default = EXACT). This is a runtime setting, it is not serialized.
+  NoiseEstimation noiseEstimation = NoiseEstimation::EXACT;
+
+  // Whether Ctxt::multiplyBy defers re-linearization (default = false).
+  // This is a runtime setting, it is not serialized.
+  bool lazyRelinearization = false;
+
   // The "ciphertext primes" are the "normal" primes that are used to
   // represent the public encryption key and ciphertexts. These are all
   // "large" single=precision primes, or bit-size roughly NTL_SP_SIZE bits.
@@ -185,9 +222,31 @@ private:
   // Bootstrapping-related data in the context includes both thin and thick
   ThinRecryptData rcData;
 
+  // The base converters built so far, keyed by the indexes of the source
+  // and target primes. Entries are never removed, so references to them
+  // remain valid for the lifetime of the context.
+  mutable std::map<std::pair<std::vector<long>, std::vector<long>>,
+                   std::shared_ptr<const BaseConverter>>
+      baseConverters;
+  mutable HELIB_MUTEX_TYPE baseConvertersLock;
+
   // Helper for serialisation.
   static SerializableContent readParamsFrom(std::istream& str);
 
+  // Helper for serialisation, writes everything but the bootstrapping data.
+  void writeParamsTo(std::ostream& str) const;
+
+  // Helper for snapshots, reads the tables that follow the parameters.
+  // Returns false, with a warning, if they cannot be used.
+  static bool readSnapshotTables(std::istream& str,
+                                 const SerializableContent& content,
+                                 Snapshot& snapshot);
+
+  // A digest of the parameters that the recryption data depends on.
+  std::array<unsigned char, 32> recryptDataDigest(const NTL::Vec<long>& mvec,
+                                                  bool build_cache,
+                                                  bool alsoThick) const;
+
   // Helper for serialisation.
   static SerializableContent readParamsFromJSON(const JsonWrapper& str);
 
@@ -197,11 +256,13 @@ private:
   // r BGV: The Hensel lifting parameter. CKKS: The bit precision.
   // gens The generators of `(Z/mZ)^*` (other than `p`).
   // ords The orders of each of the generators of `(Z/mZ)^*`.
+  // tables If not null, the tables of zMStar and alMod are restored from it.
   Context(unsigned long m,
           unsigned long p,
           unsigned long r,
           const std::vector<long>& gens = std::vector<long>(),
-          const std::vector<long>& ords = std::vector<long>());
+          const std::vector<long>& ords = std::vector<long>(),
+          const PAlgebraTables* tables = nullptr);
 
   // Used by ContextBuilder
   Context(long m,
@@ -212,8 +273,9 @@ private:
           const std::optional<ModChainParams>& mparams,
           const std::optional<BootStrapParams>& bparams);
 
-  // Used for serialisation
-  Context(const SerializableContent& content);
+  // Used for serialisation, snapshot (if not null) holds the tables to restore
+  Context(const SerializableContent& content,
+          const Snapshot* snapshot = nullptr);
 
   // Methods for adding primes.
   void addSpecialPrimes(long nDgts,
@@ -289,6 +351,46 @@ public:
    **/
   NTL::xdouble getStdev() const { return stdev; }
 
+  /**
+   * @brief Whether the native NTT is used when `m` is a power of two.
+   * @return A `bool`, `true` unless disabled with `ContextBuilder::nativeNTT`.
+   **/
+  bool usesNativeNTT() const { return nativeNTT; }
+
+  /**
+   * @brief Getter method for the noise-estimation policy.
+   * @return The `NoiseEstimation` used by key switching and modulus
+   * switching.
+   **/
+  NoiseEstimation getNoiseEstimation() const { return noiseEstimation; }
+
+  /**
+   * @brief Set the noise-estimation policy.
+   * @param policy The new policy.
+   * @note This should not be called while other threads are operating on
+   * ciphertexts of this context.
+   **/
+  void setNoiseEstimation(NoiseEstimation policy) { noiseEstimation = policy; }
+
+  /**
+   * @brief Whether multiplication defers re-linearization, see
+   * `setLazyRelinearization`.
+   **/
+  bool getLazyRelinearization() const { return lazyRelinearization; }
+
+  /**
+   * @brief Turn lazy re-linearization on or off.
+   * @param lazy If set, `Ctxt::multiplyBy` and `Ctxt::multiplyBy2` leave
+   * the product with a part relative to s^2 (or s^3). It is re-linearized
+   * when an operation needs it: an automorphism, a further multiplication
+   * or an explicit `Ctxt::cleanUp()`. Sums of products, such as inner
+   * products, then pay for one key switch instead of one per product.
+   * @note The ciphertexts are serialized with all their parts. This should
+   * not be called while other threads are operating on ciphertexts of this
+   * context.
+   **/
+  void setLazyRelinearization(bool lazy) { lazyRelinearization = lazy; }
+
   /**
    * @brief Getter method for the default `r` value of the created `context`.
    * @return The `r` value representing the Hensel lifting for `BGV` or the bit
@@ -701,6 +803,53 @@ public:
     rcData.init(*this, mvec, alsoThick, build_cache);
   }
 
+  /**
+   * @brief Write out the recryption data (the linear maps of bootstrapping
+   * with their cached constants, and the slot-unpacking encodings) in binary
+   * format, so that another process can load it with `readRecryptDataFrom`
+   * instead of building it.
+   * @param str Output `std::ostream`.
+   * @note The data is tagged with a digest of the parameters of this
+   * `Context` and of the arguments of `enableBootStrapping`.
+   **/
+  void writeRecryptDataTo(std::ostream& str) const;
+
+  /**
+   * @brief Initialises the recryption data from the output of
+   * `writeRecryptDataTo`, the same as `enableBootStrapping` with these
+   * arguments would.
+   * @param str Input `std::istream`.
+   * @param mvec A `std::vector` of unique prime factors of `m`.
+   * @param build_cache Flag for building a cache for improved efficiency.
+   * Default is false.
+   * @param alsoThick Flag for initialising additional information needed for
+   * thick bootstrapping. Default is true.
+   * @throws IOError if the data was written for other parameters or other
+   * arguments. If reading fails the `Context` is left unchanged.
+   **/
+  void readRecryptDataFrom(std::istream& str,
+                           const NTL::Vec<long>& mvec,
+                           bool build_cache = false,
+                           bool alsoThick = true);
+
+  /**
+   * @brief Initialises the recryption data, using a file as a persistent
+   * cache. If the file holds recryption data for these parameters it is
+   * loaded, otherwise the data is built as by `enableBootStrapping` and
+   * written to the file (atomically, so concurrent processes may share it).
+   * @param mvec A `std::vector` of unique prime factors of `m`.
+   * @param path The cache file.
+   * @param build_cache Flag for building a cache for improved efficiency.
+   * Default is false.
+   * @param alsoThick Flag for initialising additional information needed for
+   * thick bootstrapping. Default is true.
+   * @return `true` if the data was loaded from the file.
+   **/
+  bool enableBootStrappingWithCache(const NTL::Vec<long>& mvec,
+                                    const std::string& path,
+                                    bool build_cache = false,
+                                    bool alsoThick = true);
+
   /**
    * @brief Check if a `Context` is bootstrappable.
    * @return `true` if recryption data is found, `false` otherwise.
@@ -823,6 +972,19 @@ public:
     return p;
   }
 
+  /**
+   * @brief Get the tables for extending residues modulo the primes in
+   * `from` to residues modulo the primes in `to`.
+   * @param from The source primes, must not be empty.
+   * @param to The target primes, must be disjoint from `from`.
+   * @return A `BaseConverter` that remains valid for the lifetime of the
+   * context.
+   * @note The converter is built on first use and cached, this is
+   * thread-safe.
+   **/
+  const BaseConverter& getBaseConverter(const IndexSet& from,
+                                        const IndexSet& to) const;
+
   // FIXME: run-time error when ithPrime(i) returns 0
   /**
    * @brief Calculate the natural logarithm of the `i`th prime of the modulus
@@ -952,6 +1114,38 @@ public:
    **/
   static Context* readPtrFrom(std::istream& str);
 
+  /**
+   * @brief Write out a snapshot of the `Context` object in binary format.
+   * Besides what `writeTo` writes, this holds the tables that are expensive
+   * to compute at startup: Phi_m(X) and its norm bound, the factorization
+   * of Phi_m(X) modulo p^r with its CRT tables, and the roots of unity of
+   * the primes in the chain. The tables are protected by a checksum.
+   * @param str Output `std::ostream`.
+   * @note The NTL moduli and FFT tables are not stored, they are rebuilt
+   * from the restored tables when reading.
+   **/
+  void writeSnapshotTo(std::ostream& str) const;
+
+  /**
+   * @brief Read from the stream a `Context` snapshot written by
+   * `writeSnapshotTo`, restoring the stored tables.
+   * @param str Input `std::istream`.
+   * @return The deserialized `Context` object.
+   * @note If the tables fail the checksum, or do not match the parameters,
+   * a warning is issued and they are recomputed, the same as `readFrom`.
+   **/
+  static Context readSnapshotFrom(std::istream& str);
+
+  /**
+   * @brief Read from the stream a `Context` snapshot written by
+   * `writeSnapshotTo`, restoring the stored tables.
+   * @param str Input `std::istream`.
+   * @return Raw pointer to the deserialized `Context` object.
+   * @note If the tables fail the checksum, or do not match the parameters,
+   * a warning is issued and they are recomputed, the same as `readPtrFrom`.
+   **/
+  static Context* readSnapshotPtrFrom(std::istream& str);
+
   /**
    * @brief Write out the `Context` object to the output stream using JSON
    * format.
@@ -1076,6 +1270,7 @@ private:
   long resolution_ = 3;
   long bitsInSpecialPrimes_ = 0;
   bool buildModChainFlag_ = true; // Default build the modchain.
+  bool nativeNTTFlag_ = true;     // Default use the native NTT for m = 2^k.
 
   double stdev_ = 3.2;
   double scale_ = 10;
@@ -1265,6 +1460,20 @@ public:
     return *this;
   }
 
+  /**
+   * @brief Sets a flag determining whether the native negacyclic NTT is
+   * used for the CRT transforms when `m` is a power of two.
+   * @param `yesno` A `bool`, if `false` NTL's FFT is used instead.
+   * @return Reference to the `ContextBuilder` object.
+   * @note `ContextBuilder` by default will use the native NTT. This has no
+   * effect when `m` is not a power of two.
+   **/
+  ContextBuilder& nativeNTT(bool yesno = true)
+  {
+    nativeNTTFlag_ = yesno;
+    return *this;
+  }
+
   /**
    * @brief Sets `mvec` the unique primes which are factors of `m`.
    * @param mvec An `NTL::Vec` of primes factors.
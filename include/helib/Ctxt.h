@@ -396,7 +396,9 @@ class Ctxt
 {
   friend class PubKey;
   friend class SecKey;
-  friend class BasicAutomorphPrecon;
+  friend class HoistedCtxt;
+  friend class ArchiveWriter;
+  friend class MappedArchive;
 
   const Context& context;      // points to the parameters of this FHE instance
   const PubKey& pubKey;        // points to the public encryption key;
@@ -411,6 +413,11 @@ class Ctxt
   NTL::xdouble ratFactor; // rational factor to divide on decryption (for CKKS)
   NTL::xdouble ptxtMag;   // bound on the plaintext size (for CKKS)
 
+  // Nonzero for fresh symmetric encryptions (and the public encryption key),
+  // whose parts[1] is uniform and was generated from this seed. Operations
+  // on the ciphertext do not reset it, see isCompressible().
+  NTL::ZZ prgSeed;
+
   // Create a tensor product of c1,c2. It is assumed that *this,c1,c2
   // are defined relative to the same set of primes and plaintext space,
   // and that *this DOES NOT point to the same object as c1,c2
@@ -477,7 +484,8 @@ class Ctxt
   void keySwitchPart(const CtxtPart& p, const KeySwitch& W);
 
   // internal procedure used in key-switching
-  void keySwitchDigits(const KeySwitch& W, std::vector<DoubleCRT>& digits);
+  void keySwitchDigits(const KeySwitch& W,
+                       const std::vector<DoubleCRT>& digits);
 
   long getPartIndexByHandle(const SKHandle& handle) const
   {
@@ -495,6 +503,7 @@ class Ctxt
   // public key, this is needed when we copy the pubEncrKey member between
   // different public keys.
   Ctxt& privateAssign(const Ctxt& other);
+  Ctxt& privateAssign(Ctxt&& other);
 
   // explicitly multiply intFactor by e, which should be
   // in the interval [0, ptxtSpace)
@@ -510,6 +519,10 @@ public:
   // Default copy-constructor
   Ctxt(const Ctxt& other) = default;
 
+  // Move-constructor, takes over the parts and prime set of other (which is
+  // left empty, with an empty prime set)
+  Ctxt(Ctxt&& other);
+
   // VJS-FIXME: this was really a messy design choice to not
   // have ciphertext constructors that specify prime sets.
   // The default value of ctxtPrimes is kind of pointless.
@@ -538,6 +551,20 @@ public:
     return privateAssign(other);
   }
 
+  // Move assignment, takes over the parts of other (which is left with
+  // none, and an empty prime set). The context and public key must match,
+  // as for copy assignment.
+  Ctxt& operator=(Ctxt&& other)
+  {
+    assertEq(&context,
+             &other.context,
+             "Cannot assign Ctxts with different context");
+    assertEq(&pubKey,
+             &other.pubKey,
+             "Cannot assign Ctxts with different pubKey");
+    return privateAssign(std::move(other));
+  }
+
   bool operator==(const Ctxt& other) const { return equalsTo(other); }
   bool operator!=(const Ctxt& other) const { return !equalsTo(other); }
 
@@ -722,6 +749,14 @@ public:
   //! explicitly computed bounds (if not CKKS).
   void multByConstant(const DoubleCRT& dcrt, double size = -1.0);
 
+  //! Multiply-accumulate: *this += dcrt*other, with size as in multByConstant.
+  //! When the two BGV ciphertexts agree on their prime-set, plaintext space,
+  //! integer factor and key handles, this is done in place with a single
+  //! modular reduction per coefficient, without a temporary ciphertext.
+  void addConstantProduct(const DoubleCRT& dcrt,
+                          const Ctxt& other,
+                          double size = -1.0);
+
   void multByConstant(const NTL::ZZX& poly, double size = -1.0);
   void multByConstant(const zzX& poly, double size = -1.0);
 
@@ -1229,7 +1264,8 @@ public:
   void divideBy2();
   void extractBits(std::vector<Ctxt>& bits, long nBits2extract = 0);
 
-  // Higher-level multiply routines
+  // Higher-level multiply routines, these re-linearize the product unless
+  // the context defers it (see Context::setLazyRelinearization)
   void multiplyBy(const Ctxt& other);
   void multiplyBy2(const Ctxt& other1, const Ctxt& other2);
   void square() { multiplyBy(*this); }
@@ -1356,6 +1392,7 @@ public:
     noiseBound = 0.0;
     intFactor = 1;
     ratFactor = ptxtMag = 1.0;
+    NTL::clear(prgSeed);
   }
 
   //! @brief Is this an empty ciphertext without any parts
@@ -1421,11 +1458,23 @@ public:
 
   // Raw IO
 
+  /**
+   * @brief Whether the ciphertext can be written in compressed form, i.e.,
+   * it is (still) a fresh symmetric encryption whose uniformly random part
+   * can be written as the seed it was generated from.
+   * This regenerates that part from the seed and compares, so it costs about
+   * as much as a DoubleCRT::randomize.
+   **/
+  bool isCompressible() const;
+
   /**
    * @brief Write out the `Ctxt` object in binary format.
    * @param str Output `std::ostream`.
+   * @param compressed If set, and the ciphertext isCompressible(), its
+   * uniformly random part is written as a seed, roughly halving the size.
+   * Ciphertexts written either way are read by read().
    **/
-  void writeTo(std::ostream& str) const;
+  void writeTo(std::ostream& str, bool compressed = false) const;
 
   /**
    * @brief Read from the stream the serialized `Ctxt` object in binary format.
@@ -1445,14 +1494,16 @@ public:
    * @brief Write out the ciphertext (`Ctxt`) object to the output
    * stream using JSON format.
    * @param str Output `std::ostream`.
+   * @param compressed Write the compressed form if possible, see writeTo.
    **/
-  void writeToJSON(std::ostream& str) const;
+  void writeToJSON(std::ostream& str, bool compressed = false) const;
 
   /**
    * @brief Write out the ciphertext (`Ctxt`) object to a `JsonWrapper`.
+   * @param compressed Write the compressed form if possible, see writeTo.
    * @return The `JsonWrapper`.
    **/
-  JsonWrapper writeToJSON() const;
+  JsonWrapper writeToJSON(bool compressed = false) const;
 
   /**
    * @brief Read from the stream the serialized ciphertext (`Ctxt`) object using
@@ -1562,6 +1613,80 @@ inline void power(Ctxt& ctxt, long e) { ctxt.power(e); }
 //! negate: free function version of negate method
 inline void negate(Ctxt& ctxt) { ctxt.negate(); }
 
+//! @name Binary ciphertext arithmetic
+//! These return a new ciphertext. When an operand is an rvalue (a temporary
+//! or the result of std::move), the result is computed in place in it, so
+//! that expressions such as `a * b + c` copy no residues beyond the first.
+//! Multiplication is the high-level one, as in `Ctxt::operator*=`.
+///@{
+inline Ctxt operator+(const Ctxt& a, const Ctxt& b)
+{
+  Ctxt result(a);
+  result += b;
+  return result;
+}
+inline Ctxt operator+(Ctxt&& a, const Ctxt& b)
+{
+  a += b;
+  return std::move(a);
+}
+inline Ctxt operator+(const Ctxt& a, Ctxt&& b)
+{
+  b += a;
+  return std::move(b);
+}
+inline Ctxt operator+(Ctxt&& a, Ctxt&& b)
+{
+  a += b;
+  return std::move(a);
+}
+
+inline Ctxt operator-(const Ctxt& a, const Ctxt& b)
+{
+  Ctxt result(a);
+  result -= b;
+  return result;
+}
+inline Ctxt operator-(Ctxt&& a, const Ctxt& b)
+{
+  a -= b;
+  return std::move(a);
+}
+inline Ctxt operator-(const Ctxt& a, Ctxt&& b)
+{
+  b.negate();
+  b += a;
+  return std::move(b);
+}
+inline Ctxt operator-(Ctxt&& a, Ctxt&& b)
+{
+  a -= b;
+  return std::move(a);
+}
+
+inline Ctxt operator*(const Ctxt& a, const Ctxt& b)
+{
+  Ctxt result(a);
+  result *= b;
+  return result;
+}
+inline Ctxt operator*(Ctxt&& a, const Ctxt& b)
+{
+  a *= b;
+  return std::move(a);
+}
+inline Ctxt operator*(const Ctxt& a, Ctxt&& b)
+{
+  b *= a;
+  return std::move(b);
+}
+inline Ctxt operator*(Ctxt&& a, Ctxt&& b)
+{
+  a *= b;
+  return std::move(a);
+}
+///@}
+
 //! print to cerr some info about ciphertext
 void CheckCtxt(const Ctxt& c, const char* label);
 
@@ -17,40 +17,13 @@
  **/
 #include <helib/zzX.h>
 #include <helib/NumbTh.h>
-#include <helib/IndexMap.h>
+#include <helib/ResidueMatrix.h>
 #include <helib/timing.h>
 
 namespace helib {
 
 class Context;
 
-/**
- * @class DoubleCRTHelper
- * @brief A helper class to enforce consistency within an DoubleCRTHelper object
- *
- * See Section 2.6.2 of the design document (IndexMap)
- */
-class DoubleCRTHelper : public IndexMapInit<NTL::vec_long>
-{
-private:
-  long val;
-
-public:
-  DoubleCRTHelper(const Context& context);
-
-  /** @brief the init method ensures that all rows have the same size */
-  virtual void init(NTL::vec_long& v) { v.FixLength(val); }
-
-  /** @brief clone allocates a new object and copies the content */
-  virtual IndexMapInit<NTL::vec_long>* clone() const
-  {
-    return new DoubleCRTHelper(*this);
-  }
-
-private:
-  DoubleCRTHelper(); // disable default constructor
-};
-
 /**
  * @class DoubleCRT
  * @brief Implementing polynomials (elements in the ring R_Q) in double-CRT
@@ -62,10 +35,11 @@ private:
  * The polynomial thus represented is defined modulo the product of all the
  * primes in use.
  *
- * The list of primes is defined by the data member indexMap.
- * indexMap.getIndexSet() defines the set of indices of primes
+ * The list of primes is defined by the data member map.
+ * map.getIndexSet() defines the set of indices of primes
  * associated with this DoubleCRT object: they index the
- * primes stored in the associated Context.
+ * primes stored in the associated Context. All the rows are kept in a
+ * single cache-aligned buffer (see ResidueMatrix).
  *
  * Arithmetic operations are computed modulo the product of the primes in use
  * and also modulo Phi_m(X). Arithmetic operations can only be applied to
@@ -76,9 +50,9 @@ class DoubleCRT
 {
   const Context& context; // the context
 
-  // the data itself: if the i'th prime is in use then map[i] is the std::vector
-  // of evaluations wrt this prime
-  IndexMap<NTL::vec_long> map;
+  // the data itself: if the i'th prime is in use then map[i] points to the
+  // phi(m) evaluations wrt this prime
+  ResidueMatrix map;
 
   //! a "sanity check" method, verifies consistency of the map with
   //! current moduli chain, an error is raised if they are not consistent
@@ -119,6 +93,20 @@ class DoubleCRT
   template <typename Fun>
   DoubleCRT& Op(const NTL::ZZX& poly, Fun fun);
 
+  // RNS base extension (see BaseConverter), without going through ZZX.
+  // iFFTRows writes the coefficients of the rows in s to coeffs, one row
+  // of phi(m) longs per prime; FFTRow sets y to the evaluations of the
+  // coefficients in coeffs (which may alias y) modulo the i'th prime.
+  void iFFTRows(long* coeffs, const IndexSet& s) const;
+  void FFTRow(long* y, const long* coeffs, long i) const;
+
+  // Fill in the rows of `to` (already in the map) from the balanced lift
+  // of the rows of `from`. If frac is not null, it receives the
+  // coefficients of that lift divided by the product of the primes in from.
+  void extendRows(const IndexSet& from,
+                  const IndexSet& to,
+                  std::vector<double>* frac = nullptr);
+
 public:
   // Constructors and assignment operators
 
@@ -130,6 +118,9 @@ public:
   // Default copy-constructor:
   DoubleCRT(const DoubleCRT& other) = default;
 
+  // Default move-constructor, takes over the residues of other
+  DoubleCRT(DoubleCRT&& other) = default;
+
   //! @brief Initializing DoubleCRT from a ZZX polynomial
   //! @param poly The ring element itself, zero if not specified
   //! @param _context The context for this DoubleCRT object, use "current active
@@ -183,6 +174,10 @@ public:
 
   DoubleCRT& operator=(const DoubleCRT& other);
 
+  // Move assignment, takes over the residues of other (which is left with
+  // no primes). The contexts must match, as for copy assignment.
+  DoubleCRT& operator=(DoubleCRT&& other);
+
   // Copy only the primes in s \intersect other.getIndexSet()
   //  void partialCopy(const DoubleCRT& other, const IndexSet& s);
 
@@ -263,7 +258,8 @@ public:
   //! @brief Expand the index set by s1.
   //! It is assumed that s1 is disjoint from the current index set.
   //! If poly_p != 0, then *poly_p will first be set to the result of applying
-  //! toPoly.
+  //! toPoly. Otherwise the new rows are computed by RNS base extension,
+  //! without recovering the polynomial.
   void addPrimes(const IndexSet& s1, NTL::ZZX* poly_p = 0);
 
   //! @brief Expand index set by s1, and multiply by Prod_{q in s1}.
@@ -352,6 +348,28 @@ public:
     do_mul(other, matchIndexSets);
   }
 
+  //! @brief Set *this = sum_i a[i]*b[i] for i < a.size(), using the
+  //! current index set of *this. The index sets of all the a[i], b[i] must
+  //! contain that of *this. The primes are processed in parallel.
+  //! The products are accumulated in double-word integers and every
+  //! coefficient is reduced only once (see lazyReductionBound()), if NTL
+  //! has a double-word type (NTL_HAVE_LL_TYPE).
+  DoubleCRT& dotProduct(const std::vector<DoubleCRT>& a,
+                        const std::vector<DoubleCRT>& b);
+
+  //! @brief Set *this += a*b using the current index set of *this, with a
+  //! single modular reduction per coefficient. The index sets of a and b
+  //! must contain that of *this.
+  DoubleCRT& addProduct(const DoubleCRT& a, const DoubleCRT& b);
+
+  //! @brief The number of products of residues that can be summed in a
+  //! double-word accumulator (together with one more residue) before it
+  //! must be reduced. This is at least 15 for any NTL configuration.
+  static constexpr long lazyReductionBound()
+  {
+    return (1L << (2 * (NTL_BITS_PER_LONG - NTL_SP_NBITS))) - 1;
+  }
+
   // Division by constant
   DoubleCRT& operator/=(const NTL::ZZ& num);
   DoubleCRT& operator/=(long num) { return (*this /= NTL::to_ZZ(num)); }
@@ -374,9 +392,16 @@ public:
   // Utilities
 
   const Context& getContext() const { return context; }
-  const IndexMap<NTL::vec_long>& getMap() const { return map; }
+  const ResidueMatrix& getMap() const { return map; }
   const IndexSet& getIndexSet() const { return map.getIndexSet(); }
 
+  //! @brief Make this object a view of the residues at `rows`, laid out as
+  //! described in ResidueMatrix::attach, without copying them.
+  //! See MappedArchive for where such buffers come from.
+  void attach(const IndexSet& s,
+              long* rows,
+              std::shared_ptr<const void> rowsOwner);
+
   // Choose random DoubleCRT's, either at random or with small/Gaussian
   // coefficients.
 
@@ -408,6 +433,13 @@ public:
   // used to implement modulus switching
   void scaleDownToSet(const IndexSet& s, long ptxtSpace, NTL::ZZX& delta);
 
+  //! @brief Same as above, but computed in RNS form. Sets fdelta to the
+  //! coefficients of delta divided by the product of the dropped primes
+  //! (as doubles), which is all that modulus switching needs of delta.
+  void scaleDownToSet(const IndexSet& s,
+                      long ptxtSpace,
+                      std::vector<double>& fdelta);
+
   void FFT(const NTL::ZZX& poly, const IndexSet& s);
   void FFT(const zzX& poly, const IndexSet& s);
   // for internal use
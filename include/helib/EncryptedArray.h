@@ -77,6 +77,7 @@ typedef std::complex<double> cx_double;
 class PlaintextArray; // forward reference
 class PtxtArray;      // forward reference
 class EncryptedArray; // forward reference
+class HoistedCtxt;    // forward reference
 
 typedef EncryptedArray View;
 // New and improved name for EncryptedArray.
@@ -145,6 +146,15 @@ public:
   //! optimizations that would not otherwise be possible
   virtual void rotate1D(Ctxt& ctxt, long i, long k, bool dc = false) const = 0;
 
+  //! @brief Hoisted variant of rotate1D: set out to the rotation of
+  //! in.getCtxt() by k positions along the i'th dimension, reusing the
+  //! digits that were computed when in was constructed (see HoistedCtxt)
+  virtual void rotate1D(Ctxt& out,
+                        const HoistedCtxt& in,
+                        long i,
+                        long k,
+                        bool dc = false) const = 0;
+
   //! @brief Right shift k positions along the i'th dimension with zero fill
   virtual void shift1D(Ctxt& ctxt, long i, long k) const = 0;
 
@@ -421,6 +431,10 @@ private:
   NTL::Lazy<NTL::Pair<NTL::Mat<R>, NTL::Mat<R>>> normalBasisMatrices;
   // a is the matrix, b is its inverse
 
+  // Combine ctxt = rho_i^amt(c) and T = rho_i^{amt-ord}(c) into the
+  // non-native rotation of c by amt along dimension i
+  void blendRotation(Ctxt& ctxt, Ctxt& T, long i, long amt) const;
+
 public:
   explicit EncryptedArrayDerived(const Context& _context,
                                  const RX& _G,
@@ -495,6 +509,11 @@ public:
                         long i,
                         long k,
                         bool dc = false) const override;
+  virtual void rotate1D(Ctxt& out,
+                        const HoistedCtxt& in,
+                        long i,
+                        long k,
+                        bool dc = false) const override;
 
   long getP2R() const override { return getTab().getPPowR(); }
 
@@ -920,6 +939,11 @@ public:
   void rotate(Ctxt& ctxt, long k) const override;
   void shift(Ctxt& ctxt, long k) const override;
   void rotate1D(Ctxt& ctxt, long i, long k, bool dc = false) const override;
+  void rotate1D(Ctxt& out,
+                const HoistedCtxt& in,
+                long i,
+                long k,
+                bool dc = false) const override;
   void shift1D(Ctxt& ctxt, long i, long k) const override;
 
   long getP2R() const override { return alMod.getPPowR(); }
@@ -1123,6 +1147,14 @@ public:
     return encode(ptxt, tmp, useThisSize, precision);
   }
 
+  // Batch version: ptxts[i] is the encoding of arrays[i], and the scaling
+  // factors are returned in the same order. The transforms of the arrays
+  // are batched, see CKKS_embedInSlots.
+  std::vector<double> encode(std::vector<zzX>& ptxts,
+                             const std::vector<std::vector<cx_double>>& arrays,
+                             double useThisSize,
+                             long precision = -1) const;
+
   /**
    * @brief Encode a `Ptxt` object into a `zzX`.
    * @tparam Scheme Encryption scheme to be used (either `BGV` or `CKKS`).
@@ -1352,6 +1384,13 @@ public:
               const zzX& ptxt,
               double scaling) const;
 
+  // Batch version: arrays[i] is the decoding of ptxts[i] with scaling[i].
+  // The transforms of the polynomials are batched, see
+  // CKKS_canonicalEmbedding.
+  void decode(std::vector<std::vector<cx_double>>& arrays,
+              const std::vector<zzX>& ptxts,
+              const std::vector<double>& scaling) const;
+
   void decode(std::vector<cx_double>& array,
               const NTL::ZZX& ptxt,
               double scaling) const
@@ -1400,6 +1439,15 @@ public:
                std::vector<cx_double>& ptxt,
                OptLong prec = OptLong()) const override;
 
+  //! The second half of decrypt: decodes pp, the raw decryption of ctxt
+  //! under sKey, after adding the same noise that decrypt adds to it.
+  //! Used by SecKey::decryptBatch, which decrypts the polynomials in bulk.
+  void decodeDecrypted(std::vector<cx_double>& ptxt,
+                       const NTL::ZZX& pp,
+                       const Ctxt& ctxt,
+                       const SecKey& sKey,
+                       OptLong prec = OptLong()) const;
+
   void decrypt(const Ctxt& ctxt,
                const SecKey& sKey,
                std::vector<double>& ptxt,
@@ -1675,6 +1723,14 @@ public:
   {
     rep->rotate1D(ctxt, i, k, dc);
   }
+  void rotate1D(Ctxt& out,
+                const HoistedCtxt& in,
+                long i,
+                long k,
+                bool dc = false) const
+  {
+    rep->rotate1D(out, in, i, k, dc);
+  }
   void shift1D(Ctxt& ctxt, long i, long k) const { rep->shift1D(ctxt, i, k); }
 
   void encode(zzX& ptxt, const std::vector<long>& array) const
@@ -2530,6 +2586,25 @@ inline void rotate1D(PtxtArray& a, long i, long k)
 
 inline void shift1D(PtxtArray& a, long i, long k) { shift1D(a.ea, a.pa, i, k); }
 
+//! @brief Encrypts a batch of plaintext arrays under pk, equivalent to
+//! ptxts[i].encrypt(ctxts[i], mag, prec) for all i. ctxts is resized to the
+//! size of ptxts. The batch is encoded across the NTL threads, then
+//! encrypted by PubKey::encryptBatch.
+void encryptBatch(std::vector<Ctxt>& ctxts,
+                  const std::vector<PtxtArray>& ptxts,
+                  const PubKey& pk,
+                  double mag = -1,
+                  OptLong prec = OptLong());
+
+//! @brief Decrypts a batch of ciphertexts, equivalent to
+//! ptxts[i].decrypt(ctxts[i], sKey, prec) for all i. ptxts is resized to
+//! the size of ctxts. The batch is decrypted by SecKey::decryptBatch, then
+//! decoded across the NTL threads.
+void decryptBatch(std::vector<PtxtArray>& ptxts,
+                  const std::vector<Ctxt>& ctxts,
+                  const SecKey& sKey,
+                  OptLong prec = OptLong());
+
 inline bool operator==(const PtxtArray& a, const PtxtArray& b)
 {
   assertTrue(&a.ea == &b.ea, "PtxtArray: inconsistent operation");
@@ -72,6 +72,11 @@ public:
   // normal basis transformation when invert == true.
   // On by default, off for testing
 
+  // Read the matrices written by writeTo (with the constants in the format
+  // they had then), instead of building them
+  EvalMap(const EncryptedArray& _ea, std::istream& str);
+  void writeTo(std::ostream& str) const;
+
   void upgrade();
   void apply(Ctxt& ctxt) const;
 };
@@ -99,6 +104,9 @@ public:
               bool _invert,
               bool build_cache);
 
+  ThinEvalMap(const EncryptedArray& _ea, std::istream& str);
+  void writeTo(std::ostream& str) const;
+
   void upgrade();
   void apply(Ctxt& ctxt) const;
 };
@@ -0,0 +1,73 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_HOISTEDCTXT_H
+#define HELIB_HOISTEDCTXT_H
+/**
+ * @file HoistedCtxt.h
+ * @brief Hoisted key-switching: many automorphisms of the same ciphertext.
+ **/
+
+#include <memory>
+#include <vector>
+#include <helib/Ctxt.h>
+
+namespace helib {
+
+/**
+ * @class HoistedCtxt
+ * @brief Pre-computation to speed many automorphism on the same ciphertext.
+ *
+ * The expensive part of homomorphic automorphism is breaking the ciphertext
+ * parts into digits. The usual setting is we first rotate the ciphertext
+ * parts, then break them into digits. But when we apply many automorphisms
+ * it is faster to break the original ciphertext into digits, then rotate
+ * the digits (as opposed to first rotate, then break).
+ * A HoistedCtxt object breaks the original ciphertext and keeps the digits,
+ * then when you call automorph is only needs to apply the native automorphism
+ * and key switching to the digits, which is fast(er).
+ *
+ * A typical usage is
+ * \code
+ *   HoistedCtxt hoisted(ctxt); // decompose ctxt once
+ *   for (long k : amounts) {
+ *     Ctxt tmp(ZeroCtxtLike, ctxt);
+ *     ea.rotate1D(tmp, hoisted, 0, k); // tmp = rotate1D(ctxt, 0, k)
+ *     ...
+ *   }
+ * \endcode
+ * The automorphism methods are const, so the same HoistedCtxt can be used
+ * concurrently from several threads.
+ **/
+class HoistedCtxt
+{
+  Ctxt ctxt;
+  NTL::xdouble noise;
+  std::vector<DoubleCRT> polyDigits;
+
+public:
+  //! @brief Decompose ctxt into digits (ctxt itself is not modified)
+  explicit HoistedCtxt(const Ctxt& ctxt);
+
+  //! @brief The ciphertext being hoisted (after cleanUp())
+  const Ctxt& getCtxt() const { return ctxt; }
+
+  //! @brief Set out to the automorphism X -> X^k of the hoisted ciphertext.
+  //! This is equivalent to `out = ctxt; out.smartAutomorph(k);`
+  void automorph(Ctxt& out, long k) const;
+
+  //! @brief Same as above, returning a newly allocated ciphertext.
+  std::shared_ptr<Ctxt> automorph(long k) const;
+};
+
+} // namespace helib
+
+#endif // ifndef HELIB_HOISTEDCTXT_H
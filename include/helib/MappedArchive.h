@@ -0,0 +1,248 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_MAPPEDARCHIVE_H
+#define HELIB_MAPPEDARCHIVE_H
+/**
+ * @file MappedArchive.h
+ * @brief A memory-mappable container of ciphertexts and key-switching
+ * matrices.
+ *
+ * The binary serialization of Ctxt (Ctxt::writeTo / Ctxt::read) goes through
+ * a stream one number at a time, and reading a ciphertext copies all of its
+ * residues into fresh buffers. An archive instead stores the residues of
+ * every DoubleCRT exactly as ResidueMatrix keeps them in memory: one block of
+ * rows per DoubleCRT, each row `ResidueMatrix::ALIGNMENT`-aligned. Opening an
+ * archive maps the file into memory, and the ciphertexts read from it are
+ * views of the mapped rows, so no residue is copied. The residues of an item
+ * are only read once, to check them, when it is mapped; the matrices of a
+ * KeySwitchStore are not read before they are first used or handed out.
+ *
+ * Layout of the file (all numbers are 64-bit, in the byte order of the
+ * machine that wrote it; the header records it):
+ *
+ *     header      magic, byte-order mark, version, m, phi(m), row stride,
+ *                 number of primes, offset of the table of contents
+ *     primes      the moduli of the context, used to validate it on open
+ *     items       for each item, its residue blocks followed by a record
+ *                 with its metadata and the offsets of its blocks
+ *     contents    number of items, then the kind and record offset of each
+ *
+ * The header and every residue block start on a 64-byte boundary.
+ **/
+
+#include <fstream>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <helib/Context.h>
+#include <helib/Ctxt.h>
+#include <helib/keySwitching.h>
+#include <helib/multicore.h>
+
+namespace helib {
+
+/**
+ * @class ArchiveWriter
+ * @brief Writes ciphertexts and key-switching matrices to an archive that
+ * can be opened with MappedArchive.
+ *
+ * Items are appended in order and numbered from 0. The table of contents
+ * is written by close(), which the destructor calls if needed.
+ **/
+class ArchiveWriter
+{
+public:
+  //! @brief Create (or truncate) the archive at path for objects of context
+  ArchiveWriter(const std::string& path, const Context& context);
+  ~ArchiveWriter();
+
+  ArchiveWriter(const ArchiveWriter&) = delete;
+  ArchiveWriter& operator=(const ArchiveWriter&) = delete;
+
+  //! @brief Append a ciphertext, returns its item number
+  long append(const Ctxt& ctxt);
+
+  //! @brief Append a key-switching matrix, returns its item number
+  long append(const KeySwitch& ksm);
+
+  //! @brief Number of items appended so far
+  long size() const { return toc.size(); }
+
+  //! @brief Write the table of contents and close the file
+  void close();
+
+private:
+  const Context& context;
+  std::ofstream str;
+  std::vector<std::pair<long, long>> toc; // (kind, record offset)
+  long stride;
+
+  void pad();
+  long writeResidues(const DoubleCRT& d);
+};
+
+/**
+ * @class MappedArchive
+ * @brief A read-only, memory-mapped view of an archive.
+ *
+ * The ciphertexts and matrices obtained from an archive share its mapping
+ * (a private, copy-on-write mapping): they can be used and modified like any
+ * other object, which never changes the file, and they remain valid after
+ * the MappedArchive itself is destroyed. Copying them makes ordinary deep
+ * copies.
+ *
+ * The records and residues of an item are checked when it is mapped: a
+ * prime index that is not one of the context's, or a residue that is not
+ * reduced modulo its prime, throws an IOError, as a truncated file does.
+ **/
+class MappedArchive
+{
+public:
+  //! @brief The kinds of items in an archive
+  enum class ItemKind : long
+  {
+    CTXT = 1,
+    KEY_SWITCH = 2
+  };
+
+  //! @brief Map the archive at path, whose items must have been written
+  //! for a context with the same m and primes as context
+  MappedArchive(const std::string& path, const Context& context);
+
+  //! @brief Number of items in the archive
+  long size() const { return toc.size(); }
+
+  //! @brief The kind of item i
+  ItemKind kind(long i) const;
+
+  //! @brief Set ctxt to a view of ciphertext number i.
+  //! The public key of ctxt is not changed, and must be the one that
+  //! the ciphertext was encrypted under.
+  void get(Ctxt& ctxt, long i) const;
+
+  //! @brief Set ksm to a view of key-switching matrix number i. If check
+  //! is false, the residues are neither read nor checked yet, and the
+  //! caller must call checkResidues(i) before the matrix is used.
+  void get(KeySwitch& ksm, long i, bool check = true) const;
+
+  //! @brief Check that the residues of item i are reduced modulo their
+  //! primes, throwing an IOError on the first one that is not
+  void checkResidues(long i) const;
+
+  //! @brief Drop the pages of the residues of item i that are resident in
+  //! memory. They are read again from the file when the item is next used,
+  //! so the views of the item stay valid, but any change made to them
+  //! through those pages is lost.
+  void release(long i) const;
+
+private:
+  struct Mapping;
+
+  const Context& context;
+  std::shared_ptr<Mapping> mapping;
+  std::vector<std::pair<long, long>> toc; // (kind, record offset)
+
+  void attach(DoubleCRT& d,
+              const IndexSet& s,
+              long blockOffset,
+              const std::string& what,
+              bool check = true) const;
+
+  // Throw an IOError if a residue in the rows for the primes s is out of
+  // range, what names the item in the message
+  void checkRows(const long* rows,
+                 const IndexSet& s,
+                 const std::string& what) const;
+
+  // The (offset, primes) of the residue blocks of item i
+  std::vector<std::pair<long, IndexSet>> blocks(long i) const;
+};
+
+/**
+ * @class KeySwitchStore
+ * @brief The key-switching matrices of a public key, kept in an archive and
+ * read from the mapping only when they are used (see PubKey::openKeyStore).
+ *
+ * With all the rotation and bootstrapping matrices, a public key can take
+ * many GB. A key that uses a store holds views of the mapped matrices, so
+ * only the matrices that are actually used are ever read, and the store
+ * keeps at most maxResident of them in memory: when a use brings in one
+ * more, the pages of the least recently used matrix are released (see
+ * MappedArchive::release), to be read again if it is needed later.
+ *
+ * The bound counts the matrices that the key hands out for key switching.
+ * A matrix may be released while another thread still uses it, in which
+ * case its pages are just read again, so the bound can be exceeded for a
+ * moment but the results never change. The matrices must not be modified.
+ **/
+class KeySwitchStore
+{
+public:
+  //! @brief Write the matrices to a new store at path
+  static void write(const std::string& path,
+                    const Context& context,
+                    const std::vector<KeySwitch>& matrices);
+
+  //! @brief Open the store at path, written for a context with the same m
+  //! and primes as context. If maxResident <= 0, the number of matrices in
+  //! memory is not bounded (they are still only read when used).
+  KeySwitchStore(const std::string& path,
+                 const Context& context,
+                 long maxResident = 0);
+
+  KeySwitchStore(const KeySwitchStore&) = delete;
+  KeySwitchStore& operator=(const KeySwitchStore&) = delete;
+
+  //! @brief Number of matrices in the store
+  long size() const { return archive.size(); }
+
+  //! @brief Set ksm to a view of matrix number i. Its residues are not
+  //! read until the first check(i) or touch(i). The view must not be used
+  //! before that.
+  void get(KeySwitch& ksm, long i) const;
+
+  //! @brief Check the residues of matrix number i, unless that was done
+  //! already, see MappedArchive::checkResidues. Thread safe.
+  void check(long i) const;
+
+  //! @brief Check the residues of all the matrices, see check(i)
+  void checkAll() const;
+
+  //! @brief Record a use of matrix number i, releasing the least recently
+  //! used matrices if there are more than maxResident. The first use of a
+  //! matrix checks its residues, see check(i). Thread safe.
+  void touch(long i) const;
+
+  long getMaxResident() const { return maxResident; }
+
+  //! @brief Number of matrices used and not released since. Uses are only
+  //! tracked with a bound, so this is 0 if maxResident <= 0.
+  long numResident() const;
+
+private:
+  MappedArchive archive;
+  long maxResident;
+
+  mutable HELIB_MUTEX_TYPE lruMutex;
+  mutable std::list<long> lru; // the resident matrices, most recent first
+  // where[i] is the position of matrix i in lru, or lru.end()
+  mutable std::vector<std::list<long>::iterator> where;
+  // checked[i] is set once the residues of matrix i have been checked. Two
+  // threads may both check a matrix on its first use, which is harmless.
+  std::unique_ptr<HELIB_atomic_long[]> checked;
+};
+
+} // namespace helib
+
+#endif // ifndef HELIB_MAPPEDARCHIVE_H
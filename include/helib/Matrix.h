@@ -295,6 +295,22 @@ public:
     return Tensor<T, 2>(ts, this->elements_ptr);
   }
 
+  // A view of the count rows starting at row i
+  Tensor<T, 2> getRows(std::size_t i, std::size_t count) const
+  {
+    if (count == 0 || i + count > this->dims(0)) {
+      throw OutOfRangeError("Rows given: [" + std::to_string(i) + ", " +
+                            std::to_string(i + count) +
+                            "). Max value is: " + std::to_string(this->dims(0)));
+    }
+    TensorSlice<2> ts(this->subscripts);
+    ts.lengths.front() = count;
+    ts.start = {/*row X strides*/ static_cast<long>(i * ts.strides.at(0))};
+    ts.size = count * ts.lengths[1];
+
+    return Tensor<T, 2>(ts, this->elements_ptr);
+  }
+
   Tensor<T, 2> getColumn(std::size_t j) const
   {
     if (j >= this->dims(1)) {
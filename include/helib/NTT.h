@@ -0,0 +1,91 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_NTT_H
+#define HELIB_NTT_H
+/**
+ * @file NTT.h
+ * @brief A native negacyclic NTT modulo a single-precision prime
+ **/
+#include <vector>
+
+namespace helib {
+
+/**
+ * @class NegacyclicNTT
+ * @brief Forward and inverse negacyclic NTT of length n = 2^logn modulo q.
+ *
+ * Given a primitive 2n-th root of unity psi mod q, the forward transform maps
+ * the coefficients of x(X) mod (X^n+1, q) to y[j] = x(psi^{2j+1}) for
+ * j = 0,...,n-1, and the inverse transform maps them back. For m = 2n this is
+ * exactly the evaluation at the primitive m-th roots of unity, in the order
+ * used by DoubleCRT.
+ *
+ * The butterflies are those of D. Harvey, "Faster arithmetic for
+ * number-theoretic transforms" (J. Symb. Comp. 2014): twiddle factors come
+ * with Shoup pre-computed quotients and the intermediate values are kept in
+ * [0,4q) (forward) or [0,2q) (inverse), so the only reductions are
+ * conditional subtractions. This requires q < 2^{NTL_BITS_PER_LONG-2}.
+ *
+ * When HElib is compiled with AVX512-IFMA support (e.g., -march=native on a
+ * processor that has it), the butterflies of the outer layers are computed
+ * eight at a time with 52-bit multiply-add instructions, for primes
+ * q < 2^50. Otherwise (and for the inner layers) the scalar code is used.
+ **/
+class NegacyclicNTT
+{
+  long q = 0;
+  long logn = 0;
+  long n = 0;
+
+  // psiRev[i] = psi^{rev(i)}, ipsiRev[i] = psi^{-rev(i)}, rev() = bit reversal
+  std::vector<unsigned long> psiRev, psiRevPrecon;
+  std::vector<unsigned long> ipsiRev, ipsiRevPrecon;
+  // Shoup quotients with respect to 2^52 for the IFMA butterflies, these
+  // are empty if q is too large or IFMA is not available
+  std::vector<unsigned long> psiRevPrecon52, ipsiRevPrecon52;
+
+  // n^{-1} mod q
+  unsigned long nInv = 0, nInvPrecon = 0;
+
+  // the bit-reversal permutation of [0,n)
+  std::vector<long> rev;
+
+  void bitReverse(unsigned long* a) const;
+
+public:
+  NegacyclicNTT() = default;
+
+  /**
+   * @brief Constructor
+   * @param q The modulus, a prime with q = 1 (mod 2^{logn+1}).
+   * @param psi A primitive 2^{logn+1}-th root of unity mod q.
+   * @param logn The log of the transform length.
+   **/
+  NegacyclicNTT(long q, long psi, long logn);
+
+  long getQ() const { return q; }
+  long getLogN() const { return logn; }
+  long getN() const { return n; }
+
+  //! @brief Whether the AVX512-IFMA butterflies are used for this modulus
+  bool usesIFMA() const { return !psiRevPrecon52.empty(); }
+
+  //! @brief y = NTT(x). Both point to n longs in [0,q), and may alias.
+  void forward(long* y, const long* x) const;
+
+  //! @brief x = NTT^{-1}(y). Both point to n longs in [0,q), and may alias.
+  void inverse(long* x, const long* y) const;
+};
+
+} // namespace helib
+
+#endif // ifndef HELIB_NTT_H
@@ -653,6 +653,16 @@ private:
   RandomState& operator=(const RandomState&); // disable assignment
 };
 
+/**
+ * @brief Derive an independent 256-bit PRG seed from a seed and an index.
+ *
+ * Used when several pseudorandom objects are generated from a single seed,
+ * but must be generated independently of each other (e.g., in parallel):
+ * object i is generated after `SetSeed(deriveSeed(seed, i))`, rather than
+ * from the evolving PRG state after `SetSeed(seed)`.
+ **/
+NTL::ZZ deriveSeed(const NTL::ZZ& seed, long index);
+
 //! @brief Advance the input stream beyond white spaces and a single instance of
 //! the char cc
 void seekPastChar(std::istream& str, int cc);
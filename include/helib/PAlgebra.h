@@ -45,6 +45,24 @@ struct quarter_FFT
   quarter_FFT(long m);
 };
 
+/**
+ * @brief Tables of a PAlgebra and of a PAlgebraMod that are expensive to
+ * compute, so that they can be restored rather than recomputed (see
+ * Context::writeSnapshotTo).
+ **/
+struct PAlgebraTables
+{
+  double polyNormBnd = 0; // see PAlgebra::getPolyNormBnd
+  NTL::ZZX PhimX;         // Phi_m(X)
+
+  // The factors F_t of Phi_m(X) mod p^r, their CRT coefficients and the CRT
+  // table of PAlgebraModDerived, in the order of the slots. These are empty
+  // for CKKS.
+  std::vector<zzX> factors;
+  std::vector<zzX> crtCoeffs;
+  std::vector<zzX> crtTable;
+};
+
 /**
  * @class PAlgebra
  * @brief The structure of (Z/mZ)* /(p)
@@ -146,7 +164,9 @@ public:
   PAlgebra(long mm,
            long pp = 2,
            const std::vector<long>& _gens = std::vector<long>(),
-           const std::vector<long>& _ords = std::vector<long>()); // constructor
+           const std::vector<long>& _ords = std::vector<long>(),
+           const PAlgebraTables* tables = nullptr); // constructor
+  // If tables is not null, polyNormBnd and Phi_m(X) are taken from it
 
   bool operator==(const PAlgebra& other) const;
   bool operator!=(const PAlgebra& other) const { return !(*this == other); }
@@ -475,6 +495,10 @@ public:
   virtual void restoreContext() const = 0;
 
   virtual zzX getMask_zzX(long i, long j) const = 0;
+
+  //! Stores the factorization of Phi_m(X) mod p^r and the CRT tables in
+  //! tables (nothing for CKKS)
+  virtual void getTables(PAlgebraTables& tables) const = 0;
 };
 
 #ifndef DOXYGEN_IGNORE
@@ -586,11 +610,16 @@ private:
 
   void genMaskTable();
   void genCrtTable();
+  void restoreTables(const PAlgebraTables& tables);
 
 public:
   PAlgebraModDerived& operator=(const PAlgebraModDerived&) = delete;
 
-  PAlgebraModDerived(const PAlgebra& zMStar, long r);
+  //! If tables is not null, the factorization of Phi_m(X) and the CRT
+  //! tables are restored from it instead of being computed
+  PAlgebraModDerived(const PAlgebra& zMStar,
+                     long r,
+                     const PAlgebraTables* tables = nullptr);
 
   PAlgebraModDerived(const PAlgebraModDerived& other) // copy constructor
       :
@@ -675,6 +704,8 @@ public:
     return balanced_zzX(maskTable.at(i).at(j));
   }
 
+  void getTables(PAlgebraTables& tables) const override;
+
   ///@{
   //! @name Embedding in the plaintext slots and decoding back
   //! In all the functions below, G must be irreducible mod p,
@@ -800,12 +831,16 @@ public:
   {
     throw LogicError("PAlgebraModCx::getMask_zzX undefined");
   }
+  void getTables(UNUSED PAlgebraTables& tables) const override {}
 };
 
 typedef PAlgebraModDerived<PA_cx> PAlgebraModCx;
 
-//! Builds a table, of type PA_GF2 if p == 2 and r == 1, and PA_zz_p otherwise
-PAlgebraModBase* buildPAlgebraMod(const PAlgebra& zMStar, long r);
+//! Builds a table, of type PA_GF2 if p == 2 and r == 1, and PA_zz_p otherwise.
+//! If tables is not null, the tables are restored from it.
+PAlgebraModBase* buildPAlgebraMod(const PAlgebra& zMStar,
+                                  long r,
+                                  const PAlgebraTables* tables = nullptr);
 
 // A simple wrapper for a pointer to an object of type PAlgebraModBase.
 //
@@ -827,8 +862,10 @@ public:
 
   PAlgebraMod& operator=(const PAlgebraMod&) = delete;
 
-  explicit PAlgebraMod(const PAlgebra& zMStar, long r) :
-      rep(buildPAlgebraMod(zMStar, r))
+  explicit PAlgebraMod(const PAlgebra& zMStar,
+                       long r,
+                       const PAlgebraTables* tables = nullptr) :
+      rep(buildPAlgebraMod(zMStar, r, tables))
   {}
   // constructor
 
@@ -873,6 +910,7 @@ public:
   void restoreContext() const { rep->restoreContext(); }
 
   zzX getMask_zzX(long i, long j) const { return rep->getMask_zzX(i, j); }
+  void getTables(PAlgebraTables& tables) const { rep->getTables(tables); }
 };
 
 //! returns true if the palg parameters match the rest, false otherwise
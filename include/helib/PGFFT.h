@@ -44,6 +44,19 @@ public:
    void apply(std::complex<double>* v) const { apply(v, v); }
    // same as apply(v, v)
 
+   void apply_many(const std::complex<double>* src, std::complex<double>* dst,
+                   long count, long stride) const;
+   // Apply n-point FFT to count vectors, the i-th one being
+   // src[i*stride..i*stride+n-1], storing its result in
+   // dst[i*stride..i*stride+n-1].
+   // This is the same as count calls to apply, but the scratch space
+   // and the tables are shared by the transforms of the batch.
+   // REQUIREMENT: count >= 0, and stride >= n if count > 1
+
+   void apply_many(std::complex<double>* v, long count, long stride) const
+   { apply_many(v, v, count, stride); }
+   // same as apply_many(v, v, count, stride)
+
    // Copy/move constructors/assignment ops deleted, as future implementations
    // may not support them.
    PGFFT(const PGFFT&) = delete;
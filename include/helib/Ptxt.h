@@ -173,6 +173,16 @@ std::ostream& operator<<(std::ostream& is, const Ptxt<Scheme>& ptxt);
  * `PolyMod` type can be easily converted via `static_cast` to more convenient
  * types such as `long` and `NTL::ZZX`.
  *
+ * When the slots are in \f$\mathbb{Z}_{p^r}\f$ (i.e. the order of p in
+ * Zm* is d = 1), the data is instead kept as a dense `std::vector<long>` of
+ * residues mod p^r, and the arithmetic, rotations, shifts and `mapTo01` work
+ * directly on it.  This is transparent: the `PolyMod` slots are rebuilt
+ * when they are asked for (by `getSlotRepr()` or by `operator[]` and
+ * `at()`).  The const methods never modify the object, so they are safe to
+ * call concurrently on a shared object.  As with `std::vector`, a reference
+ * returned by the non-const `operator[]`, `at()` or `getSlotRepr()` is
+ * invalidated by the next operation that modifies the `Ptxt`.
+ *
  * In the `CKKS` case, the slot type is `std::complex<double>`, and has
  * sensible operator overloads supporting operations with other `Ptxt<CKKS>`,
  * `Ctxt`, and `std::complex<double>` objects, as well as performing all
@@ -357,8 +367,18 @@ public:
   /**
    * @brief Get the data held in the slots as a `std::vector<SlotType>`.
    * @return Constant reference to the slot vector.
+   * @note When the slots are in Z_{p^r} this builds the `PolyMod` slots from
+   * the dense data the first time it is called after a modification.
    **/
-  const std::vector<SlotType>& getSlotRepr() const;
+  const std::vector<SlotType>& getSlotRepr();
+
+  /**
+   * @brief Get the data held in the slots as a `std::vector<SlotType>`.
+   * @return A copy of the slot vector.
+   * @note When the slots are in Z_{p^r} the copy is built from the dense
+   * data, the object is not modified.
+   **/
+  std::vector<SlotType> getSlotRepr() const;
 
   /**
    * @brief Converts the slot data in `this` to its single polynomial
@@ -466,9 +486,14 @@ public:
     assertTrue<RuntimeError>(isValid(),
                              "Cannot call operator*= on "
                              "default-constructed Ptxt");
-    for (std::size_t i = 0; i < this->slots.size(); i++) {
-      this->slots[i] *= scalar;
+    if constexpr (std::is_integral<Scalar>::value) {
+      if (flatEligible()) {
+        flatMulBy(scalar);
+        return *this;
+      }
     }
+    for (auto& slot : slotData())
+      slot *= scalar;
     return *this;
   }
 
@@ -497,9 +522,14 @@ public:
     assertTrue<RuntimeError>(isValid(),
                              "Cannot call operator+= on "
                              "default-constructed Ptxt");
-    for (std::size_t i = 0; i < this->slots.size(); i++) {
-      this->slots[i] += scalar;
+    if constexpr (std::is_integral<Scalar>::value) {
+      if (flatEligible()) {
+        flatAdd(scalar);
+        return *this;
+      }
     }
+    for (auto& slot : slotData())
+      slot += scalar;
     return *this;
   }
 
@@ -528,9 +558,14 @@ public:
     assertTrue<RuntimeError>(isValid(),
                              "Cannot call operator-= on "
                              "default-constructed Ptxt");
-    for (std::size_t i = 0; i < this->slots.size(); i++) {
-      this->slots[i] -= scalar;
+    if constexpr (std::is_integral<Scalar>::value) {
+      if (flatEligible()) {
+        flatSub(scalar);
+        return *this;
+      }
     }
+    for (auto& slot : slotData())
+      slot -= scalar;
     return *this;
   }
 
@@ -876,7 +911,41 @@ private:
 
   //! @brief The slot data of the object, where `SlotType` will typically be
   //! `std::complex<double>` (CKKS) or `helib::PolyMod` (BGV).
+  //! Out of date when `slotsValid` is false, see `flat`.
   std::vector<SlotType> slots;
+  bool slotsValid = true;
+
+  //! @brief The dense slot data of a BGV object with d = 1, flat[i] in
+  //! [0, p^r) being the value of slot i.  Used only when `flatValid` is
+  //! true, and then the operations work on it rather than on `slots`.
+  //! At least one of `slots` and `flat` is up to date.
+  std::vector<long> flat;
+  bool flatValid = false;
+
+  //! @brief Whether the dense representation can be used: BGV with d = 1.
+  bool flatEligible() const;
+
+  //! @brief Rebuild `slots` from `flat` if it is out of date (keeps `flat`).
+  void expandSlots();
+
+  //! @brief The up to date `slots`, to be modified (drops `flat`).
+  std::vector<SlotType>& slotData();
+
+  //! @brief The up to date `flat`, to be modified (drops `slots`).
+  //! Requires `flatEligible()`.
+  std::vector<long>& flatData();
+
+  //! @brief Replace the data with the dense `values` (drops `slots`).
+  void setFlat(std::vector<long>&& values);
+
+  //! @brief The dense slot data, `flat` if up to date, else `tmp` computed
+  //! from `slots`.  Requires `flatEligible()`.
+  const std::vector<long>& flatView(std::vector<long>& tmp) const;
+
+  //! @brief Dense versions of the scalar operations.
+  void flatMulBy(long scalar);
+  void flatAdd(long scalar);
+  void flatSub(long scalar);
 
   /**
    * @brief Helper function to convert between different indexing formats.
@@ -0,0 +1,152 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_RESIDUEMATRIX_H
+#define HELIB_RESIDUEMATRIX_H
+/**
+ * @file ResidueMatrix.h
+ * @brief Contiguous storage for the rows of a DoubleCRT object.
+ **/
+
+#include <memory>
+#include <vector>
+#include <helib/IndexSet.h>
+#include <helib/assertions.h>
+
+namespace helib {
+
+/**
+ * @class ResidueMatrix
+ * @brief A matrix of residues indexed by a dynamic set of prime indices.
+ *
+ * ResidueMatrix plays the role that `IndexMap<NTL::vec_long>` used to play
+ * for DoubleCRT: it maps every index in its index set to a row of `rowLen`
+ * longs. Unlike IndexMap, all the rows live in a single buffer whose rows
+ * start on `ALIGNMENT`-byte boundaries, and the index of a prime is mapped to
+ * its row through a plain lookup table rather than a hash map.
+ *
+ * Removing indices only marks their rows as free, and inserting indices
+ * reuses free rows before growing the buffer, so `addPrimes` / `removePrimes`
+ * sequences (e.g., during key-switching) do not reallocate the existing rows.
+ * When the buffer does need to grow it grows geometrically. Buffers are
+ * drawn from and returned to the per-thread ResiduePool, so temporaries
+ * normally reuse the buffers of earlier temporaries of the same shape.
+ *
+ * Rows are returned as raw pointers; they remain valid until the next call
+ * to `insert`, `clear` or assignment to the matrix.
+ *
+ * A matrix can also be a view of rows owned by someone else (e.g., a memory
+ * mapped file, see MappedArchive), set up with `attach`. The owner object is
+ * kept alive for as long as the matrix uses the rows. A view is read and
+ * written in place; the first time it needs to grow, its rows are copied
+ * into a buffer of its own.
+ **/
+class ResidueMatrix
+{
+public:
+  //! @brief Byte alignment of every row (a cache line).
+  static constexpr long ALIGNMENT = 64;
+
+  //! @brief An empty matrix whose rows have `rowLength` entries.
+  explicit ResidueMatrix(long rowLength = 0);
+
+  ResidueMatrix(const ResidueMatrix& other);
+  ResidueMatrix(ResidueMatrix&& other) noexcept;
+  ResidueMatrix& operator=(const ResidueMatrix& other);
+  ResidueMatrix& operator=(ResidueMatrix&& other) noexcept;
+  ~ResidueMatrix();
+
+  //! @brief Get the underlying index set
+  const IndexSet& getIndexSet() const { return indexSet; }
+
+  //! @brief Number of entries in each row
+  long getRowLength() const { return rowLen; }
+
+  //! @brief Number of rows the buffer can hold without reallocating
+  long capacity() const { return rowCap; }
+
+  //! @brief Distance (in longs) between the starts of consecutive rows
+  long getStride() const { return stride; }
+
+  //! @brief Whether the rows are borrowed from another owner (see attach)
+  bool isView() const { return owner != nullptr; }
+
+  //! @brief Access functions: will raise an error
+  //! if j does not belong to the current index set
+  long* operator[](long j)
+  {
+    assertTrue(indexSet.contains(j), "Key not found");
+    return data + rowOf[j] * stride;
+  }
+  const long* operator[](long j) const
+  {
+    assertTrue(indexSet.contains(j), "Key not found");
+    return data + rowOf[j] * stride;
+  }
+
+  //! @brief Insert indexes to the IndexSet.
+  //! The content of the new rows is unspecified.
+  void insert(long j);
+  void insert(const IndexSet& s);
+
+  //! @brief Delete indexes from the IndexSet. The rows are kept for reuse.
+  void remove(long j);
+  void remove(const IndexSet& s);
+
+  //! @brief Remove all indices (the buffer is kept for reuse).
+  void clear();
+
+  //! @brief Make sure that at least `rows` rows fit without reallocating.
+  void reserve(long rows);
+
+  //! @brief Release the buffer, this also removes all indices.
+  void release();
+
+  /**
+   * @brief Make the matrix a view of `s.card()` consecutive rows at `rows`.
+   * @param s The new index set, the row of the i'th smallest index in s
+   * is the i'th row of the buffer.
+   * @param rows A buffer of `s.card()*getStride()` longs, aligned to
+   * `ALIGNMENT` bytes.
+   * @param rowsOwner An object that keeps the buffer alive, it is held for
+   * as long as the matrix uses the buffer.
+   **/
+  void attach(const IndexSet& s,
+              long* rows,
+              std::shared_ptr<const void> rowsOwner);
+
+private:
+  long rowLen = 0; // number of valid entries in a row (phi(m) for DoubleCRT)
+  long stride = 0; // distance between consecutive rows, >= rowLen
+  long rowCap = 0; // number of rows allocated in data
+  long* data = nullptr;
+  std::shared_ptr<const void> owner; // non-null if data is borrowed
+
+  IndexSet indexSet;
+  std::vector<long> rowOf;    // rowOf[j] = row of index j, or -1
+  std::vector<long> freeRows; // rows not assigned to any index
+
+  void grow(long rows);
+  void copyFrom(const ResidueMatrix& other);
+  void freeData();
+};
+
+//! @brief Comparing matrices, by comparing their index sets and all the rows
+bool operator==(const ResidueMatrix& a, const ResidueMatrix& b);
+
+inline bool operator!=(const ResidueMatrix& a, const ResidueMatrix& b)
+{
+  return !(a == b);
+}
+
+} // namespace helib
+
+#endif // ifndef HELIB_RESIDUEMATRIX_H
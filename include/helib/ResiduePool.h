@@ -0,0 +1,82 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+#ifndef HELIB_RESIDUEPOOL_H
+#define HELIB_RESIDUEPOOL_H
+/**
+ * @file ResiduePool.h
+ * @brief A per-thread pool of the buffers that hold DoubleCRT residues.
+ **/
+
+#include <cstddef>
+
+namespace helib {
+
+/**
+ * @class ResiduePool
+ * @brief Per-thread cache of the aligned buffers used by ResidueMatrix.
+ *
+ * Every DoubleCRT (and hence every CtxtPart and Ctxt) keeps its residues in
+ * a ResidueMatrix, whose buffer is drawn from this pool and returned to it
+ * when the matrix is destroyed or regrown. Temporaries that are created
+ * and destroyed in a loop (key-switching digits, baby steps, scratch
+ * ciphertexts and so on) therefore reuse the same few buffers instead of
+ * going back to malloc/free and faulting in fresh pages every iteration.
+ *
+ * Buffers are cached by their exact size, in the pool of the thread that
+ * releases them. The total size of the buffers cached by all the threads is
+ * bounded by getLimit(); beyond that, released buffers are freed. So the
+ * idle memory of the pools does not grow with the number of threads, even
+ * when the buffers are released by other threads than those that allocated
+ * them.
+ *
+ * When `fhe_stats` is set, misses and hits are recorded in the stats
+ * records "ResiduePool-alloc-bytes" and "ResiduePool-hit-bytes".
+ **/
+class ResiduePool
+{
+public:
+  //! @brief Counters of the calling thread
+  struct Counters
+  {
+    long allocations = 0;           // buffers allocated from the system
+    long hits = 0;                  // buffers served from the pool
+    std::size_t bytesAllocated = 0; // total size of the allocations
+    std::size_t bytesCached = 0;    // size of the buffers now in the pool
+  };
+
+  //! @brief Alignment of all the buffers (a cache line)
+  static constexpr std::size_t ALIGNMENT = 64;
+
+  //! @brief Get a buffer of `bytes` bytes, aligned to `ALIGNMENT`
+  static void* allocate(std::size_t bytes);
+
+  //! @brief Return a buffer obtained from allocate(bytes)
+  static void deallocate(void* p, std::size_t bytes);
+
+  //! @brief Set the maximum number of bytes cached by all the threads
+  //! together. A limit of 0 disables the pool.
+  static void setLimit(std::size_t bytes);
+
+  //! @brief Get the maximum number of bytes cached by all the threads
+  //! together.
+  static std::size_t getLimit();
+
+  //! @brief Free all the buffers cached by the calling thread
+  static void clear();
+
+  //! @brief Get the counters of the calling thread
+  static Counters getCounters();
+};
+
+} // namespace helib
+
+#endif // ifndef HELIB_RESIDUEPOOL_H
@@ -25,6 +25,9 @@
 #include <helib/keySwitching.h>
 #include <helib/keys.h>
 #include <helib/EncryptedArray.h>
+#include <helib/HoistedCtxt.h>
+#include <helib/MappedArchive.h>
+#include <helib/Circuit.h>
 #include <helib/Ptxt.h>
 
 #endif // HELIB_HELIB_H
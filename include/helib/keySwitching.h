@@ -65,6 +65,11 @@ namespace helib {
  *
  * In this implementation we save some space, by keeping only a PRG seed for
  * generating the pseudo-random elements, rather than the elements themselves.
+ * Each aj is generated from its own seed, deriveSeed(prgSeed, j), so the
+ * columns can be regenerated independently of each other (see randomizeA).
+ * Earlier versions drew all the aj's from one PRG stream seeded with prgSeed,
+ * so the derivation is recorded when a matrix is written (SEED_DERIVATION),
+ * and matrices written by those versions are rejected when read.
  *
  * To convert a ciphertext part R, we break R into digits R = sum_j Bj Rj,
  * then set (q0,q1)^T = sum_j Rj * column-j. Note that we have
@@ -92,6 +97,9 @@ public:
    */
   static constexpr std::string_view typeName = "KeySwitch";
 
+  //! @brief The derivation of the aj's from prgSeed, see randomizeA
+  static constexpr long SEED_DERIVATION = 1;
+
   SKHandle fromKey; // A handle for the key s'
   long toKeyID;     // Index of the key s that we are switching into
   long ptxtSpace;   // either p or p^r
@@ -120,6 +128,11 @@ public:
   static const KeySwitch& dummy();
   bool isDummy() const;
 
+  //! @brief Set a to the pseudorandom element aj of column j.
+  //! a must be defined relative to all the ctxt and special primes.
+  //! The NTL PRG state of the calling thread is left unchanged.
+  void randomizeA(DoubleCRT& a, long j) const;
+
   //! A debugging method
   void verify(SecKey& sk);
 
@@ -209,6 +222,10 @@ std::ostream& operator<<(std::ostream& str, const KeySwitch& matrix);
 //! this and matmul routines "in sync".
 long KSGiantStepSize(long D);
 
+// NOTE: the functions below generate their matrices with
+// SecKey::GenKeySWmatrices, i.e., in parallel and independently of the
+// number of threads.
+
 //! @brief Maximalistic approach:
 //! generate matrices s(X^e)->s(X) for all e in Zm*
 void addAllMatrices(SecKey& sKey, long keyID = 0);
@@ -20,6 +20,9 @@
  * Copyright IBM Corporation 2019 All rights reserved.
  */
 
+#include <functional>
+#include <memory>
+
 #include <helib/keySwitching.h>
 #include <helib/EncodedPtxt.h>
 
@@ -37,6 +40,8 @@ namespace helib {
 #define HELIB_KSS_MIN (3)
 // minimal strategy (for g_i, and for g_i^{-ord_i} for bad dims)
 
+class KeySwitchStore;
+
 /**
  * @class PubKey
  * @brief The public key
@@ -56,6 +61,10 @@ private:
 
   std::vector<KeySwitch> keySwitching; // The key-switching matrices
 
+  // If not null, keySwitching[i] for i < keyStore->size() is a view of
+  // matrix i of the store, see openKeyStore
+  std::shared_ptr<const KeySwitchStore> keyStore;
+
   // The keySwitchMap structure contains pointers to key-switching matrices
   // for re-linearizing automorphisms. The entry keySwitchMap[i][n] contains
   // the index j such that keySwitching[j] is the first matrix one needs to
@@ -69,6 +78,34 @@ private:
   long recryptKeyID; // index of the bootstrapping key
   Ctxt recryptEkey;  // the key itself, encrypted under key #0
 
+  // The phases of recryption, see recryption.cpp
+  bool recryptTrivial(Ctxt& ctxt) const;
+  double recryptBootKeySwitch(Ctxt& ctxt) const;
+  double reCryptPreProcess(Ctxt& ctxt) const;
+  double thinReCryptPreProcess(Ctxt& ctxt) const;
+  void recryptBatch(
+      std::vector<Ctxt>& ctxts,
+      const std::function<double(Ctxt&)>& preProcess,
+      const std::vector<std::function<void(Ctxt&)>>& phases) const;
+
+  // The index of a matrix in keySwitching, or -1 if there is none
+  long findKeySWmatrix(const SKHandle& from, long toID) const;
+  long findAnyKeySWmatrix(const SKHandle& from) const;
+
+  // keySwitching[i] (or the dummy matrix if i < 0), recording the use
+  // with the key store
+  const KeySwitch& useKeySWmatrix(long i) const;
+
+  // Check the residues of all the matrices of the key store, if any, before
+  // they are handed out other than through useKeySWmatrix
+  void checkKeyStore() const;
+
+  // Sets ctxt to a fresh encryption of zero over the ciphertext primes, with
+  // the noise scaled by ptxtSpace (1 for CKKS), and returns its noise bound.
+  // This is the randomized half of Encrypt(EncodedPtxt), SecKey overrides it
+  // with a secret-key RLWE sample.
+  virtual NTL::xdouble encryptZero(Ctxt& ctxt, long ptxtSpace) const;
+
 public:
   /**
    * @brief Class label to be added to JSON serialization as object type
@@ -104,6 +141,10 @@ public:
   //! @name Find key-switching matrices
   const std::vector<KeySwitch>& keySWlist() const;
 
+  //! @brief The largest noise bound of the key-switching matrices.
+  //! Only their metadata is used, the residues of a key store are not read.
+  NTL::xdouble maxKeySwitchNoise() const;
+
   //! @brief Find a key-switching matrix by its indexes.
   //! If no such matrix exists it returns a dummy matrix with toKeyID==-1.
   const KeySwitch& getKeySWmatrix(const SKHandle& from, long toID = 0) const;
@@ -145,6 +186,38 @@ public:
   //! dim == -1 is Frobenius
   void setKSStrategy(long dim, int val);
 
+  ///@{
+  //! @name Key stores
+  //! A key can keep its key-switching matrices in a memory-mapped file
+  //! instead of in memory, see KeySwitchStore. A server that keeps the keys
+  //! of many clients writes each key with writeTo(str, compressed, false)
+  //! and its matrices with writeKeyStore, and then after readFrom, calls
+  //! openKeyStore to get the matrices from the file as they are used.
+
+  //! @brief Write the key-switching matrices to a new key store at path
+  void writeKeyStore(const std::string& path) const;
+
+  /**
+   * @brief Replace the key-switching matrices of this key by those in the
+   * key store at path.
+   * @param path The store, written by writeKeyStore for a key with the same
+   * secret keys.
+   * @param maxResident A bound on the number of matrices that are kept in
+   * memory, <= 0 for no bound.
+   *
+   * The matrices are only read from the file when getKeySWmatrix,
+   * getAnyKeySWmatrix or getNextKSWmatrix returns them. keySWlist,
+   * operator== and the serialization methods read and check all of them
+   * (an IOError is thrown if the file is corrupt). Copies of this key
+   * share the store. Matrices generated after opening the store are kept
+   * in memory as usual.
+   **/
+  void openKeyStore(const std::string& path, long maxResident = 0);
+
+  //! @brief The key store in use, or null
+  const KeySwitchStore* getKeyStore() const { return keyStore.get(); }
+  ///@}
+
   /**
    * Encrypts plaintext, result returned in the ciphertext argument. When
    * called with highNoise=true, returns a ciphertext with noise level
@@ -224,6 +297,28 @@ public:
 
   //============================================================
 
+  /**
+   * @brief Encrypts a batch of plaintexts, ctxts[i] = Enc(ptxts[i]).
+   * @tparam Scheme Encryption scheme used (must be `BGV` or `CKKS`).
+   * @param ctxts Ciphertexts into which to encrypt. The vector is resized
+   * to the size of `ptxts`, new entries are ciphertexts under this key.
+   * @param ptxts Plaintexts to encrypt.
+   *
+   * The whole batch is encoded first, then converted to DoubleCRT over the
+   * ciphertext primes in one pass, and only then is the encryption noise
+   * sampled for each ciphertext. Each pass is split across the NTL threads,
+   * so the caller does not need to manage them. The result is distributed
+   * as if Encrypt was called on each element.
+   **/
+  template <typename Scheme>
+  void encryptBatch(std::vector<Ctxt>& ctxts,
+                    const std::vector<Ptxt<Scheme>>& ptxts) const;
+
+  //! @brief Encrypts a batch of encoded plaintexts, ctxts[i] = Enc(eptxts[i]).
+  //! See encryptBatch above. All of eptxts must match the scheme of this key.
+  void encryptBatch(std::vector<Ctxt>& ctxts,
+                    const std::vector<EncodedPtxt>& eptxts) const;
+
   bool isCKKS() const;
   // NOTE: Is taking the alMod from the context the right thing to do?
 
@@ -232,6 +327,26 @@ public:
   void thinReCrypt(Ctxt& ctxt) const; // bootstrap a "thin" ciphertext, where
   // slots are assumed to contain constants
 
+  /**
+   * @brief Bootstrap a batch of ciphertexts, the same as calling reCrypt on
+   * each of them.
+   * @param ctxts The ciphertexts to bootstrap, in place.
+   *
+   * The ciphertexts go through the phases of recryption together: all of
+   * them are key-switched and mod-switched, then all go through the first
+   * linear map, the digit extraction and the second linear map, so each
+   * phase works with the same constants (e.g. the cached EvalMap matrices)
+   * for the whole batch. With at least as many ciphertexts as NTL threads,
+   * each thread bootstraps its own share of the batch in every phase;
+   * smaller batches are processed one ciphertext at a time, with the
+   * threads used inside each phase as in reCrypt.
+   **/
+  void reCryptBatch(std::vector<Ctxt>& ctxts) const;
+
+  //! @brief Thin-bootstrap a batch of ciphertexts, the same as calling
+  //! thinReCrypt on each of them. See reCryptBatch.
+  void thinReCryptBatch(std::vector<Ctxt>& ctxts) const;
+
   friend class SecKey;
   friend std::ostream& operator<<(std::ostream& str, const PubKey& pk);
   friend std::istream& operator>>(std::istream& str, PubKey& pk);
@@ -239,8 +354,15 @@ public:
   /**
    * @brief Write out the `PubKey` object in binary format.
    * @param str Output `std::ostream`.
+   * @param compressed If set, the public encryption key is written in the
+   * compressed form of Ctxt::writeTo (the key-switching matrices are always
+   * written with their seeds).
+   * @param withMatrices If not set, the key is written without its
+   * key-switching matrices (e.g., because they are in a key store).
    **/
-  void writeTo(std::ostream& str) const;
+  void writeTo(std::ostream& str,
+               bool compressed = false,
+               bool withMatrices = true) const;
 
   /**
    * @brief Read from the stream the serialized `PubKey` object in binary
@@ -254,14 +376,16 @@ public:
    * @brief Write out the public key (`PubKey`) object to the output
    * stream using JSON format.
    * @param str Output `std::ostream`.
+   * @param compressed Compress the public encryption key, see writeTo.
    **/
-  void writeToJSON(std::ostream& str) const;
+  void writeToJSON(std::ostream& str, bool compressed = false) const;
 
   /**
    * @brief Write out the public key (`PubKey`) object to a `JsonWrapper`.
+   * @param compressed Compress the public encryption key, see writeTo.
    * @return The `JsonWrapper`.
    **/
-  JsonWrapper writeToJSON() const;
+  JsonWrapper writeToJSON(bool compressed = false) const;
 
   /**
    * @brief Read from the stream the serialized public key (`PubKey`) object
@@ -314,6 +438,32 @@ private:
   std::vector<DoubleCRT> sKeys; // The secret key(s) themselves
   explicit SecKey(const PubKey& pk);
 
+  // Encrypts zero under sKeys[0], see PubKey::encryptZero
+  NTL::xdouble encryptZero(Ctxt& ctxt, long ptxtSpace) const override;
+
+  // The secret key s^k(X^t) for a ciphertext part with handle (k,t), over
+  // the given primes
+  DoubleCRT keyPower(const SKHandle& handle, const IndexSet& primes) const;
+
+  // The second half of Decrypt: converts the decrypted ptxt back to a
+  // polynomial and reduces it as appropriate for ciphertxt. If f is not
+  // null, the polynomial before reduction is returned there.
+  void decryptFromDCRT(NTL::ZZX& plaintxt,
+                       const DoubleCRT& ptxt,
+                       const Ctxt& ciphertxt,
+                       NTL::ZZX* f = nullptr) const;
+
+  // The plaintext space of a new key-switching matrix, see GenKeySWmatrix
+  long keySWptxtSpace(long ptxtSpace) const;
+
+  // Generate a key-switching matrix from the current PRG state, without
+  // storing it. The plaintext space must already be resolved.
+  KeySwitch makeKeySWmatrix(long fromSPower,
+                            long fromXPower,
+                            long fromKeyIdx,
+                            long toKeyIdx,
+                            long ptxtSpace) const;
+
 public:
   /**
    * @brief Class label to be added to JSON serialization as object type
@@ -363,6 +513,18 @@ public:
                       long toKeyIdx = 0,
                       long ptxtSpace = 0);
 
+  //! Generate the key-switching matrices s(X^t) -> s for all t in
+  //! fromXPowers (skipping those that we already have), as by
+  //! GenKeySWmatrix(1, t, fromKeyIdx, toKeyIdx, ptxtSpace).
+  //! The matrices are generated in parallel: a seed is drawn from the
+  //! current PRG, and the i'th new matrix is generated after
+  //! SetSeed(deriveSeed(seed, i)). So the keys only depend on the PRG state,
+  //! not on the number of threads.
+  void GenKeySWmatrices(const std::vector<long>& fromXPowers,
+                        long fromKeyIdx = 0,
+                        long toKeyIdx = 0,
+                        long ptxtSpace = 0);
+
   // Decryption
   void Decrypt(NTL::ZZX& plaintxt, const Ctxt& ciphertxt) const;
 
@@ -380,6 +542,30 @@ public:
                const Ctxt& ciphertxt,
                OptLong prec = OptLong()) const;
 
+  /**
+   * @brief Decrypts a batch of ciphertexts, ptxts[i] = Dec(ctxts[i]).
+   * @tparam Scheme Encryption scheme used (must be `BGV` or `CKKS`).
+   * @param ptxts Plaintexts into which to decrypt, resized to the size of
+   * `ctxts`.
+   * @param ctxts Ciphertexts to decrypt.
+   * @param prec `CKKS` precision to be used (must be defaulted if Scheme is
+   *`BGV`).
+   *
+   * The ciphertexts are decrypted as by decryptBatch below, then decoded in
+   * parallel.
+   **/
+  template <typename Scheme>
+  void decryptBatch(std::vector<Ptxt<Scheme>>& ptxts,
+                    const std::vector<Ctxt>& ctxts,
+                    OptLong prec = OptLong()) const;
+
+  //! @brief Decrypts a batch of ciphertexts to their plaintext polynomials,
+  //! as Decrypt(plaintxts[i], ctxts[i]) does. The secret-key powers that
+  //! the ciphertext parts refer to are computed once for the whole batch,
+  //! then the ciphertexts are decrypted across the NTL threads.
+  void decryptBatch(std::vector<NTL::ZZX>& plaintxts,
+                    const std::vector<Ctxt>& ctxts) const;
+
   //! @brief Debugging version, returns in f the polynomial
   //! before reduction modulo the ptxtSpace
   void Decrypt(NTL::ZZX& plaintxt, const Ctxt& ciphertxt, NTL::ZZX& f) const;
@@ -496,6 +682,15 @@ double RLWE(DoubleCRT& c0,
 //! Same as RLWE, but assumes that c1 is already chosen by the caller
 double RLWE1(DoubleCRT& c0, const DoubleCRT& c1, const DoubleCRT& s, long p);
 
+//! Same as RLWE, but c1 is generated from a fresh random seed, returned in
+//! prgSeed, so that c1 can later be recovered from the seed alone. The PRG
+//! stream that e is drawn from does not depend on the seed.
+double seededRLWE(DoubleCRT& c0,
+                  DoubleCRT& c1,
+                  const DoubleCRT& s,
+                  long p,
+                  NTL::ZZ& prgSeed);
+
 } // namespace helib
 
 #endif // HELIB_KEYS_H
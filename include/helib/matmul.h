@@ -261,8 +261,28 @@ struct ConstMultiplierCache
 
   // Upgrade zzX constants to DoubleCRT constants.
   void upgrade(const Context& context);
+
+  // Binary I/O of the constants, in either zzX or DoubleCRT format.
+  // Only the BGV constants can be written (the ones used in bootstrapping).
+  // read throws an IOError unless there are exactly n constants, each with
+  // at most phi(m) coefficients (zzX) or over the primes of the context
+  // (DoubleCRT).
+  void writeTo(std::ostream& str) const;
+  void read(std::istream& str, const Context& context, long n);
 };
 
+// x += a*b, where a null constant is zero
+void MulAdd(Ctxt& x, const std::shared_ptr<ConstMultiplier>& a, const Ctxt& b);
+
+// x += a*b, where a null constant is zero and b may be modified
+void DestMulAdd(Ctxt& x, const std::shared_ptr<ConstMultiplier>& a, Ctxt& b);
+
+// A DoubleCRT constant for the image of the (BGV) polynomial poly under the
+// automorphism X -> X^k, null if poly is zero.
+std::shared_ptr<ConstMultiplier> build_ConstMultiplier(const zzX& poly,
+                                                       long k,
+                                                       const Context& context);
+
 //====================================
 
 // Abstract base case for multiplying an encrypted std::vector by a plaintext
@@ -315,6 +335,10 @@ public:
   // addSome{1D,Frb}Matrices routines declared in helib.h.
   explicit MatMul1DExec(const MatMul1D& mat, bool minimal = false);
 
+  // Read the tables written by writeTo, instead of building them
+  MatMul1DExec(const EncryptedArray& ea, std::istream& str);
+  void writeTo(std::ostream& str) const;
+
   // VJS-FIXME: it seems that the minimal flag is currently
   // redundant, as the decision is essentially based on
   // ctxt.getPubKey().getKSStrategy(dim0). Need to look into this
@@ -372,6 +396,10 @@ public:
   // addSome{1D,Frb}Matrices routines declared in helib.h.
   explicit BlockMatMul1DExec(const BlockMatMul1D& mat, bool minimal = false);
 
+  // Read the tables written by writeTo, instead of building them
+  BlockMatMul1DExec(const EncryptedArray& ea, std::istream& str);
+  void writeTo(std::ostream& str) const;
+
   // Replaces an encryption of row std::vector v by encryption of v*mat
   void mul(Ctxt& ctxt) const override;
 
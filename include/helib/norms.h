@@ -94,6 +94,13 @@ void embeddingLargestCoeff_x2(double& norm1,
                               const std::vector<double>& f2,
                               const PAlgebra& palg);
 
+//! The norms of many vectors, norms[i] = embeddingLargestCoeff(f[i], palg).
+//! The vectors are paired as in embeddingLargestCoeff_x2, and the
+//! transforms are batched (see PGFFT::apply_many) over the NTL threads.
+void embeddingLargestCoeffs(std::vector<double>& norms,
+                            const std::vector<std::vector<double>>& f,
+                            const PAlgebra& palg);
+
 NTL::xdouble embeddingLargestCoeff(const NTL::ZZX& f, const PAlgebra& palg);
 
 //! Computes canonical embedding.
@@ -115,6 +122,12 @@ void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
                              const std::vector<double>& f,
                              const PAlgebra& palg);
 
+//! Batch version: v[i] is the canonical embedding of f[i].
+//! The transforms are batched (see PGFFT::apply_many) over the NTL threads.
+void CKKS_canonicalEmbedding(std::vector<std::vector<cx_double>>& v,
+                             const std::vector<zzX>& f,
+                             const PAlgebra& palg);
+
 //! Requires p==-1 and m==2^k where k >=2.
 //! Computes the inverse of canonical embedding, scaled by scaling
 //! and then rounded to nearest integer.
@@ -123,6 +136,14 @@ void CKKS_embedInSlots(zzX& f,
                        const PAlgebra& palg,
                        double scaling);
 
+//! Batch version: f[i] is the inverse of the canonical embedding of v[i],
+//! scaled by scaling[i].
+//! The transforms are batched (see PGFFT::apply_many) over the NTL threads.
+void CKKS_embedInSlots(std::vector<zzX>& f,
+                       const std::vector<std::vector<cx_double>>& v,
+                       const PAlgebra& palg,
+                       const std::vector<double>& scaling);
+
 } // namespace helib
 
 #endif // ifndef HELIB_NORMS_H
@@ -13,11 +13,17 @@
 #ifndef HELIB_PARTIALMATCH_H
 #define HELIB_PARTIALMATCH_H
 
+#include <atomic>
+#include <functional>
 #include <sstream>
 #include <stack>
 
+#include <NTL/BasicThreadPool.h>
+
 #include <helib/Matrix.h>
+#include <helib/MappedArchive.h>
 #include <helib/PolyMod.h>
+#include <helib/keys.h>
 
 // This code is in flux and should be considered bery alpha.
 // Not recommended for public use.
@@ -525,6 +531,8 @@ private:
  * @tparam TXT The database is templated on `TXT` which can either be a `Ctxt`
  * or a `Ptxt<BGV>`
  * @brief An object representing a database which is a `HElib::Matrix<TXT>`.
+ * @note The whole database and the intermediate results of a query are held
+ * in memory, see `StreamingDatabase` for large databases.
  **/
 template <typename TXT>
 class Database
@@ -633,6 +641,339 @@ inline Matrix<TXT2> Database<TXT>::getScore(
   return result;
 }
 
+/**
+ * @class RowBlockSource
+ * @tparam TXT The type of the entries of the database, `Ctxt` or
+ * `Ptxt<BGV>`.
+ * @brief A database that is read a block of rows at a time, so that it does
+ * not have to be held in memory. See `StreamingDatabase`.
+ **/
+template <typename TXT>
+class RowBlockSource
+{
+public:
+  virtual ~RowBlockSource() = default;
+
+  /**
+   * @brief Returns number of rows in the database.
+   * @return The number of rows in the database.
+   **/
+  virtual long rows() const = 0;
+
+  /**
+   * @brief Returns number of columns in the database.
+   * @return The number of columns in the database.
+   **/
+  virtual long columns() const = 0;
+
+  /**
+   * @brief Reads a block of rows of the database.
+   * @param first The index of the first row of the block.
+   * @param count The number of rows in the block.
+   * @return A `count` by `columns()` matrix holding the rows.
+   **/
+  virtual Matrix<TXT> read(long first, long count) const = 0;
+
+  /**
+   * @brief Called when the block of rows returned by `read(first, count)` is
+   * no longer used, so that the memory it takes can be given back.
+   * @param first The index of the first row of the block.
+   * @param count The number of rows in the block.
+   **/
+  virtual void release(long UNUSED first, long UNUSED count) const {}
+};
+
+/**
+ * @class MatrixRowSource
+ * @brief A `RowBlockSource` for a database held in memory. The blocks are
+ * views of the matrix, nothing is copied.
+ **/
+template <typename TXT>
+class MatrixRowSource : public RowBlockSource<TXT>
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param M The `Matrix<TXT>` containing the data of the database. It is
+   * shared with `M`, not copied.
+   **/
+  explicit MatrixRowSource(const Matrix<TXT>& M) : data(M)
+  {
+    assertTrue<InvalidArgument>(data.fullView(),
+                                "MatrixRowSource needs a whole matrix");
+  }
+
+  long rows() const override { return data.dims(0); }
+
+  long columns() const override { return data.dims(1); }
+
+  Matrix<TXT> read(long first, long count) const override
+  {
+    return data.getRows(first, count);
+  }
+
+private:
+  Matrix<TXT> data;
+};
+
+/**
+ * @class ArchiveRowSource
+ * @brief A `RowBlockSource` for an encrypted database in an archive (see
+ * `MappedArchive`), holding the ciphertexts of the database row by row. Such
+ * an archive is written by appending the entries of each row in turn to an
+ * `ArchiveWriter`.
+ *
+ * Each block is read into new ciphertexts, deserialized from the
+ * memory-mapped file, and `release` drops the mapped pages of its entries.
+ * So the memory taken by the database is one deserialized block plus the
+ * mapped pages of that block, whatever the size of the archive.
+ **/
+class ArchiveRowSource : public RowBlockSource<Ctxt>
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param path The path of the archive.
+   * @param pubKey The public key that the database is encrypted under.
+   * @param columns The number of columns in the database.
+   **/
+  ArchiveRowSource(const std::string& path,
+                   const PubKey& _pubKey,
+                   long columns) :
+      archive(path, _pubKey.getContext()), pubKey(_pubKey), nColumns(columns)
+  {
+    assertTrue<InvalidArgument>(nColumns > 0,
+                                "Database must have at least one column");
+    assertEq<IOError>(archive.size() % nColumns,
+                      0l,
+                      "Archive does not hold whole rows of the database");
+    for (long i = 0; i < archive.size(); i++)
+      assertTrue<IOError>(archive.kind(i) == MappedArchive::ItemKind::CTXT,
+                          "Archive holds items that are not ciphertexts");
+  }
+
+  long rows() const override { return archive.size() / nColumns; }
+
+  long columns() const override { return nColumns; }
+
+  Matrix<Ctxt> read(long first, long count) const override
+  {
+    assertTrue<InvalidArgument>(first >= 0 && count > 0 &&
+                                    first + count <= rows(),
+                                "Rows out of range of the database");
+    Matrix<Ctxt> block(Ctxt(pubKey), count, nColumns);
+    for (long i = 0; i < count; ++i)
+      for (long j = 0; j < nColumns; ++j)
+        archive.get(block(i, j), (first + i) * nColumns + j);
+    return block;
+  }
+
+  void release(long first, long count) const override
+  {
+    for (long k = first * nColumns; k < (first + count) * nColumns; ++k)
+      archive.release(k);
+  }
+
+private:
+  MappedArchive archive;
+  const PubKey& pubKey;
+  long nColumns;
+};
+
+/**
+ * @class StreamingDatabase
+ * @tparam TXT The type of the entries of the database, `Ctxt` or
+ * `Ptxt<BGV>`.
+ * @brief A query engine for a database that is read in blocks of rows from a
+ * `RowBlockSource`, and whose results are emitted a block at a time.
+ *
+ * `Database::getScore` replicates the query for every row of the database and
+ * holds the masks of the whole database at once. Here, the masks of a block
+ * are computed directly from the single row of the query, scored, and freed
+ * before the next block is read, so the memory taken by a query is bounded by
+ * the block size rather than by the size of the database.
+ *
+ * The entries of the masks of a block are computed by the NTL threads, which
+ * take the next entry as they finish one, so uneven entries still balance.
+ * Blocks that have fewer entries than threads are computed one entry at a
+ * time, with the threads used inside each entry.
+ **/
+template <typename TXT>
+class StreamingDatabase
+{
+public:
+  /**
+   * @brief Constructor.
+   * @param src The source of the rows of the database.
+   * @param c A shared pointer to the context used to create the data.
+   * @param blockRows The number of rows in a block. If `blockRows <= 0`, the
+   * blocks are the fewest rows that have an entry for each NTL thread.
+   **/
+  StreamingDatabase(std::shared_ptr<const RowBlockSource<TXT>> src,
+                    std::shared_ptr<const Context> c,
+                    long blockRows = 0) :
+      source(src), context(c), blockRows(blockRows)
+  {
+    assertNotNull<InvalidArgument>(source, "Row source must not be null");
+  }
+
+  /**
+   * @brief Constructor.
+   * @param src The source of the rows of the database.
+   * @param c The context object used to create the data.
+   * @param blockRows The number of rows in a block. If `blockRows <= 0`, the
+   * blocks are the fewest rows that have an entry for each NTL thread.
+   * @note This version accepts a `Context` that this object is not responsible
+   * for i.e. if it is on the stack. The programmer is responsible in this case
+   * for scope.
+   **/
+  StreamingDatabase(std::shared_ptr<const RowBlockSource<TXT>> src,
+                    const Context& c,
+                    long blockRows = 0) :
+      StreamingDatabase(
+          src,
+          std::shared_ptr<const helib::Context>(&c, [](auto UNUSED p) {}),
+          blockRows)
+  {}
+
+  /**
+   * @brief Function for performing a database lookup given a query expression
+   * and query data, see `Database::contains`.
+   * @tparam TXT2 The type of the query data, can be either a `Ctxt` or
+   * `Ptxt<BGV>`.
+   * @param lookup_query The lookup query expression to perform.
+   * @param query_data The lookup query data to compare with the database.
+   * @param emit Called with the index of the first row of each block, in
+   * order, and the result for the rows of the block. It may move from the
+   * result.
+   **/
+  template <typename TXT2>
+  void contains(const Query_t& lookup_query,
+                const Matrix<TXT2>& query_data,
+                const std::function<void(long, Matrix<TXT2>&)>& emit) const
+  {
+    stream(lookup_query, query_data, emit, lookup_query.containsOR);
+  }
+
+  /**
+   * @brief Function for performing a weighted partial match given a query
+   * expression and query data, see `Database::getScore`.
+   * @tparam TXT2 The type of the query data, can be either a `Ctxt` or
+   * `Ptxt<BGV>`.
+   * @param weighted_query The weighted lookup query expression to perform.
+   * @param query_data The query data to compare with the database.
+   * @param emit Called with the index of the first row of each block, in
+   * order, and the scores of the rows of the block. It may move from the
+   * scores.
+   **/
+  template <typename TXT2>
+  void getScore(const Query_t& weighted_query,
+                const Matrix<TXT2>& query_data,
+                const std::function<void(long, Matrix<TXT2>&)>& emit) const
+  {
+    stream(weighted_query, query_data, emit, /*flt=*/false);
+  }
+
+  /**
+   * @brief Returns number of rows in the database.
+   * @return The number of rows in the database.
+   **/
+  long rows() const { return source->rows(); }
+
+  /**
+   * @brief Returns number of columns in the database.
+   * @return The number of columns in the database.
+   **/
+  long columns() const { return source->columns(); }
+
+  /**
+   * @brief Returns the number of rows in the blocks of the next query.
+   * @return The number of rows in a block.
+   **/
+  long getBlockRows() const
+  {
+    if (blockRows > 0)
+      return blockRows;
+    return divc(NTL::AvailableThreads(), std::max(columns(), 1l));
+  }
+
+private:
+  std::shared_ptr<const RowBlockSource<TXT>> source;
+  std::shared_ptr<const Context> context;
+  long blockRows;
+
+  template <typename TXT2>
+  void stream(const Query_t& query,
+              const Matrix<TXT2>& query_data,
+              const std::function<void(long, Matrix<TXT2>&)>& emit,
+              bool flt) const;
+};
+
+template <typename TXT>
+template <typename TXT2>
+void StreamingDatabase<TXT>::stream(
+    const Query_t& query,
+    const Matrix<TXT2>& query_data,
+    const std::function<void(long, Matrix<TXT2>&)>& emit,
+    bool flt) const
+{
+  if (query_data.dims(0) != 1)
+    throw InvalidArgument("Query must be a row vector");
+  if (long(query_data.dims(1)) != columns())
+    throw InvalidArgument(
+        "Database and query must have same number of columns");
+
+  const EncryptedArray& ea = context->getEA();
+  const long nColumns = columns();
+  const long step = getBlockRows();
+
+  for (long first = 0; first < rows(); first += step) {
+    const long count = std::min(step, rows() - first);
+    Matrix<TXT2> mask(query_data(0, 0), count, nColumns);
+    {
+      const Matrix<TXT> block = source->read(first, count);
+
+      // The same computation as calculateMasks, entry by entry
+      auto maskEntry = [&](long k) {
+        long i = k / nColumns, j = k % nColumns;
+        TXT2& entry = mask(i, j);
+        if (j != 0)
+          entry = query_data(0, j);
+        entry -= block(i, j);
+        mapTo01(ea, entry);
+        entry.negate();
+        entry.addConstant(NTL::ZZX(1l));
+      };
+
+      const long size = count * nColumns;
+      const long nThreads = NTL::AvailableThreads();
+      if (size > 1 && size >= nThreads) {
+        std::atomic<long> next(0);
+        NTL_EXEC_INDEX(nThreads, index)
+        (void)index;
+        for (long k = next++; k < size; k = next++)
+          maskEntry(k);
+        NTL_EXEC_INDEX_END
+      } else {
+        for (long k = 0; k < size; ++k)
+          maskEntry(k);
+      }
+    }
+    source->release(first, count);
+
+    Matrix<TXT2> result =
+        calculateScores(query.Fs, query.mus, query.taus, mask);
+    if (flt) {
+      // FLT on the scores
+      result.apply([&](auto& txt) {
+        txt.power(context->getAlMod().getPPowR() - 1);
+        return txt;
+      });
+    }
+    emit(first, result);
+  }
+}
+
 } // namespace helib
 
 #endif
@@ -20,6 +20,7 @@
 #include <helib/matching.h>
 #include <helib/hypercube.h>
 #include <helib/apiAttributes.h>
+#include <helib/matmul.h>
 
 namespace helib {
 
@@ -597,6 +598,49 @@ public:
   friend std::ostream& operator<<(std::ostream& s, const PermNetwork& net);
 };
 
+//! @class PermNetworkExec
+//! @brief A permutation network compiled for an EncryptedArray, to apply the
+//! same permutation to many ciphertexts.
+//!
+//! PermNetwork::applyToCtxt encodes the mask of every shift of every layer,
+//! and rotates each masked copy of the ciphertext on its own. Here the masks
+//! are encoded once, as DoubleCRT constants. They are rotated along with
+//! their shift, so that each layer multiplies the rotations of the
+//! ciphertext by the masks rather than rotating the masked copies. The
+//! rotations of a layer then all come from one decomposition of the
+//! ciphertext (see HoistedCtxt), and are computed by the NTL threads.
+//! Only BGV is supported.
+//!
+//! NOTE: rotating before masking changes the noise. applyToCtxt adds the
+//! key-switching noise of each rotation after the mask multiplication, so
+//! per layer it adds about |mask|*noise(c) + noise(KS). Here the mask
+//! multiplies the key-switching noise as well, about
+//! |mask|*(noise(c) + noise(KS)). The key-switching noise is scaled down by
+//! the special primes and is usually much smaller than noise(c), so the
+//! difference is small, but with little noise in c (e.g. right after
+//! encryption or bootstrapping) a layer can cost more than with
+//! applyToCtxt. The noise estimate of the result accounts for it.
+class PermNetworkExec
+{
+  struct Layer
+  {
+    std::vector<long> automorphs; // the shifts of the layer, as X -> X^k
+    ConstMultiplierCache masks;   // the rotated mask of each shift
+  };
+
+  const Context& context;
+  std::vector<Layer> layers; // the layers that are not the identity
+
+public:
+  PermNetworkExec(const PermNetwork& net, const EncryptedArray& ea);
+
+  //! Number of layers that are not the identity
+  long depth() const { return layers.size(); }
+
+  //! Apply the network to permute a ciphertext
+  void apply(Ctxt& c) const;
+};
+
 // some convenience classes that are easier to work with
 // VJS-FIXME: document these
 
@@ -628,6 +672,7 @@ class PermPrecomp
   const EncryptedArray& ea;
   Permut pi;
   PermNetwork net;
+  std::unique_ptr<PermNetworkExec> exec; // null for CKKS
 
 public:
   PermPrecomp(const PermPrecomp&) = delete;
@@ -635,7 +680,14 @@ public:
 
   PermPrecomp(const PermIndepPrecomp& pip, const Permut& _pi);
 
-  void apply(Ctxt& ctxt) const { net.applyToCtxt(ctxt, ea); }
+  // For BGV this uses PermNetworkExec, see there for the noise it adds
+  void apply(Ctxt& ctxt) const
+  {
+    if (exec)
+      exec->apply(ctxt);
+    else
+      net.applyToCtxt(ctxt, ea);
+  }
 
   void apply(PtxtArray& a) const;
 
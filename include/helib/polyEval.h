@@ -36,6 +36,33 @@ void polyEval(Ctxt& ret, NTL::ZZX poly, const Ctxt& x, long k = 0);
 //! @param[in]  x    the point on which to evaluate
 void polyEval(Ctxt& ret, const NTL::Vec<Ctxt>& poly, const Ctxt& x);
 
+//! @brief Evaluate a cleartext polynomial on an encrypted input, computing
+//! the independent parts in parallel
+//! @param[out] ret  to hold the return value
+//! @param[in]  poly the degree-d polynomial to evaluate, the coefficients
+//! are taken mod the plaintext space of x (BGV only)
+//! @param[in]  x    the point on which to evaluate
+//! @param[in]  k    optional number of baby steps, a power of two, defaults
+//! to about sqrt(d)
+//!
+//! The polynomial is cut into blocks of k coefficients, evaluated with the
+//! baby steps X^1, ..., X^{k-1}, and the blocks are put together with a
+//! balanced tree of giant steps X^{k*2^j}. The baby steps (level by level),
+//! the blocks and each level of the tree are split across the NTL threads.
+//! The multiplicative depth is ceil(log2(d+1)), which is optimal, for a few
+//! more multiplications than polyEval.
+void polyEvalParallel(Ctxt& ret,
+                      const NTL::ZZX& poly,
+                      const Ctxt& x,
+                      long k = 0);
+
+//! @brief CKKS version of polyEvalParallel, the depth-optimal evaluation of
+//! a polynomial with real coefficients poly[0], ..., poly[d]
+void polyEvalParallel(Ctxt& ret,
+                      const std::vector<double>& poly,
+                      const Ctxt& x,
+                      long k = 0);
+
 // A useful helper class
 
 //! @brief Store powers of X, compute them dynamically as needed.
@@ -62,6 +89,11 @@ public:
   //! @brief Returns the e'th power, computing it as needed
   Ctxt& getPower(long e); // must use e >= 1, else throws an exception
 
+  //! @brief Compute all the powers up to size(), the ones that do not
+  //! depend on each other in parallel. getPower is then read-only, and can
+  //! be called from several threads.
+  void computeAll();
+
   //! dp.at(i) and dp[i] both return the i+1st power
   Ctxt& at(long i) { return getPower(i + 1); }
   Ctxt& operator[](long i) { return getPower(i + 1); }
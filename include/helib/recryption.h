@@ -79,6 +79,20 @@ public:
             bool build_cache = false,
             bool minimal = false);
 
+  //! Write the unpacking encodings and the linear maps, the parts of init
+  //! that take long to build, in binary format.
+  void writeTo(std::ostream& str) const;
+
+  //! Initialize the recryption data like init, reading the parts written
+  //! by writeTo instead of building them. The other arguments must be the
+  //! same as those of the init call that built the data, which the caller
+  //! is responsible for checking (see Context::readRecryptDataFrom).
+  void readFrom(std::istream& str,
+                const Context& context,
+                const NTL::Vec<long>& mvec_,
+                bool enableThick,
+                bool build_cache = false);
+
   bool operator==(const RecryptData& other) const;
   bool operator!=(const RecryptData& other) const
   {
@@ -90,6 +104,13 @@ public:
   // VJS-FIXME: this needs to be documented.
   // It is based on the most recent version of our bootstrapping
   // paper (see Section 6.2)
+
+protected:
+  // The parts of init that are cheap to compute, and not written by writeTo
+  void initBase(const Context& context,
+                const NTL::Vec<long>& mvec_,
+                bool enableThick,
+                bool build_cache_);
 };
 
 //! @class ThinRecryptData
@@ -107,6 +128,16 @@ public:
             bool alsoThick, /*init linear transforms also for non-thin*/
             bool build_cache = false,
             bool minimal = false);
+
+  //! Same as RecryptData::writeTo, also writing the thin linear maps
+  void writeTo(std::ostream& str) const;
+
+  //! Same as RecryptData::readFrom, also reading the thin linear maps
+  void readFrom(std::istream& str,
+                const Context& context,
+                const NTL::Vec<long>& mvec_,
+                bool alsoThick,
+                bool build_cache = false);
 };
 
 #define HELIB_MIN_CAP_FRAC (2.0 / 3.0)
@@ -27,6 +27,16 @@
  * built-in macro \_\_func\_\_). We can also use the "lower level" methods
  * startFHEtimer(name), stopFHEtimer(name), and resetFHEtimer(name) to add
  * timers with arbitrary names (not necessarily associated with functions).
+ *
+ * The same macros also feed a hierarchical profiler, which is turned on
+ * with setProfilerOn(). While it is on, every thread records the timed
+ * scopes in its own call tree (so there is no contention between threads),
+ * keyed by the chain of enclosing timers, together with a histogram of the
+ * duration of each scope. The result can be printed with printProfile(), or
+ * exported with writeCollapsedStacks() (the input format of flamegraph.pl)
+ * and writeChromeTrace() (for chrome://tracing or Perfetto). Note that
+ * scopes running on NTL's thread pool are attributed to the root of the
+ * worker thread's tree, not to the scope that launched them.
  **/
 #ifndef HELIB_TIMING_H
 #define HELIB_TIMING_H
@@ -69,6 +79,44 @@ inline bool areTimersOn() { return true; }
 
 const FHEtimer* getTimerByName(const char* name);
 
+//! @brief Turn on the hierarchical profiler. If recordEvents is set, every
+//! scope is also recorded as an event for writeChromeTrace() (this costs
+//! memory proportional to the number of timed calls).
+void setProfilerOn(bool recordEvents = false);
+//! @brief Turn off the hierarchical profiler, the data is kept.
+void setProfilerOff();
+bool isProfilerOn();
+
+//! @brief Clear the data of the profiler in all threads
+void resetProfile();
+
+//! @brief Print the call tree of all the profiled scopes, merged across
+//! threads, with the total time, number of calls and average per node.
+//! All the profile output functions expect that no timed code is running.
+void printProfile(std::ostream& str = std::cerr);
+
+//! @brief Write the profile as collapsed stacks, one line per call path
+//! with its self time in microseconds ("main;reLinearize;KS_loop_1 1234")
+void writeCollapsedStacks(std::ostream& str);
+
+//! @brief Write the recorded events in the Chrome trace-event JSON format
+void writeChromeTrace(std::ostream& str);
+
+//! @brief Histogram of the durations of the calls to timer under all
+//! call paths: entry i counts the calls that took [2^i, 2^{i+1}) clock
+//! ticks (entry 0 also counts calls of 0 ticks).
+std::vector<long> getProfileHistogram(const FHEtimer* timer);
+
+//! \cond FALSE (make doxygen ignore these functions)
+// Entry points used by auto_timer
+extern HELIB_atomic_long profiler_on;
+long profilerEnter(FHEtimer* timer, long& generation);
+void profilerExit(long node,
+                  long generation,
+                  unsigned long start,
+                  unsigned long end);
+//! \endcond
+
 void resetAllTimers();
 
 //! Print the value of all timers to stream
@@ -84,16 +132,29 @@ public:
   FHEtimer* timer;
   unsigned long amt;
   bool running;
+  long generation; // of the profile when node was entered
+  long node;       // the node in the profiler tree, -1 if not profiling
 
   auto_timer(FHEtimer* _timer) :
-      timer(_timer), amt(GetTimerClock()), running(true)
+      timer(_timer),
+      amt(GetTimerClock()),
+      running(true),
+      generation(0),
+      node(profiler_on ? profilerEnter(_timer, generation) : -1)
   {}
 
   void stop()
   {
-    amt = GetTimerClock() - amt;
-    timer->counter += amt;
-    timer->numCalls++;
+    unsigned long end = GetTimerClock();
+    if (node >= 0) {
+      // the profiler keeps per-thread totals, no shared atomics
+      profilerExit(node, generation, amt, end);
+      amt = end - amt;
+    } else {
+      amt = end - amt;
+      timer->counter += amt;
+      timer->numCalls++;
+    }
     running = false;
   }
 
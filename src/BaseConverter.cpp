@@ -0,0 +1,167 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+/* BaseConverter.cpp - fast RNS base extension
+ */
+#include <cmath>
+
+#include <NTL/ZZ.h>
+#include <NTL/BasicThreadPool.h>
+
+#include <helib/BaseConverter.h>
+#include <helib/Context.h>
+#include <helib/assertions.h>
+#include <helib/timing.h>
+
+namespace helib {
+
+BaseConverter::BaseConverter(const Context& context,
+                             const IndexSet& _from,
+                             const IndexSet& _to) :
+    from(_from), to(_to)
+{
+  assertFalse(empty(from), "BaseConverter: no source primes");
+  assertTrue(disjoint(from, to),
+             "BaseConverter: source and target primes must be disjoint");
+
+  long k = from.card();
+  long l = to.card();
+
+  NTL::ZZ Q = context.productOfPrimes(from);
+  NTL::ZZ qHat;
+
+  q.resize(k);
+  qHatInv.resize(k);
+  qHatInvPrecon.resize(k);
+  qRecip.resize(k);
+  p.resize(l);
+  pRed.resize(l);
+  QModP.resize(l);
+  QModPPrecon.resize(l);
+  qHatModP.resize(l * k);
+  qHatModPPrecon.resize(l * k);
+
+  long j = 0;
+  for (long idx : to) {
+    p[j] = context.ithPrime(idx);
+    pRed[j] = NTL::sp_PrepRem(p[j]);
+    QModP[j] = rem(Q, p[j]);
+    QModPPrecon[j] = NTL::PrepMulModPrecon(QModP[j], p[j]);
+    j++;
+  }
+
+  long i = 0;
+  for (long idx : from) {
+    q[i] = context.ithPrime(idx);
+    div(qHat, Q, q[i]);
+    qHatInv[i] = NTL::InvMod(rem(qHat, q[i]), q[i]);
+    qHatInvPrecon[i] = NTL::PrepMulModPrecon(qHatInv[i], q[i]);
+    qRecip[i] = 1.0L / q[i];
+    for (long r : range(l)) {
+      qHatModP[r * k + i] = rem(qHat, p[r]);
+      qHatModPPrecon[r * k + i] =
+          NTL::PrepMulModPrecon(qHatModP[r * k + i], p[r]);
+    }
+    i++;
+  }
+}
+
+BaseConverter::AuxModulus BaseConverter::auxModulus(long t) const
+{
+  assertInRange(t,
+                2l,
+                long(NTL_SP_BOUND),
+                "BaseConverter: auxiliary modulus out of range");
+
+  AuxModulus aux;
+  aux.t = t;
+  aux.red = NTL::sp_PrepRem(t);
+  long k = q.size();
+  aux.qHatModT.assign(k, 1 % t);
+  aux.QModT = 1 % t;
+  for (long i : range(k)) {
+    long qi = NTL::rem((unsigned long)q[i], t, aux.red);
+    aux.QModT = NTL::MulMod(aux.QModT, qi, t);
+    for (long i1 : range(k))
+      if (i1 != i)
+        aux.qHatModT[i1] = NTL::MulMod(aux.qHatModT[i1], qi, t);
+  }
+  return aux;
+}
+
+void BaseConverter::convert(long* out,
+                            long outStride,
+                            const long* in,
+                            long inStride,
+                            long n,
+                            double* frac,
+                            const AuxModulus* aux,
+                            long* outAux) const
+{
+  HELIB_TIMER_START;
+  assertTrue(aux == nullptr || outAux != nullptr,
+             "BaseConverter: no output for the auxiliary modulus");
+
+  long k = q.size();
+  long l = p.size();
+
+  NTL_EXEC_RANGE(n, first, last)
+  std::vector<long> y(k);
+  for (long h : range(first, last)) {
+    // y_i = x_i * Q_i^{-1} mod q_i, and v = round(sum_i y_i/q_i)
+    long double sum = 0;
+    for (long i : range(k)) {
+      y[i] = NTL::MulModPrecon(in[i * inStride + h],
+                               qHatInv[i],
+                               q[i],
+                               qHatInvPrecon[i]);
+      sum += y[i] * qRecip[i];
+    }
+    long v = long(std::floor(sum + 0.5L));
+    if (frac)
+      frac[h] = double(sum - v);
+
+    // x mod p_j = sum_i y_i * (Q_i mod p_j) - v * (Q mod p_j)
+    for (long j : range(l)) {
+      long pj = p[j];
+      const long* qHatRow = &qHatModP[j * k];
+      const NTL::mulmod_precon_t* qHatPreconRow = &qHatModPPrecon[j * k];
+      long acc = 0;
+      for (long i : range(k)) {
+        long a = (y[i] < pj) ? y[i]
+                             : NTL::rem((unsigned long)y[i], pj, pRed[j]);
+        acc = NTL::AddMod(
+            acc,
+            NTL::MulModPrecon(a, qHatRow[i], pj, qHatPreconRow[i]),
+            pj);
+      }
+      long vj = (v < pj) ? v : NTL::rem((unsigned long)v, pj, pRed[j]);
+      acc = NTL::SubMod(acc,
+                        NTL::MulModPrecon(vj, QModP[j], pj, QModPPrecon[j]),
+                        pj);
+      out[j * outStride + h] = acc;
+    }
+
+    if (aux) {
+      long t = aux->t;
+      long acc = 0;
+      for (long i : range(k)) {
+        long a = NTL::rem((unsigned long)y[i], t, aux->red);
+        acc = NTL::AddMod(acc, NTL::MulMod(a, aux->qHatModT[i], t), t);
+      }
+      long vt = NTL::rem((unsigned long)v, t, aux->red);
+      outAux[h] = NTL::SubMod(acc, NTL::MulMod(vt, aux->QModT, t), t);
+    }
+  }
+  NTL_EXEC_RANGE_END
+}
+
+} // namespace helib
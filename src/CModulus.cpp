@@ -43,7 +43,7 @@ NTL::zz_pContext BuildContext(long p, long maxroot)
 
 // Constructor: it is assumed that zms is already set with m>1
 // If q == 0, then the current context is used
-Cmodulus::Cmodulus(const PAlgebra& zms, long qq, long rt)
+Cmodulus::Cmodulus(const PAlgebra& zms, long qq, long rt, bool nativeNTT)
 {
   assertTrue<InvalidArgument>(zms.getM() > 1,
                               "Bad Z_m^* modulus m (must be greater than 1)");
@@ -103,6 +103,13 @@ Cmodulus::Cmodulus(const PAlgebra& zms, long qq, long rt)
     long w0 = NTL::zz_pInfo->p_info->RootTable[0][k];
     long w1 = NTL::zz_pInfo->p_info->RootTable[1][k];
 
+    if (nativeNTT) {
+      // w0 is a primitive m-th root of unity, so this evaluates at the
+      // same points (and in the same order) as the code below
+      ntt.reset(new NegacyclicNTT(q, w0, k - 1));
+      return;
+    }
+
     powers->rep.SetLength(phim);
     powers_aux.SetLength(phim);
     for (long i = 0, w = 1; i < phim; i++) {
@@ -200,6 +207,7 @@ Cmodulus& Cmodulus::operator=(const Cmodulus& other)
   ipowers = other.ipowers;
   iRb = other.iRb;
   phimx = other.phimx;
+  ntt = other.ntt;
 
 #ifdef HELIB_OPENCL
   altFFTInfo = other.altFFTInfo;
@@ -342,10 +350,25 @@ static void BitReverseCopy(long* NTL_RESTRICT B,
 
 //================================================
 
-void Cmodulus::FFT_aux(NTL::vec_long& y, NTL::zz_pX& tmp) const
+void Cmodulus::FFT_aux(long* y, NTL::zz_pX& tmp) const
 {
   HELIB_TIMER_START;
 
+  if (ntt) {
+    // m is a power of 2, use the native NTT
+    long phim = ntt->getN();
+    long dx = deg(tmp);
+    const NTL::zz_p* tmp_p = tmp.rep.elts();
+
+    for (long i = 0; i <= dx; i++)
+      y[i] = rep(tmp_p[i]);
+    for (long i = dx + 1; i < phim; i++)
+      y[i] = 0;
+
+    ntt->forward(y, y);
+    return;
+  }
+
   if (zMStar->getPow2()) {
     // special case when m is a power of 2
 
@@ -357,8 +380,7 @@ void Cmodulus::FFT_aux(NTL::vec_long& y, NTL::zz_pX& tmp) const
     const NTL::zz_p* powers_p = (*powers).rep.elts();
     const NTL::mulmod_precon_t* powers_aux_p = powers_aux.elts();
 
-    y.SetLength(phim);
-    long* yp = y.elts();
+    long* yp = y;
 
     NTL::zz_p* tmp_p = tmp.rep.elts();
 
@@ -407,7 +429,6 @@ void Cmodulus::FFT_aux(NTL::vec_long& y, NTL::zz_pX& tmp) const
 
   // copy the result to the output vector y, keeping only the
   // entries corresponding to primitive roots of unity
-  y.SetLength(zMStar->getPhiM());
   long i, j;
   long m = getM();
   for (i = j = 0; i < m; i++)
@@ -416,6 +437,18 @@ void Cmodulus::FFT_aux(NTL::vec_long& y, NTL::zz_pX& tmp) const
 }
 
 void Cmodulus::FFT(NTL::vec_long& y, const NTL::ZZX& x) const
+{
+  y.SetLength(getPhiM());
+  FFT(y.elts(), x);
+}
+
+void Cmodulus::FFT(NTL::vec_long& y, const zzX& x) const
+{
+  y.SetLength(getPhiM());
+  FFT(y.elts(), x);
+}
+
+void Cmodulus::FFT(long* y, const NTL::ZZX& x) const
 {
   HELIB_TIMER_START;
   NTL::zz_pBak bak;
@@ -431,7 +464,7 @@ void Cmodulus::FFT(NTL::vec_long& y, const NTL::ZZX& x) const
   FFT_aux(y, tmp);
 }
 
-void Cmodulus::FFT(NTL::vec_long& y, const zzX& x) const
+void Cmodulus::FFT(long* y, const zzX& x) const
 {
   HELIB_TIMER_START;
   NTL::zz_pBak bak;
@@ -448,12 +481,36 @@ void Cmodulus::FFT(NTL::vec_long& y, const zzX& x) const
 }
 
 void Cmodulus::iFFT(NTL::zz_pX& x, const NTL::vec_long& y) const
+{
+  iFFT(x, y.elts());
+}
+
+void Cmodulus::iFFT(NTL::zz_pX& x, const long* y) const
 {
   HELIB_TIMER_START;
   NTL::zz_pBak bak;
   bak.save();
   context.restore();
 
+  if (ntt) {
+    // m is a power of 2, use the native NTT
+    long phim = ntt->getN();
+
+    NTL::vec_long& tmp = Cmodulus::getScratch_vec_long();
+    tmp.SetLength(phim);
+    long* tmp_p = tmp.elts();
+
+    ntt->inverse(tmp_p, y);
+
+    x.rep.SetLength(phim);
+    NTL::zz_p* xp = x.rep.elts();
+    for (long i = 0; i < phim; i++)
+      xp[i].LoopHole() = tmp_p[i]; // DIRT: tmp_p[i] already reduced
+
+    x.normalize();
+    return;
+  }
+
   if (zMStar->getPow2()) {
     // special case when m is a power of 2
 
@@ -464,7 +521,7 @@ void Cmodulus::iFFT(NTL::zz_pX& x, const NTL::vec_long& y) const
     const NTL::zz_p* ipowers_p = (*ipowers).rep.elts();
     const NTL::mulmod_precon_t* ipowers_aux_p = ipowers_aux.elts();
 
-    const long* yp = y.elts();
+    const long* yp = y;
 
     NTL::vec_long& tmp = Cmodulus::getScratch_vec_long();
     tmp.SetLength(phim);
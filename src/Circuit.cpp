@@ -0,0 +1,364 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+/* Circuit.cpp - deferred evaluation of a circuit of ciphertext operations
+ */
+#include <algorithm>
+#include <memory>
+
+#include <NTL/BasicThreadPool.h>
+
+#include <helib/Circuit.h>
+#include <helib/HoistedCtxt.h>
+#include <helib/keys.h>
+#include <helib/timing.h>
+
+namespace helib {
+
+Circuit::Circuit(const PubKey& _pubKey) :
+    pubKey(_pubKey), ea(_pubKey.getContext().getView())
+{}
+
+void Circuit::checkNode(Node a) const
+{
+  assertInRange<InvalidArgument>(a, 0l, size(), "Circuit: no such node");
+}
+
+Circuit::Op Circuit::op(Node a) const
+{
+  checkNode(a);
+  return nodes[a].op;
+}
+
+Circuit::Node Circuit::make(Op op, Node a, Node b, long param)
+{
+  checkNode(a);
+  if (b >= 0)
+    checkNode(b);
+
+  auto key = std::make_tuple(op, a, b, param);
+  auto it = known.find(key);
+  if (it != known.end())
+    return it->second; // a common subexpression
+
+  nodes.push_back(NodeData{op, a, b, param});
+  known.emplace(key, size() - 1);
+  return size() - 1;
+}
+
+Circuit::Node Circuit::input()
+{
+  nodes.push_back(NodeData{Op::INPUT, -1, -1, nInputs++});
+  return size() - 1;
+}
+
+Circuit::Constant Circuit::constant(const PtxtArray& value)
+{
+  assertEq<InvalidArgument>(&value.getView().getContext(),
+                            &pubKey.getContext(),
+                            "Circuit: constant of another context");
+  constants.push_back(value);
+  return constants.size() - 1;
+}
+
+Circuit::Node Circuit::add(Node a, Node b)
+{
+  return make(Op::ADD, std::min(a, b), std::max(a, b));
+}
+
+Circuit::Node Circuit::sub(Node a, Node b) { return make(Op::SUB, a, b); }
+
+Circuit::Node Circuit::negate(Node a)
+{
+  checkNode(a);
+  if (nodes[a].op == Op::NEGATE)
+    return nodes[a].a;
+  return make(Op::NEGATE, a);
+}
+
+Circuit::Node Circuit::mult(Node a, Node b)
+{
+  return make(Op::MULT, std::min(a, b), std::max(a, b));
+}
+
+Circuit::Node Circuit::rotate(Node a, long k)
+{
+  checkNode(a);
+  if (nodes[a].op == Op::ROTATE) { // merge with the rotation of a
+    k += nodes[a].param;
+    a = nodes[a].a;
+  }
+  k = mcMod(k, ea.size());
+  if (k == 0)
+    return a;
+  return make(Op::ROTATE, a, -1, k);
+}
+
+Circuit::Node Circuit::addConstant(Node a, Constant c)
+{
+  assertInRange<InvalidArgument>(c,
+                                 0l,
+                                 lsize(constants),
+                                 "Circuit: no such constant");
+  return make(Op::ADD_CONST, a, -1, c);
+}
+
+Circuit::Node Circuit::multByConstant(Node a, Constant c)
+{
+  assertInRange<InvalidArgument>(c,
+                                 0l,
+                                 lsize(constants),
+                                 "Circuit: no such constant");
+  return make(Op::MUL_CONST, a, -1, c);
+}
+
+Circuit::Node Circuit::multByInteger(Node a, long c)
+{
+  checkNode(a);
+  if (c == 1)
+    return a;
+  return make(Op::MUL_INT, a, -1, c);
+}
+
+Circuit::Node Circuit::reCrypt(Node a) { return make(Op::RECRYPT, a); }
+
+std::vector<long> Circuit::schedule(const std::vector<Node>& outputs) const
+{
+  // The nodes are created after their operands, so the index order is a
+  // topological order
+  std::vector<bool> needed(nodes.size(), false);
+  for (Node n : outputs) {
+    checkNode(n);
+    needed[n] = true;
+  }
+  for (long n = size() - 1; n >= 0; n--) {
+    if (!needed[n] || nodes[n].op == Op::INPUT)
+      continue;
+    needed[nodes[n].a] = true;
+    if (nodes[n].b >= 0)
+      needed[nodes[n].b] = true;
+  }
+
+  std::vector<long> wave(nodes.size(), -1);
+  for (long n = 0; n < size(); n++) {
+    if (!needed[n])
+      continue;
+    if (nodes[n].op == Op::INPUT) {
+      wave[n] = 0;
+      continue;
+    }
+    wave[n] = wave[nodes[n].a] + 1;
+    if (nodes[n].b >= 0)
+      wave[n] = std::max(wave[n], wave[nodes[n].b] + 1);
+  }
+  return wave;
+}
+
+Circuit::Stats Circuit::analyze(const std::vector<Node>& outputs) const
+{
+  std::vector<long> wave = schedule(outputs);
+  std::vector<long> depth(nodes.size(), 0);
+  Stats stats;
+  for (long n = 0; n < size(); n++) {
+    if (wave[n] <= 0) // not needed, or an input
+      continue;
+    const NodeData& node = nodes[n];
+    stats.operations++;
+    stats.waves = std::max(stats.waves, wave[n]);
+    depth[n] = depth[node.a];
+    if (node.b >= 0)
+      depth[n] = std::max(depth[n], depth[node.b]);
+
+    switch (node.op) {
+    case Op::MULT:
+      stats.multiplications++;
+      stats.keySwitches++;
+      depth[n]++;
+      break;
+    case Op::ROTATE:
+      stats.rotations++;
+      stats.keySwitches++;
+      break;
+    case Op::RECRYPT:
+      stats.recryptions++;
+      depth[n] = 0;
+      break;
+    default:
+      break;
+    }
+  }
+  for (Node n : outputs)
+    stats.depth = std::max(stats.depth, depth[n]);
+  return stats;
+}
+
+void Circuit::apply(Node n, Ctxt& result, const Ctxt* second) const
+{
+  const NodeData& node = nodes[n];
+  switch (node.op) {
+  case Op::ADD:
+    result += *second;
+    break;
+  case Op::SUB:
+    result -= *second;
+    break;
+  case Op::NEGATE:
+    result.negate();
+    break;
+  case Op::MULT:
+    if (node.a == node.b)
+      result.square();
+    else
+      result.multiplyBy(*second);
+    break;
+  case Op::ROTATE:
+    ea.rotate(result, node.param);
+    break;
+  case Op::ADD_CONST:
+    result.addConstant(constants[node.param]);
+    break;
+  case Op::MUL_CONST:
+    result.multByConstant(constants[node.param]);
+    break;
+  case Op::MUL_INT:
+    result.multByConstant(node.param);
+    break;
+  case Op::RECRYPT:
+    pubKey.reCrypt(result);
+    break;
+  case Op::INPUT:
+    throw LogicError("Circuit: an input is not computed");
+  }
+}
+
+void Circuit::evaluate(std::vector<Ctxt>& results,
+                       const std::vector<Ctxt>& inputs,
+                       const std::vector<Node>& outputs) const
+{
+  HELIB_TIMER_START;
+  assertEq<InvalidArgument>(lsize(inputs),
+                            nInputs,
+                            "Circuit: wrong number of inputs");
+  std::vector<long> wave = schedule(outputs);
+  long nWaves = 0;
+  for (long w : wave)
+    nWaves = std::max(nWaves, w);
+
+  // The pending uses of each node. The outputs count as one use each, so
+  // they are kept until the end.
+  std::vector<long> uses(nodes.size(), 0);
+  std::vector<std::vector<Node>> waves(nWaves + 1);
+  for (long n = 0; n < size(); n++) {
+    if (wave[n] < 0)
+      continue;
+    waves[wave[n]].push_back(n);
+    if (nodes[n].op == Op::INPUT)
+      continue;
+    uses[nodes[n].a]++;
+    if (nodes[n].b >= 0)
+      uses[nodes[n].b]++;
+  }
+  for (Node n : outputs)
+    uses[n]++;
+
+  // The value of each node, the intermediate values are owned by this
+  // function and freed after their last use
+  std::vector<const Ctxt*> value(nodes.size(), nullptr);
+  std::vector<std::unique_ptr<Ctxt>> owned(nodes.size());
+  for (Node n : waves[0])
+    value[n] = &inputs.at(nodes[n].param);
+
+  // A new ciphertext with the value of a for its last user, taking over
+  // its ciphertext when there is no other use
+  auto takeValue = [&](Node a) {
+    if (owned[a] && uses[a] == 1)
+      return std::move(owned[a]);
+    return std::unique_ptr<Ctxt>(new Ctxt(*value[a]));
+  };
+
+  for (long w = 1; w <= nWaves; w++) {
+    std::vector<Node> ops, recrypts;
+    for (Node n : waves[w])
+      (nodes[n].op == Op::RECRYPT ? recrypts : ops).push_back(n);
+
+    // Hoist the nodes that are rotated more than once (single dimension)
+    std::map<Node, std::unique_ptr<HoistedCtxt>> hoisted;
+    if (ea.dimension() == 1) {
+      std::map<Node, long> rotations;
+      for (Node n : ops)
+        if (nodes[n].op == Op::ROTATE)
+          rotations[nodes[n].a]++;
+      for (const auto& entry : rotations)
+        if (entry.second > 1)
+          hoisted[entry.first].reset(new HoistedCtxt(*value[entry.first]));
+    }
+
+    // Each node is written by only one thread
+    std::vector<std::unique_ptr<Ctxt>> computed(ops.size());
+    auto compute = [&](long i) {
+      Node n = ops[i];
+      const NodeData& node = nodes[n];
+      if (node.op == Op::ROTATE && hoisted.count(node.a)) {
+        const HoistedCtxt& in = *hoisted.at(node.a);
+        computed[i].reset(new Ctxt(ZeroCtxtLike, in.getCtxt()));
+        ea.rotate1D(*computed[i], in, 0, node.param);
+        return;
+      }
+      computed[i] = takeValue(node.a);
+      apply(n, *computed[i], node.b >= 0 ? value[node.b] : nullptr);
+    };
+
+    long count = ops.size();
+    if (count > 1 && count >= NTL::AvailableThreads()) {
+      NTL_EXEC_RANGE(count, first, last)
+      for (long i = first; i < last; i++)
+        compute(i);
+      NTL_EXEC_RANGE_END
+    } else {
+      for (long i = 0; i < count; i++)
+        compute(i);
+    }
+    for (long i = 0; i < count; i++)
+      owned[ops[i]] = std::move(computed[i]);
+
+    // The reCrypt operations of the wave are bootstrapped together
+    if (!recrypts.empty()) {
+      std::vector<Ctxt> batch;
+      for (Node n : recrypts)
+        batch.push_back(std::move(*takeValue(nodes[n].a)));
+      pubKey.reCryptBatch(batch);
+      for (std::size_t i = 0; i < recrypts.size(); i++)
+        owned[recrypts[i]].reset(new Ctxt(std::move(batch[i])));
+    }
+
+    for (Node n : waves[w])
+      value[n] = owned[n].get();
+
+    // Free the values that are no longer needed
+    for (Node n : waves[w]) {
+      for (Node a : {nodes[n].a, nodes[n].b}) {
+        if (a >= 0 && --uses[a] == 0) {
+          owned[a].reset();
+          value[a] = nullptr;
+        }
+      }
+    }
+  }
+
+  results.clear();
+  results.reserve(outputs.size());
+  for (Node n : outputs) {
+    results.push_back(std::move(*takeValue(n)));
+    uses[n]--;
+  }
+}
+
+} // namespace helib
@@ -9,20 +9,26 @@
  * See the License for the specific language governing permissions and
  * limitations under the License. See accompanying LICENSE file.
  */
+#include <cstdio>
 #include <cstring>
 #include <algorithm>
+#include <fstream>
 #include <optional>
+#include <random>
+#include <sstream>
 
 #include <json.hpp>
 using json = ::nlohmann::json;
 
 #include <helib/Context.h>
+#include <helib/BaseConverter.h>
 #include <helib/EvalMap.h>
 #include <helib/powerful.h>
 #include <helib/sample.h>
 #include <helib/EncryptedArray.h>
 #include <helib/PolyModRing.h>
 #include <helib/fhe_stats.h>
+#include <helib/log.h>
 
 #include "binio.h"
 #include "io.h"
@@ -174,6 +180,7 @@ struct Context::ModChainParams
   long bitsInSpecialPrimes;
   double stdev;
   double scale;
+  bool nativeNTT;
 };
 
 struct Context::BootStrapParams
@@ -204,6 +211,13 @@ struct Context::SerializableContent
   bool alsoThick;
 };
 
+// The tables stored in a snapshot, see writeSnapshotTo.
+struct Context::Snapshot
+{
+  PAlgebraTables tables;
+  std::vector<long> roots; // The roots of unity of the moduli
+};
+
 long FindM(long k,
            long nBits,
            long c,
@@ -365,6 +379,22 @@ void Context::productOfPrimes(NTL::ZZ& p, const IndexSet& s) const
     p *= ithPrime(i);
 }
 
+const BaseConverter& Context::getBaseConverter(const IndexSet& from,
+                                               const IndexSet& to) const
+{
+  std::pair<std::vector<long>, std::vector<long>> key;
+  for (long i : from)
+    key.first.push_back(i);
+  for (long i : to)
+    key.second.push_back(i);
+
+  HELIB_MUTEX_GUARD(baseConvertersLock);
+  std::shared_ptr<const BaseConverter>& conv = baseConverters[key];
+  if (!conv)
+    conv = std::make_shared<BaseConverter>(*this, from, to);
+  return *conv;
+}
+
 bool Context::operator==(const Context& other) const
 {
   if (&other == this)
@@ -418,6 +448,17 @@ void Context::writeTo(std::ostream& str) const
 
   writeEyeCatcher(str, EyeCatcher::CONTEXT_BEGIN);
 
+  writeParamsTo(str);
+
+  write_ntl_vec_long(str, this->rcData.mvec);
+  write_raw_int(str, static_cast<long>(this->rcData.build_cache));
+  write_raw_int(str, static_cast<long>(this->rcData.alsoThick));
+
+  writeEyeCatcher(str, EyeCatcher::CONTEXT_END);
+}
+
+void Context::writeParamsTo(std::ostream& str) const
+{
   write_raw_int(str, this->zMStar.getP());
   write_raw_int(str, this->alMod.getR());
   write_raw_int(str, this->zMStar.getM());
@@ -469,12 +510,6 @@ void Context::writeTo(std::ostream& str) const
   write_raw_int(str, this->hwt_param);
   write_raw_int(str, this->e_param);
   write_raw_int(str, this->ePrime_param);
-
-  write_ntl_vec_long(str, this->rcData.mvec);
-  write_raw_int(str, static_cast<long>(this->rcData.build_cache));
-  write_raw_int(str, static_cast<long>(this->rcData.alsoThick));
-
-  writeEyeCatcher(str, EyeCatcher::CONTEXT_END);
 }
 
 Context::SerializableContent Context::readParamsFrom(std::istream& str)
@@ -542,6 +577,290 @@ Context* Context::readPtrFrom(std::istream& str)
   return new Context(readParamsFrom(str));
 }
 
+static std::array<unsigned char, 32> digestOf(const std::string& data)
+{
+  std::array<unsigned char, 32> digest;
+  NTL::DeriveKey(digest.data(),
+                 digest.size(),
+                 reinterpret_cast<const unsigned char*>(data.data()),
+                 data.size());
+  return digest;
+}
+
+static void writeZZXTable(std::ostream& str, const std::vector<zzX>& v)
+{
+  write_raw_int(str, v.size());
+  for (const zzX& poly : v)
+    write_ntl_vec_long(str, poly);
+}
+
+static void readZZXTable(std::istream& str, std::vector<zzX>& v)
+{
+  long n = read_raw_int(str);
+  assertTrue<IOError>(n >= 0 && str.good(), "Bad number of polynomials");
+  v.assign(n, zzX());
+  for (zzX& poly : v)
+    read_ntl_vec_long(str, poly);
+}
+
+// The number of bytes left in str, or -1 if the stream cannot tell
+static long remainingBytes(std::istream& str)
+{
+  std::streampos pos = str.tellg();
+  if (pos == std::streampos(-1))
+    return -1;
+  str.seekg(0, std::ios::end);
+  std::streampos end = str.tellg();
+  str.seekg(pos);
+  if (end == std::streampos(-1) || !str.good())
+    return -1;
+  return end - pos;
+}
+
+void Context::writeSnapshotTo(std::ostream& str) const
+{
+  writeTo(str);
+
+  PAlgebraTables tables;
+  tables.polyNormBnd = zMStar.getPolyNormBnd();
+  tables.PhimX = zMStar.getPhimX();
+  alMod.getTables(tables);
+
+  std::ostringstream ss;
+  write_raw_int(ss, zMStar.getM());
+  write_raw_int(ss, zMStar.getP());
+  write_raw_int(ss, alMod.getR());
+  write_raw_double(ss, tables.polyNormBnd);
+  write_raw_ZZX(ss, tables.PhimX);
+  writeZZXTable(ss, tables.factors);
+  writeZZXTable(ss, tables.crtCoeffs);
+  writeZZXTable(ss, tables.crtTable);
+  write_raw_int(ss, moduli.size());
+  for (const Cmodulus& modulus : moduli) {
+    write_raw_int(ss, modulus.getQ());
+    write_raw_int(ss, modulus.getRoot());
+  }
+  const std::string& data = ss.str();
+
+  writeEyeCatcher(str, EyeCatcher::SNAP_BEGIN);
+  write_raw_int(str, data.size());
+  std::array<unsigned char, 32> digest = digestOf(data);
+  str.write(reinterpret_cast<const char*>(digest.data()), digest.size());
+  str.write(data.data(), data.size());
+  writeEyeCatcher(str, EyeCatcher::SNAP_END);
+}
+
+bool Context::readSnapshotTables(std::istream& str,
+                                 const SerializableContent& content,
+                                 Snapshot& snapshot)
+{
+  try {
+    bool eyeCatcherFound = readEyeCatcher(str, EyeCatcher::SNAP_BEGIN);
+    assertTrue<IOError>(eyeCatcherFound,
+                        "Could not find pre-snapshot eye catcher");
+
+    long size = read_raw_int(str);
+    std::array<unsigned char, 32> digest;
+    str.read(reinterpret_cast<char*>(digest.data()), digest.size());
+    long remaining = remainingBytes(str);
+    assertTrue<IOError>(size >= 0 && str.good() &&
+                            (remaining < 0 || size <= remaining),
+                        "Bad snapshot size");
+
+    // Read in chunks, so that a corrupt size on a stream whose length is
+    // unknown fails at the end of the stream rather than allocating it all
+    const long chunk = 1L << 20;
+    std::string data;
+    while (long(data.size()) < size && str.good()) {
+      long offset = data.size();
+      long n = std::min(chunk, size - offset);
+      data.resize(offset + n);
+      str.read(&data[offset], n);
+    }
+    assertTrue<IOError>(str.good() && digest == digestOf(data),
+                        "Snapshot checksum mismatch");
+
+    eyeCatcherFound = readEyeCatcher(str, EyeCatcher::SNAP_END);
+    assertTrue<IOError>(eyeCatcherFound,
+                        "Could not find post-snapshot eye catcher");
+
+    std::istringstream ss(data);
+    long m = read_raw_int(ss);
+    long p = read_raw_int(ss);
+    long r = read_raw_int(ss);
+    assertTrue<IOError>(m == content.m && p == content.p && r == content.r,
+                        "Snapshot tables are for other parameters");
+
+    PAlgebraTables& tables = snapshot.tables;
+    tables.polyNormBnd = read_raw_double(ss);
+    read_raw_ZZX(ss, tables.PhimX);
+    readZZXTable(ss, tables.factors);
+    readZZXTable(ss, tables.crtCoeffs);
+    readZZXTable(ss, tables.crtTable);
+
+    long nModuli = read_raw_int(ss);
+    assertEq<IOError>(nModuli,
+                      lsize(content.qs),
+                      "Snapshot tables are for another prime chain");
+    snapshot.roots.resize(nModuli);
+    for (long i : range(nModuli)) {
+      long q = read_raw_int(ss);
+      assertEq<IOError>(q,
+                        content.qs[i],
+                        "Snapshot tables are for another prime chain");
+      snapshot.roots[i] = read_raw_int(ss);
+    }
+    assertTrue<IOError>(ss.good(), "Truncated snapshot tables");
+    return true;
+  } catch (const std::exception& err) { // e.g. std::bad_alloc
+    Warning(std::string("Recomputing the context tables: ") + err.what());
+    return false;
+  }
+}
+
+Context Context::readSnapshotFrom(std::istream& str)
+{
+  SerializableContent content = readParamsFrom(str);
+  Snapshot snapshot;
+  if (readSnapshotTables(str, content, snapshot)) {
+    try {
+      return Context(content, &snapshot);
+    } catch (const std::exception& err) {
+      Warning(std::string("Recomputing the context tables: ") + err.what());
+    }
+  }
+  return Context(content);
+}
+
+Context* Context::readSnapshotPtrFrom(std::istream& str)
+{
+  SerializableContent content = readParamsFrom(str);
+  Snapshot snapshot;
+  if (readSnapshotTables(str, content, snapshot)) {
+    try {
+      return new Context(content, &snapshot);
+    } catch (const std::exception& err) {
+      Warning(std::string("Recomputing the context tables: ") + err.what());
+    }
+  }
+  return new Context(content);
+}
+
+std::array<unsigned char, 32> Context::recryptDataDigest(
+    const NTL::Vec<long>& mvec,
+    bool build_cache,
+    bool alsoThick) const
+{
+  // Hash everything that the recryption data is built from
+  std::ostringstream ss;
+  writeParamsTo(ss);
+  write_ntl_vec_long(ss, mvec);
+  write_raw_int(ss, build_cache);
+  write_raw_int(ss, alsoThick);
+  write_raw_int(ss, fhe_test_force_bsgs);
+  return digestOf(ss.str());
+}
+
+void Context::writeRecryptDataTo(std::ostream& str) const
+{
+  assertTrue(isBootstrappable(),
+             "writeRecryptDataTo invoked before enableBootStrapping");
+
+  SerializeHeader<RecryptData>().writeTo(str);
+  writeEyeCatcher(str, EyeCatcher::RCD_BEGIN);
+
+  std::array<unsigned char, 32> digest =
+      recryptDataDigest(rcData.mvec, rcData.build_cache, rcData.alsoThick);
+  str.write(reinterpret_cast<const char*>(digest.data()), digest.size());
+  rcData.writeTo(str);
+
+  writeEyeCatcher(str, EyeCatcher::RCD_END);
+}
+
+void Context::readRecryptDataFrom(std::istream& str,
+                                  const NTL::Vec<long>& mvec,
+                                  bool build_cache,
+                                  bool alsoThick)
+{
+  assertTrue(e_param > 0,
+             "readRecryptDataFrom invoked but willBeBootstrappable "
+             "not set in buildModChain");
+  assertFalse(isBootstrappable(), "Recryption data already initialized");
+
+  const auto header = SerializeHeader<RecryptData>::readFrom(str);
+  assertEq<IOError>(header.version,
+                    Binio::VERSION_0_0_1_0,
+                    "Header: version " + header.versionString() +
+                        " not supported");
+  assertEq<IOError>(header.structId,
+                    nameToStructId<RecryptData>(),
+                    "Not a serialized recryption data");
+
+  bool eyeCatcherFound = readEyeCatcher(str, EyeCatcher::RCD_BEGIN);
+  assertTrue<IOError>(eyeCatcherFound,
+                      "Could not find pre-recryption-data eye catcher");
+
+  std::array<unsigned char, 32> digest;
+  str.read(reinterpret_cast<char*>(digest.data()), digest.size());
+  assertTrue<IOError>(str.good() &&
+                          digest ==
+                              recryptDataDigest(mvec, build_cache, alsoThick),
+                      "Recryption data does not match the parameters");
+
+  // read into a copy, so that a failure leaves the context unchanged
+  ThinRecryptData data;
+  data.readFrom(str, *this, mvec, alsoThick, build_cache);
+
+  eyeCatcherFound = readEyeCatcher(str, EyeCatcher::RCD_END);
+  assertTrue<IOError>(eyeCatcherFound,
+                      "Could not find post-recryption-data eye catcher");
+
+  rcData = std::move(data);
+}
+
+bool Context::enableBootStrappingWithCache(const NTL::Vec<long>& mvec,
+                                           const std::string& path,
+                                           bool build_cache,
+                                           bool alsoThick)
+{
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (in) {
+      // readRecryptDataFrom only sets rcData once everything is read, so a
+      // failure leaves nothing half installed for enableBootStrapping
+      try {
+        readRecryptDataFrom(in, mvec, build_cache, alsoThick);
+        return true;
+      } catch (const std::exception& err) {
+        // e.g. a truncated file, or a corrupt size that fails to allocate
+        Warning("Rebuilding recryption data, cannot use " + path + ": " +
+                err.what());
+      }
+    }
+  }
+
+  enableBootStrapping(mvec, build_cache, alsoThick);
+
+  // Write to a temporary file and rename it, so that a reader never sees a
+  // partially written file
+  std::string tmpPath = path + ".tmp" + std::to_string(std::random_device{}());
+  {
+    std::ofstream out(tmpPath, std::ios::binary);
+    if (out)
+      writeRecryptDataTo(out);
+    if (!out) {
+      Warning("Cannot write recryption data to " + tmpPath);
+      std::remove(tmpPath.c_str());
+      return false;
+    }
+  }
+  if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+    Warning("Cannot rename " + tmpPath + " to " + path);
+    std::remove(tmpPath.c_str());
+  }
+  return false;
+}
+
 Context::SerializableContent Context::readParamsFromJSON(
     const JsonWrapper& jwrap)
 {
@@ -692,9 +1011,10 @@ Context::Context(unsigned long m,
                  unsigned long p,
                  unsigned long r,
                  const std::vector<long>& gens,
-                 const std::vector<long>& ords) :
-    zMStar(m, p, gens, ords),
-    alMod(zMStar, r),
+                 const std::vector<long>& ords,
+                 const PAlgebraTables* tables) :
+    zMStar(m, p, gens, ords, tables),
+    alMod(zMStar, r, tables),
 
     // VJS-FIXME: I'm not sure this makes sense.
     // This constrictor was provided mainly for bootstrapping.
@@ -749,6 +1069,7 @@ Context::Context(long m,
   if (mparams) {
     this->stdev = mparams->stdev;
     this->scale = mparams->scale;
+    this->nativeNTT = mparams->nativeNTT;
 
     this->buildModChain(mparams->bits,
                         mparams->c,
@@ -765,8 +1086,14 @@ Context::Context(long m,
   }
 }
 
-Context::Context(const SerializableContent& content) :
-    Context(content.m, content.p, content.r, content.gens, content.ords)
+Context::Context(const SerializableContent& content,
+                 const Snapshot* snapshot) :
+    Context(content.m,
+            content.p,
+            content.r,
+            content.gens,
+            content.ords,
+            snapshot ? &snapshot->tables : nullptr)
 {
   this->stdev = content.stdev;
   this->scale = content.scale;
@@ -777,8 +1104,10 @@ Context::Context(const SerializableContent& content) :
 
   for (long i = 0; i < lsize(content.qs); i++) {
     long q = content.qs[i];
+    // A root of unity of zero is found by Cmodulus
+    long root = snapshot ? snapshot->roots[i] : 0;
 
-    this->moduli.emplace_back(this->zMStar, q, 0);
+    this->moduli.emplace_back(this->zMStar, q, root, this->nativeNTT);
 
     // FIXME: Consider serializing all 3 sets and setting them directly.
     if (content.smallPrimes.contains(i))
@@ -884,7 +1213,7 @@ void Context::addCtxtPrime(long q)
 {
   assertFalse(inChain(q), "Prime q is already in the prime chain");
   long i = moduli.size(); // The index of the new prime in the list
-  moduli.push_back(Cmodulus(zMStar, q, 0));
+  moduli.push_back(Cmodulus(zMStar, q, 0, nativeNTT));
   ctxtPrimes.insert(i);
 }
 
@@ -892,7 +1221,7 @@ void Context::addSpecialPrime(long q)
 {
   assertFalse(inChain(q), "Special prime q is already in the prime chain");
   long i = moduli.size(); // The index of the new prime in the list
-  moduli.push_back(Cmodulus(zMStar, q, 0));
+  moduli.push_back(Cmodulus(zMStar, q, 0, nativeNTT));
   specialPrimes.insert(i);
 }
 
@@ -1166,7 +1495,7 @@ void Context::addSmallPrime(long q)
 {
   assertFalse(inChain(q), "Small prime q is already in the prime chain");
   long i = moduli.size(); // The index of the new prime in the list
-  moduli.push_back(Cmodulus(zMStar, q, 0));
+  moduli.push_back(Cmodulus(zMStar, q, 0, nativeNTT));
   smallPrimes.insert(i);
 }
 
@@ -1196,7 +1525,8 @@ ContextBuilder<SCHEME>::makeParamsArgs() const
                                                          resolution_,
                                                          bitsInSpecialPrimes_,
                                                          stdev_,
-                                                         scale_})
+                                                         scale_,
+                                                         nativeNTTFlag_})
           : std::nullopt;
 
   const auto bparams = bootstrappableFlag_
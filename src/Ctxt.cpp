@@ -11,6 +11,9 @@
  */
 #include <NTL/BasicThreadPool.h>
 #include <NTL/ZZ.h>
+#include <array>
+#include <sstream>
+#include <type_traits>
 
 #include "io.h"
 #include "binio.h"
@@ -173,47 +176,45 @@ bool Ctxt::verifyPrimeSet() const
 
 // Multiply vector of digits by key-switching matrix and add to *this.
 // It is assumed that W has at least as many b[i]'s as there are digits.
-// The vector of digits is modified in place.
-void Ctxt::keySwitchDigits(const KeySwitch& W, std::vector<DoubleCRT>& digits)
-{ // An object to hold the pseudorandom ai's, note that it must be defined
-  // with the maximum number of levels, else the PRG will go out of sync.
-  // FIXME: This is a bug waiting to happen.
-
-  DoubleCRT ai(context, context.getCtxtPrimes() | context.getSpecialPrimes());
-
-  // Subsequent ai's use the evolving RNG state
-  RandomState state; // backup the NTL PRG seed
-  NTL::SetSeed(W.prgSeed);
-
-  // Add the columns in, one by one
-  DoubleCRT tmpDCRT(context, IndexSet::emptySet());
-  for (size_t i = 0; i < digits.size(); i++) {
-    HELIB_NTIMER_START(KS_loop);
-    ai.randomize();
-    tmpDCRT = digits[i];
-
-    // The operations below all use the IndexSet of tmpDCRT
-
-    // add digit*a[i] with a handle pointing to base of W.toKeyID
-    {
-      HELIB_NTIMER_START(KS_loop_1);
-      tmpDCRT.Mul(ai, /*matchIndexSet=*/false);
-    }
-    {
-      HELIB_NTIMER_START(KS_loop_2);
-      this->addPart(tmpDCRT, SKHandle(1, 1, W.toKeyID), /*matchPrimeSet=*/true);
-    }
-    // add digit*b[i] with a handle pointing to one
-    {
-      HELIB_NTIMER_START(KS_loop_3);
-      digits[i].Mul(W.b[i], /*matchIndexSet=*/false);
-    }
-    {
-      HELIB_NTIMER_START(KS_loop_4);
-      this->addPart(digits[i], SKHandle(), /*matchPrimeSet=*/true);
-    }
+void Ctxt::keySwitchDigits(const KeySwitch& W,
+                           const std::vector<DoubleCRT>& digits)
+{
+  if (digits.empty())
+    return;
+
+  long n = digits.size();
+
+  // The pseudorandom ai's, each one is regenerated from its own seed (see
+  // KeySwitch::randomizeA), so they are all generated concurrently. Note that
+  // they must be defined with the maximum number of levels.
+  std::vector<DoubleCRT> a(n, DoubleCRT(context, context.fullPrimes()));
+  {
+    HELIB_NTIMER_START(KS_loop_randomize);
+    NTL_EXEC_RANGE(n, first, last)
+    for (long i = first; i < last; i++)
+      W.randomizeA(a[i], i);
+    NTL_EXEC_RANGE_END
+  }
+
+  // The operations below all use the IndexSet of the digits
+  const IndexSet& s = digits[0].getIndexSet();
+
+  // add sum_i digit[i]*a[i] with a handle pointing to base of W.toKeyID
+  {
+    HELIB_NTIMER_START(KS_loop_1);
+    DoubleCRT sumA(context, s);
+    sumA.dotProduct(digits, a);
+    this->addPart(sumA, SKHandle(1, 1, W.toKeyID), /*matchPrimeSet=*/true);
+  }
+
+  // add sum_i digit[i]*b[i] with a handle pointing to one
+  {
+    HELIB_NTIMER_START(KS_loop_2);
+    DoubleCRT sumB(context, s);
+    sumB.dotProduct(digits, W.b);
+    this->addPart(sumB, SKHandle(), /*matchPrimeSet=*/true);
   }
-} // restore random state upon destruction of the RandomState, see NumbTh.h
+}
 
 bool CtxtPart::operator==(const CtxtPart& other) const
 {
@@ -309,9 +310,49 @@ Ctxt& Ctxt::privateAssign(const Ctxt& other)
   intFactor = other.intFactor;
   ratFactor = other.ratFactor;
   ptxtMag = other.ptxtMag;
+  prgSeed = other.prgSeed;
+  return *this;
+}
+
+Ctxt::Ctxt(Ctxt&& other) :
+    context(other.context),
+    pubKey(other.pubKey),
+    parts(std::move(other.parts)),
+    primeSet(std::move(other.primeSet)),
+    ptxtSpace(other.ptxtSpace),
+    noiseBound(other.noiseBound),
+    intFactor(other.intFactor),
+    ratFactor(other.ratFactor),
+    ptxtMag(other.ptxtMag),
+    prgSeed(std::move(other.prgSeed))
+{
+  other.primeSet.clear();
+}
+
+Ctxt& Ctxt::privateAssign(Ctxt&& other)
+{
+  if (this == &other)
+    return *this;
+
+  parts = std::move(other.parts);
+  // IndexSet has no move operations of its own, so reset the source to keep
+  // its cached first/last/card consistent with its (now empty) parts
+  primeSet = std::move(other.primeSet);
+  other.primeSet.clear();
+  ptxtSpace = other.ptxtSpace;
+  noiseBound = other.noiseBound;
+  intFactor = other.intFactor;
+  ratFactor = other.ratFactor;
+  ptxtMag = other.ptxtMag;
+  prgSeed = std::move(other.prgSeed);
   return *this;
 }
 
+// Growing the vector of parts moves them only if their move constructor
+// cannot throw, otherwise it copies them
+static_assert(std::is_nothrow_move_constructible<CtxtPart>::value,
+              "CtxtPart must be nothrow move constructible");
+
 // explicitly multiply intFactor by e, which should be
 // in the interval [0, ptxtSpace)
 void Ctxt::mulIntFactor(long e)
@@ -447,23 +488,17 @@ void Ctxt::modDownToSet(const IndexSet& s)
       intFactor = NTL::MulMod(intFactor, F, ptxtSpace);
     Warning("Ctxt::modDownToSet: DEGENERATE DROP");
   } else { // do real mod switching
-#if 1
-    NTL::ZZX delta;
-    NTL::ZZ diff = context.productOfPrimes(setDiff);
-    NTL::xdouble xdiff = NTL::conv<NTL::xdouble>(diff);
-
+    NoiseEstimation policy = context.getNoiseEstimation();
     long nparts = parts.size();
 
+    // fdeltas[i] = the coefficients of the delta of part i, divided by the
+    // product of the primes in setDiff (computed in RNS form)
     std::vector<std::vector<double>> fdeltas(nparts);
     for (long i : range(nparts)) {
       CtxtPart& part = parts[i];
       std::vector<double>& fdelta = fdeltas[i];
-      part.scaleDownToSet(intersection, ptxtSpace, delta);
-      fdelta.resize(delta.rep.length());
-      for (long j : range(delta.rep.length())) {
-        fdelta[j] =
-            NTL::conv<double>(NTL::conv<NTL::xdouble>(delta.rep[j]) / xdiff);
-
+      part.scaleDownToSet(intersection, ptxtSpace, fdelta);
+      for (long j : range(lsize(fdelta))) {
         // sanity check: |fdelta[j]| <= ptxtSpace/2
         if (std::fabs(fdelta[j]) > double(ptxtSpace) / 2.0 + 0.0001) {
           std::stringstream ss;
@@ -474,72 +509,45 @@ void Ctxt::modDownToSet(const IndexSet& s)
       }
     }
 
-    std::vector<double> norms(nparts);
-    HELIB_NTIMER_START(AAA_modDownEnbeddings);
-#if 1
-    for (long i : range(nparts / 2)) {
-      // compute two for the price of one!
-      embeddingLargestCoeff_x2(norms[2 * i],
-                               norms[2 * i + 1],
-                               fdeltas[2 * i],
-                               fdeltas[2 * i + 1],
-                               context.getZMStar());
-    }
-    if (nparts % 2) {
-      norms[nparts - 1] =
-          embeddingLargestCoeff(fdeltas[nparts - 1], context.getZMStar());
-    }
-#else
-    for (long i : range(nparts))
-      norms[i] = embeddingLargestCoeff(fdeltas[i], context.zMStar);
-#endif
-    HELIB_NTIMER_STOP(AAA_modDownEnbeddings);
-
     NTL::xdouble addedNoise(0.0);
+    if (policy == NoiseEstimation::EXACT) {
+      std::vector<double> norms;
+      HELIB_NTIMER_START(AAA_modDownEnbeddings);
+      // two for the price of one, with the transforms batched
+      embeddingLargestCoeffs(norms, fdeltas, context.getZMStar());
+      HELIB_NTIMER_STOP(AAA_modDownEnbeddings);
+
+      for (long i : range(nparts)) {
+        const CtxtPart& part = parts[i];
+        double norm = norms[i];
+
+        if (part.skHandle.isOne())
+          addedNoise += norm;
+        else {
+          long keyId = part.skHandle.getSecretKeyID();
+          long d = part.skHandle.getPowerOfS();
+          NTL::xdouble h =
+              NTL::conv<NTL::xdouble>(pubKey.getSKeyBound(keyId));
+
+          addedNoise += norm * NTL::power(h, d);
+        }
+      }
 
-    for (long i : range(nparts)) {
-      const CtxtPart& part = parts[i];
-      double norm = norms[i];
+      double ratio = NTL::conv<double>(addedNoise / addedNoiseBound);
 
-      if (part.skHandle.isOne())
-        addedNoise += norm;
-      else {
-        long keyId = part.skHandle.getSecretKeyID();
-        long d = part.skHandle.getPowerOfS();
-        NTL::xdouble h = NTL::conv<NTL::xdouble>(pubKey.getSKeyBound(keyId));
+      HELIB_STATS_UPDATE("mod-switch-added-noise", ratio);
 
-        addedNoise += norm * NTL::power(h, d);
+      if (addedNoise > addedNoiseBound) {
+        Warning("addedNoiseBound too big");
       }
-    }
+    } else if (policy == NoiseEstimation::BOUND)
+      addedNoise = addedNoiseBound;
 
     // update the noise estimate
     NTL::xdouble f = NTL::xexp(context.logOfProduct(setDiff));
     ratFactor /= f; // The factor in CKKS encryption
     noiseBound /= f;
     noiseBound += addedNoise;
-
-    double ratio = NTL::conv<double>(addedNoise / addedNoiseBound);
-
-    HELIB_STATS_UPDATE("mod-switch-added-noise", ratio);
-
-    if (addedNoise > addedNoiseBound) {
-      Warning("addedNoiseBound too big");
-    }
-
-#else
-    NTL::ZZX delta;
-
-    for (auto& part : parts) {
-      part.scaleDownToSet(intersection, ptxtSpace, delta);
-    }
-
-    // update the noise estimate
-    NTL::xdouble f = NTL::xexp(context.logOfProduct(setDiff));
-    ratFactor /= f; // The factor in CKKS encryption
-    noiseBound /= f;
-    noiseBound += addedNoiseBound;
-
-#endif
   }
   primeSet.remove(setDiff); // remove the primes not in s
 
@@ -1740,6 +1748,19 @@ void Ctxt::multLowLvl(const Ctxt& other_orig, bool destructive)
 // Higher-level multiply routines that include also modulus-switching
 // and re-linearization
 
+// With lazy re-linearization (see Context::setLazyRelinearization), the
+// products are not re-linearized, but their operands must be: otherwise the
+// product would need key-switching matrices for higher powers of s.
+// Returns ctxt if it is linear, else a re-linearized copy held by tmp.
+static const Ctxt& linearOperand(const Ctxt& ctxt, std::unique_ptr<Ctxt>& tmp)
+{
+  if (ctxt.inCanonicalForm())
+    return ctxt;
+  tmp.reset(new Ctxt(ctxt));
+  tmp->reLinearize();
+  return *tmp;
+}
+
 void Ctxt::multiplyBy(const Ctxt& other)
 {
   HELIB_TIMER_START;
@@ -1752,6 +1773,14 @@ void Ctxt::multiplyBy(const Ctxt& other)
     return;
   }
 
+  if (context.getLazyRelinearization()) {
+    std::unique_ptr<Ctxt> tmp;
+    const Ctxt& op = (this == &other) ? other : linearOperand(other, tmp);
+    reLinearize(); // does nothing if *this is linear
+    this->multLowLvl(op, /*destructive=*/tmp != nullptr);
+    return; // leave the product as is
+  }
+
   this->multLowLvl(other); // perform the multiplication
   reLinearize();           // re-linearize
 #ifdef HELIB_DEBUG
@@ -1759,23 +1788,37 @@ void Ctxt::multiplyBy(const Ctxt& other)
 #endif
 }
 
-void Ctxt::multiplyBy2(const Ctxt& other1, const Ctxt& other2)
+void Ctxt::multiplyBy2(const Ctxt& other1_orig, const Ctxt& other2_orig)
 {
   HELIB_TIMER_START;
   // Special case: if *this is empty then do nothing
   if (this->isEmpty())
     return;
 
-  if (other1.isEmpty()) {
-    *this = other1;
+  if (other1_orig.isEmpty()) {
+    *this = other1_orig;
     return;
   }
 
-  if (other2.isEmpty()) {
-    *this = other2;
+  if (other2_orig.isEmpty()) {
+    *this = other2_orig;
     return;
   }
 
+  // In lazy mode, make the operands linear, keeping the aliasing between
+  // them and *this
+  bool lazy = context.getLazyRelinearization();
+  std::unique_ptr<Ctxt> tmp1, tmp2;
+  const Ctxt* op1 = &other1_orig;
+  const Ctxt* op2 = &other2_orig;
+  if (lazy) {
+    reLinearize(); // does nothing if *this is linear
+    op1 = &linearOperand(other1_orig, tmp1);
+    op2 = (op2 == &other1_orig) ? op1 : &linearOperand(other2_orig, tmp2);
+  }
+  const Ctxt& other1 = *op1;
+  const Ctxt& other2 = *op2;
+
   double cap = capacity();
   double cap1 = other1.capacity();
   double cap2 = other2.capacity();
@@ -1788,7 +1831,8 @@ void Ctxt::multiplyBy2(const Ctxt& other1, const Ctxt& other2)
       tmp.multLowLvl(other2);
 
     this->multLowLvl(tmp);
-    reLinearize(); // re-linearize after all the multiplications
+    if (!lazy)
+      reLinearize(); // re-linearize after all the multiplications
     return;
   }
 
@@ -1810,7 +1854,8 @@ void Ctxt::multiplyBy2(const Ctxt& other1, const Ctxt& other2)
     this->multLowLvl(*first);
     this->multLowLvl(*second);
   }
-  reLinearize(); // re-linearize after all the multiplications
+  if (!lazy)
+    reLinearize(); // re-linearize after all the multiplications
 }
 
 // Multiply-by-constant, it is assumed that the size of this
@@ -1841,6 +1886,45 @@ void Ctxt::multByConstant(const DoubleCRT& dcrt, double size)
   noiseBound *= size;
 }
 
+void Ctxt::addConstantProduct(const DoubleCRT& dcrt,
+                              const Ctxt& other,
+                              double size)
+{
+  HELIB_TIMER_START;
+  assertEq(&context, &other.context, "Context mismatch");
+  assertEq(&pubKey, &other.pubKey, "Public key mismatch");
+
+  if (other.isEmpty())
+    return;
+
+  bool fused = !isCKKS() && !isEmpty() && ptxtSpace == other.ptxtSpace &&
+               intFactor == other.intFactor && primeSet == other.primeSet &&
+               parts.size() == other.parts.size();
+  std::vector<long> idx(other.parts.size());
+  for (long i : range(other.parts.size())) {
+    if (!fused)
+      break;
+    idx[i] = getPartIndexByHandle(other.parts[i].skHandle);
+    fused = (idx[i] >= 0);
+  }
+
+  if (!fused) { // the general case
+    Ctxt tmp(other);
+    tmp.multByConstant(dcrt, size);
+    addCtxt(tmp);
+    return;
+  }
+
+  if (size < 0.0)
+    size = context.noiseBoundForMod(ptxtSpace, getContext().getPhiM());
+
+  for (long i : range(other.parts.size()))
+    parts[idx[i]].addProduct(other.parts[i], dcrt);
+
+  ptxtMag += other.ptxtMag;
+  noiseBound += other.noiseBound * size;
+}
+
 void Ctxt::multByConstant(const NTL::ZZX& poly, double size)
 {
   HELIB_TIMER_START;
@@ -2567,16 +2651,45 @@ NTL::xdouble Ctxt::modSwitchAddedNoiseBound() const
   return addedNoise * roundingNoise;
 }
 
-void Ctxt::writeTo(std::ostream& str) const
+// Set a to the uniform polynomial generated from seed, without disturbing
+// the PRG stream of the calling thread (which may be used for secret noise)
+static void expandSeed(DoubleCRT& a, const NTL::ZZ& seed)
+{
+  RandomState state;
+  a.randomize(&seed);
+}
+
+bool Ctxt::isCompressible() const
+{
+  if (NTL::IsZero(prgSeed) || parts.size() != 2 ||
+      !parts[0].skHandle.isOne() || parts[1].skHandle.getPowerOfS() != 1 ||
+      parts[1].skHandle.getPowerOfX() != 1 ||
+      parts[0].getIndexSet() != primeSet || parts[1].getIndexSet() != primeSet)
+    return false;
+
+  // Most operations leave prgSeed as is, so check that it still generates
+  // parts[1]
+  DoubleCRT a(context, primeSet);
+  expandSeed(a, prgSeed);
+  return a == parts[1];
+}
+
+void Ctxt::writeTo(std::ostream& str, bool compressed) const
 {
   SerializeHeader<Ctxt>().writeTo(str);
-  writeEyeCatcher(str, EyeCatcher::CTXT_BEGIN);
+  bool seeded = compressed && isCompressible();
+  writeEyeCatcher(str,
+                  seeded ? EyeCatcher::CTXTZ_BEGIN : EyeCatcher::CTXT_BEGIN);
 
   /*  Writing out in binary:
     1.  long ptxtSpace
     2.  NTL::xdouble noiseBound
     3.  IndexSet primeSet;
     4.  std::vector<CtxtPart> parts;
+    or, in compressed form, instead of 4:
+    4.  CtxtPart parts[0]
+    5.  SKHandle parts[1].skHandle
+    6.  NTL::ZZ prgSeed
   */
 
   write_raw_int(str, ptxtSpace);
@@ -2585,9 +2698,15 @@ void Ctxt::writeTo(std::ostream& str) const
   write_raw_xdouble(str, ratFactor);
   write_raw_xdouble(str, noiseBound);
   primeSet.writeTo(str);
-  write_raw_vector(str, parts);
+  if (seeded) {
+    parts[0].writeTo(str);
+    parts[1].skHandle.writeTo(str);
+    write_raw_ZZ(str, prgSeed);
+  } else {
+    write_raw_vector(str, parts);
+  }
 
-  writeEyeCatcher(str, EyeCatcher::CTXT_END);
+  writeEyeCatcher(str, seeded ? EyeCatcher::CTXTZ_END : EyeCatcher::CTXT_END);
 }
 
 Ctxt Ctxt::readFrom(std::istream& str, const PubKey& pubKey)
@@ -2606,8 +2725,11 @@ void Ctxt::read(std::istream& str)
                     "Header: version " + header.versionString() +
                         " not supported");
 
-  bool eyeCatcherFound = readEyeCatcher(str, EyeCatcher::CTXT_BEGIN);
-  assertTrue<IOError>(eyeCatcherFound,
+  // Either the full or the compressed form, see writeTo
+  std::array<char, EyeCatcher::SIZE> beginCatcher;
+  str.read(beginCatcher.data(), EyeCatcher::SIZE);
+  bool seeded = (beginCatcher == EyeCatcher::CTXTZ_BEGIN);
+  assertTrue<IOError>(seeded || beginCatcher == EyeCatcher::CTXT_BEGIN,
                       "Could not find pre-ciphertext eye catcher");
 
   ptxtSpace = read_raw_int(str);
@@ -2616,31 +2738,54 @@ void Ctxt::read(std::istream& str)
   ratFactor = read_raw_xdouble(str);
   noiseBound = read_raw_xdouble(str);
   primeSet = IndexSet::readFrom(str);
-  // Using inplace parts deserialization as read_raw_vector will do a resize,
-  // then reads the parts in-place, so may re-use memory.
   CtxtPart blankCtxtPart(context, IndexSet::emptySet());
-  read_raw_vector(str, parts, blankCtxtPart);
+  if (seeded) {
+    parts.assign(1, blankCtxtPart);
+    parts[0].read(str);
+    SKHandle handle = SKHandle::readFrom(str);
+    read_raw_ZZ(str, prgSeed);
+    parts.emplace_back(context, primeSet, handle);
+    expandSeed(parts[1], prgSeed);
+  } else {
+    // Using inplace parts deserialization as read_raw_vector will do a
+    // resize, then reads the parts in-place, so may re-use memory.
+    read_raw_vector(str, parts, blankCtxtPart);
+    NTL::clear(prgSeed);
+  }
 
-  eyeCatcherFound = readEyeCatcher(str, EyeCatcher::CTXT_END);
+  bool eyeCatcherFound = readEyeCatcher(
+      str, seeded ? EyeCatcher::CTXTZ_END : EyeCatcher::CTXT_END);
   assertTrue<IOError>(eyeCatcherFound,
                       "Could not find post-ciphertext eye catcher");
 }
 
-void Ctxt::writeToJSON(std::ostream& str) const
+void Ctxt::writeToJSON(std::ostream& str, bool compressed) const
 {
-  executeRedirectJsonError<void>([&]() { str << writeToJSON(); });
+  executeRedirectJsonError<void>([&]() { str << writeToJSON(compressed); });
 }
 
-JsonWrapper Ctxt::writeToJSON() const
+JsonWrapper Ctxt::writeToJSON(bool compressed) const
 {
-  auto body = [this]() {
+  auto body = [this, compressed]() {
     json j = {{"ptxtSpace", this->ptxtSpace},
               {"noiseBound", this->noiseBound},
               {"primeSet", unwrap(this->primeSet.writeToJSON())},
               {"intFactor", this->intFactor},
               {"ptxtMag", this->ptxtMag},
-              {"ratFactor", this->ratFactor},
-              {"parts", writeVectorToJSON(this->parts)}};
+              {"ratFactor", this->ratFactor}};
+    if (compressed && this->isCompressible()) {
+      // parts[1] is represented by its handle and seed, see writeTo
+      std::ostringstream seed;
+      seed << this->prgSeed;
+      json jparts = json::array();
+      jparts.push_back(unwrap(this->parts[0].writeToJSON()));
+      j["parts"] = jparts;
+      j["seededPart"] = {
+          {"skHandle", unwrap(this->parts[1].skHandle.writeToJSON())},
+          {"prgSeed", seed.str()}};
+    } else {
+      j["parts"] = writeVectorToJSON(this->parts);
+    }
 
     return wrap(toTypedJson<Ctxt>(j));
   };
@@ -2686,6 +2831,16 @@ void Ctxt::readJSON(const JsonWrapper& jw)
     // resize, then reads the parts in-place, so may re-use memory.
     CtxtPart blankCtxtPart(context, IndexSet::emptySet());
     readVectorFromJSON(j.at("parts"), this->parts, blankCtxtPart);
+    NTL::clear(this->prgSeed);
+    if (j.contains("seededPart")) {
+      const json& seeded = j.at("seededPart");
+      std::istringstream seed(seeded.at("prgSeed").get<std::string>());
+      seed >> this->prgSeed;
+      CtxtPart part(context, this->primeSet);
+      part.skHandle = SKHandle::readFromJSON(wrap(seeded.at("skHandle")));
+      expandSeed(part, this->prgSeed);
+      this->parts.push_back(part);
+    }
 
     // sanity-check
     for (const auto& part : this->parts) {
@@ -18,8 +18,11 @@
  * in use. The list of primes is defined by the data member modChain, which is
  * a vector of Cmodulus objects.
  */
+#include <algorithm>
+
 #include <NTL/ZZVec.h>
 #include <NTL/BasicThreadPool.h>
+#include <NTL/sp_arith.h>
 
 #include "binio.h"
 #include "io.h"
@@ -27,6 +30,7 @@
 #include <helib/timing.h>
 #include <helib/sample.h>
 #include <helib/DoubleCRT.h>
+#include <helib/BaseConverter.h>
 #include <helib/Context.h>
 #include <helib/norms.h>
 #include <helib/fhe_stats.h>
@@ -103,12 +107,12 @@ void DoubleCRT::verify()
 
   long phim = context.getPhiM();
 
+  if (map.getRowLength() != phim)
+    throw RuntimeError("DoubleCRT object has bad row length");
+
   // check that the content of i'th row is in [0,pi) for all i
   for (long i : s) {
-    NTL::vec_long& row = map[i];
-
-    if (row.length() != phim)
-      throw RuntimeError("DoubleCRT object has bad row length");
+    long* row = map[i];
 
     long pi = context.ithPrime(i); // the i'th modulus
     for (long j : range(phim))
@@ -144,7 +148,7 @@ DoubleCRT& DoubleCRT::Op(const DoubleCRT& other, Fun fun, bool matchIndexSets)
 
   // If you need to mod-up the other, do it on a temporary scratch copy
   DoubleCRT tmp(context, IndexSet());
-  const IndexMap<NTL::vec_long>* other_map = &other.map;
+  const ResidueMatrix* other_map = &other.map;
 
   // VJS-FIXME: experiment to insist that
   // map.getIndexSet() <= other.map.getIndexSet()
@@ -167,8 +171,8 @@ DoubleCRT& DoubleCRT::Op(const DoubleCRT& other, Fun fun, bool matchIndexSets)
   // add/sub/mul the data, element by element, modulo the respective primes
   for (long i : s) {
     long pi = context.ithPrime(i);
-    NTL::vec_long& row = map[i];
-    const NTL::vec_long& other_row = (*other_map)[i];
+    long* row = map[i];
+    const long* other_row = (*other_map)[i];
 
     for (long j : range(phim))
       row[j] = fun.apply(row[j], other_row[j], pi);
@@ -203,7 +207,7 @@ DoubleCRT& DoubleCRT::do_mul(const DoubleCRT& other, bool matchIndexSets)
 
   // If you need to mod-up the other, do it on a temporary scratch copy
   DoubleCRT tmp(context, IndexSet());
-  const IndexMap<NTL::vec_long>* other_map = &other.map;
+  const ResidueMatrix* other_map = &other.map;
 
   // VJS-FIXME: experiment to insist that
   // map.getIndexSet() <= other.map.getIndexSet()
@@ -227,8 +231,8 @@ DoubleCRT& DoubleCRT::do_mul(const DoubleCRT& other, bool matchIndexSets)
   for (long i : s) {
     long pi = context.ithPrime(i);
     NTL::mulmod_t pi_inv = context.ithModulus(i).getQInv();
-    NTL::vec_long& row = map[i];
-    const NTL::vec_long& other_row = (*other_map)[i];
+    long* row = map[i];
+    const long* other_row = (*other_map)[i];
 
     for (long j : range(phim))
       row[j] = MulMod(row[j], other_row[j], pi, pi_inv);
@@ -236,6 +240,131 @@ DoubleCRT& DoubleCRT::do_mul(const DoubleCRT& other, bool matchIndexSets)
   return *this;
 }
 
+DoubleCRT& DoubleCRT::dotProduct(const std::vector<DoubleCRT>& a,
+                                  const std::vector<DoubleCRT>& b)
+{
+  HELIB_TIMER_START;
+
+  if (isDryRun())
+    return *this;
+
+  assertTrue(a.size() <= b.size(), "dotProduct: b is shorter than a");
+
+  const IndexSet& s = map.getIndexSet();
+  for (long k : range(a.size())) {
+    if (&context != &a[k].context || &context != &b[k].context)
+      throw RuntimeError("DoubleCRT::dotProduct: incompatible objects");
+    if (!(s <= a[k].getIndexSet() && s <= b[k].getIndexSet()))
+      throw RuntimeError("DoubleCRT::dotProduct: !(s <= a[k].getIndexSet() && "
+                         "s <= b[k].getIndexSet())");
+  }
+
+  static thread_local NTL::Vec<long> tls_ivec;
+  NTL::Vec<long>& ivec = tls_ivec;
+
+  long icard = MakeIndexVector(s, ivec);
+  long phim = context.getPhiM();
+  long n = a.size();
+
+  // Each row is the inner product of the corresponding rows of a and b.
+  // Every coefficient is accumulated in a double-word integer, which is
+  // reduced once every `bound` products (so in practice only once).
+  NTL_EXEC_RANGE(icard, first, last)
+  std::vector<const long*> a_rows(n), b_rows(n);
+  for (long jj = first; jj < last; jj++) {
+    long i = ivec[jj];
+    long pi = context.ithPrime(i);
+    long* row = map[i];
+
+    for (long k : range(n)) {
+      a_rows[k] = a[k].map[i];
+      b_rows[k] = b[k].map[i];
+    }
+
+#ifdef NTL_HAVE_LL_TYPE
+    const long bound = lazyReductionBound();
+    NTL::sp_ll_reduce_struct pi_red = NTL::make_sp_ll_reduce_struct(pi);
+    for (long j : range(phim)) {
+      long acc_red = 0;
+      for (long k0 = 0; k0 < n; k0 += bound) {
+        long k1 = std::min(n, k0 + bound);
+        NTL::ll_type acc;
+        NTL::ll_init(acc, acc_red);
+        for (long k : range(k0, k1))
+          NTL::ll_imul_add(acc, a_rows[k][j], b_rows[k][j]);
+        acc_red = NTL::sp_ll_red_31(0,
+                                    NTL::ll_get_hi(acc),
+                                    NTL::ll_get_lo(acc),
+                                    pi,
+                                    pi_red);
+      }
+      row[j] = acc_red;
+    }
+#else
+    // no double-word type, reduce every product
+    NTL::mulmod_t pi_inv = context.ithModulus(i).getQInv();
+    for (long j : range(phim)) {
+      long acc = 0;
+      for (long k : range(n))
+        acc = NTL::AddMod(acc,
+                          NTL::MulMod(a_rows[k][j], b_rows[k][j], pi, pi_inv),
+                          pi);
+      row[j] = acc;
+    }
+#endif
+  }
+  NTL_EXEC_RANGE_END
+
+  return *this;
+}
+
+DoubleCRT& DoubleCRT::addProduct(const DoubleCRT& a, const DoubleCRT& b)
+{
+  if (isDryRun())
+    return *this;
+
+  if (&context != &a.context || &context != &b.context)
+    throw RuntimeError("DoubleCRT::addProduct: incompatible objects");
+
+  const IndexSet& s = map.getIndexSet();
+  if (!(s <= a.getIndexSet() && s <= b.getIndexSet()))
+    throw RuntimeError("DoubleCRT::addProduct: !(s <= a.getIndexSet() && "
+                       "s <= b.getIndexSet())");
+
+  long phim = context.getPhiM();
+
+  // row + a_row*b_row < 2^{2*NTL_SP_NBITS} fits in a double-word, so
+  // a single reduction suffices
+  for (long i : s) {
+    long pi = context.ithPrime(i);
+    long* row = map[i];
+    const long* a_row = a.map[i];
+    const long* b_row = b.map[i];
+
+#ifdef NTL_HAVE_LL_TYPE
+    NTL::sp_ll_reduce_struct pi_red = NTL::make_sp_ll_reduce_struct(pi);
+    for (long j : range(phim)) {
+      NTL::ll_type acc;
+      NTL::ll_init(acc, row[j]);
+      NTL::ll_imul_add(acc, a_row[j], b_row[j]);
+      row[j] = NTL::sp_ll_red_31(0,
+                                 NTL::ll_get_hi(acc),
+                                 NTL::ll_get_lo(acc),
+                                 pi,
+                                 pi_red);
+    }
+#else
+    NTL::mulmod_t pi_inv = context.ithModulus(i).getQInv();
+    for (long j : range(phim))
+      row[j] = NTL::AddMod(row[j],
+                           NTL::MulMod(a_row[j], b_row[j], pi, pi_inv),
+                           pi);
+#endif
+  }
+
+  return *this;
+}
+
 #if 0
 template
 DoubleCRT& DoubleCRT::Op<DoubleCRT::MulFun>(const DoubleCRT &other, MulFun fun,
@@ -262,7 +391,7 @@ DoubleCRT& DoubleCRT::Op(const NTL::ZZ& num, Fun fun)
   for (long i : s) {
     long pi = context.ithPrime(i);
     long n = rem(num, pi); // n = num % pi
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     for (long j : range(phim))
       row[j] = fun.apply(row[j], n, pi);
   }
@@ -293,8 +422,8 @@ DoubleCRT& DoubleCRT::Negate(const DoubleCRT& other)
   long phim = context.getPhiM();
   for (long i : s) {
     long pi = context.ithPrime(i);
-    NTL::vec_long& row = map[i];
-    const NTL::vec_long& other_row = other.map[i];
+    long* row = map[i];
+    const long* other_row = other.map[i];
     for (long j : range(phim))
       row[j] = NTL::NegateMod(other_row[j], pi);
   }
@@ -361,41 +490,42 @@ NTL::xdouble DoubleCRT::breakIntoDigits(std::vector<DoubleCRT>& digits) const
   }
 
   NTL::xdouble noise(0.0);
+  NoiseEstimation policy = context.getNoiseEstimation();
 
   for (long i : range(digits.size())) {
     HELIB_NTIMER_START(addPrimes_5);
     IndexSet notInDigit = allPrimes / digits[i].getIndexSet();
 
-#if 0
-// This version coumputes a high-probability bound
-
-    double digitSize = context.logOfProduct(digits[i].getIndexSet());
-    NTL::xdouble norm_bnd =
-      context.noiseBoundForUniform( NTL::xexp(digitSize)/2.0, phim );
-    noise += norm_bnd;
-
-    digits[i].addPrimes(notInDigit); // add back all the primes
-
-#else
-    // This version computes an "exact" value
-
     double digitSize = context.logOfProduct(digits[i].getIndexSet());
     NTL::xdouble norm_bnd =
         context.noiseBoundForUniform(NTL::xexp(digitSize) / 2.0, phim);
 
-    NTL::ZZX poly;
-    digits[i].addPrimes(notInDigit, &poly); // add back all the primes
-
-    HELIB_NTIMER_START(NORM_VAL);
-    NTL::xdouble norm_val = embeddingLargestCoeff(poly, context.getZMStar());
-    HELIB_NTIMER_STOP(NORM_VAL);
-
-    noise += norm_val;
-
-    double ratio = NTL::conv<double>(norm_val / norm_bnd);
-    HELIB_STATS_UPDATE("break-into-digits-ratio", ratio);
-
-#endif
+    IndexSet digitPrimes = digits[i].getIndexSet();
+    if (empty(digitPrimes)) {
+      digits[i].addPrimes(notInDigit); // the digit is zero
+    } else if (policy != NoiseEstimation::EXACT) {
+      // add back all the primes, by base extension from the digit primes
+      digits[i].addPrimes(notInDigit);
+      if (policy == NoiseEstimation::BOUND)
+        noise += norm_bnd; // a high-probability bound
+    } else {
+      // This version computes an "exact" value: add back all the primes,
+      // and get the coefficients of the digit scaled down by its modulus
+      std::vector<double> frac;
+      digits[i].map.insert(notInDigit);
+      digits[i].extendRows(digitPrimes, notInDigit, &frac);
+
+      HELIB_NTIMER_START(NORM_VAL);
+      NTL::xdouble norm_val =
+          embeddingLargestCoeff(frac, context.getZMStar()) *
+          NTL::xexp(digitSize);
+      HELIB_NTIMER_STOP(NORM_VAL);
+
+      noise += norm_val;
+
+      double ratio = NTL::conv<double>(norm_val / norm_bnd);
+      HELIB_STATS_UPDATE("break-into-digits-ratio", ratio);
+    }
 
     NTL::ZZ pi = context.productOfPrimes(context.getDigit(i));
     for (long j : range(i + 1, digits.size())) {
@@ -429,6 +559,15 @@ void DoubleCRT::addPrimes(const IndexSet& s1, NTL::ZZX* poly_p)
       clear(*poly_p);
     return;
   }
+
+  if (!poly_p) {
+    IndexSet s = getIndexSet();
+    map.insert(s1); // add new rows to the map
+    if (!isDryRun())
+      extendRows(s, s1); // and fill them in by base extension
+    return;
+  }
+
   NTL::ZZX poly;
   toPoly(poly); // recover in coefficient representation
 
@@ -446,6 +585,84 @@ void DoubleCRT::addPrimes(const IndexSet& s1, NTL::ZZX* poly_p)
     FFT(poly, s1);
 }
 
+void DoubleCRT::iFFTRows(long* coeffs, const IndexSet& s) const
+{
+  HELIB_TIMER_START;
+
+  static thread_local NTL::Vec<long> tls_ivec;
+  NTL::Vec<long>& ivec = tls_ivec; // the indexes of the primes in s
+  long phim = context.getPhiM();
+  long card = MakeIndexVector(s, ivec);
+
+  NTL_EXEC_RANGE(card, first, last)
+  NTL::zz_pX tmp;
+  for (long j : range(first, last)) {
+    long i = ivec[j];
+    context.ithModulus(i).iFFT(tmp, map[i]);
+
+    long* row = coeffs + j * phim;
+    long d = deg(tmp); // copy the coefficients, pad by zeros if needed
+    for (long h = 0; h <= d; h++)
+      row[h] = rep(tmp.rep[h]);
+    for (long h = d + 1; h < phim; h++)
+      row[h] = 0;
+  }
+  NTL_EXEC_RANGE_END
+}
+
+void DoubleCRT::FFTRow(long* y, const long* coeffs, long i) const
+{
+  const Cmodulus& mod = context.ithModulus(i);
+  long phim = context.getPhiM();
+
+  NTL::zz_pBak bak;
+  bak.save();
+  mod.restoreModulus();
+
+  NTL::zz_pX& tmp = Cmodulus::getScratch_zz_pX();
+  tmp.rep.SetLength(phim);
+  NTL::zz_p* tmp_p = tmp.rep.elts();
+  for (long h : range(phim))
+    tmp_p[h].LoopHole() = coeffs[h]; // DIRT: coeffs[h] already reduced
+  tmp.normalize();
+
+  mod.FFT_aux(y, tmp);
+}
+
+void DoubleCRT::extendRows(const IndexSet& from,
+                           const IndexSet& to,
+                           std::vector<double>* frac)
+{
+  HELIB_TIMER_START;
+
+  static thread_local NTL::Vec<long> tls_ivec;
+  static thread_local NTL::Vec<long> tls_in;
+  static thread_local NTL::Vec<long> tls_out;
+  NTL::Vec<long>& ivec = tls_ivec; // the indexes of the primes in to
+  NTL::Vec<long>& in = tls_in;     // coefficients modulo the primes in from
+  NTL::Vec<long>& out = tls_out;   // coefficients modulo the primes in to
+
+  long phim = context.getPhiM();
+  long card = MakeIndexVector(to, ivec);
+  in.SetLength(from.card() * phim);
+  out.SetLength(card * phim);
+  if (frac)
+    frac->resize(phim);
+
+  iFFTRows(in.elts(), from);
+  context.getBaseConverter(from, to).convert(out.elts(),
+                                             phim,
+                                             in.elts(),
+                                             phim,
+                                             phim,
+                                             frac ? frac->data() : nullptr);
+
+  NTL_EXEC_RANGE(card, first, last)
+  for (long j : range(first, last))
+    FFTRow(map[ivec[j]], out.elts() + j * phim, ivec[j]);
+  NTL_EXEC_RANGE_END
+}
+
 // Expand index set by s1, and multiply by \prod{q \in s1}. s1 is assumed to
 // be disjoint from the current index set. Returns the logarithm of product.
 double DoubleCRT::addPrimesAndScale(const IndexSet& s1)
@@ -476,7 +693,7 @@ double DoubleCRT::addPrimesAndScale(const IndexSet& s1)
   for (long i : iSet) {
     long qi = context.ithPrime(i);
     long f = rem(factor, qi); // f = factor % qi
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     // scale row by a factor of f modulo qi
     NTL::mulmod_precon_t bninv = NTL::PrepMulModPrecon(f, qi);
     for (long j : range(phim))
@@ -486,7 +703,7 @@ double DoubleCRT::addPrimesAndScale(const IndexSet& s1)
   // insert new rows and fill them with zeros
   map.insert(s1); // add new rows to the map
   for (long i : s1) {
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     for (long j : range(phim))
       row[j] = 0;
   }
@@ -494,16 +711,10 @@ double DoubleCRT::addPrimesAndScale(const IndexSet& s1)
   return logFactor;
 }
 
-// *****************************************************
-DoubleCRTHelper::DoubleCRTHelper(const Context& context)
-{
-  val = context.getPhiM();
-}
-
 DoubleCRT::DoubleCRT(const NTL::ZZX& poly,
                      const Context& _context,
                      const IndexSet& s) :
-    context(_context), map(new DoubleCRTHelper(_context))
+    context(_context), map(_context.getPhiM())
 {
   HELIB_TIMER_START;
   assertTrue(s.last() < context.numPrimes(),
@@ -523,7 +734,7 @@ DoubleCRT::DoubleCRT(const NTL::ZZX& poly,
 // FIXME-IndexSet
 #if 0
 DoubleCRT::DoubleCRT(const NTL::ZZX& poly, const Context &_context)
-: context(_context), map(new DoubleCRTHelper(_context))
+: context(_context), map(_context.getPhiM())
 {
   HELIB_TIMER_START;
   IndexSet s = IndexSet(0, context.numPrimes()-1);
@@ -540,7 +751,7 @@ DoubleCRT::DoubleCRT(const NTL::ZZX& poly, const Context &_context)
 }
 
 DoubleCRT::DoubleCRT(const NTL::ZZX& poly)
-: context(*activeContext), map(new DoubleCRTHelper(*activeContext))
+: context(*activeContext), map(activeContext->getPhiM())
 {
   HELIB_TIMER_START;
   IndexSet s = IndexSet(0, context.numPrimes()-1);
@@ -563,7 +774,7 @@ DoubleCRT::DoubleCRT(const NTL::ZZX& poly)
 DoubleCRT::DoubleCRT(const zzX& poly,
                      const Context& _context,
                      const IndexSet& s) :
-    context(_context), map(new DoubleCRTHelper(_context))
+    context(_context), map(_context.getPhiM())
 {
   HELIB_TIMER_START;
   assertTrue(s.last() < context.numPrimes(),
@@ -583,7 +794,7 @@ DoubleCRT::DoubleCRT(const zzX& poly,
 // FIXME-IndexSet
 #if 0
 DoubleCRT::DoubleCRT(const zzX& poly, const Context &_context)
-: context(_context), map(new DoubleCRTHelper(_context))
+: context(_context), map(_context.getPhiM())
 {
   HELIB_TIMER_START;
   IndexSet s = IndexSet(0, context.numPrimes()-1);
@@ -601,7 +812,7 @@ DoubleCRT::DoubleCRT(const zzX& poly, const Context &_context)
 }
 
 DoubleCRT::DoubleCRT(const zzX& poly)
-: context(*activeContext), map(new DoubleCRTHelper(*activeContext))
+: context(*activeContext), map(activeContext->getPhiM())
 {
   HELIB_TIMER_START;
   IndexSet s = IndexSet(0, context.numPrimes()-1);
@@ -619,8 +830,17 @@ DoubleCRT::DoubleCRT(const zzX& poly)
 }
 #endif
 
+void DoubleCRT::attach(const IndexSet& s,
+                       long* rows,
+                       std::shared_ptr<const void> rowsOwner)
+{
+  assertTrue(s.last() < context.numPrimes(),
+             "s must end with a smaller element than context.numPrimes()");
+  map.attach(s, rows, std::move(rowsOwner));
+}
+
 DoubleCRT::DoubleCRT(const Context& _context, const IndexSet& s) :
-    context(_context), map(new DoubleCRTHelper(_context))
+    context(_context), map(_context.getPhiM())
 {
   assertTrue(s.last() < context.numPrimes(),
              "s must end with a smaller element than context.numPrimes()");
@@ -632,7 +852,7 @@ DoubleCRT::DoubleCRT(const Context& _context, const IndexSet& s) :
   long phim = context.getPhiM();
 
   for (long i : s) {
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     for (long j : range(phim))
       row[j] = 0;
   }
@@ -643,7 +863,7 @@ DoubleCRT::DoubleCRT(const Context& _context, const IndexSet& s) :
 // FIXME-IndexSet
 #if 0
 DoubleCRT::DoubleCRT(const Context &_context)
-: context(_context), map(new DoubleCRTHelper(_context))
+: context(_context), map(_context.getPhiM())
 {
   IndexSet s = IndexSet(0, context.numPrimes()-1);
   // FIXME: maybe the default index set should be determined by context?
@@ -654,7 +874,7 @@ DoubleCRT::DoubleCRT(const Context &_context)
   long phim = context.getPhiM();
 
   for (long i = s.first(); i <= s.last(); i = s.next(i)) {
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     for (long j = 0; j < phim; j++) row[j] = 0;
   }
 }
@@ -675,8 +895,8 @@ DoubleCRT& DoubleCRT::operator=(const DoubleCRT& other)
     const IndexSet& s = map.getIndexSet();
     long phim = context.getPhiM();
     for (long i : s) {
-      NTL::vec_long& row = map[i];
-      const NTL::vec_long& other_row = other.map[i];
+      long* row = map[i];
+      const long* other_row = other.map[i];
       for (long j : range(phim))
         row[j] = other_row[j];
     }
@@ -684,6 +904,18 @@ DoubleCRT& DoubleCRT::operator=(const DoubleCRT& other)
   return *this;
 }
 
+DoubleCRT& DoubleCRT::operator=(DoubleCRT&& other)
+{
+  if (this == &other)
+    return *this;
+
+  if (&context != &other.context)
+    throw RuntimeError("DoubleCRT assignment: incompatible contexts");
+
+  map = std::move(other.map);
+  return *this;
+}
+
 DoubleCRT& DoubleCRT::operator=(const NTL::ZZX& poly)
 {
   if (isDryRun())
@@ -720,7 +952,7 @@ DoubleCRT& DoubleCRT::operator=(const NTL::ZZ& num)
   long phim = context.getPhiM();
 
   for (long i : s) {
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     long pi = context.ithPrime(i);
     long n = rem(num, pi);
 
@@ -978,7 +1210,7 @@ DoubleCRT& DoubleCRT::operator/=(const NTL::ZZ& num)
   for (long i : s) {
     long pi = context.ithPrime(i);
     long n = NTL::InvMod(rem(num, pi), pi); // n = num^{-1} mod pi
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     NTL::mulmod_precon_t precon = NTL::PrepMulModPrecon(n, pi);
     for (long j : range(phim))
       row[j] = NTL::MulModPrecon(row[j], n, pi, precon);
@@ -997,7 +1229,7 @@ void DoubleCRT::Exp(long e)
 
   for (long i : s) {
     long pi = context.ithPrime(i);
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     for (long j : range(phim))
       row[j] = NTL::PowerMod(row[j], e, pi);
   }
@@ -1023,7 +1255,7 @@ void DoubleCRT::automorph(long k)
 
   // go over the rows, permute them one at a time
   for (long i : s) {
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
 
     // Compute new[j] = old[j*k mod m]
 
@@ -1069,7 +1301,7 @@ void DoubleCRT::automorph(long k)
   // go over the rows, permute them one at a time
   // new[j*k mod m] = old[j]
   for (long i = s.first(); i <= s.last(); i = s.next(i)) {
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
 
     for (long j = 0; j < phim; j++)
       tmp[j] = row[j];
@@ -1095,7 +1327,7 @@ void DoubleCRT::complexConj()
 
   // go over the rows, permute them one at a time
   for (long i : s) {
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     for (long j : range(phim / 2)) { // swap i <-> phi(m)-i-1
       std::swap(row[j], row[phim - j - 1]);
     }
@@ -1130,7 +1362,7 @@ void DoubleCRT::randomize(const NTL::ZZ* seed)
     long nb = (k + 7) / 8;
     unsigned long mask = (1UL << k) - 1UL;
 
-    NTL::vec_long& row = map[i];
+    long* row = map[i];
     long j = 0;
 
     for (;;) {
@@ -1363,6 +1595,121 @@ void DoubleCRT::scaleDownToSet(const IndexSet& s,
                       // actually scales it down
 }
 
+void DoubleCRT::scaleDownToSet(const IndexSet& s,
+                               long ptxtSpace,
+                               std::vector<double>& fdelta)
+{
+  IndexSet diff = getIndexSet() / s;
+  fdelta.clear();
+  if (empty(diff))
+    return; // nothing to do
+
+  assertTrue(ptxtSpace >= 1, "ptxtSpace must be at least 1");
+  // cannot mod-down to the empty set
+  assertNeq(diff,
+            getIndexSet(),
+            "s and the index set must have some intersection");
+  if (isDryRun()) {
+    removePrimes(diff); // remove the primes from consideration
+    return;
+  }
+
+  HELIB_TIMER_START;
+
+  IndexSet remaining = getIndexSet() / diff;
+  NTL::ZZ diffProd = context.productOfPrimes(diff); // mod-down by this factor
+  const BaseConverter& conv = context.getBaseConverter(diff, remaining);
+
+  static thread_local NTL::Vec<long> tls_ivec;
+  static thread_local NTL::Vec<long> tls_in;
+  static thread_local NTL::Vec<long> tls_delta;
+  static thread_local NTL::Vec<long> tls_c;
+  NTL::Vec<long>& ivec = tls_ivec;   // the indexes of the remaining primes
+  NTL::Vec<long>& in = tls_in;       // *this in coefficient form mod diff
+  NTL::Vec<long>& delta = tls_delta; // delta modulo the remaining primes
+  NTL::Vec<long>& c = tls_c;         // delta * diffProd^{-1} mod ptxtSpace
+
+  long phim = context.getPhiM();
+  long card = MakeIndexVector(remaining, ivec);
+  in.SetLength(diff.card() * phim);
+  delta.SetLength(card * phim);
+  fdelta.resize(phim);
+
+  long p_over_2 = ptxtSpace / 2;
+  long p_mod_2 = ptxtSpace % 2;
+
+  // delta is the balanced lift of *this modulo diffProd
+  iFFTRows(in.elts(), diff);
+  if (ptxtSpace > 1) {
+    BaseConverter::AuxModulus aux = conv.auxModulus(ptxtSpace);
+    c.SetLength(phim);
+    conv.convert(delta.elts(),
+                 phim,
+                 in.elts(),
+                 phim,
+                 phim,
+                 fdelta.data(),
+                 &aux,
+                 c.elts());
+
+    // Make delta divisible by ptxtSpace by subtracting from each coefficient
+    // delta[h] the integer diffProd * c[h], with c[h] the balanced remainder
+    // of delta[h] * diffProd^{-1} mod ptxtSpace. This does not change delta
+    // modulo diffProd.
+    long prodInv = NTL::InvMod(rem(diffProd, ptxtSpace), ptxtSpace);
+    for (long h : range(phim)) {
+      long c_h = c[h];
+      if (c_h != 0) { // if not already 0 mod ptxtSpace
+        c_h = NTL::MulMod(c_h, prodInv, ptxtSpace);
+
+        // NOTE: as in the ZZX version, the tie for even ptxtSpace is broken
+        // by the sign of delta[h] (which fdelta[h] = delta[h]/diffProd
+        // keeps), and at random when that is zero
+        if (c_h > p_over_2 ||
+            (p_mod_2 == 0 && c_h == p_over_2 &&
+             (fdelta[h] < 0 || (fdelta[h] == 0 && NTL::RandomBnd(2)))))
+          c_h -= ptxtSpace;
+        fdelta[h] -= c_h;
+      }
+      c[h] = c_h;
+    }
+  } else
+    conv.convert(delta.elts(), phim, in.elts(), phim, phim, fdelta.data());
+
+  removePrimes(diff); // remove the primes from consideration
+
+  // *this = (*this - delta) / diffProd, one prime at a time
+  NTL_EXEC_RANGE(card, first, last)
+  for (long j : range(first, last)) {
+    long i = ivec[j];
+    long q = context.ithPrime(i);
+    long prodModQ = rem(diffProd, q);
+    long* delta_j = delta.elts() + j * phim;
+
+    if (ptxtSpace > 1) { // delta_j -= diffProd * c mod q
+      NTL::mulmod_precon_t precon = NTL::PrepMulModPrecon(prodModQ, q);
+      bool cReduced = (p_over_2 < q); // then |c[h]| < q
+      for (long h : range(phim)) {
+        long c_h = cReduced ? c[h] : c[h] % q;
+        if (c_h < 0)
+          c_h += q;
+        long t = NTL::MulModPrecon(c_h, prodModQ, q, precon);
+        delta_j[h] = NTL::SubMod(delta_j[h], t, q);
+      }
+    }
+    FFTRow(delta_j, delta_j, i);
+
+    long prodInv = NTL::InvMod(prodModQ, q);
+    NTL::mulmod_precon_t precon = NTL::PrepMulModPrecon(prodInv, q);
+    long* row = map[i];
+    for (long h : range(phim)) {
+      long t = NTL::SubMod(row[h], delta_j[h], q);
+      row[h] = NTL::MulModPrecon(t, prodInv, q, precon);
+    }
+  }
+  NTL_EXEC_RANGE_END
+}
+
 std::ostream& operator<<(std::ostream& str, const DoubleCRT& d)
 {
   str << d.writeToJSON();
@@ -1382,7 +1729,7 @@ void DoubleCRT::writeTo(std::ostream& str) const
   set.writeTo(str);
 
   for (long i : set) {
-    write_ntl_vec_long(str, map[i]);
+    write_raw_long_array(str, map[i], map.getRowLength());
     //   std::cerr << "[DCRT::write] map[i]: " << map[i] << std::endl;
   }
 }
@@ -1403,7 +1750,7 @@ void DoubleCRT::read(std::istream& str)
                    //  std::cerr << "[DCRT::read] set: " << set << std::endl;
 
   for (long i : set) {
-    read_ntl_vec_long(str, map[i]);
+    read_raw_long_array(str, map[i], map.getRowLength());
     //   std::cerr << "[DCRT::read] map[i]: " << map[i] << std::endl;
   }
 }
@@ -1419,8 +1766,13 @@ JsonWrapper DoubleCRT::writeToJSON() const
   std::vector<NTL::Vec<long>> map_cnt;
 
   // check that the content of i'th row is in [0,pi) for all i
-  for (long i : set)
-    map_cnt.emplace_back(this->map[i]);
+  long phim = this->map.getRowLength();
+  for (long i : set) {
+    const long* row = this->map[i];
+    map_cnt.emplace_back(NTL::Vec<long>());
+    map_cnt.back().SetLength(phim);
+    std::copy(row, row + phim, map_cnt.back().elts());
+  }
 
   json j = {{"set", unwrap(set.writeToJSON())}, {"map", map_cnt}};
   return wrap(j);
@@ -1465,18 +1817,18 @@ void DoubleCRT::readJSON(const JsonWrapper& jw)
 
   std::size_t cnt = 0;
   for (long i : set) {
-    this->map[i] = map_cnt[cnt++]; // read the actual data
+    const NTL::Vec<long>& row = map_cnt[cnt++];
 
     // verify that the data is valid
-    assertEq(this->map[i].length(),
-             phim,
-             "Data not valid: d.map[i].length() != phim");
+    assertEq(row.length(), phim, "Data not valid: d.map[i].length() != phim");
     for (long j : range(phim))
       assertInRange(
-          this->map[i][j],
+          row[j],
           0l,
           context.ithPrime(i),
           "this->map[i][j] invalid: must be between 0 and context.ithPrime(i)");
+
+    std::copy(row.elts(), row.elts() + phim, this->map[i]); // the actual data
   }
 }
 
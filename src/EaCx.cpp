@@ -16,6 +16,7 @@
 
 #include <helib/zzX.h>
 #include <helib/EncryptedArray.h>
+#include <helib/HoistedCtxt.h>
 
 #include <helib/timing.h>
 #include <helib/ClonedPtr.h>
@@ -96,7 +97,15 @@ void EncryptedArrayCx::decrypt(const Ctxt& ctxt,
 
   NTL::ZZX pp;
   sKey.Decrypt(pp, ctxt);
+  decodeDecrypted(ptxt, pp, ctxt, sKey, prec);
+}
 
+void EncryptedArrayCx::decodeDecrypted(std::vector<cx_double>& ptxt,
+                                       const NTL::ZZX& pp,
+                                       const Ctxt& ctxt,
+                                       const SecKey& sKey,
+                                       OptLong prec) const
+{
   // This mitigates against the attack in
   // "On the Security of Homomorphic Encryption on Approximate Numbers",
   // by Baiyu Li and Daniele Micciancio.
@@ -120,12 +129,12 @@ void EncryptedArrayCx::decrypt(const Ctxt& ctxt,
   ctxt.addedNoiseForCKKSDecryption(sKey, eps, noise);
 
   // Third, we add the noise to the raw plaintext
-  pp += noise;
+  noise += pp;
 
   // Finally, we decode the adjusted plaintext
   NTL::xdouble xfactor = ctxt.getRatFactor();
   const PAlgebra& palg = getPAlgebra();
-  CKKS_decode(pp, xfactor, palg, ptxt);
+  CKKS_decode(noise, xfactor, palg, ptxt);
 }
 
 void EncryptedArrayCx::decrypt(const Ctxt& ctxt,
@@ -163,6 +172,34 @@ void EncryptedArrayCx::rotate1D(Ctxt& ctxt,
   ctxt.smartAutomorph(palg.genToPow(i, amt));
 }
 
+void EncryptedArrayCx::rotate1D(Ctxt& out,
+                                const HoistedCtxt& in,
+                                long i,
+                                long amt,
+                                UNUSED bool dc) const
+{
+  const Ctxt& ctxt = in.getCtxt();
+  helib::assertEq(&context, &ctxt.getContext(), "Context mismatch");
+  helib::assertInRange(i,
+                       0l,
+                       dimension(),
+                       "i must be between 0 and dimension()");
+  assertTrue(nativeDimension(i),
+             "Rotation in " + std::to_string(i) + " is not a native operation");
+
+  const PAlgebra& palg = getPAlgebra();
+  long ord = sizeOfDimension(i);
+  amt %= ord; // DIRT: assumes division w/ remainder follows C++11 and C99 rules
+  if (amt == 0) {
+    out = ctxt;
+    return;
+  }
+  if (amt < 0)
+    amt += ord; // Make sure amt is in the range [1,ord-1]
+
+  in.automorph(out, palg.genToPow(i, amt));
+}
+
 // TODO: Shift k positions along the i'th dimension with zero fill.
 // Negative shift amount denotes shift in the opposite direction.
 #pragma GCC diagnostic push
@@ -348,6 +385,29 @@ double EncryptedArrayCx::encode(zzX& ptxt,
   return factor;
 }
 
+std::vector<double> EncryptedArrayCx::encode(
+    std::vector<zzX>& ptxts,
+    const std::vector<std::vector<cx_double>>& arrays,
+    double useThisSize,
+    long precision) const
+{
+  // The factor of each array is chosen as in the single version
+  std::vector<double> factors(arrays.size());
+  for (long i : range(lsize(arrays))) {
+    double size = useThisSize;
+    if (size < 0)
+      for (auto& x : arrays[i]) {
+        if (size < std::abs(x))
+          size = std::abs(x);
+      }
+    if (size <= 0)
+      size = 1.0;
+    factors[i] = encodeScalingFactor(precision) / size;
+  }
+  CKKS_embedInSlots(ptxts, arrays, getPAlgebra(), factors);
+  return factors;
+}
+
 double EncryptedArrayCx::encode(zzX& ptxt,
                                 double num,
                                 double useThisSize,
@@ -393,6 +453,21 @@ void EncryptedArrayCx::decode(std::vector<cx_double>& array,
     x /= scaling;
 }
 
+void EncryptedArrayCx::decode(std::vector<std::vector<cx_double>>& arrays,
+                              const std::vector<zzX>& ptxts,
+                              const std::vector<double>& scaling) const
+{
+  assertEq<InvalidArgument>(lsize(ptxts),
+                            lsize(scaling),
+                            "Need one scaling per polynomial to decode");
+  for (double s : scaling)
+    assertTrue<InvalidArgument>(s > 0, "Scaling must be positive to decode");
+  CKKS_canonicalEmbedding(arrays, ptxts, getPAlgebra());
+  for (long i : range(lsize(arrays)))
+    for (auto& x : arrays[i])
+      x /= scaling[i];
+}
+
 // return an array of random complex numbers in a circle of radius rad
 void EncryptedArrayCx::random(std::vector<cx_double>& array, double rad) const
 {
@@ -12,8 +12,10 @@
 /* EncryptedArray.cpp - Data-movement operations on arrays of slots
  */
 #include <algorithm>
+#include <NTL/BasicThreadPool.h>
 #include <helib/zzX.h>
 #include <helib/EncryptedArray.h>
+#include <helib/HoistedCtxt.h>
 #include <helib/timing.h>
 #include <helib/ClonedPtr.h>
 #include <helib/norms.h>
@@ -76,11 +78,6 @@ void EncryptedArrayDerived<type>::rotate1D(Ctxt& ctxt,
                        dimension(),
                        "i must be between 0 and dimension()");
 
-  RBak bak;
-  bak.save();
-  tab.restoreContext();
-
-  const std::vector<std::vector<RX>>& maskTable = tab.getMaskTable();
   const PAlgebra& zMStar = getPAlgebra();
   long ord = sizeOfDimension(i);
 
@@ -98,9 +95,6 @@ void EncryptedArrayDerived<type>::rotate1D(Ctxt& ctxt,
 
   // more expensive "non-native" rotation
 
-  helib::assertTrue(maskTable[i].size() > 0,
-                    "Found non-positive sized mask table entry");
-
   ctxt.smartAutomorph(zMStar.genToPow(i, amt));
   // ctxt = \rho_i^{amt}(originalCtxt)
 
@@ -111,6 +105,68 @@ void EncryptedArrayDerived<type>::rotate1D(Ctxt& ctxt,
   // assumption that we have the key switch matrix
   // for \rho_i^{-ord}
 
+  blendRotation(ctxt, T, i, amt);
+}
+
+// Hoisted variant of rotate1D, all the automorphisms are computed from the
+// digits of in
+template <typename type>
+void EncryptedArrayDerived<type>::rotate1D(Ctxt& out,
+                                           const HoistedCtxt& in,
+                                           long i,
+                                           long amt,
+                                           bool dc) const
+{
+  HELIB_TIMER_START;
+  const Ctxt& ctxt = in.getCtxt();
+  helib::assertEq(&context, &ctxt.getContext(), "Context mismatch");
+  helib::assertInRange(i,
+                       0l,
+                       dimension(),
+                       "i must be between 0 and dimension()");
+
+  const PAlgebra& zMStar = getPAlgebra();
+  long ord = sizeOfDimension(i);
+
+  amt %= ord; // assumes division w/ remainder follows C++11
+  if (amt == 0) {
+    out = ctxt;
+    return;
+  }
+  if (amt < 0)
+    amt += ord; // Make sure amt is in the range [1,ord-1]
+
+  in.automorph(out, zMStar.genToPow(i, amt));
+  // out = \rho_i^{amt}(originalCtxt)
+
+  if (dc || nativeDimension(i)) // native dimension or don't-care
+    return;
+
+  // more expensive "non-native" rotation, but unlike the non-hoisted
+  // variant both automorphisms are applied to the original digits
+  Ctxt T(ZeroCtxtLike, ctxt);
+  in.automorph(T, zMStar.genToPow(i, amt - ord));
+  // T = \rho_i^{amt-ord}(originalCtxt)
+
+  blendRotation(out, T, i, amt);
+}
+
+template <typename type>
+void EncryptedArrayDerived<type>::blendRotation(Ctxt& ctxt,
+                                                Ctxt& T,
+                                                long i,
+                                                long amt) const
+{
+  RBak bak;
+  bak.save();
+  tab.restoreContext();
+
+  const std::vector<std::vector<RX>>& maskTable = tab.getMaskTable();
+  const PAlgebra& zMStar = getPAlgebra();
+
+  helib::assertTrue(maskTable[i].size() > 0,
+                    "Found non-positive sized mask table entry");
+
   const RX& mask = maskTable[i][amt];
   zzX mask_poly = balanced_zzX(mask);
   double sz = embeddingLargestCoeff(mask_poly, zMStar);
@@ -678,6 +734,74 @@ void PtxtArray::readJSON(const JsonWrapper& tjw)
   executeRedirectJsonError<void>(body);
 }
 
+void encryptBatch(std::vector<Ctxt>& ctxts,
+                  const std::vector<PtxtArray>& ptxts,
+                  const PubKey& pk,
+                  double mag,
+                  OptLong prec)
+{
+  HELIB_TIMER_START;
+
+  // Encode the whole batch first, as PtxtArray::encrypt does for one
+  std::vector<EncodedPtxt> eptxts(ptxts.size());
+
+  NTL_EXEC_RANGE(long(ptxts.size()), first, last)
+  for (long i = first; i < last; i++) {
+    double m = mag;
+    if (ptxts[i].ea.isCKKS() && m < 0)
+      m = NextPow2(Norm(ptxts[i].pa.getData<PA_cx>()));
+    // if mag is defaulted, set it to 2^(ceil(log2(max(Norm(pa),1))))
+    ptxts[i].encode(eptxts[i], m, prec);
+  }
+  NTL_EXEC_RANGE_END
+
+  pk.encryptBatch(ctxts, eptxts);
+}
+
+void decryptBatch(std::vector<PtxtArray>& ptxts,
+                  const std::vector<Ctxt>& ctxts,
+                  const SecKey& sKey,
+                  OptLong prec)
+{
+  HELIB_TIMER_START;
+
+  if (!sKey.isCKKS() && prec.isDefined())
+    throw LogicError("EncryptedArray::decrypt: the precision parameter "
+                     "(prec) must be defaulted");
+
+  std::vector<NTL::ZZX> polys;
+  sKey.decryptBatch(polys, ctxts);
+  ptxts.resize(ctxts.size(), PtxtArray(sKey.getContext()));
+
+  for (long i = 0; i < long(ctxts.size()); i++) {
+    assertEq(&ptxts[i].ea.getContext(),
+             &ctxts[i].getContext(),
+             "Cannot decrypt when ciphertext has different context than "
+             "EncryptedArray");
+    if (!sKey.isCKKS() &&
+        ctxts[i].getPtxtSpace() < ctxts[i].getContext().getPPowR())
+      throw LogicError("EncryptedArray::decrypt: bad plaintext modulus");
+  }
+
+  // Decode the batch, as PtxtArray::decrypt does for one ciphertext. For
+  // CKKS this includes adding fresh noise to each decrypted polynomial, and
+  // only the real parts of the slots are kept, see decryptReal.
+  NTL_EXEC_RANGE(long(ctxts.size()), first, last)
+  std::vector<cx_double> slots;
+  std::vector<double> realSlots;
+  for (long i = first; i < last; i++) {
+    const EncryptedArray& ea = ptxts[i].ea;
+    if (ea.isCKKS()) {
+      ea.getCx().decodeDecrypted(slots, polys[i], ctxts[i], sKey, prec);
+      project(realSlots, slots);
+      convert(ptxts[i].pa.getData<PA_cx>(), realSlots);
+    } else {
+      ea.decode(ptxts[i].pa, polys[i]);
+    }
+  }
+  NTL_EXEC_RANGE_END
+}
+
 std::istream& operator>>(std::istream& is, PtxtArray& pa)
 {
   pa.readJSON(is);
@@ -16,6 +16,8 @@
 #include <NTL/lzz_pXFactoring.h>
 #include <NTL/GF2XFactoring.h>
 
+#include "binio.h"
+
 namespace helib {
 
 // Forward declarations
@@ -160,6 +162,28 @@ EvalMap::EvalMap(const EncryptedArray& _ea,
     upgrade();
 }
 
+EvalMap::EvalMap(const EncryptedArray& _ea, std::istream& str) : ea(_ea)
+{
+  invert = read_raw_int(str);
+  nfactors = read_raw_int(str);
+  mat1.reset(new BlockMatMul1DExec(ea, str));
+  long n = read_raw_int(str);
+  assertTrue<IOError>(n == nfactors - 1, "EvalMap: bad number of matrices");
+  matvec.SetLength(n);
+  for (long i = 0; i < n; i++)
+    matvec[i].reset(new MatMul1DExec(ea, str));
+}
+
+void EvalMap::writeTo(std::ostream& str) const
+{
+  write_raw_int(str, invert);
+  write_raw_int(str, nfactors);
+  mat1->writeTo(str);
+  write_raw_int(str, matvec.length());
+  for (long i = 0; i < matvec.length(); i++)
+    matvec[i]->writeTo(str);
+}
+
 void EvalMap::upgrade()
 {
   mat1->upgrade();
@@ -638,6 +662,34 @@ ThinEvalMap::ThinEvalMap(const EncryptedArray& _ea,
     upgrade();
 }
 
+ThinEvalMap::ThinEvalMap(const EncryptedArray& _ea, std::istream& str) :
+    ea(_ea)
+{
+  invert = read_raw_int(str);
+  nfactors = read_raw_int(str);
+  long n = read_raw_int(str);
+  assertTrue<IOError>(n == nfactors, "ThinEvalMap: bad number of matrices");
+  matvec.SetLength(n);
+  for (long i = 0; i < n; i++)
+    if (read_raw_int(str)) // a missing matrix is written as 0
+      matvec[i].reset(new MatMul1DExec(ea, str));
+}
+
+void ThinEvalMap::writeTo(std::ostream& str) const
+{
+  write_raw_int(str, invert);
+  write_raw_int(str, nfactors);
+  write_raw_int(str, matvec.length());
+  for (long i = 0; i < matvec.length(); i++) {
+    write_raw_int(str, matvec[i] != nullptr);
+    if (matvec[i]) {
+      auto mat = dynamic_cast<const MatMul1DExec*>(matvec[i].get());
+      assertNotNull(mat, "ThinEvalMap: unexpected type of matrix");
+      mat->writeTo(str);
+    }
+  }
+}
+
 void ThinEvalMap::upgrade()
 {
   for (long i = 0; i < matvec.length(); i++)
@@ -0,0 +1,141 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+/* HoistedCtxt.cpp - many automorphisms of a ciphertext that was broken into
+ * digits only once
+ */
+#include <helib/HoistedCtxt.h>
+#include <helib/keySwitching.h>
+#include <helib/keys.h>
+#include <helib/fhe_stats.h>
+#include <helib/log.h>
+#include <helib/timing.h>
+
+namespace helib {
+
+HoistedCtxt::HoistedCtxt(const Ctxt& _ctxt) : ctxt(_ctxt), noise(1.0)
+{
+  HELIB_TIMER_START;
+  if (ctxt.parts.size() >= 1)
+    assertTrue(ctxt.parts[0].skHandle.isOne(),
+               "Invalid ciphertext (secret key handle for part 0 is not one)");
+  if (ctxt.parts.size() <= 1)
+    return; // nothing to do
+
+  ctxt.cleanUp();
+  const Context& context = ctxt.getContext();
+  const PubKey& pubKey = ctxt.getPubKey();
+  long keyID = ctxt.getKeyID();
+
+  // The call to cleanUp() should ensure that this assertion passes.
+  assertTrue(ctxt.inCanonicalForm(keyID), "Ciphertext is not in canonical form");
+
+  ctxt.relin_CKKS_adjust();
+
+  // Compute the number of digits that we need and the estimated
+  // added noise from switching this ciphertext.
+
+  NTL::xdouble addedNoise = ctxt.parts[1].breakIntoDigits(polyDigits);
+  addedNoise *= pubKey.maxKeySwitchNoise();
+
+  double logProd = context.logOfProduct(context.getSpecialPrimes());
+  noise = ctxt.getNoiseBound() * NTL::xexp(logProd);
+
+  double ratio = NTL::conv<double>(addedNoise / noise);
+
+  HELIB_STATS_UPDATE("KS-noise-ratio-hoist", ratio);
+  if (ratio > 1) {
+    Warning("KS-noise-ratio-hoist=" + std::to_string(ratio) + "\n");
+  }
+
+  noise += addedNoise;
+}
+
+std::shared_ptr<Ctxt> HoistedCtxt::automorph(long k) const
+{
+  std::shared_ptr<Ctxt> result = std::make_shared<Ctxt>(ZeroCtxtLike, ctxt);
+  automorph(*result, k);
+  return result;
+}
+
+void HoistedCtxt::automorph(Ctxt& out, long k) const
+{
+  HELIB_TIMER_START;
+
+  // A hack: record this automorphism rather than actually performing it
+  if (isSetAutomorphVals()) { // defined in NumbTh.h
+    recordAutomorphVal(k);
+    out = ctxt;
+    return;
+  }
+
+  if (k == 1 || ctxt.isEmpty()) {
+    out = ctxt; // nothing to do
+    return;
+  }
+
+  const Context& context = ctxt.getContext();
+  const PubKey& pubKey = ctxt.getPubKey();
+
+  // empty ctxt
+  out = Ctxt(ZeroCtxtLike, ctxt);
+  out.noiseBound = noise; // noise estimate
+  out.intFactor = ctxt.intFactor;
+
+  out.primeSet = ctxt.primeSet | context.getSpecialPrimes();
+  // VJS-NOTE: added this to make addPart work
+
+  if (ctxt.isCKKS()) {
+    out.ptxtMag = ctxt.ptxtMag;
+    double logProd = context.logOfProduct(context.getSpecialPrimes());
+    out.ratFactor = ctxt.ratFactor * NTL::xexp(logProd);
+  }
+
+  if (ctxt.parts.size() == 1) { // only constant part, no need to key-switch
+    CtxtPart tmpPart = ctxt.parts[0];
+    tmpPart.automorph(k);
+    tmpPart.addPrimesAndScale(context.getSpecialPrimes());
+    out.addPart(tmpPart, /*matchPrimeSet=*/true);
+    return;
+  }
+
+  // Ensure that we have a key-switching matrices for this automorphism
+  long keyID = ctxt.getKeyID();
+  if (!pubKey.isReachable(k, keyID)) {
+    throw LogicError("no key-switching matrices for k=" + std::to_string(k) +
+                     ", keyID=" + std::to_string(keyID));
+  }
+
+  // Get the first key-switching matrix for this automorphism
+  const KeySwitch& W = pubKey.getNextKSWmatrix(k, keyID);
+  long amt = W.fromKey.getPowerOfX();
+
+  // Start by rotating the constant part, no need to key-switch it
+  CtxtPart tmpPart = ctxt.parts[0];
+  tmpPart.automorph(amt);
+  tmpPart.addPrimesAndScale(context.getSpecialPrimes());
+  out.addPart(tmpPart, /*matchPrimeSet=*/true);
+
+  // Then rotate the digits and key-switch them
+  std::vector<DoubleCRT> tmpDigits = polyDigits;
+  for (auto&& tmp : tmpDigits) // rotate each of the digits
+    tmp.automorph(amt);
+
+  out.keySwitchDigits(W, tmpDigits); // key-switch the digits
+
+  long m = context.getM();
+  if ((amt - k) % m != 0) { // amt != k (mod m), more automorphisms to do
+    k = NTL::MulMod(k, NTL::InvMod(amt, m), m); // k *= amt^{-1} mod m
+    out.smartAutomorph(k);                      // call usual smartAutomorph
+  }
+}
+
+} // namespace helib
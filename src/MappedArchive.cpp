@@ -0,0 +1,634 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+/* MappedArchive.cpp - a memory-mappable container of ciphertexts and
+ * key-switching matrices
+ */
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <helib/MappedArchive.h>
+#include <helib/exceptions.h>
+#include <helib/timing.h>
+
+namespace helib {
+
+static_assert(sizeof(long) == 8, "MappedArchive requires 64-bit longs");
+
+static constexpr long ARCHIVE_ALIGNMENT = ResidueMatrix::ALIGNMENT;
+static constexpr long ARCHIVE_VERSION = 1;
+static constexpr std::array<char, 8> ARCHIVE_MAGIC = {'|', 'H', 'E', 'A',
+                                                      'R', 'C', 'H', '|'};
+// Written as a number, reads differently on a machine of the other endianness
+static constexpr unsigned long ARCHIVE_BYTE_ORDER = 0x0102030405060708UL;
+
+namespace {
+
+struct ArchiveHeader
+{
+  std::array<char, 8> magic = ARCHIVE_MAGIC;
+  unsigned long byteOrder = ARCHIVE_BYTE_ORDER;
+  long version = ARCHIVE_VERSION;
+  long m = 0;
+  long phim = 0;
+  long stride = 0;
+  long numPrimes = 0;
+  long tocOffset = 0; // 0 until the archive is closed
+};
+
+static_assert(sizeof(ArchiveHeader) == ARCHIVE_ALIGNMENT,
+              "The archive header must fill exactly one aligned block");
+
+// The metadata records are sequences of 64-bit words
+struct RecordBuilder
+{
+  std::vector<long> words;
+
+  void add(long w) { words.push_back(w); }
+
+  void add(const NTL::xdouble& x)
+  {
+    double mantissa = x.mantissa();
+    long w;
+    std::memcpy(&w, &mantissa, sizeof(w));
+    add(w);
+    add(x.exponent());
+  }
+
+  void add(const IndexSet& s)
+  {
+    add(s.card());
+    for (long j : s)
+      add(j);
+  }
+
+  void add(const SKHandle& h)
+  {
+    add(h.getPowerOfS());
+    add(h.getPowerOfX());
+    add(h.getSecretKeyID());
+  }
+
+  void add(const NTL::ZZ& z)
+  {
+    long n = NTL::NumBytes(z);
+    std::vector<unsigned char> bytes(n);
+    NTL::BytesFromZZ(bytes.data(), z, n);
+    bytes.resize(((n + 7) / 8) * 8, 0);
+    add(n);
+    for (std::size_t i = 0; i < bytes.size(); i += 8) {
+      long w;
+      std::memcpy(&w, bytes.data() + i, sizeof(w));
+      add(w);
+    }
+  }
+};
+
+// Reads a record, checking that it does not run past its end and that the
+// prime indexes are those of a context with numPrimes primes
+struct RecordReader
+{
+  const long* p;
+  const long* end;
+  long numPrimes;
+
+  long next()
+  {
+    if (p >= end)
+      throw IOError("MappedArchive: truncated item record");
+    return *p++;
+  }
+
+  NTL::xdouble nextXdouble()
+  {
+    long w = next();
+    double mantissa;
+    std::memcpy(&mantissa, &w, sizeof(w));
+    long exponent = next();
+    return NTL::xdouble(mantissa, exponent);
+  }
+
+  IndexSet nextIndexSet()
+  {
+    IndexSet s;
+    long card = next();
+    if (card < 0 || card > end - p)
+      throw IOError("MappedArchive: bad index set in item record");
+    for (long i = 0; i < card; i++) {
+      long j = next();
+      // written in increasing order, see RecordBuilder::add
+      if (j < 0 || j >= numPrimes || (i > 0 && j <= s.last()))
+        throw IOError("MappedArchive: bad prime index in item record");
+      s.insert(j);
+    }
+    return s;
+  }
+
+  SKHandle nextSKHandle()
+  {
+    long powerOfS = next();
+    long powerOfX = next();
+    long secretKeyID = next();
+    return SKHandle(powerOfS, powerOfX, secretKeyID);
+  }
+
+  NTL::ZZ nextZZ()
+  {
+    long n = next();
+    if (n < 0 || n > 8 * (end - p))
+      throw IOError("MappedArchive: bad integer in item record");
+    std::vector<unsigned char> bytes(((n + 7) / 8) * 8);
+    for (std::size_t i = 0; i < bytes.size(); i += 8) {
+      long w = next();
+      std::memcpy(bytes.data() + i, &w, sizeof(w));
+    }
+    return NTL::ZZFromBytes(bytes.data(), n);
+  }
+};
+
+void writeWord(std::ostream& str, long w)
+{
+  str.write(reinterpret_cast<const char*>(&w), sizeof(w));
+}
+
+} // namespace
+
+/********************************************************************/
+/*************************** ArchiveWriter **************************/
+
+ArchiveWriter::ArchiveWriter(const std::string& path, const Context& _context) :
+    context(_context),
+    str(path, std::ios::binary | std::ios::trunc),
+    stride(ResidueMatrix(_context.getPhiM()).getStride())
+{
+  if (!str.is_open())
+    throw IOError("Could not open archive file '" + path + "'");
+
+  // the header is rewritten with the offset of the contents on close
+  ArchiveHeader header;
+  str.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (long i = 0; i < context.numPrimes(); i++)
+    writeWord(str, context.ithPrime(i));
+}
+
+ArchiveWriter::~ArchiveWriter()
+{
+  try {
+    close();
+  } catch (...) {
+    // destructors must not throw, call close() to see the error
+  }
+}
+
+// Pad the file with zeros to the next aligned offset
+void ArchiveWriter::pad()
+{
+  long rem = long(str.tellp()) % ARCHIVE_ALIGNMENT;
+  if (rem != 0) {
+    static const std::array<char, ARCHIVE_ALIGNMENT> zeros{};
+    str.write(zeros.data(), ARCHIVE_ALIGNMENT - rem);
+  }
+}
+
+// Write the rows of d in the layout of ResidueMatrix::attach,
+// returns the offset of the block
+long ArchiveWriter::writeResidues(const DoubleCRT& d)
+{
+  assertEq(&d.getContext(), &context, "Archive: context mismatch");
+  pad();
+  long offset = str.tellp();
+
+  long phim = context.getPhiM();
+  const std::vector<long> padding(stride - phim, 0);
+  const ResidueMatrix& map = d.getMap();
+  for (long j : d.getIndexSet()) {
+    str.write(reinterpret_cast<const char*>(map[j]), phim * sizeof(long));
+    str.write(reinterpret_cast<const char*>(padding.data()),
+              padding.size() * sizeof(long));
+  }
+  return offset;
+}
+
+long ArchiveWriter::append(const Ctxt& ctxt)
+{
+  HELIB_TIMER_START;
+  assertTrue<IOError>(str.is_open(), "Archive: append after close");
+  assertEq(&ctxt.getContext(), &context, "Archive: context mismatch");
+
+  std::vector<long> blocks;
+  for (const CtxtPart& part : ctxt.parts)
+    blocks.push_back(writeResidues(part));
+
+  RecordBuilder rec;
+  rec.add(ctxt.ptxtSpace);
+  rec.add(ctxt.intFactor);
+  rec.add(ctxt.ptxtMag);
+  rec.add(ctxt.ratFactor);
+  rec.add(ctxt.noiseBound);
+  rec.add(ctxt.primeSet);
+  rec.add(long(ctxt.parts.size()));
+  for (std::size_t i = 0; i < ctxt.parts.size(); i++) {
+    rec.add(ctxt.parts[i].skHandle);
+    rec.add(ctxt.parts[i].getIndexSet());
+    rec.add(blocks[i]);
+  }
+
+  long offset = str.tellp();
+  writeWord(str, rec.words.size());
+  str.write(reinterpret_cast<const char*>(rec.words.data()),
+            rec.words.size() * sizeof(long));
+  toc.emplace_back(long(MappedArchive::ItemKind::CTXT), offset);
+  return toc.size() - 1;
+}
+
+long ArchiveWriter::append(const KeySwitch& ksm)
+{
+  HELIB_TIMER_START;
+  assertTrue<IOError>(str.is_open(), "Archive: append after close");
+
+  std::vector<long> blocks;
+  for (const DoubleCRT& col : ksm.b)
+    blocks.push_back(writeResidues(col));
+
+  RecordBuilder rec;
+  rec.add(ksm.fromKey);
+  rec.add(ksm.toKeyID);
+  rec.add(ksm.ptxtSpace);
+  rec.add(ksm.noiseBound);
+  rec.add(ksm.prgSeed);
+  rec.add(long(ksm.b.size()));
+  for (std::size_t i = 0; i < ksm.b.size(); i++) {
+    rec.add(ksm.b[i].getIndexSet());
+    rec.add(blocks[i]);
+  }
+
+  long offset = str.tellp();
+  writeWord(str, rec.words.size());
+  str.write(reinterpret_cast<const char*>(rec.words.data()),
+            rec.words.size() * sizeof(long));
+  toc.emplace_back(long(MappedArchive::ItemKind::KEY_SWITCH), offset);
+  return toc.size() - 1;
+}
+
+void ArchiveWriter::close()
+{
+  if (!str.is_open())
+    return;
+
+  pad();
+  ArchiveHeader header;
+  header.m = context.getM();
+  header.phim = context.getPhiM();
+  header.stride = stride;
+  header.numPrimes = context.numPrimes();
+  header.tocOffset = str.tellp();
+
+  writeWord(str, toc.size());
+  for (const auto& entry : toc) {
+    writeWord(str, entry.first);
+    writeWord(str, entry.second);
+  }
+
+  str.seekp(0);
+  str.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  bool failed = str.fail();
+  str.close();
+  if (failed)
+    throw IOError("Archive: failed writing the archive file");
+}
+
+/********************************************************************/
+/*************************** MappedArchive **************************/
+
+// Owns the mapping of the whole file
+struct MappedArchive::Mapping
+{
+  void* addr = MAP_FAILED;
+  std::size_t len = 0;
+
+  explicit Mapping(const std::string& path)
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw IOError("Could not open archive file '" + path + "'");
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+      len = st.st_size;
+      // A private writable mapping: the objects we hand out may be modified
+      // in place, the kernel copies the pages they touch
+      addr = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+    if (addr == MAP_FAILED)
+      throw IOError("Could not map archive file '" + path + "'");
+  }
+
+  ~Mapping()
+  {
+    if (addr != MAP_FAILED)
+      ::munmap(addr, len);
+  }
+
+  Mapping(const Mapping&) = delete;
+  Mapping& operator=(const Mapping&) = delete;
+
+  char* base() const { return static_cast<char*>(addr); }
+
+  // A pointer to the words [offset, offset+8*n), checking the bounds
+  long* words(long offset, long n) const
+  {
+    if (offset < 0 || offset % sizeof(long) != 0 || n < 0 ||
+        std::size_t(offset) > len ||
+        std::size_t(n) > (len - offset) / sizeof(long))
+      throw IOError("MappedArchive: offset out of range");
+    return reinterpret_cast<long*>(base() + offset);
+  }
+};
+
+MappedArchive::MappedArchive(const std::string& path,
+                             const Context& _context) :
+    context(_context), mapping(std::make_shared<Mapping>(path))
+{
+  HELIB_TIMER_START;
+  if (mapping->len < sizeof(ArchiveHeader))
+    throw IOError("MappedArchive: '" + path + "' is too short");
+
+  ArchiveHeader header;
+  std::memcpy(&header, mapping->base(), sizeof(header));
+  if (header.magic != ARCHIVE_MAGIC)
+    throw IOError("MappedArchive: '" + path + "' is not an archive");
+  if (header.byteOrder != ARCHIVE_BYTE_ORDER)
+    throw IOError("MappedArchive: archive written on a machine of different "
+                  "endianness");
+  if (header.version != ARCHIVE_VERSION)
+    throw IOError("MappedArchive: version " + std::to_string(header.version) +
+                  " not supported");
+  if (header.tocOffset == 0)
+    throw IOError("MappedArchive: the archive was not closed");
+
+  if (header.m != context.getM() || header.phim != context.getPhiM() ||
+      header.stride != ResidueMatrix(context.getPhiM()).getStride() ||
+      header.numPrimes != context.numPrimes())
+    throw IOError("MappedArchive: the archive does not match the context");
+  const long* primes = mapping->words(sizeof(header), header.numPrimes);
+  for (long i = 0; i < header.numPrimes; i++)
+    if (primes[i] != context.ithPrime(i))
+      throw IOError("MappedArchive: the archive does not match the context");
+
+  long count = *mapping->words(header.tocOffset, 1);
+  const long* entries =
+      mapping->words(header.tocOffset + sizeof(long), 2 * count);
+  toc.reserve(count);
+  for (long i = 0; i < count; i++)
+    toc.emplace_back(entries[2 * i], entries[2 * i + 1]);
+}
+
+MappedArchive::ItemKind MappedArchive::kind(long i) const
+{
+  assertInRange(i, 0l, size(), "MappedArchive: item out of range");
+  return ItemKind(toc[i].first);
+}
+
+void MappedArchive::checkRows(const long* rows,
+                              const IndexSet& s,
+                              const std::string& what) const
+{
+  long phim = context.getPhiM();
+  long stride = ResidueMatrix(phim).getStride();
+  for (long j : s) {
+    long q = context.ithPrime(j);
+    for (long k = 0; k < phim; k++)
+      if (rows[k] < 0 || rows[k] >= q)
+        throw IOError("MappedArchive: residue out of range in " + what);
+    rows += stride;
+  }
+}
+
+void MappedArchive::attach(DoubleCRT& d,
+                           const IndexSet& s,
+                           long blockOffset,
+                           const std::string& what,
+                           bool check) const
+{
+  if (blockOffset % ARCHIVE_ALIGNMENT != 0)
+    throw IOError("MappedArchive: misaligned residues in " + what);
+  long stride = ResidueMatrix(context.getPhiM()).getStride();
+  long* rows = mapping->words(blockOffset, s.card() * stride);
+  if (check)
+    checkRows(rows, s, what);
+  d.attach(s, rows, mapping);
+}
+
+void MappedArchive::checkResidues(long i) const
+{
+  HELIB_TIMER_START;
+  long stride = ResidueMatrix(context.getPhiM()).getStride();
+  for (const auto& block : blocks(i))
+    checkRows(mapping->words(block.first, block.second.card() * stride),
+              block.second,
+              "item " + std::to_string(i));
+}
+
+void MappedArchive::get(Ctxt& ctxt, long i) const
+{
+  HELIB_TIMER_START;
+  assertTrue<IOError>(kind(i) == ItemKind::CTXT,
+                      "MappedArchive: item is not a ciphertext");
+  assertEq(&ctxt.getContext(), &context, "MappedArchive: context mismatch");
+
+  long n = *mapping->words(toc[i].second, 1);
+  const long* p = mapping->words(toc[i].second + sizeof(long), n);
+  RecordReader rec{p, p + n, context.numPrimes()};
+
+  ctxt.ptxtSpace = rec.next();
+  ctxt.intFactor = rec.next();
+  ctxt.ptxtMag = rec.nextXdouble();
+  ctxt.ratFactor = rec.nextXdouble();
+  ctxt.noiseBound = rec.nextXdouble();
+  ctxt.primeSet = rec.nextIndexSet();
+  NTL::clear(ctxt.prgSeed);
+
+  long nParts = rec.next();
+  ctxt.parts.clear();
+  ctxt.parts.reserve(nParts); // so that the views are never copied
+  for (long k = 0; k < nParts; k++) {
+    ctxt.parts.emplace_back(context, IndexSet::emptySet());
+    CtxtPart& part = ctxt.parts.back();
+    part.skHandle = rec.nextSKHandle();
+    IndexSet s = rec.nextIndexSet();
+    attach(part, s, rec.next(), "ciphertext part");
+  }
+}
+
+void MappedArchive::get(KeySwitch& ksm, long i, bool check) const
+{
+  HELIB_TIMER_START;
+  assertTrue<IOError>(kind(i) == ItemKind::KEY_SWITCH,
+                      "MappedArchive: item is not a key-switching matrix");
+
+  long n = *mapping->words(toc[i].second, 1);
+  const long* p = mapping->words(toc[i].second + sizeof(long), n);
+  RecordReader rec{p, p + n, context.numPrimes()};
+
+  ksm.fromKey = rec.nextSKHandle();
+  ksm.toKeyID = rec.next();
+  ksm.ptxtSpace = rec.next();
+  ksm.noiseBound = rec.nextXdouble();
+  ksm.prgSeed = rec.nextZZ();
+
+  long nCols = rec.next();
+  ksm.b.clear();
+  ksm.b.reserve(nCols);
+  for (long k = 0; k < nCols; k++) {
+    ksm.b.emplace_back(context, IndexSet::emptySet());
+    IndexSet s = rec.nextIndexSet();
+    attach(ksm.b.back(), s, rec.next(), "key-switching matrix", check);
+  }
+}
+
+std::vector<std::pair<long, IndexSet>> MappedArchive::blocks(long i) const
+{
+  long n = *mapping->words(toc[i].second, 1);
+  const long* p = mapping->words(toc[i].second + sizeof(long), n);
+  RecordReader rec{p, p + n, context.numPrimes()};
+
+  // skip the metadata, see ArchiveWriter::append
+  long count;
+  if (kind(i) == ItemKind::CTXT) {
+    rec.next();         // ptxtSpace
+    rec.next();         // intFactor
+    rec.nextXdouble();  // ptxtMag
+    rec.nextXdouble();  // ratFactor
+    rec.nextXdouble();  // noiseBound
+    rec.nextIndexSet(); // primeSet
+    count = rec.next();
+  } else {
+    rec.nextSKHandle(); // fromKey
+    rec.next();         // toKeyID
+    rec.next();         // ptxtSpace
+    rec.nextXdouble();  // noiseBound
+    rec.nextZZ();       // prgSeed
+    count = rec.next();
+  }
+
+  std::vector<std::pair<long, IndexSet>> result;
+  for (long k = 0; k < count; k++) {
+    if (kind(i) == ItemKind::CTXT)
+      rec.nextSKHandle();
+    IndexSet s = rec.nextIndexSet();
+    result.emplace_back(rec.next(), s);
+  }
+  return result;
+}
+
+void MappedArchive::release(long i) const
+{
+  assertInRange(i, 0l, size(), "MappedArchive: item out of range");
+  long stride = ResidueMatrix(context.getPhiM()).getStride();
+  long pageSize = ::sysconf(_SC_PAGESIZE);
+
+  for (const auto& block : blocks(i)) {
+    long rows = block.second.card();
+    long len = rows * stride * sizeof(long);
+    mapping->words(block.first, rows * stride); // check the bounds
+
+    // Only the pages that lie entirely inside the block, the others may
+    // hold residues of the neighbouring items
+    long first = ((block.first + pageSize - 1) / pageSize) * pageSize;
+    long last = ((block.first + len) / pageSize) * pageSize;
+    if (first < last)
+      ::madvise(mapping->base() + first, last - first, MADV_DONTNEED);
+  }
+}
+
+/********************************************************************/
+/************************** KeySwitchStore **************************/
+
+void KeySwitchStore::write(const std::string& path,
+                           const Context& context,
+                           const std::vector<KeySwitch>& matrices)
+{
+  HELIB_TIMER_START;
+  ArchiveWriter writer(path, context);
+  for (const KeySwitch& ksm : matrices)
+    writer.append(ksm);
+  writer.close();
+}
+
+KeySwitchStore::KeySwitchStore(const std::string& path,
+                               const Context& context,
+                               long _maxResident) :
+    archive(path, context), maxResident(_maxResident)
+{
+  for (long i = 0; i < archive.size(); i++)
+    if (archive.kind(i) != MappedArchive::ItemKind::KEY_SWITCH)
+      throw IOError("KeySwitchStore: '" + path +
+                    "' holds items other than key-switching matrices");
+  where.assign(archive.size(), lru.end());
+  checked = std::make_unique<HELIB_atomic_long[]>(archive.size());
+}
+
+void KeySwitchStore::get(KeySwitch& ksm, long i) const
+{
+  // the residues are checked on the first use, see check
+  archive.get(ksm, i, /*check=*/false);
+}
+
+void KeySwitchStore::check(long i) const
+{
+  assertInRange(i, 0l, size(), "KeySwitchStore: matrix out of range");
+  if (!checked[i]) {
+    archive.checkResidues(i);
+    checked[i] = 1;
+  }
+}
+
+void KeySwitchStore::checkAll() const
+{
+  for (long i = 0; i < size(); i++)
+    check(i);
+}
+
+void KeySwitchStore::touch(long i) const
+{
+  check(i);
+  if (maxResident <= 0)
+    return; // nothing to bound
+
+  HELIB_MUTEX_GUARD(lruMutex);
+  if (where[i] != lru.end()) {
+    lru.splice(lru.begin(), lru, where[i]);
+    return;
+  }
+
+  lru.push_front(i);
+  where[i] = lru.begin();
+  while (long(lru.size()) > maxResident) {
+    long j = lru.back();
+    lru.pop_back();
+    where[j] = lru.end();
+    archive.release(j);
+  }
+}
+
+long KeySwitchStore::numResident() const
+{
+  HELIB_MUTEX_GUARD(lruMutex);
+  return lru.size();
+}
+
+} // namespace helib
@@ -0,0 +1,293 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+/* NTT.cpp - a native negacyclic NTT with Harvey butterflies
+ *
+ * The forward transform is a Cooley-Tukey NTT taking its input in natural
+ * order and producing a bit-reversed output, the inverse transform is a
+ * Gentleman-Sande NTT taking a bit-reversed input and producing a natural
+ * output (see, e.g., Longa and Naehrig, "Speeding up the number theoretic
+ * transform for faster ideal lattice-based cryptography", CANS 2016).
+ * The twisting by powers of psi is merged into the butterflies.
+ */
+#include <algorithm>
+
+#include <NTL/ZZ.h>
+#include <NTL/sp_arith.h>
+
+#include <helib/NTT.h>
+#include <helib/assertions.h>
+#include <helib/timing.h>
+
+#if (defined(__AVX512F__) && defined(__AVX512IFMA__))
+#include <immintrin.h>
+#define HELIB_NTT_IFMA
+#endif
+
+namespace helib {
+
+// The high word of the double-word product a*b
+static inline unsigned long mulHi(unsigned long a, unsigned long b)
+{
+  NTL::ll_type t;
+  NTL::ll_init(t, 0);
+  NTL::ll_imul_add(t, a, b);
+  return NTL::ll_get_hi(t);
+}
+
+// Shoup's pre-computed quotient floor(w * 2^bits / q), for w < q
+static unsigned long shoupPrecon(unsigned long w, long q, long bits)
+{
+  NTL::ZZ t = NTL::conv<NTL::ZZ>(w);
+  t <<= bits;
+  t /= q;
+  return NTL::conv<unsigned long>(t);
+}
+
+// Returns a value in [0,2q) congruent to y*w mod q, for any y and for w < q
+// with wp = shoupPrecon(w, q, NTL_BITS_PER_LONG)
+static inline unsigned long mulModLazy(unsigned long y,
+                                       unsigned long w,
+                                       unsigned long wp,
+                                       unsigned long q)
+{
+  unsigned long quo = mulHi(y, wp);
+  return y * w - quo * q;
+}
+
+#ifdef HELIB_NTT_IFMA
+// The same butterflies as in forward/inverse below, eight at a time.
+// All the inputs are < 4q < 2^52, so the 52-bit multipliers are exact,
+// and wp52 = shoupPrecon(w, q, 52).
+
+static void forwardButterfliesIFMA(unsigned long* a0,
+                                   unsigned long* a1,
+                                   long t,
+                                   unsigned long w,
+                                   unsigned long wp52,
+                                   unsigned long q)
+{
+  const __m512i vq = _mm512_set1_epi64((long long)q);
+  const __m512i vq2 = _mm512_set1_epi64((long long)(2 * q));
+  const __m512i vw = _mm512_set1_epi64((long long)w);
+  const __m512i vwp = _mm512_set1_epi64((long long)wp52);
+  const __m512i mask52 = _mm512_set1_epi64((1LL << 52) - 1);
+  const __m512i zero = _mm512_setzero_si512();
+
+  for (long j = 0; j < t; j += 8) {
+    __m512i x = _mm512_loadu_si512(a0 + j);
+    __m512i y = _mm512_loadu_si512(a1 + j);
+    // x in [0,4q) -> [0,2q)
+    x = _mm512_min_epu64(x, _mm512_sub_epi64(x, vq2));
+    // tt = y*w mod q in [0,2q)
+    __m512i quo = _mm512_madd52hi_epu64(zero, y, vwp);
+    __m512i tt = _mm512_sub_epi64(_mm512_madd52lo_epu64(zero, y, vw),
+                                  _mm512_madd52lo_epu64(zero, quo, vq));
+    tt = _mm512_and_si512(tt, mask52);
+    _mm512_storeu_si512(a0 + j, _mm512_add_epi64(x, tt));
+    _mm512_storeu_si512(a1 + j, _mm512_sub_epi64(_mm512_add_epi64(x, vq2), tt));
+  }
+}
+
+static void inverseButterfliesIFMA(unsigned long* a0,
+                                   unsigned long* a1,
+                                   long t,
+                                   unsigned long w,
+                                   unsigned long wp52,
+                                   unsigned long q)
+{
+  const __m512i vq = _mm512_set1_epi64((long long)q);
+  const __m512i vq2 = _mm512_set1_epi64((long long)(2 * q));
+  const __m512i vw = _mm512_set1_epi64((long long)w);
+  const __m512i vwp = _mm512_set1_epi64((long long)wp52);
+  const __m512i mask52 = _mm512_set1_epi64((1LL << 52) - 1);
+  const __m512i zero = _mm512_setzero_si512();
+
+  for (long j = 0; j < t; j += 8) {
+    __m512i x = _mm512_loadu_si512(a0 + j);
+    __m512i y = _mm512_loadu_si512(a1 + j);
+    // s = x+y in [0,2q)
+    __m512i s = _mm512_add_epi64(x, y);
+    s = _mm512_min_epu64(s, _mm512_sub_epi64(s, vq2));
+    // d = (x-y+2q)*w mod q in [0,2q)
+    __m512i d = _mm512_sub_epi64(_mm512_add_epi64(x, vq2), y);
+    __m512i quo = _mm512_madd52hi_epu64(zero, d, vwp);
+    __m512i tt = _mm512_sub_epi64(_mm512_madd52lo_epu64(zero, d, vw),
+                                  _mm512_madd52lo_epu64(zero, quo, vq));
+    _mm512_storeu_si512(a0 + j, s);
+    _mm512_storeu_si512(a1 + j, _mm512_and_si512(tt, mask52));
+  }
+}
+#endif
+
+NegacyclicNTT::NegacyclicNTT(long _q, long psi, long _logn) :
+    q(_q), logn(_logn), n(1L << _logn)
+{
+  assertInRange(q,
+                2l,
+                1L << (NTL_BITS_PER_LONG - 2),
+                "NTT modulus q must be smaller than 2^{NTL_BITS_PER_LONG-2}");
+  assertEq(NTL::PowerMod(psi, n, q),
+           q - 1,
+           "psi is not a primitive 2n-th root of unity mod q");
+
+  rev.resize(n);
+  for (long i = 0; i < n; i++) {
+    long r = 0;
+    for (long b = 0; b < logn; b++)
+      r |= ((i >> b) & 1) << (logn - 1 - b);
+    rev[i] = r;
+  }
+
+  long ipsi = NTL::InvMod(psi, q);
+  std::vector<long> pw(n), ipw(n);
+  pw[0] = ipw[0] = 1;
+  for (long i = 1; i < n; i++) {
+    pw[i] = NTL::MulMod(pw[i - 1], psi, q);
+    ipw[i] = NTL::MulMod(ipw[i - 1], ipsi, q);
+  }
+
+  psiRev.resize(n);
+  psiRevPrecon.resize(n);
+  ipsiRev.resize(n);
+  ipsiRevPrecon.resize(n);
+  for (long i = 0; i < n; i++) {
+    psiRev[i] = pw[rev[i]];
+    ipsiRev[i] = ipw[rev[i]];
+    psiRevPrecon[i] = shoupPrecon(psiRev[i], q, NTL_BITS_PER_LONG);
+    ipsiRevPrecon[i] = shoupPrecon(ipsiRev[i], q, NTL_BITS_PER_LONG);
+  }
+
+  nInv = NTL::InvMod(n % q, q);
+  nInvPrecon = shoupPrecon(nInv, q, NTL_BITS_PER_LONG);
+
+#ifdef HELIB_NTT_IFMA
+  if (q < (1L << 50)) {
+    psiRevPrecon52.resize(n);
+    ipsiRevPrecon52.resize(n);
+    for (long i = 0; i < n; i++) {
+      psiRevPrecon52[i] = shoupPrecon(psiRev[i], q, 52);
+      ipsiRevPrecon52[i] = shoupPrecon(ipsiRev[i], q, 52);
+    }
+  }
+#endif
+}
+
+void NegacyclicNTT::bitReverse(unsigned long* a) const
+{
+  for (long i = 0; i < n; i++) {
+    long j = rev[i];
+    if (i < j)
+      std::swap(a[i], a[j]);
+  }
+}
+
+void NegacyclicNTT::forward(long* y, const long* x) const
+{
+  HELIB_TIMER_START;
+  if (y != x)
+    std::copy(x, x + n, y);
+
+  unsigned long* a = reinterpret_cast<unsigned long*>(y);
+  const unsigned long uq = q;
+  const unsigned long q2 = 2 * uq;
+
+  // Cooley-Tukey butterflies, all values are kept in [0,4q)
+  long t = n;
+  for (long m = 1; m < n; m *= 2) {
+    t /= 2;
+    for (long i = 0; i < m; i++) {
+      unsigned long* a0 = a + 2 * i * t;
+      unsigned long* a1 = a0 + t;
+      const unsigned long w = psiRev[m + i];
+      const unsigned long wp = psiRevPrecon[m + i];
+
+#ifdef HELIB_NTT_IFMA
+      if (t >= 8 && usesIFMA()) {
+        forwardButterfliesIFMA(a0, a1, t, w, psiRevPrecon52[m + i], uq);
+        continue;
+      }
+#endif
+      for (long j = 0; j < t; j++) {
+        unsigned long u = a0[j];
+        if (u >= q2)
+          u -= q2;
+        unsigned long v = mulModLazy(a1[j], w, wp, uq);
+        a0[j] = u + v;
+        a1[j] = u - v + q2;
+      }
+    }
+  }
+
+  // reduce from [0,4q) to [0,q)
+  for (long j = 0; j < n; j++) {
+    unsigned long u = a[j];
+    if (u >= q2)
+      u -= q2;
+    if (u >= uq)
+      u -= uq;
+    a[j] = u;
+  }
+
+  bitReverse(a);
+}
+
+void NegacyclicNTT::inverse(long* x, const long* y) const
+{
+  HELIB_TIMER_START;
+  if (x != y)
+    std::copy(y, y + n, x);
+
+  unsigned long* a = reinterpret_cast<unsigned long*>(x);
+  const unsigned long uq = q;
+  const unsigned long q2 = 2 * uq;
+
+  bitReverse(a);
+
+  // Gentleman-Sande butterflies, all values are kept in [0,2q)
+  long t = 1;
+  for (long m = n; m > 1; m /= 2) {
+    long h = m / 2;
+    for (long i = 0; i < h; i++) {
+      unsigned long* a0 = a + 2 * i * t;
+      unsigned long* a1 = a0 + t;
+      const unsigned long w = ipsiRev[h + i];
+      const unsigned long wp = ipsiRevPrecon[h + i];
+
+#ifdef HELIB_NTT_IFMA
+      if (t >= 8 && usesIFMA()) {
+        inverseButterfliesIFMA(a0, a1, t, w, ipsiRevPrecon52[h + i], uq);
+        continue;
+      }
+#endif
+      for (long j = 0; j < t; j++) {
+        unsigned long u = a0[j];
+        unsigned long v = a1[j];
+        unsigned long s = u + v;
+        if (s >= q2)
+          s -= q2;
+        a0[j] = s;
+        a1[j] = mulModLazy(u - v + q2, w, wp, uq);
+      }
+    }
+    t *= 2;
+  }
+
+  // multiply by n^{-1} and reduce to [0,q)
+  for (long j = 0; j < n; j++) {
+    unsigned long u = mulModLazy(a[j], nInv, nInvPrecon, uq);
+    if (u >= uq)
+      u -= uq;
+    a[j] = u;
+  }
+}
+
+} // namespace helib
@@ -1065,6 +1065,20 @@ void interpolateMod(NTL::ZZX& poly,
   recursiveInterpolateMod(poly, x, ytmp, xmod, ymod, p, p2e);
 }
 
+NTL::ZZ deriveSeed(const NTL::ZZ& seed, long index)
+{
+  // Hash the bytes of seed followed by the 8 bytes of index
+  long nb = NTL::NumBytes(seed);
+  std::vector<unsigned char> data(nb + 8);
+  NTL::BytesFromZZ(data.data(), seed, nb);
+  for (long k = 0; k < 8; k++)
+    data[nb + k] = (unsigned char)((unsigned long)index >> (8 * k));
+
+  unsigned char key[32];
+  NTL::DeriveKey(key, 32, data.data(), data.size());
+  return NTL::ZZFromBytes(key, 32);
+}
+
 // advance the input stream beyond white spaces and a single instance of cc
 void seekPastChar(std::istream& str, int cc)
 {
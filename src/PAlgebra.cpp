@@ -431,7 +431,8 @@ double calcPolyNormBnd(long m)
 PAlgebra::PAlgebra(long mm,
                    long pp,
                    const std::vector<long>& _gens,
-                   const std::vector<long>& _ords) :
+                   const std::vector<long>& _ords,
+                   const PAlgebraTables* tables) :
     m(mm), p(pp), cM(1.0) // default value for the ring constant
 {
   assertInRange<InvalidArgument>(mm,
@@ -455,8 +456,10 @@ PAlgebra::PAlgebra(long mm,
     throw InvalidArgument("CKKS scheme only supports m as a power of two.");
 
   // For dry-run, use a tiny m value for the PAlgebra tables
-  if (isDryRun())
+  if (isDryRun()) {
     m = (p == 3) ? 4 : 3;
+    tables = nullptr;
+  }
 
   // Compute the generators for (Z/mZ)^* (defined in NumbTh.cpp)
 
@@ -512,7 +515,10 @@ PAlgebra::PAlgebra(long mm,
     normBnd *= 2.0L * cotan(PI / (2.0L * u)) / u;
   }
 
-  polyNormBnd = calcPolyNormBnd(mm);
+  if (tables != nullptr)
+    polyNormBnd = tables->polyNormBnd;
+  else
+    polyNormBnd = calcPolyNormBnd(mm);
 
   // Allocate space for the various arrays
   resize(T, getNSlots());
@@ -558,7 +564,13 @@ PAlgebra::PAlgebra(long mm,
   // sanity check for user-supplied gens
   assertEq(ctr, getNSlots(), "Bad user-supplied generator set");
 
-  PhimX = Cyclotomic(mm); // compute and store Phi_m(X)
+  if (tables != nullptr) {
+    assertEq<InvalidArgument>(deg(tables->PhimX),
+                              phiM,
+                              "Bad degree of the given Phi_m(X)");
+    PhimX = tables->PhimX;
+  } else
+    PhimX = Cyclotomic(mm); // compute and store Phi_m(X)
   //  pp_factorize(mFactors,mm); // prime-power factorization from NumbTh.cpp
 
   if (mm % 2 == 0)
@@ -629,7 +641,9 @@ long PAlgebra::genToPow(long i, long j) const
 
 ************************************************************************/
 
-PAlgebraModBase* buildPAlgebraMod(const PAlgebra& zMStar, long r)
+PAlgebraModBase* buildPAlgebraMod(const PAlgebra& zMStar,
+                                  long r,
+                                  const PAlgebraTables* tables)
 {
   long p = zMStar.getP();
 
@@ -640,9 +654,9 @@ PAlgebraModBase* buildPAlgebraMod(const PAlgebra& zMStar, long r)
                               "Modulus p is less than 2 (nor -1 for CKKS)");
   assertTrue<InvalidArgument>(r > 0, "Hensel lifting r is less than 1");
   if (p == 2 && r == 1)
-    return new PAlgebraModDerived<PA_GF2>(zMStar, r);
+    return new PAlgebraModDerived<PA_GF2>(zMStar, r, tables);
   else
-    return new PAlgebraModDerived<PA_zz_p>(zMStar, r);
+    return new PAlgebraModDerived<PA_zz_p>(zMStar, r, tables);
 }
 
 template <typename T>
@@ -665,7 +679,9 @@ NTL::zz_pEX FrobeniusMap(const NTL::zz_pEXModulus& F)
 }
 
 template <typename type>
-PAlgebraModDerived<type>::PAlgebraModDerived(const PAlgebra& _zMStar, long _r) :
+PAlgebraModDerived<type>::PAlgebraModDerived(const PAlgebra& _zMStar,
+                                             long _r,
+                                             const PAlgebraTables* tables) :
     zMStar(_zMStar), r(_r)
 
 {
@@ -687,6 +703,12 @@ PAlgebraModDerived<type>::PAlgebraModDerived(const PAlgebra& _zMStar, long _r) :
 
   RBak bak;
   bak.save();
+
+  if (tables != nullptr && !isDryRun()) {
+    restoreTables(*tables);
+    return;
+  }
+
   SetModulus(p);
 
   // Compute the factors Ft of Phi_m(X) mod p, for all t \in T
@@ -758,6 +780,64 @@ PAlgebraModDerived<type>::PAlgebraModDerived(const PAlgebra& _zMStar, long _r) :
   genMaskTable();
 }
 
+// Coefficients of the polynomials in v, balanced mod p^r
+template <typename V>
+static std::vector<zzX> balancedTable(const V& v)
+{
+  std::vector<zzX> res(lsize(v));
+  for (long i : range(lsize(v)))
+    res[i] = balanced_zzX(v[i]);
+  return res;
+}
+
+template <typename type>
+void PAlgebraModDerived<type>::getTables(PAlgebraTables& tables) const
+{
+  RBak bak;
+  bak.save();
+  restoreContext();
+
+  tables.factors = balancedTable(factors);
+  tables.crtCoeffs = balancedTable(crtCoeffs);
+  tables.crtTable = balancedTable(crtTable);
+}
+
+// Assumes that the current modulus is saved. Only the mask tables and the
+// CRT tree are recomputed, these only take additions and a product tree.
+template <typename type>
+void PAlgebraModDerived<type>::restoreTables(const PAlgebraTables& tables)
+{
+  long nSlots = zMStar.getNSlots();
+  assertTrue<InvalidArgument>(lsize(tables.factors) == nSlots &&
+                                  lsize(tables.crtCoeffs) == nSlots &&
+                                  lsize(tables.crtTable) == nSlots,
+                              "Bad number of polynomials in the given tables");
+
+  SetModulus(pPowR);
+  pPowRContext.save();
+
+  RX phimxmod;
+  conv(phimxmod, zMStar.getPhimX());
+  build(PhimXMod, phimxmod);
+
+  resize(factors, nSlots);
+  resize(crtCoeffs, nSlots);
+  resize(crtTable, nSlots);
+  resize(factorsOverZZ, nSlots);
+  for (long i : range(nSlots)) {
+    convert(factors[i], tables.factors[i]);
+    assertEq<InvalidArgument>(deg(factors[i]),
+                              zMStar.getOrdP(),
+                              "Bad degree of a given factor of Phi_m(X)");
+    convert(crtCoeffs[i], tables.crtCoeffs[i]);
+    convert(crtTable[i], tables.crtTable[i]);
+    conv(factorsOverZZ[i], factors[i]);
+  }
+
+  buildTree(crtTree, 0, nSlots);
+  genMaskTable();
+}
+
 // Assumes current zz_p modulus is p^r
 // computes S = F^{-1} mod G via Hensel lifting
 void InvModpr(NTL::zz_pX& S,
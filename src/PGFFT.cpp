@@ -1290,12 +1290,14 @@ pow2_precomp(long n, vector<long>& rev, vector<long>& rev1, vector<aligned_vecto
    return k;
 }
 
+// x is a scratch buffer, which may be reused across calls
+
 static void
 pow2_comp(const cmplx_t* src, cmplx_t* dst,
                   long n, long k, const vector<long>& rev, const vector<long>& rev1,
-                  const vector<aligned_vector<cmplx_t>>& tab)
+                  const vector<aligned_vector<cmplx_t>>& tab,
+                  aligned_vector<cmplx_t>& x)
 {
-   aligned_vector<cmplx_t> x;
    x.assign(src, src+n);
 
    new_fft(&x[0], k, tab);
@@ -1360,11 +1362,12 @@ static void
 bluestein_comp(const cmplx_t* src, cmplx_t* dst,
                   long n, long k, const aligned_vector<cmplx_t>& powers,
                   const aligned_vector<cmplx_t>& Rb,
-                  const vector<aligned_vector<cmplx_t>>& tab)
+                  const vector<aligned_vector<cmplx_t>>& tab,
+                  aligned_vector<cmplx_t>& x)
 {
    long N = 1L << k;
 
-   aligned_vector<cmplx_t> x(N);
+   x.resize(N);
 
    for (long i = 0; i < n; i++)
       x[i] = MUL(src[i], powers[i]);
@@ -1462,11 +1465,12 @@ static void
 bluestein_comp1(const cmplx_t* src, cmplx_t* dst,
                   long n, long k, const aligned_vector<cmplx_t>& powers,
                   const aligned_vector<cmplx_t>& Rb,
-                  const vector<aligned_vector<cmplx_t>>& tab)
+                  const vector<aligned_vector<cmplx_t>>& tab,
+                  aligned_vector<cmplx_t>& x)
 {
    long N = 1L << k;
 
-   aligned_vector<cmplx_t> x(N);
+   x.resize(N);
 
    for (long i = 0; i < n; i++)
       x[i] = MUL(src[i], powers[i]);
@@ -1551,25 +1555,43 @@ PGFFT::PGFFT(long n_)
 
 void PGFFT::apply(const cmplx_t* src, cmplx_t* dst) const
 {
-   switch (strategy) {
+   apply_many(src, dst, 1, n);
+}
 
-   case PGFFT_STRATEGY_NULL:
-      break;
+void PGFFT::apply_many(const cmplx_t* src, cmplx_t* dst,
+                       long count, long stride) const
+{
+   assert(count >= 0 && (count <= 1 || stride >= n));
 
-   case PGFFT_STRATEGY_POW2:
-      pow2_comp(src, dst, n, k, rev, rev1, tab);
-      break;
+   // The scratch buffer is allocated once for the whole batch, and the
+   // twiddle tables stay in the cache from one transform to the next
+   aligned_vector<cmplx_t> x;
 
-   case PGFFT_STRATEGY_BLUE:
-      bluestein_comp(src, dst, n, k, powers, Rb, tab);
-      break;
+   for (long i = 0; i < count; i++) {
+      const cmplx_t* s = src + i*stride;
+      cmplx_t* d = dst + i*stride;
 
-   case PGFFT_STRATEGY_TBLUE:
-      bluestein_comp1(src, dst, n, k, powers, Rb, tab);
-      break;
+      switch (strategy) {
 
-   default: ;
+      case PGFFT_STRATEGY_NULL:
+         if (s != d) d[0] = s[0];
+         break;
 
+      case PGFFT_STRATEGY_POW2:
+         pow2_comp(s, d, n, k, rev, rev1, tab, x);
+         break;
+
+      case PGFFT_STRATEGY_BLUE:
+         bluestein_comp(s, d, n, k, powers, Rb, tab, x);
+         break;
+
+      case PGFFT_STRATEGY_TBLUE:
+         bluestein_comp1(s, d, n, k, powers, Rb, tab, x);
+         break;
+
+      default: ;
+
+      }
    }
 }
 
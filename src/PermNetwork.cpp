@@ -10,10 +10,13 @@
  * limitations under the License. See accompanying LICENSE file.
  */
 #include <NTL/ZZ.h>
+#include <NTL/BasicThreadPool.h>
 #include <helib/Context.h>
 #include <helib/Ctxt.h>
 #include <helib/permutations.h>
 #include <helib/EncryptedArray.h>
+#include <helib/HoistedCtxt.h>
+#include <helib/timing.h>
 
 namespace helib {
 
@@ -258,4 +261,90 @@ void PermNetwork::applyToCtxt(Ctxt& c, const EncryptedArray& ea) const
   }
 }
 
+PermNetworkExec::PermNetworkExec(const PermNetwork& net,
+                                 const EncryptedArray& ea) :
+    context(ea.getContext())
+{
+  HELIB_TIMER_START;
+  assertFalse<LogicError>(ea.isCKKS(),
+                          "PermNetworkExec: CKKS is not supported");
+  const PAlgebra& al = ea.getPAlgebra();
+
+  for (long i = 0; i < net.depth(); i++) {
+    const PermNetLayer& lyr = net.getLayer(i);
+    if (lyr.isIdentity())
+      continue; // this layer is the identity permutation
+
+    // This layer is shifted via powers of g^e mod m
+    long g2e =
+        NTL::PowerMod(al.ZmStarGen(lyr.getGenIdx()), lyr.getE(), al.getM());
+
+    // The same masks as applyToCtxt, in the same order
+    NTL::Vec<long> unused = lyr.getShifts();
+    std::vector<bool> mask(unused.length());
+    std::vector<std::vector<long>> masks;
+    Layer layer;
+    long shamt = 0;
+    while (true) {
+      std::pair<long, bool> ret = makeMask(mask, unused, shamt);
+      if (ret.second) { // non-empty mask
+        masks.emplace_back(mask.begin(), mask.end());
+        layer.automorphs.push_back(NTL::PowerMod(g2e, shamt, al.getM()));
+      }
+      if (ret.first >= 0)
+        shamt = unused[ret.first]; // next shift amount to use
+      else
+        break; // unused is all-zero, done with this layer
+    }
+
+    // Encode the masks, rotated by their shifts
+    long n = masks.size();
+    layer.masks.multiplier.resize(n);
+    NTL_EXEC_RANGE(n, first, last)
+    for (long j = first; j < last; j++) {
+      zzX maskPoly;
+      ea.encode(maskPoly, masks[j]);
+      layer.masks.multiplier[j] =
+          build_ConstMultiplier(maskPoly, layer.automorphs[j], context);
+    }
+    NTL_EXEC_RANGE_END
+    layers.push_back(std::move(layer));
+  }
+}
+
+void PermNetworkExec::apply(Ctxt& c) const
+{
+  HELIB_TIMER_START;
+  assertEq(&c.getContext(),
+           &context,
+           "PermNetworkExec: ciphertext of another context");
+
+  for (const Layer& layer : layers) {
+    // Rotate c by the shifts of the layer from a single decomposition, and
+    // multiply each rotation by its (rotated) mask. Unlike applyToCtxt, the
+    // mask multiplies the key-switching noise too, see permutations.h
+    HoistedCtxt hoisted(c);
+
+    long n = layer.automorphs.size();
+    NTL::PartitionInfo pinfo(n);
+    long cnt = pinfo.NumIntervals();
+    std::vector<Ctxt> acc(cnt, Ctxt(ZeroCtxtLike, c));
+
+    NTL_EXEC_INDEX(cnt, index)
+    long first, last;
+    pinfo.interval(first, last, index);
+    for (long j = first; j < last; j++) {
+      Ctxt rotated(ZeroCtxtLike, c);
+      hoisted.automorph(rotated, layer.automorphs[j]);
+      rotated.cleanUp();
+      DestMulAdd(acc[index], layer.masks.multiplier[j], rotated);
+    }
+    NTL_EXEC_INDEX_END
+
+    c = std::move(acc[0]);
+    for (long i = 1; i < cnt; i++)
+      c += acc[i];
+  }
+}
+
 } // namespace helib
@@ -31,22 +31,116 @@ std::complex<double> Ptxt<CKKS>::convertToSlot(const Context&, long slot)
   return {static_cast<double>(slot), 0};
 }
 
+template <>
+bool Ptxt<BGV>::flatEligible() const
+{
+  return context->getOrdP() == 1;
+}
+
+template <>
+bool Ptxt<CKKS>::flatEligible() const
+{
+  return false;
+}
+
+template <typename Scheme>
+void Ptxt<Scheme>::expandSlots()
+{
+  if (slotsValid)
+    return;
+  slots.clear();
+  slots.reserve(flat.size());
+  for (long x : flat)
+    slots.push_back(Ptxt<Scheme>::convertToSlot(*context, x));
+  slotsValid = true;
+}
+
+template <typename Scheme>
+std::vector<typename Ptxt<Scheme>::SlotType>& Ptxt<Scheme>::slotData()
+{
+  expandSlots();
+  flat.clear();
+  flatValid = false;
+  return slots;
+}
+
+template <typename Scheme>
+const std::vector<long>& Ptxt<Scheme>::flatView(std::vector<long>& tmp) const
+{
+  if (flatValid)
+    return flat;
+  if constexpr (std::is_same_v<Scheme, BGV>) {
+    tmp.resize(slots.size());
+    for (std::size_t i = 0; i < slots.size(); ++i)
+      tmp[i] = static_cast<long>(slots[i]);
+  } else {
+    throw LogicError("No dense representation of CKKS slots");
+  }
+  return tmp;
+}
+
+template <typename Scheme>
+std::vector<long>& Ptxt<Scheme>::flatData()
+{
+  if (!flatValid) {
+    flatView(flat);
+    flatValid = true;
+  }
+  slots.clear();
+  slotsValid = false;
+  return flat;
+}
+
+template <typename Scheme>
+void Ptxt<Scheme>::setFlat(std::vector<long>&& values)
+{
+  flat = std::move(values);
+  flatValid = true;
+  slots.clear();
+  slotsValid = false;
+}
+
+template <typename Scheme>
+void Ptxt<Scheme>::flatMulBy(long scalar)
+{
+  long p2r = context->getSlotRing()->p2r;
+  long c = mcMod(scalar, p2r);
+  NTL::mulmod_precon_t cinv = NTL::PrepMulModPrecon(c, p2r);
+  for (long& x : flatData())
+    x = NTL::MulModPrecon(x, c, p2r, cinv);
+}
+
+template <typename Scheme>
+void Ptxt<Scheme>::flatAdd(long scalar)
+{
+  long p2r = context->getSlotRing()->p2r;
+  long c = mcMod(scalar, p2r);
+  for (long& x : flatData())
+    x = NTL::AddMod(x, c, p2r);
+}
+
+template <typename Scheme>
+void Ptxt<Scheme>::flatSub(long scalar)
+{
+  long p2r = context->getSlotRing()->p2r;
+  long c = mcMod(scalar, p2r);
+  for (long& x : flatData())
+    x = NTL::SubMod(x, c, p2r);
+}
+
 template <typename Scheme>
 Ptxt<Scheme>::Ptxt() : context(nullptr)
 {}
 
 template <typename Scheme>
-Ptxt<Scheme>::Ptxt(const Context& context) :
-    context(&context),
-    slots(context.getEA().size(),
-          SlotType{Ptxt<Scheme>::convertToSlot(*(this->context), 0L)})
-{}
+Ptxt<Scheme>::Ptxt(const Context& context) : context(&context)
+{
+  clear();
+}
 
 template <typename Scheme>
 Ptxt<Scheme>::Ptxt(const Context& context, const SlotType& value) :
-    context(std::addressof(context)),
-    slots(context.getEA().size(),
-          SlotType{Ptxt<Scheme>::convertToSlot(*(this->context), 0L)})
+    context(std::addressof(context))
 {
   setData(value);
 }
@@ -65,18 +159,14 @@ void Ptxt<BGV>::setData(const NTL::ZZX& value)
 template <>
 template <>
 Ptxt<BGV>::Ptxt(const Context& context, const NTL::ZZX& value) :
-    context(&context),
-    slots(context.getEA().size(),
-          SlotType{Ptxt<BGV>::convertToSlot(*(this->context), 0L)})
+    context(&context)
 {
   setData(value);
 }
 
 template <typename Scheme>
 Ptxt<Scheme>::Ptxt(const Context& context, const std::vector<SlotType>& data) :
-    context(std::addressof(context)),
-    slots(context.getEA().size(),
-          SlotType{Ptxt<Scheme>::convertToSlot(*(this->context), 0L)})
+    context(std::addressof(context))
 {
   setData(data);
 }
@@ -92,7 +182,7 @@ size_t Ptxt<Scheme>::size() const
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call size on default-constructed Ptxt");
-  return this->slots.size();
+  return flatValid ? flat.size() : slots.size();
 }
 
 template <typename Scheme>
@@ -114,10 +204,21 @@ void Ptxt<Scheme>::setData(const std::vector<SlotType>& data)
   // Need to verify that they all match
   assertSlotsCompatible(data);
 
-  slots = data;
-  if (helib::lsize(slots) < context->getEA().size()) {
-    slots.resize(context->getEA().size(),
-                 SlotType{Ptxt<Scheme>::convertToSlot(*(this->context), 0L)});
+  if constexpr (std::is_same_v<Scheme, BGV>) {
+    if (flatEligible()) {
+      std::vector<long> values(context->getEA().size(), 0);
+      for (std::size_t i = 0; i < data.size(); ++i)
+        values[i] = static_cast<long>(data[i]);
+      setFlat(std::move(values));
+      return;
+    }
+  }
+
+  std::vector<SlotType>& values = slotData();
+  values = data;
+  if (helib::lsize(values) < context->getEA().size()) {
+    values.resize(context->getEA().size(),
+                  SlotType{Ptxt<Scheme>::convertToSlot(*(this->context), 0L)});
   }
 }
 
@@ -149,9 +250,14 @@ void Ptxt<BGV>::decodeSetData(const NTL::ZZX& data)
 template <typename Scheme>
 void Ptxt<Scheme>::clear()
 {
-  for (auto& slot : this->slots) {
-    slot = 0;
+  if (!isValid())
+    return;
+  if (flatEligible()) {
+    setFlat(std::vector<long>(context->getEA().size(), 0));
+    return;
   }
+  slotData().assign(context->getEA().size(),
+                    Ptxt<Scheme>::convertToSlot(*context, 0l));
 }
 
 template <typename Scheme>
@@ -181,21 +287,43 @@ CKKS::SlotType randomSlot<CKKS>(UNUSED const Context& context)
 template <typename Scheme>
 Ptxt<Scheme>& Ptxt<Scheme>::random()
 {
-  for (auto& slot : slots)
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    NTL::VectorRandomBnd(values.size(),
+                         values.data(),
+                         context->getSlotRing()->p2r);
+    return *this;
+  }
+  for (auto& slot : slotData())
     slot = randomSlot<Scheme>(*context);
   return *this;
 }
 
 template <typename Scheme>
 const std::vector<typename Ptxt<Scheme>::SlotType>& Ptxt<Scheme>::getSlotRepr()
-    const
 {
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot call getSlotRepr on default-constructed Ptxt");
+  expandSlots();
   return slots;
 }
 
+template <typename Scheme>
+std::vector<typename Ptxt<Scheme>::SlotType> Ptxt<Scheme>::getSlotRepr() const
+{
+  assertTrue<RuntimeError>(
+      isValid(),
+      "Cannot call getSlotRepr on default-constructed Ptxt");
+  if (slotsValid)
+    return slots;
+  std::vector<SlotType> result;
+  result.reserve(flat.size());
+  for (long x : flat)
+    result.push_back(Ptxt<Scheme>::convertToSlot(*context, x));
+  return result;
+}
+
 /**
  * @brief BGV specialisation of the `getPolyRepr` function.
  * @return Single encoded polynomial.
@@ -210,7 +338,7 @@ NTL::ZZX Ptxt<BGV>::getPolyRepr() const
   NTL::ZZX repr;
   std::vector<NTL::ZZX> slots_data(context->getEA().size());
   for (std::size_t i = 0; i < slots_data.size(); ++i) {
-    slots_data[i] = slots[i].getData();
+    slots_data[i] = flatValid ? NTL::ZZX(flat[i]) : slots[i].getData();
   }
   context->getEA().encode(repr, slots_data);
   return repr;
@@ -227,7 +355,7 @@ void Ptxt<BGV>::encode(EncodedPtxt& eptxt, double mag, OptLong prec) const
 
   std::vector<NTL::ZZX> slots_data(context->getEA().size());
   for (std::size_t i = 0; i < slots_data.size(); ++i) {
-    slots_data[i] = slots[i].getData();
+    slots_data[i] = flatValid ? NTL::ZZX(flat[i]) : slots[i].getData();
   }
 
   context->getEA().encode(eptxt, slots_data);
@@ -252,7 +380,7 @@ typename Ptxt<Scheme>::SlotType& Ptxt<Scheme>::operator[](long i)
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot access elements of default-constructed Ptxt");
-  return this->slots[i];
+  return slotData()[i];
 }
 
 template <typename Scheme>
@@ -261,6 +389,8 @@ typename Ptxt<Scheme>::SlotType Ptxt<Scheme>::operator[](long i) const
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot access elements of default-constructed Ptxt");
+  if (flatValid)
+    return Ptxt<Scheme>::convertToSlot(*context, flat[i]);
   return this->slots[i];
 }
 
@@ -281,8 +411,17 @@ typename Ptxt<Scheme>::SlotType Ptxt<Scheme>::at(long i) const
 template <typename Scheme>
 bool Ptxt<Scheme>::operator==(const Ptxt<Scheme>& other) const
 {
-  return (!isValid() && !other.isValid()) ||
-         (this->slots == other.slots && *(this->context) == *(other.context));
+  if (!isValid() || !other.isValid())
+    return !isValid() && !other.isValid();
+  if (flatValid || other.flatValid) {
+    // Both are BGV with d = 1 when the contexts match
+    if (!other.flatEligible())
+      return false;
+    std::vector<long> tmp, other_tmp;
+    return flatView(tmp) == other.flatView(other_tmp) &&
+           *(this->context) == *(other.context);
+  }
+  return this->slots == other.slots && *(this->context) == *(other.context);
 }
 
 template <typename Scheme>
@@ -355,8 +494,19 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator*=(const Ptxt<Scheme>& otherPtxt)
   assertEq<LogicError>(*context,
                        *(otherPtxt.context),
                        "Ptxts must have matching contexts");
-  for (unsigned i = 0; i < this->slots.size(); i++) {
-    this->slots[i] *= otherPtxt.slots[i];
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    std::vector<long> tmp;
+    const std::vector<long>& other = otherPtxt.flatView(tmp);
+    long p2r = context->getSlotRing()->p2r;
+    NTL::mulmod_t pinv = NTL::PrepMulMod(p2r);
+    for (std::size_t i = 0; i < values.size(); i++)
+      values[i] = NTL::MulMod(values[i], other[i], p2r, pinv);
+    return *this;
+  }
+  std::vector<SlotType>& values = slotData();
+  for (std::size_t i = 0; i < values.size(); i++) {
+    values[i] *= otherPtxt.slots[i];
   }
   return *this;
 }
@@ -367,7 +517,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator*=(const SlotType& scalar)
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot call operator*= on default-constructed Ptxt");
-  for (auto& x : this->slots)
+  if constexpr (std::is_same_v<Scheme, BGV>) {
+    if (flatEligible()) {
+      assertSlotsCompatible({scalar});
+      flatMulBy(static_cast<long>(scalar));
+      return *this;
+    }
+  }
+  for (auto& x : slotData())
     x *= scalar;
   return *this;
 }
@@ -385,8 +542,18 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator+=(const Ptxt<Scheme>& otherPtxt)
   assertEq<LogicError>(*context,
                        *(otherPtxt.context),
                        "Ptxts must have matching contexts");
-  for (unsigned i = 0; i < this->slots.size(); i++) {
-    this->slots[i] += otherPtxt.slots[i];
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    std::vector<long> tmp;
+    const std::vector<long>& other = otherPtxt.flatView(tmp);
+    long p2r = context->getSlotRing()->p2r;
+    for (std::size_t i = 0; i < values.size(); i++)
+      values[i] = NTL::AddMod(values[i], other[i], p2r);
+    return *this;
+  }
+  std::vector<SlotType>& values = slotData();
+  for (std::size_t i = 0; i < values.size(); i++) {
+    values[i] += otherPtxt.slots[i];
   }
   return *this;
 }
@@ -397,7 +564,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator+=(const SlotType& scalar)
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot call operator+= on default-constructed Ptxt");
-  for (auto& x : this->slots)
+  if constexpr (std::is_same_v<Scheme, BGV>) {
+    if (flatEligible()) {
+      assertSlotsCompatible({scalar});
+      flatAdd(static_cast<long>(scalar));
+      return *this;
+    }
+  }
+  for (auto& x : slotData())
     x += scalar;
   return *this;
 }
@@ -415,8 +589,18 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator-=(const Ptxt<Scheme>& otherPtxt)
   assertEq<LogicError>(*context,
                        *(otherPtxt.context),
                        "Ptxts must have matching contexts");
-  for (unsigned i = 0; i < this->slots.size(); i++) {
-    this->slots[i] -= otherPtxt.slots[i];
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    std::vector<long> tmp;
+    const std::vector<long>& other = otherPtxt.flatView(tmp);
+    long p2r = context->getSlotRing()->p2r;
+    for (std::size_t i = 0; i < values.size(); i++)
+      values[i] = NTL::SubMod(values[i], other[i], p2r);
+    return *this;
+  }
+  std::vector<SlotType>& values = slotData();
+  for (std::size_t i = 0; i < values.size(); i++) {
+    values[i] -= otherPtxt.slots[i];
   }
   return *this;
 }
@@ -427,7 +611,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::operator-=(const SlotType& scalar)
   assertTrue<RuntimeError>(
       isValid(),
       "Cannot call operator-= on default-constructed Ptxt");
-  for (auto& x : this->slots)
+  if constexpr (std::is_same_v<Scheme, BGV>) {
+    if (flatEligible()) {
+      assertSlotsCompatible({scalar});
+      flatSub(static_cast<long>(scalar));
+      return *this;
+    }
+  }
+  for (auto& x : slotData())
     x -= scalar;
   return *this;
 }
@@ -437,7 +628,13 @@ Ptxt<Scheme>& Ptxt<Scheme>::negate()
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call negate on default-constructed Ptxt");
-  for (auto& slot : slots) {
+  if (flatEligible()) {
+    long p2r = context->getSlotRing()->p2r;
+    for (long& x : flatData())
+      x = NTL::NegateMod(x, p2r);
+    return *this;
+  }
+  for (auto& slot : slotData()) {
     slot = -slot;
   }
   return *this;
@@ -490,8 +687,24 @@ Ptxt<Scheme>& Ptxt<Scheme>::multiplyBy2(const Ptxt& otherPtxt1,
                          otherPtxt2.size(),
                          "Cannot multiply by plaintext of different size - "
                          "second argument has wrong size");
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    std::vector<long> tmp1, tmp2;
+    const std::vector<long>& other1 = otherPtxt1.flatView(tmp1);
+    const std::vector<long>& other2 = otherPtxt2.flatView(tmp2);
+    long p2r = context->getSlotRing()->p2r;
+    NTL::mulmod_t pinv = NTL::PrepMulMod(p2r);
+    for (std::size_t i = 0; i < values.size(); ++i)
+      values[i] = NTL::MulMod(values[i],
+                              NTL::MulMod(other1[i], other2[i], p2r, pinv),
+                              p2r,
+                              pinv);
+    return *this;
+  }
+
+  std::vector<SlotType>& values = slotData();
   for (std::size_t i = 0; i < size(); ++i)
-    slots[i] *= otherPtxt1.slots[i] * otherPtxt2.slots[i];
+    values[i] *= otherPtxt1.slots[i] * otherPtxt2.slots[i];
 
   return *this;
 }
@@ -520,8 +733,13 @@ Ptxt<Scheme>& Ptxt<Scheme>::power(long e)
   if (e < 1) {
     throw InvalidArgument("Cannot raise a Ptxt to a non positive "
                           "exponent");
+  } else if (e > 1 && flatEligible()) {
+    long p2r = context->getSlotRing()->p2r;
+    for (long& x : flatData())
+      x = NTL::PowerMod(x, e, p2r);
   } else if (e > 1) {
     // exponentiation through squaring.
+    std::vector<SlotType>& slots = slotData();
     std::vector<SlotType> multiplier(slots);
     std::vector<SlotType> result(
         multiplier.size(),
@@ -547,6 +765,12 @@ Ptxt<Scheme>& Ptxt<Scheme>::rotate(long amount)
   amount = mcMod(amount, size());
   if (amount == 0)
     return *this;
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    std::rotate(values.begin(), values.end() - amount, values.end());
+    return *this;
+  }
+  std::vector<SlotType>& slots = slotData();
   std::vector<SlotType> rotated_slots(size());
   for (long i = 0; i < lsize(); ++i) {
     rotated_slots[i] = slots[mcMod(i - amount, size())];
@@ -560,7 +784,7 @@ Ptxt<Scheme>& Ptxt<Scheme>::rotate1D(long dim, long amount)
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call rotate1D on default-constructed Ptxt");
-  if (slots.size() == 1)
+  if (size() == 1)
     return *this; // Nothing to do (only one slot)
   const PAlgebra& zMStar = context->getZMStar();
   long num_gens = zMStar.numOfGens();
@@ -569,13 +793,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::rotate1D(long dim, long amount)
                             num_gens,
                             "Dimension must be between 0 and "
                             "number of generators");
-  // Copying in slots to avoid default PolyMod issues.
-  std::vector<SlotType> new_slots(slots);
   long ord = context->getEA().sizeOfDimension(dim);
   amount = mcMod(amount, ord); // Make amount smallest positive integer < ord
   if (amount == 0)
     return *this; // Nothing to do
 
+  // new_index[index] is the slot where slot index moves to
+  std::vector<long> new_index(lsize());
+
   // This for loop iterates over the slots of a flat array structure and
   // converts the index of each slot to its equivalent coordinate
   // representation with respect to the generators of the quotient group
@@ -590,10 +815,23 @@ Ptxt<Scheme>& Ptxt<Scheme>::rotate1D(long dim, long amount)
     // and reduces it modulo the order of the dimension.
     coord[dim] = mcMod(amount + coord[dim], ord);
     // Convert the new coordinates post rotation into the correct index.
-    long new_index = coordToIndex(coord);
-    // Set the new index of the current slot.
-    new_slots[new_index] = slots[index];
+    new_index[index] = coordToIndex(coord);
   }
+
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    std::vector<long> new_values(values.size());
+    for (long index = 0; index < lsize(); ++index)
+      new_values[new_index[index]] = values[index];
+    values = std::move(new_values);
+    return *this;
+  }
+
+  std::vector<SlotType>& slots = slotData();
+  // Copying in slots to avoid default PolyMod issues.
+  std::vector<SlotType> new_slots(slots);
+  for (long index = 0; index < lsize(); ++index)
+    new_slots[new_index[index]] = slots[index];
   slots = std::move(new_slots);
   return *this;
 }
@@ -611,6 +849,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::shift(long amount)
   }
 
   rotate(amount);
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    for (long i = 0; i < lsize(); ++i)
+      if ((i - amount) < 0 || (i - amount) >= lsize())
+        values[i] = 0;
+    return *this;
+  }
+  std::vector<SlotType>& slots = slotData();
   for (long i = 0; i < lsize(); ++i)
     if ((i - amount) < 0 || (i - amount) >= lsize())
       slots[i] = 0;
@@ -625,7 +871,7 @@ Ptxt<Scheme>& Ptxt<Scheme>::shift1D(long dim, long amount)
                            "Cannot call shift1D on default-constructed Ptxt");
   if (amount == 0)
     return *this;
-  if (slots.size() == 1 ||
+  if (size() == 1 ||
       std::abs(amount) >= context->getEA().sizeOfDimension(dim)) {
     clear();
     return *this;
@@ -638,10 +884,11 @@ Ptxt<Scheme>& Ptxt<Scheme>::shift1D(long dim, long amount)
                             num_gens,
                             "Dimension must be between 0 and "
                             "number of generators");
-  // Copying in slots to avoid default PolyMod issues.
-  std::vector<SlotType> new_slots(slots);
   long ord = context->getEA().sizeOfDimension(dim);
 
+  // old_index[new_index] is the slot that moves to new_index, -1 for a 0
+  std::vector<long> old_index(lsize());
+
   // This for loop performs similar logic in rotate1D to obtain the new index
   // post shift via the conversion to and from the corresponding coordinate
   // representation.
@@ -656,12 +903,31 @@ Ptxt<Scheme>& Ptxt<Scheme>::shift1D(long dim, long amount)
     // If the coordinate exceeds the bounds of the order of the generator then
     // set the new slot to 0.
     if (coord[dim] < 0 || coord[dim] >= ord) {
-      new_slots[new_index] = 0;
+      old_index[new_index] = -1;
     } else { // Otherwise set the old index to the value of the new index.
-      long old_index = coordToIndex(coord);
-      new_slots[new_index] = slots[old_index];
+      old_index[new_index] = coordToIndex(coord);
     }
   }
+
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    std::vector<long> new_values(values.size());
+    for (long new_index = 0; new_index < lsize(); ++new_index)
+      if (old_index[new_index] >= 0)
+        new_values[new_index] = values[old_index[new_index]];
+    values = std::move(new_values);
+    return *this;
+  }
+
+  std::vector<SlotType>& slots = slotData();
+  // Copying in slots to avoid default PolyMod issues.
+  std::vector<SlotType> new_slots(slots);
+  for (long new_index = 0; new_index < lsize(); ++new_index) {
+    if (old_index[new_index] < 0)
+      new_slots[new_index] = 0;
+    else
+      new_slots[new_index] = slots[old_index[new_index]];
+  }
   slots = std::move(new_slots);
   return *this;
 }
@@ -673,6 +939,20 @@ Ptxt<BGV>& Ptxt<BGV>::automorph(long k)
                            "Cannot call automorph on default-constructed Ptxt");
   assertTrue<RuntimeError>(context->getZMStar().inZmStar(k),
                            "k must be an element in Zm*");
+  if (flatEligible()) {
+    // With d = 1 every element of Zm* represents a slot, and X -> X^k moves
+    // the slot of t to the slot of k*t (as rotate1D does for k = g^e)
+    const PAlgebra& zMStar = context->getZMStar();
+    long m = zMStar.getM();
+    k = mcMod(k, m);
+    std::vector<long>& values = flatData();
+    std::vector<long> new_values(values.size());
+    for (long i = 0; i < lsize(); ++i)
+      new_values[zMStar.indexOfRep(NTL::MulMod(k, zMStar.ith_rep(i), m))] =
+          values[i];
+    values = std::move(new_values);
+    return *this;
+  }
   NTL::ZZX poly;
   switch (context->getEA().getTag()) {
   case PA_GF2_tag: {
@@ -720,6 +1000,12 @@ Ptxt<Scheme>& Ptxt<Scheme>::replicate(long pos)
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call replicate on default-constructed Ptxt");
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    values.assign(values.size(), long(values[pos]));
+    return *this;
+  }
+  std::vector<SlotType>& slots = slotData();
   for (auto& slot : slots)
     slot = slots[pos];
   return *this;
@@ -780,6 +1066,14 @@ Ptxt<Scheme>& Ptxt<Scheme>::runningSums()
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call runningSums on "
                            "default-constructed Ptxt");
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    long p2r = context->getSlotRing()->p2r;
+    for (std::size_t i = 1; i < values.size(); ++i)
+      values[i] = NTL::AddMod(values[i], values[i - 1], p2r);
+    return *this;
+  }
+  std::vector<SlotType>& slots = slotData();
   for (std::size_t i = 1; i < size(); ++i)
     slots[i] += slots[i - 1];
   return *this;
@@ -791,6 +1085,16 @@ Ptxt<Scheme>& Ptxt<Scheme>::totalSums()
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call totalSums on "
                            "default-constructed Ptxt");
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    long p2r = context->getSlotRing()->p2r;
+    long sum = 0;
+    for (long x : values)
+      sum = NTL::AddMod(sum, x, p2r);
+    values.assign(values.size(), sum);
+    return *this;
+  }
+  const std::vector<SlotType>& slots = slotData();
   SlotType sum = slots[0];
   for (std::size_t i = 1; i < size(); ++i)
     sum += slots[i];
@@ -804,6 +1108,15 @@ Ptxt<Scheme>& Ptxt<Scheme>::incrementalProduct()
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call incrementalProduct on "
                            "default-constructed Ptxt");
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    long p2r = context->getSlotRing()->p2r;
+    NTL::mulmod_t pinv = NTL::PrepMulMod(p2r);
+    for (std::size_t i = 1; i < values.size(); ++i)
+      values[i] = NTL::MulMod(values[i], values[i - 1], p2r, pinv);
+    return *this;
+  }
+  std::vector<SlotType>& slots = slotData();
   for (std::size_t i = 1; i < size(); ++i)
     slots[i] *= slots[i - 1];
   return *this;
@@ -815,6 +1128,17 @@ Ptxt<Scheme>& Ptxt<Scheme>::totalProduct()
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call totalProduct on "
                            "default-constructed Ptxt");
+  if (flatEligible()) {
+    std::vector<long>& values = flatData();
+    long p2r = context->getSlotRing()->p2r;
+    NTL::mulmod_t pinv = NTL::PrepMulMod(p2r);
+    long product = values[0];
+    for (std::size_t i = 1; i < values.size(); ++i)
+      product = NTL::MulMod(product, values[i], p2r, pinv);
+    values.assign(values.size(), product);
+    return *this;
+  }
+  const std::vector<SlotType>& slots = slotData();
   SlotType product = slots[0];
   for (std::size_t i = 1; i < size(); ++i)
     product *= slots[i];
@@ -827,7 +1151,12 @@ Ptxt<Scheme>& Ptxt<Scheme>::mapTo01()
 {
   assertTrue<RuntimeError>(isValid(),
                            "Cannot call mapTo01 on default-constructed Ptxt");
-  for (auto& slot : slots)
+  if (flatEligible()) {
+    for (long& x : flatData())
+      x = (x != 0);
+    return *this;
+  }
+  for (auto& slot : slotData())
     if (slot != Ptxt<Scheme>::convertToSlot(*context, 0l))
       slot = 1;
   return *this;
@@ -963,6 +1292,13 @@ JsonWrapper Ptxt<Scheme>::writeToJSON() const
 
     if constexpr (std::is_same_v<Scheme, CKKS>) {
       jslots = slots;
+    } else if (flatValid) {
+      // The same as the PolyMod serialization, a constant polynomial
+      std::vector<json> js;
+      js.reserve(flat.size());
+      for (long x : flat)
+        js.emplace_back(NTL::ZZX(x));
+      jslots = js;
     } else {
       jslots = writeVectorToJSON(slots);
     }
@@ -1047,6 +1383,22 @@ void Ptxt<Scheme>::readJSON(const JsonWrapper& tjw)
     if constexpr (std::is_same_v<Scheme, CKKS>) {
       // Scheme is CKKS
       this->setData(jslots.get<std::vector<std::complex<double>>>());
+    } else if (this->flatEligible()) {
+      // Scheme is BGV with d = 1, read the constant polynomials directly
+      long p2r = context->getSlotRing()->p2r;
+      std::vector<long> values(this->context->getEA().size(), 0);
+      for (std::size_t i = 0; i < jslots.size(); ++i) {
+        NTL::ZZX poly = jslots[i];
+        if (NTL::deg(poly) >= 1) {
+          std::stringstream err_msg;
+          err_msg << "Cannot deserialize to PolyMod: Degree is too small.  "
+                  << "Trying to deserialize " << NTL::deg(poly) + 1
+                  << " coefficients.  Slot modulus degree is 1.";
+          throw IOError(err_msg.str());
+        }
+        values[i] = NTL::rem(NTL::ConstTerm(poly), p2r);
+      }
+      this->setFlat(std::move(values));
     } else {
       // Scheme is BGV
       this->setData(
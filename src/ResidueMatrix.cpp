@@ -0,0 +1,258 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+/* ResidueMatrix.cpp - contiguous, cache-aligned storage for DoubleCRT rows
+ */
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <helib/ResidueMatrix.h>
+#include <helib/ResiduePool.h>
+
+namespace helib {
+
+static_assert(ResiduePool::ALIGNMENT % ResidueMatrix::ALIGNMENT == 0,
+              "ResiduePool buffers must be aligned as ResidueMatrix rows");
+
+// The buffers are drawn from (and returned to) the per-thread ResiduePool
+static inline std::size_t rowBytes(long rows, long stride)
+{
+  return std::size_t(rows) * std::size_t(stride) * sizeof(long);
+}
+
+static long* allocateRows(long rows, long stride)
+{
+  return static_cast<long*>(ResiduePool::allocate(rowBytes(rows, stride)));
+}
+
+static void deallocateRows(long* p, long rows, long stride)
+{
+  ResiduePool::deallocate(p, rowBytes(rows, stride));
+}
+
+ResidueMatrix::ResidueMatrix(long rowLength) : rowLen(rowLength)
+{
+  assertTrue(rowLength >= 0, "Row length must be non-negative");
+  // round the row length up so that every row starts on an aligned address
+  constexpr long perLine = ALIGNMENT / sizeof(long);
+  stride = ((rowLen + perLine - 1) / perLine) * perLine;
+}
+
+ResidueMatrix::ResidueMatrix(const ResidueMatrix& other) :
+    rowLen(other.rowLen), stride(other.stride)
+{
+  copyFrom(other);
+}
+
+ResidueMatrix::ResidueMatrix(ResidueMatrix&& other) noexcept :
+    rowLen(other.rowLen),
+    stride(other.stride),
+    rowCap(other.rowCap),
+    data(other.data),
+    owner(std::move(other.owner)),
+    indexSet(std::move(other.indexSet)),
+    rowOf(std::move(other.rowOf)),
+    freeRows(std::move(other.freeRows))
+{
+  other.rowCap = 0;
+  other.data = nullptr;
+  other.indexSet.clear();
+  other.rowOf.clear();
+  other.freeRows.clear();
+}
+
+ResidueMatrix& ResidueMatrix::operator=(const ResidueMatrix& other)
+{
+  if (this == &other)
+    return *this;
+
+  if (rowLen != other.rowLen) {
+    release();
+    rowLen = other.rowLen;
+    stride = other.stride;
+  }
+  copyFrom(other);
+  return *this;
+}
+
+ResidueMatrix& ResidueMatrix::operator=(ResidueMatrix&& other) noexcept
+{
+  if (this == &other)
+    return *this;
+
+  freeData();
+  rowLen = other.rowLen;
+  stride = other.stride;
+  rowCap = other.rowCap;
+  data = other.data;
+  owner = std::move(other.owner);
+  indexSet = std::move(other.indexSet);
+  rowOf = std::move(other.rowOf);
+  freeRows = std::move(other.freeRows);
+
+  other.rowCap = 0;
+  other.data = nullptr;
+  other.indexSet.clear();
+  other.rowOf.clear();
+  other.freeRows.clear();
+  return *this;
+}
+
+ResidueMatrix::~ResidueMatrix() { freeData(); }
+
+// Return the buffer to the pool, or just drop it if it is borrowed
+void ResidueMatrix::freeData()
+{
+  if (owner)
+    owner.reset();
+  else
+    deallocateRows(data, rowCap, stride);
+}
+
+// Copy the rows of other into *this, packing them into the first rows of the
+// buffer. The existing buffer is reused if it is large enough.
+void ResidueMatrix::copyFrom(const ResidueMatrix& other)
+{
+  long card = other.indexSet.card();
+  clear();
+  reserve(card);
+
+  indexSet = other.indexSet;
+  rowOf.assign(other.rowOf.size(), -1);
+  long r = 0;
+  for (long j : indexSet) {
+    rowOf[j] = r;
+    std::memcpy(data + r * stride, other[j], rowLen * sizeof(long));
+    r++;
+  }
+
+  freeRows.clear();
+  for (long k = rowCap - 1; k >= r; k--)
+    freeRows.push_back(k);
+}
+
+// Reallocate the buffer to hold `rows` rows, preserving the existing content
+void ResidueMatrix::grow(long rows)
+{
+  long* newData = allocateRows(rows, stride);
+  if (data) {
+    std::memcpy(newData, data, rowBytes(rowCap, stride));
+    freeData();
+  }
+  data = newData;
+  // freeRows is used as a stack, push so that lower rows are handed out first
+  for (long k = rows - 1; k >= rowCap; k--)
+    freeRows.push_back(k);
+  rowCap = rows;
+}
+
+void ResidueMatrix::reserve(long rows)
+{
+  if (rows > rowCap)
+    grow(rows);
+}
+
+void ResidueMatrix::insert(long j)
+{
+  if (indexSet.contains(j))
+    return;
+
+  if (freeRows.empty())
+    grow(std::max(2 * rowCap, 1L));
+
+  if (j >= long(rowOf.size()))
+    rowOf.resize(j + 1, -1);
+  rowOf[j] = freeRows.back();
+  freeRows.pop_back();
+  indexSet.insert(j);
+}
+
+void ResidueMatrix::insert(const IndexSet& s)
+{
+  // allocate once for all the new rows
+  long needed = indexSet.card() + (s / indexSet).card();
+  if (needed > rowCap)
+    grow(std::max(2 * rowCap, needed));
+
+  for (long j : s)
+    insert(j);
+}
+
+void ResidueMatrix::remove(long j)
+{
+  if (!indexSet.contains(j))
+    return;
+
+  freeRows.push_back(rowOf[j]);
+  rowOf[j] = -1;
+  indexSet.remove(j);
+}
+
+void ResidueMatrix::remove(const IndexSet& s)
+{
+  for (long j : s)
+    remove(j);
+}
+
+void ResidueMatrix::clear()
+{
+  indexSet.clear();
+  rowOf.clear();
+  freeRows.clear();
+  for (long k = rowCap - 1; k >= 0; k--)
+    freeRows.push_back(k);
+}
+
+void ResidueMatrix::release()
+{
+  freeData();
+  data = nullptr;
+  rowCap = 0;
+  indexSet.clear();
+  rowOf.clear();
+  freeRows.clear();
+}
+
+void ResidueMatrix::attach(const IndexSet& s,
+                           long* rows,
+                           std::shared_ptr<const void> rowsOwner)
+{
+  assertNotNull(rows, "Cannot attach to a null buffer");
+  assertEq(reinterpret_cast<std::uintptr_t>(rows) % ALIGNMENT,
+           std::uintptr_t(0),
+           "Attached rows must be aligned to ResidueMatrix::ALIGNMENT");
+
+  release();
+  data = rows;
+  owner = std::move(rowsOwner);
+  rowCap = s.card();
+  indexSet = s;
+  rowOf.assign(s.last() + 1, -1);
+  long r = 0;
+  for (long j : s)
+    rowOf[j] = r++;
+}
+
+bool operator==(const ResidueMatrix& a, const ResidueMatrix& b)
+{
+  if (a.getIndexSet() != b.getIndexSet() ||
+      a.getRowLength() != b.getRowLength())
+    return false;
+
+  std::size_t bytes = a.getRowLength() * sizeof(long);
+  for (long j : a.getIndexSet())
+    if (std::memcmp(a[j], b[j], bytes) != 0)
+      return false;
+  return true;
+}
+
+} // namespace helib
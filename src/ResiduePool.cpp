@@ -0,0 +1,141 @@
+/* Copyright (C) 2012-2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+/* ResiduePool.cpp - a per-thread pool of the buffers of ResidueMatrix
+ */
+#include <new>
+#include <unordered_map>
+#include <vector>
+
+#include <helib/ResiduePool.h>
+#include <helib/fhe_stats.h>
+#include <helib/multicore.h>
+
+namespace helib {
+
+// The default limit is 256MB for all the threads together, enough for a few
+// dozen ciphertexts with m around 2^15 and a full chain of primes
+static HELIB_atomic_ulong pool_limit(256UL << 20);
+
+// The total size of the buffers cached by all the threads
+static HELIB_atomic_ulong total_cached(0);
+
+namespace {
+
+struct ThreadPool
+{
+  std::unordered_map<std::size_t, std::vector<void*>> buffers;
+  ResiduePool::Counters counters;
+
+  ~ThreadPool();
+  void clear();
+};
+
+// Set when the thread-local pool has been destroyed, so that buffers released
+// afterwards (e.g., by other thread-local or static objects) are just freed.
+// This is a trivially destructible object, so it is valid throughout the
+// thread's lifetime.
+thread_local bool pool_destroyed = false;
+
+ThreadPool* getThreadPool()
+{
+  if (pool_destroyed)
+    return nullptr;
+  static thread_local ThreadPool pool;
+  return &pool;
+}
+
+void freeBuffer(void* p)
+{
+  ::operator delete(p, std::align_val_t(ResiduePool::ALIGNMENT));
+}
+
+void ThreadPool::clear()
+{
+  for (auto& entry : buffers)
+    for (void* p : entry.second)
+      freeBuffer(p);
+  buffers.clear();
+  total_cached -= counters.bytesCached;
+  counters.bytesCached = 0;
+}
+
+ThreadPool::~ThreadPool()
+{
+  clear();
+  pool_destroyed = true;
+}
+
+} // namespace
+
+void* ResiduePool::allocate(std::size_t bytes)
+{
+  if (bytes == 0)
+    return nullptr;
+
+  ThreadPool* pool = getThreadPool();
+  if (pool) {
+    auto it = pool->buffers.find(bytes);
+    if (it != pool->buffers.end() && !it->second.empty()) {
+      void* p = it->second.back();
+      it->second.pop_back();
+      pool->counters.hits++;
+      pool->counters.bytesCached -= bytes;
+      total_cached -= bytes;
+      HELIB_STATS_UPDATE("ResiduePool-hit-bytes", bytes);
+      return p;
+    }
+    pool->counters.allocations++;
+    pool->counters.bytesAllocated += bytes;
+  }
+
+  HELIB_STATS_UPDATE("ResiduePool-alloc-bytes", bytes);
+  return ::operator new(bytes, std::align_val_t(ALIGNMENT));
+}
+
+void ResiduePool::deallocate(void* p, std::size_t bytes)
+{
+  if (!p)
+    return;
+
+  ThreadPool* pool = getThreadPool();
+  if (pool) {
+    // Claim room in the global budget first, and give it back if there is
+    // none (two threads may then both free their buffer, which is harmless)
+    if ((total_cached += bytes) <= getLimit()) {
+      pool->buffers[bytes].push_back(p);
+      pool->counters.bytesCached += bytes;
+      return;
+    }
+    total_cached -= bytes;
+  }
+
+  freeBuffer(p);
+}
+
+void ResiduePool::setLimit(std::size_t bytes) { pool_limit = bytes; }
+
+std::size_t ResiduePool::getLimit() { return pool_limit; }
+
+void ResiduePool::clear()
+{
+  ThreadPool* pool = getThreadPool();
+  if (pool)
+    pool->clear();
+}
+
+ResiduePool::Counters ResiduePool::getCounters()
+{
+  ThreadPool* pool = getThreadPool();
+  return pool ? pool->counters : Counters();
+}
+
+} // namespace helib
@@ -104,21 +104,7 @@ void write_ntl_vec_long(std::ostream& str,
                         const NTL::vec_long& vl,
                         long intSize)
 {
-  assertTrue<InvalidArgument>(intSize == Binio::BIT64 ||
-                                  intSize == Binio::BIT32,
-                              "intSize must be 32 or 64 bit for binary IO");
-  write_raw_int32(str, vl.length());
-  write_raw_int32(str, intSize);
-
-  if (intSize == Binio::BIT64) {
-    for (long i = 0; i < vl.length(); i++) {
-      write_raw_int(str, vl[i]);
-    }
-  } else {
-    for (long i = 0; i < vl.length(); i++) {
-      write_raw_int32(str, vl[i]);
-    }
-  }
+  write_raw_long_array(str, vl.elts(), vl.length(), intSize);
 }
 
 void read_ntl_vec_long(std::istream& str, NTL::vec_long& vl)
@@ -145,6 +131,48 @@ void read_ntl_vec_long(std::istream& str, NTL::vec_long& vl)
   }
 }
 
+void write_raw_long_array(std::ostream& str,
+                          const long* p,
+                          long n,
+                          long intSize)
+{
+  assertTrue<InvalidArgument>(intSize == Binio::BIT64 ||
+                                  intSize == Binio::BIT32,
+                              "intSize must be 32 or 64 bit for binary IO");
+  write_raw_int32(str, n);
+  write_raw_int32(str, intSize);
+
+  if (intSize == Binio::BIT64) {
+    for (long i = 0; i < n; i++) {
+      write_raw_int(str, p[i]);
+    }
+  } else {
+    for (long i = 0; i < n; i++) {
+      write_raw_int32(str, p[i]);
+    }
+  }
+}
+
+void read_raw_long_array(std::istream& str, long* p, long n)
+{
+  int sizeOfVL = read_raw_int32(str);
+  int intSize = read_raw_int32(str);
+  assertTrue<InvalidArgument>(intSize == Binio::BIT64 ||
+                                  intSize == Binio::BIT32,
+                              "intSize must be 32 or 64 bit for binary IO");
+  assertEq<IOError>(long(sizeOfVL), n, "Array length mismatch in stream");
+
+  if (intSize == Binio::BIT64) {
+    for (long i = 0; i < n; i++) {
+      p[i] = read_raw_int(str);
+    }
+  } else {
+    for (long i = 0; i < n; i++) {
+      p[i] = read_raw_int32(str);
+    }
+  }
+}
+
 void write_raw_double(std::ostream& str, const double d)
 {
   // FIXME: this is not portable:
@@ -202,6 +230,36 @@ void read_raw_ZZ(std::istream& str, NTL::ZZ& zz)
   delete[] zzBytes;
 }
 
+void write_raw_ZZX(std::ostream& str, const NTL::ZZX& poly)
+{
+  write_raw_int(str, poly.rep.length());
+  for (long i = 0; i < poly.rep.length(); i++) {
+    long sign = NTL::sign(poly.rep[i]);
+    write_raw_int(str, sign);
+    if (sign != 0)
+      write_raw_ZZ(str, NTL::abs(poly.rep[i]));
+  }
+}
+
+void read_raw_ZZX(std::istream& str, NTL::ZZX& poly)
+{
+  long len = read_raw_int(str);
+  assertTrue<IOError>(len >= 0 && str.good(), "Bad polynomial length");
+  poly.rep.SetLength(len);
+  for (long i = 0; i < len; i++) {
+    long sign = read_raw_int(str);
+    assertInRange<IOError>(sign, -1l, 1l, "Bad coefficient sign", true);
+    if (sign == 0)
+      NTL::clear(poly.rep[i]);
+    else {
+      read_raw_ZZ(str, poly.rep[i]);
+      if (sign < 0)
+        NTL::negate(poly.rep[i], poly.rep[i]);
+    }
+  }
+  poly.normalize();
+}
+
 // FIXME: there is some repetitive code here.
 // We should think about a better overloading strategy for
 // read/write_raw_vector to avoid this.
@@ -22,6 +22,7 @@
 
 #include <NTL/xdouble.h>
 #include <NTL/vec_long.h>
+#include <NTL/ZZX.h>
 
 namespace helib {
 
@@ -43,12 +44,20 @@ struct EyeCatcher
   static constexpr std::array<char, SIZE> CONTEXT_END   = {']','C','N','|'};
   static constexpr std::array<char, SIZE> CTXT_BEGIN    = {'|','C','X','['};
   static constexpr std::array<char, SIZE> CTXT_END      = {']','C','X','|'};
+  static constexpr std::array<char, SIZE> CTXTZ_BEGIN   = {'|','C','Z','['};
+  static constexpr std::array<char, SIZE> CTXTZ_END     = {']','C','Z','|'};
   static constexpr std::array<char, SIZE> PK_BEGIN      = {'|','P','K','['};
   static constexpr std::array<char, SIZE> PK_END        = {']','P','K','|'};
   static constexpr std::array<char, SIZE> SK_BEGIN      = {'|','S','K','['};
   static constexpr std::array<char, SIZE> SK_END        = {']','S','K','|'};
   static constexpr std::array<char, SIZE> SKM_BEGIN     = {'|','K','M','['};
   static constexpr std::array<char, SIZE> SKM_END       = {']','K','M','|'};
+  // Key-switching matrices with per-column seeds (KeySwitch::SEED_DERIVATION)
+  static constexpr std::array<char, SIZE> SKM1_BEGIN    = {'|','K','1','['};
+  static constexpr std::array<char, SIZE> RCD_BEGIN     = {'|','R','D','['};
+  static constexpr std::array<char, SIZE> RCD_END       = {']','R','D','|'};
+  static constexpr std::array<char, SIZE> SNAP_BEGIN    = {'|','S','N','['};
+  static constexpr std::array<char, SIZE> SNAP_END      = {']','S','N','|'};
   // clang-format on
 };
 
@@ -63,6 +72,7 @@ class Context;
 class PubKey;
 class SecKey;
 class Ctxt;
+class RecryptData;
 
 template <>
 inline constexpr char nameToStructId<Context>()
@@ -84,6 +94,11 @@ inline constexpr char nameToStructId<Ctxt>()
 {
   return 20;
 }
+template <>
+inline constexpr char nameToStructId<RecryptData>()
+{
+  return 25;
+}
 
 // Already broken into bytes, thus should be the same written and read in bog
 // or little endian.
@@ -156,6 +171,14 @@ void write_ntl_vec_long(std::ostream& str,
                         long intSize = Binio::BIT64);
 void read_ntl_vec_long(std::istream& str, NTL::vec_long& vl);
 
+// Same format as write/read_ntl_vec_long, for n longs stored at p.
+// On input the length in the stream must be exactly n.
+void write_raw_long_array(std::ostream& str,
+                          const long* p,
+                          long n,
+                          long intSize = Binio::BIT64);
+void read_raw_long_array(std::istream& str, long* p, long n);
+
 long read_raw_int(std::istream& str);
 int read_raw_int32(std::istream& str);
 void write_raw_int(std::ostream& str, long num);
@@ -170,6 +193,11 @@ NTL::xdouble read_raw_xdouble(std::istream& str);
 void write_raw_ZZ(std::ostream& str, const NTL::ZZ& zz);
 void read_raw_ZZ(std::istream& str, NTL::ZZ& zz);
 
+// Unlike write_raw_ZZ, these keep the signs of the coefficients and allow
+// zero coefficients.
+void write_raw_ZZX(std::ostream& str, const NTL::ZZX& poly);
+void read_raw_ZZX(std::istream& str, NTL::ZZX& poly);
+
 template <typename T>
 void write_raw_vector(std::ostream& str, const std::vector<T>& v)
 {
@@ -75,6 +75,20 @@ unsigned long KeySwitch::NumCols() const { return b.size(); }
 
 bool KeySwitch::isDummy() const { return (toKeyID == -1); }
 
+void KeySwitch::randomizeA(DoubleCRT& a, long j) const
+{
+  // Every column has its own seed, so the columns can be generated in any
+  // order (and by different threads). The full set of primes must be used,
+  // else the rows would come out of a different part of the PRG stream.
+  assertEq(a.getIndexSet(),
+           a.getContext().fullPrimes(),
+           "a must be defined relative to all ctxt and special primes");
+
+  RandomState state; // backup the NTL PRG seed
+  NTL::ZZ seed = deriveSeed(prgSeed, j);
+  a.randomize(&seed);
+} // restore random state upon destruction of the RandomState, see NumbTh.h
+
 void KeySwitch::verify(SecKey& sk)
 {
   long fromSPower = fromKey.getPowerOfS();
@@ -129,14 +143,8 @@ void KeySwitch::verify(SecKey& sk)
   std::vector<DoubleCRT> a;
   a.resize(n, DoubleCRT(context, fullPrimes)); // defined modulo all primes
 
-  {
-    RandomState state;
-
-    SetSeed(prgSeed);
-    for (long i = 0; i < n; i++)
-      a[i].randomize();
-
-  } // the RandomState destructor "restores the state" (see NumbTh.h)
+  for (long i = 0; i < n; i++)
+    randomizeA(a[i], i);
 
   std::vector<NTL::ZZX> A, B;
 
@@ -195,7 +203,8 @@ void KeySwitch::readMatrix(std::istream& str, const Context& context)
 
 void KeySwitch::writeTo(std::ostream& str) const
 {
-  writeEyeCatcher(str, EyeCatcher::SKM_BEGIN);
+  // The begin eye catcher also records the derivation of the ai's
+  writeEyeCatcher(str, EyeCatcher::SKM1_BEGIN);
   /*
       Write out raw
       1. SKHandle fromKey;
@@ -220,8 +229,14 @@ void KeySwitch::writeTo(std::ostream& str) const
 
 KeySwitch KeySwitch::readFrom(std::istream& str, const Context& context)
 {
-  bool eyeCatcherFound = readEyeCatcher(str, EyeCatcher::SKM_BEGIN);
-  assertTrue(eyeCatcherFound, "Could not find pre-secret key eyecatcher");
+  std::array<char, EyeCatcher::SIZE> eye;
+  str.read(eye.data(), EyeCatcher::SIZE);
+  if (eye == EyeCatcher::SKM_BEGIN)
+    throw IOError("Key-switching matrix written by an older version, which "
+                  "derived the ai's differently from prgSeed, "
+                  "it must be re-generated");
+  assertTrue<IOError>(eye == EyeCatcher::SKM1_BEGIN,
+                      "Could not find pre-secret key eyecatcher");
 
   KeySwitch ret;
 
@@ -232,7 +247,7 @@ KeySwitch KeySwitch::readFrom(std::istream& str, const Context& context)
   read_raw_ZZ(str, ret.prgSeed);
   ret.noiseBound = read_raw_xdouble(str);
 
-  eyeCatcherFound = readEyeCatcher(str, EyeCatcher::SKM_END);
+  bool eyeCatcherFound = readEyeCatcher(str, EyeCatcher::SKM_END);
   assertTrue(eyeCatcherFound, "Could not find post-secret key eyecatcher");
 
   return ret;
@@ -250,13 +265,15 @@ JsonWrapper KeySwitch::writeToJSON() const
    * 4. vector<DoubleCRT> b;
    * 5. ZZ prgSeed;
    * 6. xdouble noiseBound;
+   * 7. long     seedDerivation;
    */
   json j = {{"fromKey", unwrap(this->fromKey.writeToJSON())},
             {"toKeyID", this->toKeyID},
             {"ptxtSpace", this->ptxtSpace},
             {"b", writeVectorToJSON(b)},
             {"prgSeed", prgSeed},
-            {"noiseBound", noiseBound}};
+            {"noiseBound", noiseBound},
+            {"seedDerivation", SEED_DERIVATION}};
 
   return wrap(toTypedJson<KeySwitch>(j));
 }
@@ -286,6 +303,13 @@ void KeySwitch::readJSON(const JsonWrapper& jw, const Context& context)
 {
   json j = fromTypedJson<KeySwitch>(unwrap(jw));
 
+  // Without it, the matrix was written by a version that derived the ai's
+  // differently from prgSeed
+  assertTrue<IOError>(j.contains("seedDerivation") &&
+                          j.at("seedDerivation").get<long>() ==
+                              SEED_DERIVATION,
+                      "Key-switching matrix written with another derivation "
+                      "of the ai's from prgSeed, it must be re-generated");
   this->fromKey = SKHandle::readFromJSON(wrap(j.at("fromKey")));
   this->toKeyID = j.at("toKeyID");
   this->ptxtSpace = j.at("ptxtSpace");
@@ -310,11 +334,13 @@ void addAllMatrices(SecKey& sKey, long keyID)
   long m = context.getM();
 
   // key-switching matrices for the automorphisms
+  std::vector<long> vals;
   for (long i = 0; i < m; i++) {
     if (!context.getZMStar().inZmStar(i))
       continue;
-    sKey.GenKeySWmatrix(1, i, keyID, keyID);
+    vals.push_back(i);
   }
+  sKey.GenKeySWmatrices(vals, keyID, keyID);
   sKey.setKeySwitchMap(); // re-compute the key-switching map
 }
 
@@ -375,10 +401,10 @@ static void add1Dmats4dim(SecKey& sKey, long i, long keyID)
 */
 }
 #else
-// adds all matrices for dim i.
+// adds (to vals) the automorphisms of all matrices for dim i.
 // i == -1 => Frobenius (NOTE: in matmul1D, i ==#gens means something else,
 //   so it is best to avoid that).
-static void add1Dmats4dim(SecKey& sKey, long i, long keyID)
+static void add1Dmats4dim(SecKey& sKey, long i, std::vector<long>& vals)
 {
   const PAlgebra& zMStar = sKey.getContext().getZMStar();
   long ord;
@@ -394,10 +420,10 @@ static void add1Dmats4dim(SecKey& sKey, long i, long keyID)
   }
 
   for (long j = 1; j < ord; j++)
-    sKey.GenKeySWmatrix(1, zMStar.genToPow(i, j), keyID, keyID);
+    vals.push_back(zMStar.genToPow(i, j));
 
   if (!native)
-    sKey.GenKeySWmatrix(1, zMStar.genToPow(i, -ord), keyID, keyID);
+    vals.push_back(zMStar.genToPow(i, -ord));
 
   sKey.setKSStrategy(i, HELIB_KSS_FULL);
 }
@@ -528,7 +554,7 @@ MAUTO
 static void addSome1Dmats4dim(SecKey& sKey,
                               long i,
                               UNUSED long bound,
-                              long keyID)
+                              std::vector<long>& vals)
 {
   const PAlgebra& zMStar = sKey.getContext().getZMStar();
   long ord;
@@ -547,14 +573,14 @@ static void addSome1Dmats4dim(SecKey& sKey,
 
   // baby steps
   for (long j = 1; j < g; j++)
-    sKey.GenKeySWmatrix(1, zMStar.genToPow(i, j), keyID, keyID);
+    vals.push_back(zMStar.genToPow(i, j));
 
   // giant steps
   for (long j = g; j < ord; j += g)
-    sKey.GenKeySWmatrix(1, zMStar.genToPow(i, j), keyID, keyID);
+    vals.push_back(zMStar.genToPow(i, j));
 
   if (!native)
-    sKey.GenKeySWmatrix(1, zMStar.genToPow(i, -ord), keyID, keyID);
+    vals.push_back(zMStar.genToPow(i, -ord));
 
   sKey.setKSStrategy(i, HELIB_KSS_BSGS);
 
@@ -575,13 +601,15 @@ void addSome1DMatrices(SecKey& sKey, long bound, long keyID)
   const Context& context = sKey.getContext();
 
   // key-switching matrices for the automorphisms
+  std::vector<long> vals;
   for (long i : range(context.getZMStar().numOfGens())) {
     // For generators of small order, add all the powers
     if (bound >= context.getZMStar().OrderOf(i))
-      add1Dmats4dim(sKey, i, keyID);
+      add1Dmats4dim(sKey, i, vals);
     else // For generators of large order, add only some of the powers
-      addSome1Dmats4dim(sKey, i, bound, keyID);
+      addSome1Dmats4dim(sKey, i, bound, vals);
   }
+  sKey.GenKeySWmatrices(vals, keyID, keyID);
   sKey.setKeySwitchMap(); // re-compute the key-switching map
 }
 
@@ -599,11 +627,13 @@ void addBSGS1DMatrices(SecKey& sKey, long keyID)
 void addSomeFrbMatrices(SecKey& sKey, long bound, long keyID)
 {
   const Context& context = sKey.getContext();
+  std::vector<long> vals;
   if (bound >= LONG(context.getOrdP()))
-    add1Dmats4dim(sKey, -1, keyID);
+    add1Dmats4dim(sKey, -1, vals);
   else // For generators of large order, add only some of the powers
-    addSome1Dmats4dim(sKey, -1, bound, keyID);
+    addSome1Dmats4dim(sKey, -1, bound, vals);
 
+  sKey.GenKeySWmatrices(vals, keyID, keyID);
   sKey.setKeySwitchMap(); // re-compute the key-switching map
 }
 
@@ -617,7 +647,9 @@ void addBSGSFrbMatrices(SecKey& sKey, long keyID)
   addSomeFrbMatrices(sKey, 0, keyID);
 }
 
-static void addMinimal1Dmats4dim(SecKey& sKey, long i, long keyID)
+static void addMinimal1Dmats4dim(SecKey& sKey,
+                                 long i,
+                                 std::vector<long>& vals)
 {
   const PAlgebra& zMStar = sKey.getContext().getZMStar();
   long ord;
@@ -632,14 +664,14 @@ static void addMinimal1Dmats4dim(SecKey& sKey, long i, long keyID)
     native = true;
   }
 
-  sKey.GenKeySWmatrix(1, zMStar.genToPow(i, 1), keyID, keyID);
+  vals.push_back(zMStar.genToPow(i, 1));
 
   if (!native)
-    sKey.GenKeySWmatrix(1, zMStar.genToPow(i, -ord), keyID, keyID);
+    vals.push_back(zMStar.genToPow(i, -ord));
 
   if (ord > HELIB_KEYSWITCH_MIN_THRESH) {
     long g = KSGiantStepSize(ord);
-    sKey.GenKeySWmatrix(1, zMStar.genToPow(i, g), keyID, keyID);
+    vals.push_back(zMStar.genToPow(i, g));
   }
 
   sKey.setKSStrategy(i, HELIB_KSS_MIN);
@@ -650,16 +682,20 @@ void addMinimal1DMatrices(SecKey& sKey, long keyID)
   const Context& context = sKey.getContext();
 
   // key-switching matrices for the automorphisms
+  std::vector<long> vals;
   for (long i : range(context.getZMStar().numOfGens())) {
-    addMinimal1Dmats4dim(sKey, i, keyID);
+    addMinimal1Dmats4dim(sKey, i, vals);
   }
+  sKey.GenKeySWmatrices(vals, keyID, keyID);
   sKey.setKeySwitchMap(); // re-compute the key-switching map
 }
 
 // Generate all Frobenius matrices of the form s(X^{p^i})->s(X)
 void addMinimalFrbMatrices(SecKey& sKey, long keyID)
 {
-  addMinimal1Dmats4dim(sKey, -1, keyID);
+  std::vector<long> vals;
+  addMinimal1Dmats4dim(sKey, -1, vals);
+  sKey.GenKeySWmatrices(vals, keyID, keyID);
   sKey.setKeySwitchMap(); // re-compute the key-switching map
 }
 
@@ -669,6 +705,7 @@ void addMatrices4Network(SecKey& sKey, const PermNetwork& net, long keyID)
   const Context& context = sKey.getContext();
   long m = context.getM();
 
+  std::vector<long> vals;
   for (long i = 0; i < net.depth(); i++) {
     long e = net.getLayer(i).getE();
     long gIdx = net.getLayer(i).getGenIdx();
@@ -678,20 +715,18 @@ void addMatrices4Network(SecKey& sKey, const PermNetwork& net, long keyID)
     for (long j = 0; j < shamts.length(); j++) {
       if (shamts[j] == 0)
         continue;
-      long val = NTL::PowerMod(g2e, shamts[j], m);
-      sKey.GenKeySWmatrix(1, val, keyID, keyID);
+      vals.push_back(NTL::PowerMod(g2e, shamts[j], m));
     }
   }
+  sKey.GenKeySWmatrices(vals, keyID, keyID);
   sKey.setKeySwitchMap(); // re-compute the key-switching map
 }
 
 void addTheseMatrices(SecKey& sKey, const std::set<long>& automVals, long keyID)
 {
-  std::set<long>::iterator it;
-  for (it = automVals.begin(); it != automVals.end(); ++it) {
-    long k = *it;
-    sKey.GenKeySWmatrix(1, k, keyID, keyID);
-  }
+  sKey.GenKeySWmatrices(std::vector<long>(automVals.begin(), automVals.end()),
+                        keyID,
+                        keyID);
   sKey.setKeySwitchMap(); // re-compute the key-switching map
 }
 
@@ -10,8 +10,13 @@
  * limitations under the License. See accompanying LICENSE file.
  */
 #include <queue>
+#include <set>
+#include <type_traits>
+
+#include <NTL/BasicThreadPool.h>
 
 #include <helib/keys.h>
+#include <helib/MappedArchive.h>
 #include <helib/timing.h>
 #include <helib/EncryptedArray.h>
 #include <helib/Ptxt.h>
@@ -77,6 +82,20 @@ double RLWE(DoubleCRT& c0,
   return RLWE1(c0, c1, s, p);
 }
 
+double seededRLWE(DoubleCRT& c0,
+                  DoubleCRT& c1,
+                  const DoubleCRT& s,
+                  long p,
+                  NTL::ZZ& prgSeed)
+{
+  RandomBits(prgSeed, 256); // a random 256-bit seed
+  {
+    RandomState state; // the seed is public, so restore the PRG afterwards
+    c1.randomize(&prgSeed);
+  }
+  return RLWE1(c0, c1, s, p);
+}
+
 /******************** PubKey implementation **********************/
 /********************************************************************/
 // Computes the keySwitchMap pointers, using breadth-first search (BFS)
@@ -92,7 +111,9 @@ PubKey::PubKey(const PubKey& other) :
     context(other.context),
     pubEncrKey(*this),
     skBounds(other.skBounds),
-    keySwitching(other.keySwitching),
+    keySwitching(other.keyStore ? std::vector<KeySwitch>()
+                                : other.keySwitching),
+    keyStore(other.keyStore),
     keySwitchMap(other.keySwitchMap),
     KS_strategy(other.KS_strategy),
     recryptKeyID(other.recryptKeyID),
@@ -100,6 +121,17 @@ PubKey::PubKey(const PubKey& other) :
 { // copy pubEncrKey,recryptEkey w/o checking the ref to the public key
   pubEncrKey.privateAssign(other.pubEncrKey);
   recryptEkey.privateAssign(other.recryptEkey);
+
+  // Copying a view makes a deep copy, so take new views of the store
+  if (keyStore) {
+    keySwitching.resize(other.keySwitching.size());
+    for (long i : range(lsize(keySwitching))) {
+      if (i < keyStore->size())
+        keyStore->get(keySwitching[i], i);
+      else
+        keySwitching[i] = other.keySwitching[i];
+    }
+  }
 }
 
 void PubKey::clear()
@@ -107,6 +139,7 @@ void PubKey::clear()
   pubEncrKey.clear();
   skBounds.clear();
   keySwitching.clear();
+  keyStore.reset();
   keySwitchMap.clear();
   recryptKeyID = -1;
   recryptEkey.clear();
@@ -164,46 +197,65 @@ void PubKey::setKeySwitchMap(long keyId)
   }
 }
 
-const KeySwitch& PubKey::getKeySWmatrix(const SKHandle& from, long toIdx) const
+long PubKey::findKeySWmatrix(const SKHandle& from, long toIdx) const
 {
   // First try to use the keySwitchMap
   if (from.getPowerOfS() == 1 && from.getSecretKeyID() == toIdx &&
       toIdx < (long)keySwitchMap.size()) {
     long matIdx = keySwitchMap.at(toIdx).at(from.getPowerOfX());
-    if (matIdx >= 0) {
-      const KeySwitch& matrix = keySwitching.at(matIdx);
-      if (matrix.fromKey == from)
-        return matrix;
-    }
+    if (matIdx >= 0 && keySwitching.at(matIdx).fromKey == from)
+      return matIdx;
   }
 
   // Otherwise resort to linear search
   for (size_t i = 0; i < keySwitching.size(); i++) {
     if (keySwitching[i].toKeyID == toIdx && keySwitching[i].fromKey == from)
-      return keySwitching[i];
+      return i;
   }
-  return KeySwitch::dummy(); // return this if nothing is found
+  return -1; // nothing is found
 }
 
-const KeySwitch& PubKey::getAnyKeySWmatrix(const SKHandle& from) const
+long PubKey::findAnyKeySWmatrix(const SKHandle& from) const
 {
   // First try to use the keySwitchMap
   if (from.getPowerOfS() == 1 &&
       from.getSecretKeyID() < (long)keySwitchMap.size()) {
     long matIdx = keySwitchMap.at(from.getSecretKeyID()).at(from.getPowerOfX());
-    if (matIdx >= 0) {
-      const KeySwitch& matrix = keySwitching.at(matIdx);
-      if (matrix.fromKey == from)
-        return matrix;
-    }
+    if (matIdx >= 0 && keySwitching.at(matIdx).fromKey == from)
+      return matIdx;
   }
 
   // Otherwise resort to linear search
   for (size_t i = 0; i < keySwitching.size(); i++) {
     if (keySwitching[i].fromKey == from)
-      return keySwitching[i];
+      return i;
   }
-  return KeySwitch::dummy(); // return this if nothing is found
+  return -1; // nothing is found
+}
+
+const KeySwitch& PubKey::useKeySWmatrix(long matIdx) const
+{
+  if (matIdx < 0)
+    return KeySwitch::dummy();
+  if (keyStore && matIdx < keyStore->size())
+    keyStore->touch(matIdx);
+  return keySwitching.at(matIdx);
+}
+
+void PubKey::checkKeyStore() const
+{
+  if (keyStore)
+    keyStore->checkAll();
+}
+
+const KeySwitch& PubKey::getKeySWmatrix(const SKHandle& from, long toIdx) const
+{
+  return useKeySWmatrix(findKeySWmatrix(from, toIdx));
+}
+
+const KeySwitch& PubKey::getAnyKeySWmatrix(const SKHandle& from) const
+{
+  return useKeySWmatrix(findAnyKeySWmatrix(from));
 }
 
 bool PubKey::operator==(const PubKey& other) const
@@ -224,6 +276,8 @@ bool PubKey::operator==(const PubKey& other) const
 
   if (keySwitching.size() != other.keySwitching.size())
     return false;
+  checkKeyStore();
+  other.checkKeyStore();
   for (size_t i = 0; i < keySwitching.size(); i++)
     if (keySwitching[i] != other.keySwitching[i])
       return false;
@@ -272,7 +326,22 @@ bool PubKey::keyExists(long keyID) const
 
 double PubKey::getSKeyBound(long keyID) const { return skBounds.at(keyID); }
 
-const std::vector<KeySwitch>& PubKey::keySWlist() const { return keySwitching; }
+const std::vector<KeySwitch>& PubKey::keySWlist() const
+{
+  checkKeyStore();
+  return keySwitching;
+}
+
+NTL::xdouble PubKey::maxKeySwitchNoise() const
+{
+  // only the metadata of the matrices, not their residues, so this does
+  // not need to check or touch the key store
+  NTL::xdouble max_noise(0.0);
+  for (const KeySwitch& ks : keySwitching)
+    if (max_noise < ks.noiseBound)
+      max_noise = ks.noiseBound;
+  return max_noise;
+}
 
 const KeySwitch& PubKey::getKeySWmatrix(long fromSPower,
                                         long fromXPower,
@@ -284,7 +353,8 @@ const KeySwitch& PubKey::getKeySWmatrix(long fromSPower,
 
 bool PubKey::haveKeySWmatrix(const SKHandle& from, long toID) const
 {
-  return getKeySWmatrix(from, toID).toKeyID >= 0;
+  // does not count as a use of the matrix
+  return findKeySWmatrix(from, toID) >= 0;
 }
 
 bool PubKey::haveKeySWmatrix(long fromSPower,
@@ -297,13 +367,12 @@ bool PubKey::haveKeySWmatrix(long fromSPower,
 
 bool PubKey::haveAnyKeySWmatrix(const SKHandle& from) const
 {
-  return getAnyKeySWmatrix(from).toKeyID >= 0;
+  return findAnyKeySWmatrix(from) >= 0;
 }
 
 const KeySwitch& PubKey::getNextKSWmatrix(long fromXPower, long fromID) const
 {
-  long matIdx = keySwitchMap.at(fromID).at(fromXPower);
-  return (matIdx >= 0 ? keySwitching.at(matIdx) : KeySwitch::dummy());
+  return useKeySWmatrix(keySwitchMap.at(fromID).at(fromXPower));
 }
 
 bool PubKey::isReachable(long k, long keyID) const
@@ -337,6 +406,33 @@ void PubKey::setKSStrategy(long dim, int val)
   // std::cout << "*** setKSSStrategy for dim " << dim << " = " << val << "\n";
 }
 
+void PubKey::writeKeyStore(const std::string& path) const
+{
+  checkKeyStore();
+  KeySwitchStore::write(path, context, keySwitching);
+}
+
+void PubKey::openKeyStore(const std::string& path, long maxResident)
+{
+  HELIB_TIMER_START;
+  auto store = std::make_shared<KeySwitchStore>(path, context, maxResident);
+
+  // The views only map the residues, nothing is read yet
+  std::vector<KeySwitch> matrices(store->size());
+  for (long i : range(store->size()))
+    store->get(matrices[i], i);
+  for (const KeySwitch& ksm : matrices)
+    assertTrue<IOError>(keyExists(ksm.toKeyID) &&
+                            keyExists(ksm.fromKey.getSecretKeyID()),
+                        "Key store has a matrix for a key that we do not have");
+
+  keySwitching = std::move(matrices);
+  keyStore = store;
+  keySwitchMap.clear();
+  for (long i = skBounds.size() - 1; i >= 0; i--)
+    setKeySwitchMap(i);
+}
+
 // Encrypts plaintext, result returned in the ciphertext argument. When
 // called with highNoise=true, returns a ciphertext with noise level
 // approximately q/8. For BGV, ptxtSpace is the intended plaintext
@@ -371,6 +467,7 @@ long PubKey::Encrypt(Ctxt& ctxt,
 
   // generate a random encryption of zero from the public encryption key
   ctxt = pubEncrKey; // already an encryption of zero, just not a random one
+  NTL::clear(ctxt.prgSeed); // parts[1] will not be uniform
                      // ctxt with two parts, each with all the ctxtPrimes
   ctxt.noiseBound = 0;
 
@@ -511,6 +608,7 @@ void PubKey::CKKSencrypt(Ctxt& ctxt,
 
   // generate a random encryption of zero from the public encryption key
   ctxt = pubEncrKey; // already an encryption of zero, just not a random one
+  NTL::clear(ctxt.prgSeed); // parts[1] will not be uniform
 
   // choose a random small scalar r and a small random error vector
   // (e0,e1), then set ctxt = r*pk + (e0,e1) + (ef*ptxt,0), where
@@ -623,69 +721,31 @@ void PubKey::Encrypt(Ctxt& ciphertxt, const Ptxt<CKKS>& plaintxt) const
   Encrypt(ciphertxt, eptxt);
 }
 
-void PubKey::Encrypt(Ctxt& ctxt, const EncodedPtxt_BGV& eptxt) const
+NTL::xdouble PubKey::encryptZero(Ctxt& ctxt, long ptxtSpace) const
 {
-  HELIB_TIMER_START;
-
-  assertTrue(!isCKKS(), "Encrypt: mismatched BGV ptxt / CKKS ctxt");
-  assertEq(this, &ctxt.pubKey, "Encrypt: public key mismatch");
-  assertEq(&context, &eptxt.getContext(), "Encrypt: context mismatch");
-
-  long ptxtSpace = eptxt.getPtxtSpace();
-  NTL::ZZX ptxt;
-
-  convert(ptxt, eptxt.getPoly());
-
-  // The rest of the code is copy/pasted from the
-  // original Encrypt code, except that for now, highNoise
-  // is not implemented.  We can put it back if necessary.
-  // We may eventually want to completely deprecate the original
-  // Encrypt code, which is why it is copy/pasted for now.
-  // We could also just invoke
-  //    Encrypt(ctxt, ptxt, ptxtSpace, /*highNoise=*/false);
-  // at this point for the same effect.
-
-  // VJS-FIXME: I really should get rid of the unnecessary
-  // connversions from zzX to ZZX...I've added a zzX version
-  // of balanced_mulMod...but I also need zzX versions
-  // of DoubleCRT += and friends.
-
-  if (ptxtSpace != pubEncrKey.ptxtSpace) { // plaintext-space mismatch
-    ptxtSpace = NTL::GCD(ptxtSpace, pubEncrKey.ptxtSpace);
-    if (ptxtSpace <= 1)
-      throw RuntimeError("Plaintext-space mismatch on encryption");
-  }
-
   // generate a random encryption of zero from the public encryption key
   ctxt = pubEncrKey; // already an encryption of zero, just not a random one
+  NTL::clear(ctxt.prgSeed); // parts[1] will not be uniform
                      // ctxt with two parts, each with all the ctxtPrimes
-  ctxt.noiseBound = 0;
 
   // choose a random small scalar r and a small random error vector (e0,e1),
-  // then set ctxt = r*pk + p*(e0,e1) + (ptxt,0),
-  // where pk = pubEncrKey, and p = ptxtSpace.
+  // then set ctxt = r*pk + p*(e0,e1), where pk = pubEncrKey, and
+  // p = ptxtSpace.
 
   // The resulting ciphertext decrypts to
-  //   r*<sk,pk> + p*(e0 + sk1*e1) + ptxt,
+  //   r*<sk,pk> + p*(e0 + sk1*e1),
   // where sk = (1, sk1) is the secret key.
   // This leads to a noise bound of:
   //   r_bound*pubEncrKey.noiseBound
   //     + p*e0_bound + p*e1_bound*getSKeyBound()
-  //     + ptxt_bound
   //  Here, r_bound, e0_bound, and e1_bound are values
   //  returned by the corresponding sampling routines.
-  //  ptxt_bound is somewhat heuristically set assuming
-  //  that the coefficients of the ciphertext are uniformly
-  //  and independently chosen from the interval [-p/2, p/2].
 
   DoubleCRT e(context, context.getCtxtPrimes());
   DoubleCRT r(context, context.getCtxtPrimes());
-  double r_bound = r.sampleSmallBounded();
-
-  ctxt.noiseBound += r_bound * pubEncrKey.noiseBound;
+  double r_bound = r.sampleSmallBounded(); // r is a {0,+-1} polynomial
 
-  // std::cerr << "*** r_bound*pubEncrKey.noiseBound " << r_bound *
-  // pubEncrKey.noiseBound << "\n";
+  NTL::xdouble noiseBound = r_bound * pubEncrKey.noiseBound;
 
   double stdev = to_double(context.getStdev());
   if (context.getZMStar().getPow2() == 0) // not power of two
@@ -697,19 +757,60 @@ void PubKey::Encrypt(Ctxt& ctxt, const EncodedPtxt_BGV& eptxt) const
 
     e_bound = e.sampleGaussianBounded(stdev);
 
-    e *= ptxtSpace;
-    e_bound *= ptxtSpace;
+    if (ptxtSpace != 1) {
+      e *= ptxtSpace;
+      e_bound *= ptxtSpace;
+    }
 
     if (i == 1) {
       e_bound *= getSKeyBound(ctxt.parts[i].skHandle.getSecretKeyID());
     }
 
     ctxt.parts[i] += e;
-    ctxt.noiseBound += e_bound;
+    noiseBound += e_bound;
+  }
 
-    // std::cerr << "*** e_bound " << e_bound << "\n";
+  return noiseBound;
+}
+
+void PubKey::Encrypt(Ctxt& ctxt, const EncodedPtxt_BGV& eptxt) const
+{
+  HELIB_TIMER_START;
+
+  assertTrue(!isCKKS(), "Encrypt: mismatched BGV ptxt / CKKS ctxt");
+  assertEq(this, &ctxt.pubKey, "Encrypt: public key mismatch");
+  assertEq(&context, &eptxt.getContext(), "Encrypt: context mismatch");
+
+  long ptxtSpace = eptxt.getPtxtSpace();
+  NTL::ZZX ptxt;
+
+  convert(ptxt, eptxt.getPoly());
+
+  // The rest of the code follows the original Encrypt code,
+  // except that for now, highNoise is not implemented (the noise
+  // is sampled by encryptZero, which is shared with encryptBatch).
+  // We can put it back if necessary.
+  // We may eventually want to completely deprecate the original
+  // Encrypt code, which is why it is duplicated for now.
+  // We could also just invoke
+  //    Encrypt(ctxt, ptxt, ptxtSpace, /*highNoise=*/false);
+  // at this point for the same effect.
+
+  // VJS-FIXME: I really should get rid of the unnecessary
+  // connversions from zzX to ZZX...I've added a zzX version
+  // of balanced_mulMod...but I also need zzX versions
+  // of DoubleCRT += and friends.
+
+  if (ptxtSpace != pubEncrKey.ptxtSpace) { // plaintext-space mismatch
+    ptxtSpace = NTL::GCD(ptxtSpace, pubEncrKey.ptxtSpace);
+    if (ptxtSpace <= 1)
+      throw RuntimeError("Plaintext-space mismatch on encryption");
   }
 
+  // generate a random encryption of zero from the public encryption key,
+  // see encryptZero for how its noise is bounded
+  ctxt.noiseBound = encryptZero(ctxt, ptxtSpace);
+
   // add in the plaintext
   // FIXME: we should really randomize ptxt, so that each coefficient
   //    has expected value 0
@@ -769,13 +870,11 @@ void PubKey::Encrypt(Ctxt& ctxt, const EncodedPtxt_CKKS& eptxt) const
   assertTrue(scale > 0, "CKKS encryption: scale <= 0");
   assertTrue(err > 0, "CKKS encryption: err <= 0");
 
-  long m = context.getM();
-
   // generate a random encryption of zero from the public encryption key
-  ctxt = pubEncrKey; // already an encryption of zero, just not a random one
+  NTL::xdouble error_bound = encryptZero(ctxt, /*ptxtSpace=*/1);
 
-  // choose a random small scalar r and a small random error vector
-  // (e0,e1), then set ctxt = r*pk + (e0,e1) + (ef*ptxt,0), where
+  // encryptZero chose a random small scalar r and a small random error
+  // vector (e0,e1), we now set ctxt = r*pk + (e0,e1) + (ef*ptxt,0), where
   // pk = pubEncrKey, and ef (the "extra factor") is described below
 
   // The resulting ciphertext decrypts to
@@ -794,34 +893,6 @@ void PubKey::Encrypt(Ctxt& ctxt, const EncodedPtxt_CKKS& eptxt) const
   // the scaled noise added by encryption is less than the scaled
   // noise already present in the encoded ptxt.
 
-  DoubleCRT e(context, context.getCtxtPrimes());
-  DoubleCRT r(context, context.getCtxtPrimes());
-
-  double r_bound = r.sampleSmallBounded(); // r is a {0,+-1} polynomial
-
-  NTL::xdouble error_bound = r_bound * pubEncrKey.noiseBound;
-
-  double stdev = to_double(context.getStdev());
-
-  // VJS-NOTE: this should never happen for CKKS
-  if (context.getZMStar().getPow2() == 0) // not power of two
-    stdev *= sqrt(m);
-
-  for (size_t i = 0; i < ctxt.parts.size(); i++) {
-    // add noise to all the parts
-
-    ctxt.parts[i] *= r;
-
-    double e_bound = e.sampleGaussianBounded(stdev);
-    // zero-mean Gaussian, sigma=stdev
-
-    ctxt.parts[i] += e;
-    if (i == 1) {
-      e_bound *= getSKeyBound(ctxt.parts[i].skHandle.getSecretKeyID());
-    }
-    error_bound += e_bound;
-  }
-
   // Compute the extra scaling factor, if needed
 
   // VJS-NOTE: note the new logic for computing ef...
@@ -855,6 +926,141 @@ void PubKey::Encrypt(Ctxt& ctxt, const EncodedPtxt& eptxt) const
     throw LogicError("Encrypt: bad EncodedPtxt");
 }
 
+// The batch version of Encrypt(EncodedPtxt_BGV) and Encrypt(EncodedPtxt_CKKS),
+// see there for the noise analysis. The plaintexts are all brought to
+// DoubleCRT form before any noise is sampled, and the randomized part is
+// done by encryptZero, which is virtual, so a SecKey encrypts with the
+// secret key here.
+void PubKey::encryptBatch(std::vector<Ctxt>& ctxts,
+                          const std::vector<EncodedPtxt>& eptxts) const
+{
+  HELIB_TIMER_START;
+
+  long n = eptxts.size();
+  bool ckks = isCKKS();
+
+  // Check the whole batch up front, and resolve the BGV plaintext spaces
+  std::vector<long> ptxtSpaces(n, 1);
+  for (long i = 0; i < n; i++) {
+    if (ckks) {
+      assertTrue(eptxts[i].isCKKS(), "encryptBatch: mismatched ptxt / ctxt");
+      const EncodedPtxt_CKKS& eptxt = eptxts[i].getCKKS();
+      assertEq(&context, &eptxt.getContext(), "encryptBatch: context mismatch");
+      assertTrue(eptxt.getMag() > 0, "CKKS encryption: mag <= 0");
+      assertTrue(eptxt.getScale() > 0, "CKKS encryption: scale <= 0");
+      assertTrue(eptxt.getErr() > 0, "CKKS encryption: err <= 0");
+    } else {
+      assertTrue(eptxts[i].isBGV(), "encryptBatch: mismatched ptxt / ctxt");
+      const EncodedPtxt_BGV& eptxt = eptxts[i].getBGV();
+      assertEq(&context, &eptxt.getContext(), "encryptBatch: context mismatch");
+      long ptxtSpace = eptxt.getPtxtSpace();
+      if (ptxtSpace != pubEncrKey.ptxtSpace) { // plaintext-space mismatch
+        ptxtSpace = NTL::GCD(ptxtSpace, pubEncrKey.ptxtSpace);
+        if (ptxtSpace <= 1)
+          throw RuntimeError("Plaintext-space mismatch on encryption");
+      }
+      ptxtSpaces[i] = ptxtSpace;
+    }
+  }
+
+  // Convert all the plaintexts to DoubleCRT over the ciphertext primes. For
+  // BGV they are first multiplied by Q mod p, as in Encrypt, with the product
+  // of primes Q computed once for the batch.
+  const IndexSet& primes = context.getCtxtPrimes();
+  NTL::ZZ Q = context.productOfPrimes(primes);
+  std::vector<DoubleCRT> polys(n, DoubleCRT(context, primes));
+  std::vector<double> ptxtBounds(n, 0.0);
+
+  NTL_EXEC_RANGE(n, first, last)
+  NTL::ZZX ptxt, ptxt_fixed;
+  for (long i = first; i < last; i++) {
+    if (ckks) {
+      convert(ptxt, eptxts[i].getCKKS().getPoly());
+      polys[i] = ptxt;
+      continue;
+    }
+
+    long ptxtSpace = ptxtSpaces[i];
+    convert(ptxt, eptxts[i].getBGV().getPoly());
+    balanced_MulMod(ptxt_fixed, ptxt, rem(Q, ptxtSpace), ptxtSpace);
+    polys[i] = ptxt_fixed;
+
+    ptxtBounds[i] = context.noiseBoundForMod(ptxtSpace, context.getPhiM());
+    double ptxt_sz = NTL::conv<double>(
+        embeddingLargestCoeff(ptxt_fixed, context.getZMStar()));
+    if (ptxt_sz > ptxtBounds[i]) {
+      Warning("noise bound exceeded in encryption");
+    }
+    HELIB_STATS_UPDATE("ptxt_rat", ptxt_sz / ptxtBounds[i]);
+  }
+  NTL_EXEC_RANGE_END
+
+  // Sample a fresh encryption of zero for each ciphertext and add in the
+  // converted plaintext
+  ctxts.resize(n, Ctxt(*this));
+
+  NTL_EXEC_RANGE(n, first, last)
+  for (long i = first; i < last; i++) {
+    Ctxt& ctxt = ctxts[i];
+    if (ckks) {
+      const EncodedPtxt_CKKS& eptxt = eptxts[i].getCKKS();
+      double scale = eptxt.getScale();
+      double err = eptxt.getErr();
+
+      NTL::xdouble error_bound = encryptZero(ctxt, /*ptxtSpace=*/1);
+      long ef = NTL::conv<long>(ceil(error_bound / err));
+      if (ef > 1) { // scale up some more
+        polys[i] *= ef;
+        scale *= ef;
+        err *= ef;
+      }
+      ctxt.parts[0] += polys[i];
+
+      ctxt.ptxtMag = eptxt.getMag();
+      ctxt.ratFactor = scale;
+      ctxt.noiseBound = error_bound + err;
+      ctxt.ptxtSpace = 1;
+      ctxt.intFactor = 1;
+    } else {
+      ctxt.noiseBound = encryptZero(ctxt, ptxtSpaces[i]);
+      ctxt.parts[0] += polys[i];
+
+      ctxt.noiseBound += ptxtBounds[i];
+      ctxt.ptxtSpace = ptxtSpaces[i];
+      ctxt.intFactor = 1;
+      ctxt.ratFactor = ctxt.ptxtMag = 1.0;
+    }
+  }
+  NTL_EXEC_RANGE_END
+}
+
+template <typename Scheme>
+void PubKey::encryptBatch(std::vector<Ctxt>& ctxts,
+                          const std::vector<Ptxt<Scheme>>& ptxts) const
+{
+  HELIB_TIMER_START;
+
+  // Encode the whole batch first, as Encrypt(Ctxt, Ptxt) does for one
+  std::vector<EncodedPtxt> eptxts(ptxts.size());
+
+  NTL_EXEC_RANGE(long(ptxts.size()), first, last)
+  for (long i = first; i < last; i++) {
+    if constexpr (std::is_same_v<Scheme, CKKS>)
+      ptxts[i].encode(eptxts[i],
+                      /*mag=*/NextPow2(Norm(ptxts[i].getSlotRepr())));
+    else
+      ptxts[i].encode(eptxts[i]);
+  }
+  NTL_EXEC_RANGE_END
+
+  encryptBatch(ctxts, eptxts);
+}
+
+template void PubKey::encryptBatch(std::vector<Ctxt>& ctxts,
+                                   const std::vector<Ptxt<BGV>>& ptxts) const;
+template void PubKey::encryptBatch(std::vector<Ctxt>& ctxts,
+                                   const std::vector<Ptxt<CKKS>>& ptxts) const;
+
 bool PubKey::isCKKS() const
 {
   return (getContext().getAlMod().getTag() == PA_cx_tag);
@@ -878,8 +1084,12 @@ std::istream& operator>>(std::istream& str, PubKey& pk)
   return str;
 }
 
-void PubKey::writeTo(std::ostream& str) const
+void PubKey::writeTo(std::ostream& str,
+                     bool compressed,
+                     bool withMatrices) const
 {
+  if (withMatrices)
+    checkKeyStore(); // before anything is written
   SerializeHeader<PubKey>().writeTo(str);
   writeEyeCatcher(str, EyeCatcher::PK_BEGIN);
 
@@ -894,16 +1104,21 @@ void PubKey::writeTo(std::ostream& str) const
   //  8. Ctxt recryptEkey;
 
   this->getContext().writeTo(str);
-  this->pubEncrKey.writeTo(str);
+  this->pubEncrKey.writeTo(str, compressed);
   write_raw_vector(str, this->skBounds);
 
-  // Keyswitch Matrices
-  write_raw_vector(str, this->keySwitching);
+  // Keyswitch Matrices, the map is recomputed by readFrom
+  if (withMatrices) {
+    write_raw_vector(str, this->keySwitching);
 
-  long sz = this->keySwitchMap.size();
-  write_raw_int(str, sz);
-  for (auto v : this->keySwitchMap)
-    write_raw_vector(str, v);
+    long sz = this->keySwitchMap.size();
+    write_raw_int(str, sz);
+    for (auto v : this->keySwitchMap)
+      write_raw_vector(str, v);
+  } else {
+    write_raw_vector(str, std::vector<KeySwitch>());
+    write_raw_int(str, 0);
+  }
 
   write_ntl_vec_long(str, this->KS_strategy);
 
@@ -966,16 +1181,17 @@ PubKey PubKey::readFrom(std::istream& str, const Context& context)
   return ret;
 }
 
-void PubKey::writeToJSON(std::ostream& str) const
+void PubKey::writeToJSON(std::ostream& str, bool compressed) const
 {
-  executeRedirectJsonError<void>([&]() { str << writeToJSON(); });
+  executeRedirectJsonError<void>([&]() { str << writeToJSON(compressed); });
 }
 
-JsonWrapper PubKey::writeToJSON() const
+JsonWrapper PubKey::writeToJSON(bool compressed) const
 {
-  auto body = [this]() {
+  checkKeyStore();
+  auto body = [this, compressed]() {
     json j = {{"context", unwrap(this->getContext().writeToJSON())},
-              {"pubEncrKey", unwrap(this->pubEncrKey.writeToJSON())},
+              {"pubEncrKey", unwrap(this->pubEncrKey.writeToJSON(compressed))},
               {"skBounds", this->skBounds},
               {"keySwitching", writeVectorToJSON(keySwitching)},
               {"keySwitchMap", this->keySwitchMap},
@@ -1103,7 +1319,11 @@ long SecKey::ImportSecKey(const DoubleCRT& sKey,
     pubEncrKey.parts.assign(2, CtxtPart(context, context.getCtxtPrimes()));
     // Choose a new RLWE instance
     pubEncrKey.noiseBound =
-        RLWE(pubEncrKey.parts[0], pubEncrKey.parts[1], sKey, ptxtSpace);
+        seededRLWE(pubEncrKey.parts[0],
+                   pubEncrKey.parts[1],
+                   sKey,
+                   ptxtSpace,
+                   pubEncrKey.prgSeed);
     if (isCKKS()) {
       pubEncrKey.ptxtMag = 0.0;
       pubEncrKey.ratFactor = pubEncrKey.noiseBound *
@@ -1167,6 +1387,95 @@ void SecKey::GenKeySWmatrix(long fromSPower,
   if (haveKeySWmatrix(fromSPower, fromXPower, fromIdx, toIdx))
     return; // nothing to do here
 
+  // Push the new matrix onto our list
+  keySwitching.push_back(makeKeySWmatrix(fromSPower,
+                                         fromXPower,
+                                         fromIdx,
+                                         toIdx,
+                                         keySWptxtSpace(p)));
+}
+
+void SecKey::GenKeySWmatrices(const std::vector<long>& fromXPowers,
+                              long fromIdx,
+                              long toIdx,
+                              long p)
+{
+  HELIB_TIMER_START;
+
+  // The new matrices, without repetitions
+  std::vector<long> todo;
+  std::set<long> seen;
+  for (long t : fromXPowers) {
+    if (t <= 0 || (t == 1 && fromIdx == toIdx))
+      continue;
+    if (haveKeySWmatrix(1, t, fromIdx, toIdx) || !seen.insert(t).second)
+      continue;
+    todo.push_back(t);
+  }
+  long n = todo.size();
+  if (n == 0)
+    return;
+
+  p = keySWptxtSpace(p);
+  NTL::ZZ seed;
+  RandomBits(seed, 256);
+
+  // The state is restored at the end, so that the PRG state of this thread
+  // does not depend on which matrices it generated
+  RandomState state;
+  std::vector<KeySwitch> matrices(n);
+  auto generate = [&](long i) {
+    RandomState localState;
+    NTL::SetSeed(deriveSeed(seed, i));
+    matrices[i] = makeKeySWmatrix(1, todo[i], fromIdx, toIdx, p);
+  };
+
+  // When there are fewer matrices than threads, generate them one at a time
+  // so that the NTL loops inside get all the threads
+  if (n > 1 && n >= NTL::AvailableThreads()) {
+    NTL_EXEC_RANGE(n, first, last)
+    for (long i = first; i < last; i++)
+      generate(i);
+    NTL_EXEC_RANGE_END
+  } else {
+    for (long i = 0; i < n; i++)
+      generate(i);
+  }
+
+  for (KeySwitch& ksMatrix : matrices)
+    keySwitching.push_back(std::move(ksMatrix));
+}
+
+long SecKey::keySWptxtSpace(long p) const
+{
+  if (isCKKS())
+    return 1;
+
+  // BGV
+  if (p < 2) {
+    if (context.isBootstrappable()) {
+      // use larger bootstrapping plaintext space
+      p = context.getRcData().alMod->getPPowR();
+    } else {
+      p = pubEncrKey.ptxtSpace; // default plaintext space from public key
+    }
+  }
+  // FIXME: We use context.isBootstrappable() rather than
+  //   this->isBootstrappable(). So we get the larger bootstrapping
+  //   plaintext space even if *this is not currently bootstrappable,
+  //   in case the calling application will make it bootstrappable later.
+
+  assertTrue(p >= 2,
+             "Invalid p value found generating BGV key-switching matrix");
+  return p;
+}
+
+KeySwitch SecKey::makeKeySWmatrix(long fromSPower,
+                                  long fromXPower,
+                                  long fromIdx,
+                                  long toIdx,
+                                  long p) const
+{
   DoubleCRT fromKey = sKeys.at(fromIdx);    // copy object, not a reference
   const DoubleCRT& toKey = sKeys.at(toIdx); // this can be a reference
 
@@ -1193,33 +1502,10 @@ void SecKey::GenKeySWmatrix(long fromSPower,
       n,
       DoubleCRT(context, context.getCtxtPrimes() | context.getSpecialPrimes()));
 
-  {
-    RandomState state;
-    SetSeed(ksMatrix.prgSeed);
-    for (long i = 0; i < n; i++)
-      a[i].randomize();
-  } // restore state upon destruction of state
+  for (long i = 0; i < n; i++)
+    ksMatrix.randomizeA(a[i], i);
 
   // Record the plaintext space for this key-switching matrix
-  if (isCKKS())
-    p = 1;
-  else { // BGV
-    if (p < 2) {
-      if (context.isBootstrappable()) {
-        // use larger bootstrapping plaintext space
-        p = context.getRcData().alMod->getPPowR();
-      } else {
-        p = pubEncrKey.ptxtSpace; // default plaintext space from public key
-      }
-    }
-    // FIXME: We use context.isBootstrappable() rather than
-    //   this->isBootstrappable(). So we get the larger bootstrapping
-    //   plaintext space even if *this is not currently bootstrappable,
-    //   in case the calling application will make it bootstrappable later.
-
-    assertTrue(p >= 2,
-               "Invalid p value found generating BGV key-switching matrix");
-  }
   ksMatrix.ptxtSpace = p;
 
   // generate the RLWE instances with pseudorandom ai's
@@ -1234,9 +1520,6 @@ void SecKey::GenKeySWmatrix(long fromSPower,
     fromKey *= context.productOfPrimes(context.getDigit(i));
   }
 
-  // Push the new matrix onto our list
-  keySwitching.push_back(ksMatrix);
-
 #if 0
   // HERE
   std::cout
@@ -1245,6 +1528,8 @@ void SecKey::GenKeySWmatrix(long fromSPower,
     << toIdx << " " << p << " "
     << (log(ksMatrix.noiseBound)/log(2.0)) << "\n";
 #endif
+
+  return ksMatrix;
 }
 
 // Decryption
@@ -1281,6 +1566,129 @@ void SecKey::Decrypt<CKKS>(Ptxt<CKKS>& plaintxt,
   plaintxt.setData(ptxt);
 }
 
+// this will trigger a warning if any operations that were
+// previously performed on the polynomial basis were invalid
+// because of excess noise.
+static void checkDecryptionNoise(const Ctxt& ciphertxt)
+{
+  if (!ciphertxt.isCorrect()) {
+    std::string message = "Decrypting with too much noise";
+
+// TODO: Turn the following preprocessor logics into a warnOrThrow function
+#ifdef HELIB_DEBUG
+    Warning(message);
+#else
+    throw LogicError(message);
+#endif
+  }
+}
+
+void SecKey::decryptBatch(std::vector<NTL::ZZX>& plaintxts,
+                          const std::vector<Ctxt>& ctxts) const
+{
+  HELIB_TIMER_START;
+
+  long n = ctxts.size();
+
+  // The secret-key powers s^k(X^t) that the batch needs, one for each
+  // distinct handle and prime set. A batch usually holds ciphertexts at the
+  // same level, so this computes each power once rather than once per
+  // ciphertext as Decrypt does.
+  struct KeyPower
+  {
+    SKHandle handle;
+    IndexSet primes;
+    DoubleCRT key;
+  };
+  std::vector<KeyPower> powers;
+  std::vector<std::vector<long>> partPowers(n); // index into powers, or -1
+
+  for (long i = 0; i < n; i++) {
+    const Ctxt& ciphertxt = ctxts[i];
+    assertEq(&getContext(), &ciphertxt.getContext(), "Context mismatch");
+    checkDecryptionNoise(ciphertxt);
+
+    for (const CtxtPart& part : ciphertxt.parts) {
+      long j = -1;
+      if (!part.skHandle.isOne()) {
+        for (j = 0; j < long(powers.size()); j++)
+          if (powers[j].handle == part.skHandle &&
+              powers[j].primes == ciphertxt.primeSet)
+            break;
+        if (j == long(powers.size()))
+          powers.push_back({part.skHandle,
+                            ciphertxt.primeSet,
+                            DoubleCRT(context, IndexSet())});
+      }
+      partPowers[i].push_back(j);
+    }
+  }
+
+  NTL_EXEC_RANGE(long(powers.size()), first, last)
+  for (long j = first; j < last; j++)
+    powers[j].key = keyPower(powers[j].handle, powers[j].primes);
+  NTL_EXEC_RANGE_END
+
+  plaintxts.resize(n);
+
+  NTL_EXEC_RANGE(n, first, last)
+  for (long i = first; i < last; i++) {
+    const Ctxt& ciphertxt = ctxts[i];
+    DoubleCRT ptxt(context, ciphertxt.primeSet); // Set to zero
+    for (size_t k = 0; k < ciphertxt.parts.size(); k++) {
+      const CtxtPart& part = ciphertxt.parts[k];
+      long j = partPowers[i][k];
+      if (j < 0) { // No need to multiply
+        ptxt += part;
+        continue;
+      }
+
+      DoubleCRT key = powers[j].key;
+      key *= part;
+      ptxt += key;
+    }
+    decryptFromDCRT(plaintxts[i], ptxt, ciphertxt);
+  }
+  NTL_EXEC_RANGE_END
+}
+
+template <typename Scheme>
+void SecKey::decryptBatch(std::vector<Ptxt<Scheme>>& ptxts,
+                          const std::vector<Ctxt>& ctxts,
+                          OptLong prec) const
+{
+  HELIB_TIMER_START;
+
+  std::vector<NTL::ZZX> polys;
+  decryptBatch(polys, ctxts);
+  ptxts.resize(ctxts.size(), Ptxt<Scheme>(getContext()));
+
+  // Decode the batch, as Decrypt does for one ciphertext. For CKKS this
+  // includes adding fresh noise to each decrypted polynomial, see
+  // EncryptedArrayCx::decrypt.
+  NTL_EXEC_RANGE(long(ctxts.size()), first, last)
+  std::vector<std::complex<double>> slots;
+  for (long i = first; i < last; i++) {
+    if constexpr (std::is_same_v<Scheme, CKKS>) {
+      assertTrue(&getContext() == &ptxts[i].getContext(),
+                 "Decrypt: inconsistent contexts");
+      getContext().getView().getCx().decodeDecrypted(
+          slots, polys[i], ctxts[i], *this, prec);
+      ptxts[i].setData(slots);
+    } else {
+      ptxts[i].decodeSetData(polys[i]);
+    }
+  }
+  NTL_EXEC_RANGE_END
+}
+
+template void SecKey::decryptBatch(std::vector<Ptxt<BGV>>& ptxts,
+                                   const std::vector<Ctxt>& ctxts,
+                                   OptLong prec) const;
+template void SecKey::decryptBatch(std::vector<Ptxt<CKKS>>& ptxts,
+                                   const std::vector<Ctxt>& ctxts,
+                                   OptLong prec) const;
+
 // VJS-NOTE: this is duplicated code...moreover, it does
 // not implement the mitigation against CKKS vulnerability.
 #if 0
@@ -1329,21 +1737,7 @@ void SecKey::Decrypt(NTL::ZZX& plaintxt,
   // assertEq(getContext(), ciphertxt.getContext(), "Context mismatch");
   // To be addressed later
   assertEq(&getContext(), &ciphertxt.getContext(), "Context mismatch");
-
-  // this will trigger a warning if any operations that were
-  // previously performed on the polynomial basis were invalid
-  // because of excess noise.
-
-  if (!ciphertxt.isCorrect()) {
-    std::string message = "Decrypting with too much noise";
-
-// TODO: Turn the following preprocessor logics into a warnOrThrow function
-#ifdef HELIB_DEBUG
-    Warning(message);
-#else
-    throw LogicError(message);
-#endif
-  }
+  checkDecryptionNoise(ciphertxt);
 
   const IndexSet& ptxtPrimes = ciphertxt.primeSet;
 
@@ -1357,24 +1751,38 @@ void SecKey::Decrypt(NTL::ZZX& plaintxt,
       continue;
     }
 
-    long keyIdx = part.skHandle.getSecretKeyID();
-    DoubleCRT key = sKeys.at(keyIdx); // copy object, not a reference
-    key.setPrimes(ptxtPrimes);
-    // need to equalize the prime sets without changing prime set of ciphertext.
-    // Note that ciphertext may contain small primes, which are not in key.
-
-    long xPower = part.skHandle.getPowerOfX();
-    long sPower = part.skHandle.getPowerOfS();
-    if (xPower > 1) {
-      key.automorph(xPower); // s(X^t)
-    }
-    if (sPower > 1) {
-      key.Exp(sPower); // s^r(X^t)
-    }
-
+    DoubleCRT key = keyPower(part.skHandle, ptxtPrimes);
     key *= part;
     ptxt += key;
   }
+
+  decryptFromDCRT(plaintxt, ptxt, ciphertxt, &f);
+}
+
+DoubleCRT SecKey::keyPower(const SKHandle& handle, const IndexSet& primes) const
+{
+  long keyIdx = handle.getSecretKeyID();
+  DoubleCRT key = sKeys.at(keyIdx); // copy object, not a reference
+  key.setPrimes(primes);
+  // need to equalize the prime sets without changing prime set of ciphertext.
+  // Note that ciphertext may contain small primes, which are not in key.
+
+  long xPower = handle.getPowerOfX();
+  long sPower = handle.getPowerOfS();
+  if (xPower > 1) {
+    key.automorph(xPower); // s(X^t)
+  }
+  if (sPower > 1) {
+    key.Exp(sPower); // s^r(X^t)
+  }
+  return key;
+}
+
+void SecKey::decryptFromDCRT(NTL::ZZX& plaintxt,
+                             const DoubleCRT& ptxt,
+                             const Ctxt& ciphertxt,
+                             NTL::ZZX* f) const
+{
   // convert to coefficient representation & reduce modulo the plaintext space
 
   if (DECRYPT_ON_PWFL_BASIS && !getContext().getZMStar().getPow2()) {
@@ -1392,7 +1800,8 @@ void SecKey::Decrypt(NTL::ZZX& plaintxt,
     ptxt.toPoly(plaintxt);
   }
 
-  f = plaintxt; // f used only for debugging
+  if (f)
+    *f = plaintxt; // f used only for debugging
 
   if (isCKKS())
     return; // CKKS encryption, nothing else to do
@@ -1460,7 +1869,8 @@ long SecKey::skEncrypt(Ctxt& ctxt,
 
   const DoubleCRT& sKey = sKeys.at(skIdx); // get key
   // Sample a new RLWE instance
-  ctxt.noiseBound = RLWE(ctxt.parts[0], ctxt.parts[1], sKey, ptxtSpace);
+  ctxt.noiseBound = seededRLWE(
+      ctxt.parts[0], ctxt.parts[1], sKey, ptxtSpace, ctxt.prgSeed);
 
   if (isCKKS()) {
 
@@ -1553,6 +1963,23 @@ void SecKey::Encrypt(Ctxt& ctxt, const EncodedPtxt& eptxt) const
     throw LogicError("Encrypt: bad EncodedPtxt");
 }
 
+NTL::xdouble SecKey::encryptZero(Ctxt& ctxt, long ptxtSpace) const
+{
+  long skIdx = 0; // in case we eventually want to generalize
+
+  ctxt.primeSet = context.getCtxtPrimes();
+  ctxt.parts.assign(2, CtxtPart(context, context.getCtxtPrimes()));
+
+  // make parts[0],parts[1] point to (1,s)
+  ctxt.parts[0].skHandle.setOne();
+  ctxt.parts[1].skHandle.setBase(skIdx);
+
+  // Sample a new RLWE instance
+  const DoubleCRT& sKey = sKeys.at(skIdx);
+  return NTL::to_xdouble(seededRLWE(
+      ctxt.parts[0], ctxt.parts[1], sKey, ptxtSpace, ctxt.prgSeed));
+}
+
 void SecKey::Encrypt(Ctxt& ctxt, const EncodedPtxt_BGV& eptxt) const
 {
   HELIB_TIMER_START;
@@ -1566,21 +1993,12 @@ void SecKey::Encrypt(Ctxt& ctxt, const EncodedPtxt_BGV& eptxt) const
 
   convert(ptxt, eptxt.getPoly());
 
-  long skIdx = 0; // in case we eventually want to generalize
-
   ctxt.ptxtSpace = ptxtSpace;
-  ctxt.primeSet = context.getCtxtPrimes();
   ctxt.intFactor = 1;
   ctxt.ratFactor = ctxt.ptxtMag = 1.0;
-  ctxt.parts.assign(2, CtxtPart(context, context.getCtxtPrimes()));
-
-  // make parts[0],parts[1] point to (1,s)
-  ctxt.parts[0].skHandle.setOne();
-  ctxt.parts[1].skHandle.setBase(skIdx);
 
   // Sample a new RLWE instance
-  const DoubleCRT& sKey = sKeys.at(skIdx);
-  ctxt.noiseBound = RLWE(ctxt.parts[0], ctxt.parts[1], sKey, ptxtSpace);
+  ctxt.noiseBound = encryptZero(ctxt, ptxtSpace);
 
   // The logic here has changed to be identical
   // to that used in public key encryption
@@ -1631,17 +2049,8 @@ void SecKey::Encrypt(Ctxt& ctxt, const EncodedPtxt_CKKS& eptxt) const
   double scale = eptxt.getScale();
   double err = eptxt.getErr();
 
-  long skIdx = 0; // in case we eventually want to generalize
-
-  ctxt.parts.assign(2, CtxtPart(context, context.getCtxtPrimes()));
-
-  // make parts[0],parts[1] point to (1,s)
-  ctxt.parts[0].skHandle.setOne();
-  ctxt.parts[1].skHandle.setBase(skIdx);
-
   // Sample a new RLWE instance
-  const DoubleCRT& sKey = sKeys.at(skIdx);
-  double error_bound = RLWE(ctxt.parts[0], ctxt.parts[1], sKey, 1);
+  NTL::xdouble error_bound = encryptZero(ctxt, /*ptxtSpace=*/1);
 
   // This follows the same logic in PubKey::Encrypt(EncodedPtxt_CKKS).
   // See documentation there
@@ -1657,7 +2066,6 @@ void SecKey::Encrypt(Ctxt& ctxt, const EncodedPtxt_CKKS& eptxt) const
 
   // VJS-NOTE: we no longer round to the next power of two:
   // Then encoding routine should take care of setting mag correctly.
-  ctxt.primeSet = context.getCtxtPrimes();
   ctxt.ptxtMag = mag;
   ctxt.ratFactor = scale;
   ctxt.noiseBound = error_bound + err;
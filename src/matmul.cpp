@@ -14,10 +14,13 @@
 #include <algorithm>
 #include <NTL/BasicThreadPool.h>
 #include <helib/matmul.h>
+#include <helib/HoistedCtxt.h>
 #include <helib/norms.h>
 #include <helib/fhe_stats.h>
 #include <helib/apiAttributes.h>
 
+#include "binio.h"
+
 namespace helib {
 
 int fhe_test_force_bsgs = 0;
@@ -44,145 +47,6 @@ static bool comp_hoist(bool hoist)
 /********************************************************************/
 /****************** Auxiliary stuff: should go elsewhere   **********/
 
-/**
- * @class BasicAutomorphPrecon
- * @brief Pre-computation to speed many automorphism on the same ciphertext.
- *
- * The expensive part of homomorphic automorphism is breaking the ciphertext
- * parts into digits. The usual setting is we first rotate the ciphertext
- * parts, then break them into digits. But when we apply many automorphisms
- * it is faster to break the original ciphertext into digits, then rotate
- * the digits (as opposed to first rotate, then break).
- * An BasicAutomorphPrecon object breaks the original ciphertext and keeps
- * the digits, then when you call automorph is only needs to apply the
- * native automorphism and key switching to the digits, which is fast(er).
- **/
-class BasicAutomorphPrecon
-{
-  Ctxt ctxt;
-  NTL::xdouble noise;
-  std::vector<DoubleCRT> polyDigits;
-
-public:
-  BasicAutomorphPrecon(const Ctxt& _ctxt) : ctxt(_ctxt), noise(1.0)
-  {
-    HELIB_TIMER_START;
-    if (ctxt.parts.size() >= 1)
-      assertTrue(
-          ctxt.parts[0].skHandle.isOne(),
-          "Invalid ciphertext (secret key handle for part 0 is not one)");
-    if (ctxt.parts.size() <= 1)
-      return; // nothing to do
-
-    ctxt.cleanUp();
-    const Context& context = ctxt.getContext();
-    const PubKey& pubKey = ctxt.getPubKey();
-    long keyID = ctxt.getKeyID();
-
-    // The call to cleanUp() should ensure that this assertion passes.
-    assertTrue(ctxt.inCanonicalForm(keyID),
-               "Ciphertext is not in canonical form");
-
-    ctxt.relin_CKKS_adjust();
-
-    // Compute the number of digits that we need and the estimated
-    // added noise from switching this ciphertext.
-
-    NTL::xdouble addedNoise = ctxt.parts[1].breakIntoDigits(polyDigits);
-    NTL::xdouble max_ks_noise(0.0);
-    for (const KeySwitch& ks : pubKey.keySWlist()) {
-      if (max_ks_noise < ks.noiseBound)
-        max_ks_noise = ks.noiseBound;
-    }
-    addedNoise *= max_ks_noise;
-
-    double logProd = context.logOfProduct(context.getSpecialPrimes());
-    noise = ctxt.getNoiseBound() * NTL::xexp(logProd);
-
-    double ratio = NTL::conv<double>(addedNoise / noise);
-
-    HELIB_STATS_UPDATE("KS-noise-ratio-hoist", ratio);
-    if (ratio > 1) {
-      Warning("KS-noise-ratio-hoist=" + std::to_string(ratio) + "\n");
-    }
-    // std::stderr << "*** HOIST INIT\n";
-    // fprintf(stderr, "   KS-log-noise-ratio-hoist: %f\n",
-    // log(addedNoise/noise)/log(2.0));
-
-    noise += addedNoise;
-  }
-
-  std::shared_ptr<Ctxt> automorph(long k) const
-  {
-    HELIB_TIMER_START;
-
-    // A hack: record this automorphism rather than actually performing it
-    if (isSetAutomorphVals()) { // defined in NumbTh.h
-      recordAutomorphVal(k);
-      return std::make_shared<Ctxt>(ctxt);
-    }
-
-    if (k == 1 || ctxt.isEmpty())
-      return std::make_shared<Ctxt>(ctxt); // nothing to do
-
-    const Context& context = ctxt.getContext();
-    const PubKey& pubKey = ctxt.getPubKey();
-
-    // empty ctxt
-    std::shared_ptr<Ctxt> result = std::make_shared<Ctxt>(ZeroCtxtLike, ctxt);
-    result->noiseBound = noise; // noise estimate
-    result->intFactor = ctxt.intFactor;
-
-    result->primeSet = ctxt.primeSet | context.getSpecialPrimes();
-    // VJS-NOTE: added this to make addPart work
-
-    if (ctxt.isCKKS()) {
-      result->ptxtMag = ctxt.ptxtMag;
-      double logProd = context.logOfProduct(context.getSpecialPrimes());
-      result->ratFactor = ctxt.ratFactor * NTL::xexp(logProd);
-    }
-
-    if (ctxt.parts.size() == 1) { // only constant part, no need to key-switch
-      CtxtPart tmpPart = ctxt.parts[0];
-      tmpPart.automorph(k);
-      tmpPart.addPrimesAndScale(context.getSpecialPrimes());
-      result->addPart(tmpPart, /*matchPrimeSet=*/true);
-      return result;
-    }
-
-    // Ensure that we have a key-switching matrices for this automorphism
-    long keyID = ctxt.getKeyID();
-    if (!pubKey.isReachable(k, keyID)) {
-      throw LogicError("no key-switching matrices for k=" + std::to_string(k) +
-                       ", keyID=" + std::to_string(keyID));
-    }
-
-    // Get the first key-switching matrix for this automorphism
-    const KeySwitch& W = pubKey.getNextKSWmatrix(k, keyID);
-    long amt = W.fromKey.getPowerOfX();
-
-    // Start by rotating the constant part, no need to key-switch it
-    CtxtPart tmpPart = ctxt.parts[0];
-    tmpPart.automorph(amt);
-    tmpPart.addPrimesAndScale(context.getSpecialPrimes());
-    result->addPart(tmpPart, /*matchPrimeSet=*/true);
-
-    // Then rotate the digits and key-switch them
-    std::vector<DoubleCRT> tmpDigits = polyDigits;
-    for (auto&& tmp : tmpDigits) // rotate each of the digits
-      tmp.automorph(amt);
-
-    result->keySwitchDigits(W, tmpDigits); // key-switch the digits
-
-    long m = context.getM();
-    if ((amt - k) % m != 0) { // amt != k (mod m), more automorphisms to do
-      k = NTL::MulMod(k, NTL::InvMod(amt, m), m); // k *= amt^{-1} mod m
-      result->smartAutomorph(k);                  // call usual smartAutomorph
-    }
-    return result;
-  }
-};
-
 class GeneralAutomorphPrecon
 {
 public:
@@ -222,7 +86,7 @@ public:
 class GeneralAutomorphPrecon_FULL : public GeneralAutomorphPrecon
 {
 private:
-  BasicAutomorphPrecon precon;
+  HoistedCtxt precon;
   long dim;
   const PAlgebra& zMStar;
 
@@ -248,7 +112,7 @@ private:
   long D;
   long g;
   long h;
-  std::vector<std::shared_ptr<BasicAutomorphPrecon>> precon;
+  std::vector<std::shared_ptr<HoistedCtxt>> precon;
 
 public:
   GeneralAutomorphPrecon_BSGS(const Ctxt& _ctxt,
@@ -260,14 +124,14 @@ public:
     g = KSGiantStepSize(D);
     h = divc(D, g);
 
-    BasicAutomorphPrecon precon0(_ctxt);
+    HoistedCtxt precon0(_ctxt);
     precon.resize(h);
 
     // parallel for k in [0..h)
     NTL_EXEC_RANGE(h, first, last)
     for (long k = first; k < last; k++) {
       std::shared_ptr<Ctxt> p = precon0.automorph(zMStar.genToPow(dim, g * k));
-      precon[k] = std::make_shared<BasicAutomorphPrecon>(*p);
+      precon[k] = std::make_shared<HoistedCtxt>(*p);
     }
     NTL_EXEC_RANGE_END
   }
@@ -321,6 +185,21 @@ struct ConstMultiplier
 
   virtual void mul(Ctxt& ctxt) const = 0;
 
+  virtual void mulAdd(Ctxt& x, const Ctxt& b) const
+  // x += (*this)*b
+  {
+    Ctxt tmp(b);
+    mul(tmp);
+    x += tmp;
+  }
+
+  virtual void destMulAdd(Ctxt& x, Ctxt& b) const
+  // x += (*this)*b, b may be modified
+  {
+    mul(b);
+    x += b;
+  }
+
   virtual std::shared_ptr<ConstMultiplier> upgrade(
       const Context& context) const = 0;
   // Upgrade to DCRT. Returns null if no upgrade required
@@ -337,6 +216,21 @@ struct ConstMultiplier_DoubleCRT : ConstMultiplier
 
   void mul(Ctxt& ctxt) const override { ctxt.multByConstant(data, sz); }
 
+  // Accumulate in place with lazy reduction when x and b are compatible
+  void mulAdd(Ctxt& x, const Ctxt& b) const override
+  {
+    x.addConstantProduct(data, b, sz);
+  }
+
+  void destMulAdd(Ctxt& x, Ctxt& b) const override
+  {
+    if (x.isEmpty()) {
+      mul(b);
+      x += b;
+    } else
+      x.addConstantProduct(data, b, sz);
+  }
+
   std::shared_ptr<ConstMultiplier> upgrade(
       UNUSED const Context& context) const override
   {
@@ -391,20 +285,30 @@ std::shared_ptr<ConstMultiplier> build_ConstMultiplier(
 void MulAdd(Ctxt& x, const std::shared_ptr<ConstMultiplier>& a, const Ctxt& b)
 // x += a*b
 {
-  if (a) {
-    Ctxt tmp(b);
-    a->mul(tmp);
-    x += tmp;
-  }
+  if (a)
+    a->mulAdd(x, b);
 }
 
 void DestMulAdd(Ctxt& x, const std::shared_ptr<ConstMultiplier>& a, Ctxt& b)
 // x += a*b, b may be modified
 {
-  if (a) {
-    a->mul(b);
-    x += b;
-  }
+  if (a)
+    a->destMulAdd(x, b);
+}
+
+std::shared_ptr<ConstMultiplier> build_ConstMultiplier(const zzX& poly,
+                                                       long k,
+                                                       const Context& context)
+{
+  if (IsZero(poly))
+    return nullptr;
+
+  // The automorphism permutes the canonical embedding, so the size of the
+  // constant does not change
+  double sz = embeddingLargestCoeff(poly, context.getZMStar());
+  DoubleCRT data(poly, context, context.fullPrimes());
+  data.automorph(k);
+  return std::make_shared<ConstMultiplier_DoubleCRT>(data, sz);
 }
 
 void ConstMultiplierCache::upgrade(const Context& context)
@@ -421,6 +325,104 @@ void ConstMultiplierCache::upgrade(const Context& context)
   NTL_EXEC_RANGE_END
 }
 
+// Tags of the constants in the binary format of a ConstMultiplierCache
+enum ConstMultiplierTag : long
+{
+  CONST_NONE = 0,
+  CONST_ZZX = 1,
+  CONST_DCRT = 2
+};
+
+void ConstMultiplierCache::writeTo(std::ostream& str) const
+{
+  write_raw_int(str, multiplier.size());
+  for (const auto& ptr : multiplier) {
+    if (!ptr) {
+      write_raw_int(str, CONST_NONE);
+    } else if (auto zzx = dynamic_cast<const ConstMultiplier_zzX*>(ptr.get())) {
+      write_raw_int(str, CONST_ZZX);
+      write_ntl_vec_long(str, zzx->data);
+    } else if (auto dcrt =
+                   dynamic_cast<const ConstMultiplier_DoubleCRT*>(ptr.get())) {
+      write_raw_int(str, CONST_DCRT);
+      dcrt->data.writeTo(str);
+      write_raw_double(str, dcrt->sz);
+    } else {
+      throw LogicError("ConstMultiplierCache: cannot write CKKS constants");
+    }
+  }
+}
+
+// Read the index set that starts a DoubleCRT in binary format, checking that
+// it is a set of primes of context (IndexSet::readFrom would allocate for
+// whatever index it reads)
+static void checkPrimeSet(std::istream& str, const Context& context)
+{
+  long card = read_raw_int(str);
+  assertInRange<IOError>(card,
+                         0l,
+                         context.numPrimes(),
+                         "ConstMultiplierCache: bad prime set",
+                         true);
+  for (long k = 0; k < card; k++) {
+    long j = read_raw_int(str);
+    assertInRange<IOError>(j,
+                           0l,
+                           context.numPrimes(),
+                           "ConstMultiplierCache: bad prime set");
+  }
+  assertTrue<IOError>(str.good(), "ConstMultiplierCache: truncated stream");
+}
+
+void ConstMultiplierCache::read(std::istream& str,
+                                const Context& context,
+                                long n)
+{
+  // n is what the caller indexes, so check it before allocating anything
+  long count = read_raw_int(str);
+  assertTrue<IOError>(count == n && str.good(),
+                      "ConstMultiplierCache: bad number of constants");
+  multiplier.clear();
+  multiplier.reserve(n);
+  for (long i = 0; i < n; i++) {
+    long tag = read_raw_int(str);
+    assertTrue<IOError>(str.good(), "ConstMultiplierCache: truncated stream");
+    switch (tag) {
+    case CONST_NONE:
+      multiplier.emplace_back(nullptr);
+      break;
+    case CONST_ZZX: {
+      // the length is checked before read_ntl_vec_long allocates
+      std::streampos pos = str.tellg();
+      long len = read_raw_int32(str);
+      assertInRange<IOError>(len,
+                             0l,
+                             context.getPhiM(),
+                             "ConstMultiplierCache: bad constant length",
+                             true);
+      str.seekg(pos);
+      zzX data;
+      read_ntl_vec_long(str, data);
+      multiplier.push_back(std::make_shared<ConstMultiplier_zzX>(data));
+      break;
+    }
+    case CONST_DCRT: {
+      std::streampos pos = str.tellg();
+      checkPrimeSet(str, context);
+      str.seekg(pos);
+      DoubleCRT data = DoubleCRT::readFrom(str, context);
+      double sz = read_raw_double(str);
+      multiplier.push_back(
+          std::make_shared<ConstMultiplier_DoubleCRT>(data, sz));
+      break;
+    }
+    default:
+      throw IOError("ConstMultiplierCache: unknown type of constant " +
+                    std::to_string(tag));
+    }
+  }
+}
+
 static inline long dimSz(const EncryptedArray& ea, long dim)
 {
   return (dim == ea.dimension()) ? 1 : ea.sizeOfDimension(dim);
@@ -946,7 +948,7 @@ void GenBabySteps(std::vector<std::shared_ptr<Ctxt>>& v,
 
   if (fhe_test_force_hoist >= 0 &&
       ctxt.getPubKey().getKSStrategy(dim) != HELIB_KSS_UNKNOWN) {
-    BasicAutomorphPrecon precon(ctxt);
+    HoistedCtxt precon(ctxt);
 
     NTL_EXEC_RANGE(n, first, last)
     for (long j : range(first, last)) {
@@ -970,6 +972,43 @@ void GenBabySteps(std::vector<std::shared_ptr<Ctxt>>& v,
   }
 }
 
+MatMul1DExec::MatMul1DExec(const EncryptedArray& _ea, std::istream& str) :
+    ea(_ea)
+{
+  dim = read_raw_int(str);
+  D = read_raw_int(str);
+  long nativeFlag = read_raw_int(str);
+  long minimalFlag = read_raw_int(str);
+  g = read_raw_int(str);
+  assertInRange<IOError>(dim,
+                         0l,
+                         ea.dimension(),
+                         "MatMul1DExec: bad dimension",
+                         true);
+  assertTrue<IOError>(D == dimSz(ea, dim) && nativeFlag == dimNative(ea, dim),
+                      "MatMul1DExec: tables do not match the EA");
+  assertTrue<IOError>(minimalFlag == 0 || minimalFlag == 1,
+                      "MatMul1DExec: bad minimal flag");
+  native = nativeFlag;
+  minimal = minimalFlag;
+  // mul indexes the constants by i < D, with giant steps of g
+  assertTrue<IOError>(g == 0 || g == KSGiantStepSize(D),
+                      "MatMul1DExec: bad giant step size");
+  cache.read(str, ea.getContext(), D);
+  cache1.read(str, ea.getContext(), native ? 0 : D);
+}
+
+void MatMul1DExec::writeTo(std::ostream& str) const
+{
+  write_raw_int(str, dim);
+  write_raw_int(str, D);
+  write_raw_int(str, native);
+  write_raw_int(str, minimal);
+  write_raw_int(str, g);
+  cache.writeTo(str);
+  cache1.writeTo(str);
+}
+
 void MatMul1DExec::mul(Ctxt& ctxt) const
 {
   HELIB_NTIMER_START(mul_MatMul1DExec);
@@ -1694,6 +1733,42 @@ BlockMatMul1DExec::BlockMatMul1DExec(const BlockMatMul1D& mat,
                                            strategy);
 }
 
+BlockMatMul1DExec::BlockMatMul1DExec(const EncryptedArray& _ea,
+                                     std::istream& str) :
+    ea(_ea)
+{
+  dim = read_raw_int(str);
+  D = read_raw_int(str);
+  d = read_raw_int(str);
+  long nativeFlag = read_raw_int(str);
+  strategy = read_raw_int(str);
+  assertInRange<IOError>(dim,
+                         0l,
+                         ea.dimension(),
+                         "BlockMatMul1DExec: bad dimension",
+                         true);
+  assertTrue<IOError>(D == dimSz(ea, dim) && d == ea.getDegree() &&
+                          nativeFlag == dimNative(ea, dim),
+                      "BlockMatMul1DExec: tables do not match the EA");
+  native = nativeFlag;
+  assertTrue<IOError>(strategy == (D >= d ? +1 : -1),
+                      "BlockMatMul1DExec: bad strategy");
+  // mul indexes the constants by i * d + j < D * d
+  cache.read(str, ea.getContext(), D * d);
+  cache1.read(str, ea.getContext(), native ? 0 : D * d);
+}
+
+void BlockMatMul1DExec::writeTo(std::ostream& str) const
+{
+  write_raw_int(str, dim);
+  write_raw_int(str, D);
+  write_raw_int(str, d);
+  write_raw_int(str, native);
+  write_raw_int(str, strategy);
+  cache.writeTo(str);
+  cache1.writeTo(str);
+}
+
 void BlockMatMul1DExec::mul(Ctxt& ctxt) const
 {
   HELIB_NTIMER_START(mul_BlockMatMul1DExec);
@@ -2876,7 +2951,7 @@ void traceMap(Ctxt& ctxt)
   long strategy = ctxt.getPubKey().getKSStrategy(-1);
 
   if (strategy == HELIB_KSS_FULL && d <= HELIB_TRACE_THRESH) {
-    BasicAutomorphPrecon precon(ctxt);
+    HoistedCtxt precon(ctxt);
     Ctxt acc(ctxt);
 
     for (long i : range(1, d)) {
@@ -16,6 +16,8 @@
 #include <cmath>
 #include <algorithm>
 
+#include <NTL/BasicThreadPool.h>
+
 #include <helib/NumbTh.h>
 #include <helib/DoubleCRT.h>
 #include <helib/norms.h>
@@ -39,6 +41,12 @@ namespace helib {
 // This is only used in embeddingLargestCoeff_x2.
 // Experimentally, one half FFT seems a bit better, so setting to 0 is best.
 
+#define FFT_BATCH (8)
+// the number of transforms that the batch functions (embeddingLargestCoeffs,
+// and the vector versions of CKKS_canonicalEmbedding and CKKS_embedInSlots)
+// pass to each PGFFT::apply_many call; each thread works on FFT_BATCH
+// vectors at a time.
+
 long sumOfCoeffs(const zzX& f) // = f(1)
 {
   long sum = 0;
@@ -263,13 +271,12 @@ double embeddingLargestCoeff(const std::vector<double>& f, const PAlgebra& palg)
 // This is a standard technique for computing the two real DFT's
 // using one complex DFT.
 
-static void basic_embeddingLargestCoeff_x2(double& norm1,
-                                           double& norm2,
-                                           const std::vector<double>& f1,
-                                           const std::vector<double>& f2,
-                                           const PAlgebra& palg)
+// The input buffer (of size m) of the DFT for the pair f1, f2
+static void basic_x2_fill(cx_double* buf,
+                          const std::vector<double>& f1,
+                          const std::vector<double>& f2,
+                          const PAlgebra& palg)
 {
-
   long m = palg.getM();
   long sz1 = f1.size();
   long sz2 = f2.size();
@@ -280,7 +287,6 @@ static void basic_embeddingLargestCoeff_x2(double& norm1,
   long sz_max = std::max(sz1, sz2);
   long sz_min = std::min(sz1, sz2);
 
-  std::vector<cx_double> buf(m);
   for (long i : range(0, sz_min))
     buf[i] = cx_double(f1[i], f2[i]);
   for (long i : range(sz_min, sz1))
@@ -289,9 +295,15 @@ static void basic_embeddingLargestCoeff_x2(double& norm1,
     buf[i] = cx_double(0, f2[i]);
   for (long i : range(sz_max, m))
     buf[i] = 0;
+}
 
-  palg.getFFTInfo().apply(&buf[0]);
-
+// The norms of the pair, from the output buffer of the DFT
+static void basic_x2_norms(double& norm1,
+                           double& norm2,
+                           const cx_double* buf,
+                           const PAlgebra& palg)
+{
+  long m = palg.getM();
   double mx1 = 0, mx2 = 0;
 
   for (long i = 1; i <= m / 2; i++) {
@@ -313,6 +325,18 @@ static void basic_embeddingLargestCoeff_x2(double& norm1,
 
   norm1 = sqrt(mx1);
   norm2 = sqrt(mx2);
+}
+
+static void basic_embeddingLargestCoeff_x2(double& norm1,
+                                           double& norm2,
+                                           const std::vector<double>& f1,
+                                           const std::vector<double>& f2,
+                                           const PAlgebra& palg)
+{
+  std::vector<cx_double> buf(palg.getM());
+  basic_x2_fill(&buf[0], f1, f2, palg);
+  palg.getFFTInfo().apply(&buf[0]);
+  basic_x2_norms(norm1, norm2, &buf[0], palg);
 
 #if 0
 // debugging code
@@ -336,13 +360,12 @@ static void basic_embeddingLargestCoeff_x2(double& norm1,
 #endif
 }
 
-static void half_embeddingLargestCoeff_x2(double& norm1,
-                                          double& norm2,
-                                          const std::vector<double>& f1,
-                                          const std::vector<double>& f2,
-                                          const PAlgebra& palg)
+// The input buffer (of size m/2) of the DFT for the pair f1, f2
+static void half_x2_fill(cx_double* buf,
+                         const std::vector<double>& f1,
+                         const std::vector<double>& f2,
+                         const PAlgebra& palg)
 {
-
   long m = palg.getM();
   long sz1 = f1.size();
   long sz2 = f2.size();
@@ -358,7 +381,6 @@ static void half_embeddingLargestCoeff_x2(double& norm1,
 
   // Odd-Power Trick.  See above.
 
-  std::vector<cx_double> buf(m / 2);
   for (long i : range(0, sz_min))
     buf[i] = MUL(cx_double(f1[i], f2[i]), pow[i]);
   for (long i : range(sz_min, sz1))
@@ -367,9 +389,15 @@ static void half_embeddingLargestCoeff_x2(double& norm1,
     buf[i] = MUL(cx_double(0, f2[i]), pow[i]);
   for (long i : range(sz_max, m / 2))
     buf[i] = 0;
+}
 
-  hfft.fft.apply(&buf[0]);
-
+// The norms of the pair, from the output buffer of the DFT
+static void half_x2_norms(double& norm1,
+                          double& norm2,
+                          const cx_double* buf,
+                          const PAlgebra& palg)
+{
+  long m = palg.getM();
   double mx1 = 0, mx2 = 0;
 
   for (long i = 1; i <= m / 2; i += 2) {
@@ -391,6 +419,18 @@ static void half_embeddingLargestCoeff_x2(double& norm1,
 
   norm1 = sqrt(mx1);
   norm2 = sqrt(mx2);
+}
+
+static void half_embeddingLargestCoeff_x2(double& norm1,
+                                          double& norm2,
+                                          const std::vector<double>& f1,
+                                          const std::vector<double>& f2,
+                                          const PAlgebra& palg)
+{
+  std::vector<cx_double> buf(palg.getM() / 2);
+  half_x2_fill(&buf[0], f1, f2, palg);
+  palg.getHalfFFTInfo().fft.apply(&buf[0]);
+  half_x2_norms(norm1, norm2, &buf[0], palg);
 
 #if 0
 // debugging code
@@ -433,6 +473,58 @@ void embeddingLargestCoeff_x2(double& norm1,
     basic_embeddingLargestCoeff_x2(norm1, norm2, f1, f2, palg);
 }
 
+void embeddingLargestCoeffs(std::vector<double>& norms,
+                            const std::vector<std::vector<double>>& f,
+                            const PAlgebra& palg)
+{
+  HELIB_NTIMER_START(AAA_embeddingLargest_many);
+
+  long n = f.size();
+  norms.resize(n);
+
+  long m = palg.getM();
+  bool half = USE_HALF_FFT && m % 2 == 0;
+  if (half && USE_QUARTER_FFT && USE_TWO_QUARTERS && m % 4 == 0) {
+    for (long i : range(n))
+      norms[i] = quarter_embeddingLargestCoeff(f[i], palg);
+    return;
+  }
+
+  // Two vectors per transform, see embeddingLargestCoeff_x2
+  long pairs = n / 2;
+  long len = half ? m / 2 : m;
+  long chunks = divc(pairs, FFT_BATCH);
+  const PGFFT& fft = half ? palg.getHalfFFTInfo().fft : palg.getFFTInfo();
+
+  NTL_EXEC_RANGE(chunks, first, last)
+  std::vector<cx_double> buf(len * FFT_BATCH);
+  for (long c : range(first, last)) {
+    long lo = c * FFT_BATCH;
+    long count = std::min(pairs - lo, long(FFT_BATCH));
+    for (long j : range(count)) {
+      const std::vector<double>& f1 = f[2 * (lo + j)];
+      const std::vector<double>& f2 = f[2 * (lo + j) + 1];
+      if (half)
+        half_x2_fill(&buf[j * len], f1, f2, palg);
+      else
+        basic_x2_fill(&buf[j * len], f1, f2, palg);
+    }
+    fft.apply_many(&buf[0], count, len);
+    for (long j : range(count)) {
+      double& norm1 = norms[2 * (lo + j)];
+      double& norm2 = norms[2 * (lo + j) + 1];
+      if (half)
+        half_x2_norms(norm1, norm2, &buf[j * len], palg);
+      else
+        basic_x2_norms(norm1, norm2, &buf[j * len], palg);
+    }
+  }
+  NTL_EXEC_RANGE_END
+
+  if (n % 2)
+    norms[n - 1] = embeddingLargestCoeff(f[n - 1], palg);
+}
+
 double embeddingLargestCoeff(const zzX& f, const PAlgebra& palg)
 {
   std::vector<double> ff;
@@ -492,33 +584,47 @@ NTL::xdouble embeddingLargestCoeff(const NTL::ZZX& f, const PAlgebra& palg)
 // logic.  We can revisit this if this code ever becomes a bottleneck,
 // but this does not seem to be a significant issue at the moment.
 
-void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
-                             const std::vector<double>& in,
-                             const PAlgebra& palg)
+// The input buffer (of size m/2) of the DFT of CKKS_canonicalEmbedding
+static void CKKS_canonical_fill(cx_double* buf,
+                                const std::vector<double>& in,
+                                const PAlgebra& palg)
 {
-  HELIB_TIMER_START;
-
   long sz = in.size();
   long m = palg.getM();
 
   if (!(palg.getP() == -1 && palg.getPow2() >= 2 && sz <= m / 2))
     throw LogicError("bad args to CKKS_canonicalEmbedding");
 
-  const half_FFT& hfft = palg.getHalfFFTInfo();
-  const cx_double* pow = &hfft.pow[0];
-
-  std::vector<cx_double> buf(m / 2);
+  const cx_double* pow = &palg.getHalfFFTInfo().pow[0];
   for (long i : range(0, sz))
     buf[i] = in[i] * pow[i];
   for (long i : range(sz, m / 2))
     buf[i] = 0;
-  hfft.fft.apply(&buf[0]);
+}
 
+// The embedding, from the output buffer of the DFT
+static void CKKS_canonical_extract(std::vector<cx_double>& v,
+                                   const cx_double* buf,
+                                   const PAlgebra& palg)
+{
+  long m = palg.getM();
   v.resize(m / 4);
   for (long i : range(m / 4))
     v[m / 4 - i - 1] = buf[palg.ith_rep(i) >> 1];
 }
 
+void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
+                             const std::vector<double>& in,
+                             const PAlgebra& palg)
+{
+  HELIB_TIMER_START;
+
+  std::vector<cx_double> buf(palg.getM() / 2);
+  CKKS_canonical_fill(&buf[0], in, palg);
+  palg.getHalfFFTInfo().fft.apply(&buf[0]);
+  CKKS_canonical_extract(v, &buf[0], palg);
+}
+
 void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
                              const zzX& f,
                              const PAlgebra& palg)
@@ -543,6 +649,35 @@ void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
   CKKS_canonicalEmbedding(v, x, palg);
 }
 
+void CKKS_canonicalEmbedding(std::vector<std::vector<cx_double>>& v,
+                             const std::vector<zzX>& f,
+                             const PAlgebra& palg)
+{
+  HELIB_TIMER_START;
+
+  long n = f.size();
+  long len = palg.getM() / 2;
+  long chunks = divc(n, FFT_BATCH);
+  const PGFFT& fft = palg.getHalfFFTInfo().fft;
+  v.resize(n);
+
+  NTL_EXEC_RANGE(chunks, first, last)
+  std::vector<cx_double> buf(len * FFT_BATCH);
+  std::vector<double> x;
+  for (long c : range(first, last)) {
+    long lo = c * FFT_BATCH;
+    long count = std::min(n - lo, long(FFT_BATCH));
+    for (long j : range(count)) {
+      convert(x, f[lo + j]);
+      CKKS_canonical_fill(&buf[j * len], x, palg);
+    }
+    fft.apply_many(&buf[0], count, len);
+    for (long j : range(count))
+      CKKS_canonical_extract(v[lo + j], &buf[j * len], palg);
+  }
+  NTL_EXEC_RANGE_END
+}
+
 // The forward transform (as computed by CKKS_canonicalEmbedding)
 // is computing the linear transformation:
 //    DFT * D
@@ -571,21 +706,18 @@ void CKKS_canonicalEmbedding(std::vector<cx_double>& v,
 // then applies D^{-1} * DFT^{-1}, and then reverses the expanding
 // step by dropping the complex part.
 
-void CKKS_embedInSlots(zzX& f,
-                       const std::vector<cx_double>& v,
-                       const PAlgebra& palg,
-                       double scaling)
-
+// The input buffer (of size m/2) of the DFT of CKKS_embedInSlots
+static void CKKS_embed_fill(cx_double* buf,
+                            const std::vector<cx_double>& v,
+                            const PAlgebra& palg)
 {
-  HELIB_TIMER_START;
-
   long v_sz = v.size();
   long m = palg.getM();
 
   if (!(palg.getP() == -1 && palg.getPow2() >= 2))
     throw LogicError("bad args to CKKS_canonicalEmbedding");
 
-  std::vector<cx_double> buf(m / 2, cx_double(0));
+  std::fill(buf, buf + m / 2, cx_double(0));
   for (long i : range(m / 4)) {
     long j = palg.ith_rep(i);
     long ii = m / 4 - i - 1;
@@ -594,14 +726,20 @@ void CKKS_embedInSlots(zzX& f,
       buf[(m - j) >> 1] = v[ii];
     }
   }
+}
 
-  const half_FFT& hfft = palg.getHalfFFTInfo();
-  const cx_double* pow = &hfft.pow[0];
+// The scaled and rounded polynomial, from the output buffer of the DFT
+static void CKKS_embed_extract(zzX& f,
+                               const cx_double* buf,
+                               const PAlgebra& palg,
+                               double scaling)
+{
+  long m = palg.getM();
+  const cx_double* pow = &palg.getHalfFFTInfo().pow[0];
 
   scaling /= (m / 2);
   // This is becuase DFT^{-1} = 1/(m/2) times a DFT matrix for conj(V)
 
-  hfft.fft.apply(&buf[0]);
   f.SetLength(m / 2);
   for (long i : range(m / 2)) {
     double f_i = std::round(MUL(buf[i], pow[i]).real() * scaling);
@@ -614,6 +752,51 @@ void CKKS_embedInSlots(zzX& f,
   normalize(f);
 }
 
+void CKKS_embedInSlots(zzX& f,
+                       const std::vector<cx_double>& v,
+                       const PAlgebra& palg,
+                       double scaling)
+
+{
+  HELIB_TIMER_START;
+
+  std::vector<cx_double> buf(palg.getM() / 2);
+  CKKS_embed_fill(&buf[0], v, palg);
+  palg.getHalfFFTInfo().fft.apply(&buf[0]);
+  CKKS_embed_extract(f, &buf[0], palg, scaling);
+}
+
+void CKKS_embedInSlots(std::vector<zzX>& f,
+                       const std::vector<std::vector<cx_double>>& v,
+                       const PAlgebra& palg,
+                       const std::vector<double>& scaling)
+{
+  HELIB_TIMER_START;
+
+  assertEq<InvalidArgument>(lsize(v),
+                            lsize(scaling),
+                            "CKKS_embedInSlots: size mismatch");
+
+  long n = v.size();
+  long len = palg.getM() / 2;
+  long chunks = divc(n, FFT_BATCH);
+  const PGFFT& fft = palg.getHalfFFTInfo().fft;
+  f.resize(n);
+
+  NTL_EXEC_RANGE(chunks, first, last)
+  std::vector<cx_double> buf(len * FFT_BATCH);
+  for (long c : range(first, last)) {
+    long lo = c * FFT_BATCH;
+    long count = std::min(n - lo, long(FFT_BATCH));
+    for (long j : range(count))
+      CKKS_embed_fill(&buf[j * len], v[lo + j], palg);
+    fft.apply_many(&buf[0], count, len);
+    for (long j : range(count))
+      CKKS_embed_extract(f[lo + j], &buf[j * len], palg, scaling[lo + j]);
+  }
+  NTL_EXEC_RANGE_END
+}
+
 // === obsolete versions of canonical embedding and inverse ===
 
 // These are less efficient, and seem to have some logic errors.
@@ -554,6 +554,8 @@ PermPrecomp::PermPrecomp(const PermIndepPrecomp& pip, const Permut& _pi) :
     throw LogicError("buildOptimalTrees failed");
 
   net.buildNetwork(pi, pip.trees);
+  if (!ea.isCKKS())
+    exec.reset(new PermNetworkExec(net, ea));
 }
 
 template <typename type>
@@ -9,8 +9,14 @@
  * See the License for the specific language governing permissions and
  * limitations under the License. See accompanying LICENSE file.
  */
+#include <algorithm>
+#include <memory>
+
+#include <NTL/BasicThreadPool.h>
+
 #include <helib/Context.h>
 #include <helib/polyEval.h>
+#include <helib/timing.h>
 
 namespace helib {
 
@@ -28,6 +34,40 @@ Ctxt& DynamicCtxtPowers::getPower(long e)
   return v[e - 1];
 }
 
+// Run f(0), ..., f(count-1), split across the threads when there are at
+// least as many calls as threads, otherwise one at a time with the threads
+// used inside each call
+template <typename Fn>
+static void execRange(long count, const Fn& f)
+{
+  if (count > 1 && count >= NTL::AvailableThreads()) {
+    NTL_EXEC_RANGE(count, first, last)
+    for (long i = first; i < last; i++)
+      f(i);
+    NTL_EXEC_RANGE_END
+  } else {
+    for (long i = 0; i < count; i++)
+      f(i);
+  }
+}
+
+// Computes all the powers, level by level. getPower computes X^e from X^k
+// and X^{e-k}, with k the largest power of two below e, so the powers in
+// (2^{j-1}, 2^j] only depend on the powers up to 2^{j-1}.
+void DynamicCtxtPowers::computeAll()
+{
+  for (long lo = 1; lo < size(); lo *= 2) {
+    long hi = std::min(2 * lo, size());
+    std::vector<long> missing;
+    for (long e = lo + 1; e <= hi; e++)
+      if (!isPowerComputed(e))
+        missing.push_back(e);
+
+    // Each thread writes its own powers and only reads the lower ones
+    execRange(lsize(missing), [&](long i) { getPower(missing[i]); });
+  }
+}
+
 // Local functions for polynomial evaluation in some special cases
 static void simplePolyEval(Ctxt& ret,
                            const NTL::ZZX& poly,
@@ -162,6 +202,7 @@ void polyEval(Ctxt& ret, NTL::ZZX poly, const Ctxt& x, long k)
 
   long n = divc(deg(poly), k); // n = ceil(deg(p)/k), deg(p) >= k*n
   DynamicCtxtPowers babyStep(x, k);
+  babyStep.computeAll(); // the evaluation uses (almost) all of them
   const Ctxt& x2k = babyStep.getPower(k);
 
   // Special case when deg(p)>k*(2^e -1)
@@ -388,6 +429,158 @@ static void recursivePolyEval(Ctxt& ret,
   ret += tmp;
 }
 
+// A part of a polynomial in blockPolyEval: a ciphertext (if any) plus a
+// constant. The constants are kept out of the ciphertexts until they are
+// added to one, so multiplying a constant by a giant step costs no level.
+namespace {
+template <typename Coeff>
+struct PolyPart
+{
+  std::unique_ptr<Ctxt> ctxt;
+  Coeff constant{};
+};
+} // namespace
+
+// Set part to sum_i coeffs[first+i] * X^i for i < k
+template <typename Coeff>
+static void blockLeaf(PolyPart<Coeff>& part,
+                      const std::vector<Coeff>& coeffs,
+                      long first,
+                      long k,
+                      const DynamicCtxtPowers& babyStep)
+{
+  long end = std::min(first + k, lsize(coeffs));
+  part.constant = coeffs[first];
+  for (long i = first + 1; i < end; i++) {
+    if (coeffs[i] == 0)
+      continue;
+    Ctxt tmp = babyStep.getVector()[i - first - 1]; // X^{i-first}
+    tmp.multByConstant(coeffs[i]);
+    if (part.ctxt)
+      *part.ctxt += tmp;
+    else
+      part.ctxt.reset(new Ctxt(std::move(tmp)));
+  }
+}
+
+// Set ret = lo + giant * hi
+template <typename Coeff>
+static void blockCombine(PolyPart<Coeff>& ret,
+                         PolyPart<Coeff>& lo,
+                         PolyPart<Coeff>& hi,
+                         const Ctxt& giant)
+{
+  std::unique_ptr<Ctxt> prod;
+  if (hi.ctxt) {
+    prod = std::move(hi.ctxt);
+    if (hi.constant != 0)
+      prod->addConstant(hi.constant);
+    prod->multiplyBy(giant);
+  } else if (hi.constant != 0) {
+    prod.reset(new Ctxt(giant));
+    prod->multByConstant(hi.constant);
+  }
+
+  if (prod && lo.ctxt)
+    *prod += *lo.ctxt;
+  ret.ctxt = prod ? std::move(prod) : std::move(lo.ctxt);
+  ret.constant = lo.constant;
+}
+
+// Baby-step/giant-step evaluation with a balanced tree of giant steps.
+// With D = 2^E >= deg+1 and the k baby steps a power of two, the polynomial
+// is cut into D/k blocks of degree < k, and evaluated as
+//   p(X) = p_lo(X) + X^{D/2} * p_hi(X)
+// recursively. The blocks and each level of the tree are independent, and
+// the depth is E = ceil(log2(deg+1)): the baby steps X^i, i < k, have depth
+// at most log2(k) and the giant step X^{k*2^j} has depth log2(k)+j.
+template <typename Coeff>
+static void blockPolyEval(Ctxt& ret,
+                          std::vector<Coeff> coeffs,
+                          const Ctxt& x,
+                          long k)
+{
+  HELIB_TIMER_START;
+  while (!coeffs.empty() && coeffs.back() == 0)
+    coeffs.pop_back();
+
+  PolyPart<Coeff> root;
+  if (lsize(coeffs) > 1) {
+    long E = NTL::NextPowerOfTwo(lsize(coeffs)); // 2^E >= deg+1
+    if (k <= 0)
+      k = 1L << (E / 2); // about sqrt(deg)
+    assertEq<InvalidArgument>(k,
+                              1L << NTL::NextPowerOfTwo(k),
+                              "Number of baby steps must be a power of two");
+    k = std::min(k, 1L << E);
+
+    long nBlocks = divc(lsize(coeffs), k);
+    long logBlocks = NTL::NextPowerOfTwo(nBlocks);
+
+    // X^1, ..., X^{k-1} for the blocks, and X^k for the first giant step
+    DynamicCtxtPowers babyStep(x, logBlocks > 0 ? k : k - 1);
+    babyStep.computeAll();
+
+    std::vector<PolyPart<Coeff>> parts(1L << logBlocks);
+    execRange(nBlocks, [&](long j) {
+      blockLeaf(parts[j], coeffs, j * k, k, babyStep);
+    });
+
+    Ctxt giant(ZeroCtxtLike, x);
+    for (long level = 0; level < logBlocks; level++) {
+      if (level == 0)
+        giant = babyStep.getPower(k);
+      else
+        giant.square(); // X^{k*2^level}
+
+      std::vector<PolyPart<Coeff>> next(parts.size() / 2);
+      execRange(lsize(next), [&](long j) {
+        blockCombine(next[j], parts[2 * j], parts[2 * j + 1], giant);
+      });
+      parts.swap(next);
+    }
+    root = std::move(parts[0]);
+  } else if (!coeffs.empty()) {
+    root.constant = coeffs[0];
+  }
+
+  if (root.ctxt) {
+    ret = std::move(*root.ctxt);
+  } else { // a constant: zero with the primes and scale of x, plus it
+    Ctxt zero = x;
+    zero -= x;
+    ret = std::move(zero);
+  }
+  if (root.constant != 0)
+    ret.addConstant(root.constant);
+}
+
+void polyEvalParallel(Ctxt& ret, const NTL::ZZX& poly, const Ctxt& x, long k)
+{
+  assertFalse<InvalidArgument>(x.isCKKS(),
+                               "polyEvalParallel on ZZX is for BGV, "
+                               "use the real coefficients for CKKS");
+  // The coefficients mod p, in the symmetric interval as in simplePolyEval
+  const NTL::ZZ p = NTL::to_ZZ(x.getPtxtSpace());
+  std::vector<NTL::ZZ> coeffs(deg(poly) + 1);
+  for (long i = 0; i <= deg(poly); i++) {
+    rem(coeffs[i], poly[i], p);
+    if (coeffs[i] > p / 2)
+      coeffs[i] -= p;
+  }
+  blockPolyEval(ret, std::move(coeffs), x, k);
+}
+
+void polyEvalParallel(Ctxt& ret,
+                      const std::vector<double>& poly,
+                      const Ctxt& x,
+                      long k)
+{
+  assertTrue<InvalidArgument>(x.isCKKS(),
+                              "polyEvalParallel on doubles is for CKKS");
+  blockPolyEval(ret, poly, x, k);
+}
+
 // raise ciphertext to some power
 void Ctxt::power(long e)
 {
@@ -10,6 +10,7 @@
  * limitations under the License. See accompanying LICENSE file.
  */
 #include <NTL/BasicThreadPool.h>
+#include <functional>
 
 #include <helib/recryption.h>
 #include <helib/EncryptedArray.h>
@@ -23,6 +24,8 @@
 #include <helib/fhe_stats.h>
 #include <helib/log.h>
 
+#include "binio.h"
+
 #ifdef HELIB_DEBUG
 
 #include <helib/debugging.h>
@@ -266,18 +269,11 @@ bool RecryptData::operator==(const RecryptData& other) const
   return true;
 }
 
-// The main method
-void RecryptData::init(const Context& context,
-                       const NTL::Vec<long>& mvec_,
-                       bool enableThick,
-                       bool build_cache_,
-                       bool minimal)
+void RecryptData::initBase(const Context& context,
+                           const NTL::Vec<long>& mvec_,
+                           bool enableThick,
+                           bool build_cache_)
 {
-  if (alMod != nullptr) { // were we called for a second time?
-    std::cerr << "@Warning: multiple calls to RecryptData::init\n";
-    return;
-  }
-
   // sanity check
   assertEq(computeProd(mvec_),
            context.getM(),
@@ -312,6 +308,21 @@ void RecryptData::init(const Context& context,
   // Polynomial defaults to F0, PAlgebraMod explicitly given
 
   p2dConv = std::make_shared<PowerfulDCRT>(context, mvec);
+}
+
+// The main method
+void RecryptData::init(const Context& context,
+                       const NTL::Vec<long>& mvec_,
+                       bool enableThick,
+                       bool build_cache_,
+                       bool minimal)
+{
+  if (alMod != nullptr) { // were we called for a second time?
+    std::cerr << "@Warning: multiple calls to RecryptData::init\n";
+    return;
+  }
+
+  initBase(context, mvec_, enableThick, build_cache_);
 
   if (!enableThick)
     return;
@@ -350,6 +361,52 @@ void RecryptData::init(const Context& context,
                                         build_cache);
 }
 
+static void writeZZXVec(std::ostream& str, const std::vector<NTL::ZZX>& v)
+{
+  write_raw_int(str, v.size());
+  for (const NTL::ZZX& poly : v)
+    write_raw_ZZX(str, poly);
+}
+
+// Read exactly n polynomials
+static void readZZXVec(std::istream& str, std::vector<NTL::ZZX>& v, long n)
+{
+  long count = read_raw_int(str);
+  assertTrue<IOError>(count == n && str.good(), "Bad number of polynomials");
+  v.resize(n);
+  for (NTL::ZZX& poly : v)
+    read_raw_ZZX(str, poly);
+}
+
+void RecryptData::writeTo(std::ostream& str) const
+{
+  assertNotNull(alMod, "RecryptData: writing uninitialized recryption data");
+  if (!alsoThick)
+    return;
+  writeZZXVec(str, unpackSlotEncoding);
+  firstMap->writeTo(str);
+  secondMap->writeTo(str);
+}
+
+void RecryptData::readFrom(std::istream& str,
+                           const Context& context,
+                           const NTL::Vec<long>& mvec_,
+                           bool enableThick,
+                           bool build_cache_)
+{
+  assertTrue(alMod == nullptr,
+             "RecryptData: recryption data already initialized");
+
+  initBase(context, mvec_, enableThick, build_cache_);
+
+  if (!enableThick)
+    return;
+
+  readZZXVec(str, unpackSlotEncoding, ea->getDegree());
+  firstMap = std::make_shared<EvalMap>(*ea, str);
+  secondMap = std::make_shared<EvalMap>(context.getEA(), str);
+}
+
 /********************************************************************/
 /********************************************************************/
 
@@ -363,15 +420,14 @@ void extractDigitsPacked(Ctxt& ctxt,
 // Extract digits from unpacked slots
 void extractDigitsThin(Ctxt& ctxt, long botHigh, long r, long ePrime);
 
-// bootstrap a ciphertext to reduce noise
-void PubKey::reCrypt(Ctxt& ctxt) const
+// Handle the ciphertexts that need no bootstrapping, returns true if ctxt
+// is one of them
+bool PubKey::recryptTrivial(Ctxt& ctxt) const
 {
-  HELIB_TIMER_START;
-
   // Some sanity checks for dummy ciphertext
   long ptxtSpace = ctxt.getPtxtSpace();
   if (ctxt.isEmpty())
-    return;
+    return true;
   if (ctxt.parts.size() == 1 && ctxt.parts[0].skHandle.isOne()) {
     // Dummy encryption, just ensure that it is reduced mod p
     NTL::ZZX poly = to_ZZX(ctxt.parts[0]);
@@ -379,42 +435,43 @@ void PubKey::reCrypt(Ctxt& ctxt) const
       poly[i] = NTL::to_ZZ(rem(poly[i], ptxtSpace));
     poly.normalize();
     ctxt.DummyEncrypt(poly);
-    return;
+    return true;
   }
+  return false;
+}
 
-  // check that we have bootstrapping data
-  assertTrue(recryptKeyID >= 0l, "No bootstrapping data");
+// Record the ratio of the raw mod-switch noise to its bound, and complain
+// if the noise exceeds the bound
+static void checkRawModSwitchNoise(double noise_rat)
+{
+  HELIB_STATS_UPDATE("raw-mod-switch-noise", noise_rat);
 
+  if (noise_rat > 1) {
+    // TODO: Turn the following preprocessor logics into a warnOrThrow function
+    std::string message =
+        "rawModSwitch scaled noise exceeds bound: " + std::to_string(noise_rat);
+#ifdef HELIB_DEBUG
+    Warning(message);
+#else
+    throw LogicError(message);
+#endif
+  }
+}
+
+// Key-switch ctxt to the bootstrapping key and compute the encryption of
+// the mod-switched ciphertext, this is common to thick and thin recryption.
+// Returns the ratio of the raw mod-switch noise to its bound, which the
+// callers pass to checkRawModSwitchNoise (outside of any parallel region).
+double PubKey::recryptBootKeySwitch(Ctxt& ctxt) const
+{
   long p = getContext().getP();
-  long r = getContext().getAlMod().getR();
   long p2r = getContext().getAlMod().getPPowR();
 
-  long intFactor = ctxt.intFactor;
-
-  // the bootstrapping key is encrypted relative to plaintext space p^{e-e'+r}.
   const RecryptData& rcData = getContext().getRcData();
   long e = rcData.e;
   long ePrime = rcData.ePrime;
   long p2ePrime = NTL::power_long(p, ePrime);
   long q = NTL::power_long(p, e) + 1;
-  assertTrue(e >= r, "rcData.e must be at least alMod.r");
-
-#ifdef HELIB_DEBUG
-  std::cerr << "reCrypt: p=" << p << ", r=" << r << ", e=" << e
-            << " ePrime=" << ePrime << ", q=" << q << std::endl;
-  CheckCtxt(ctxt, "init");
-#endif
-
-  // can only bootstrap ciphertext with plaintext-space dividing p^r
-  assertEq(p2r % ptxtSpace, 0l, "ptxtSpace must divide p^r when bootstrapping");
-
-  ctxt.dropSmallAndSpecialPrimes();
-
-#ifdef HELIB_DEBUG
-  CheckCtxt(ctxt, "after mod down");
-#endif
-
-  HELIB_NTIMER_START(AAA_preProcess);
 
   // Make sure that this ciphertext is in canonical form
   if (!ctxt.inCanonicalForm())
@@ -449,19 +506,6 @@ void PubKey::reCrypt(Ctxt& ctxt) const
   // noise_bnd is the bound assumed in selecting the parameters
   double noise_rat = noise_est / noise_bnd;
 
-  HELIB_STATS_UPDATE("raw-mod-switch-noise", noise_rat);
-
-  if (noise_rat > 1) {
-    // TODO: Turn the following preprocessor logics into a warnOrThrow function
-    std::string message =
-        "rawModSwitch scaled noise exceeds bound: " + std::to_string(noise_rat);
-#ifdef HELIB_DEBUG
-    Warning(message);
-#else
-    throw LogicError(message);
-#endif
-  }
-
   assertEq(zzParts.size(),
            (std::size_t)2,
            "Exactly 2 parts required for mod-switching in thin bootstrapping");
@@ -497,18 +541,59 @@ void PubKey::reCrypt(Ctxt& ctxt) const
   }
 
   // NOTE: here we lose the intFactor associated with ctxt.
-  // We will restore it below.
+  // The callers restore it.
   ctxt = recryptEkey;
 
   ctxt.multByConstant(zzParts[1]);
   ctxt.addConstant(zzParts[0]);
 
+  return noise_rat;
+}
+
+// Everything up to the first linear map of thick recryption, returns the
+// raw mod-switch noise ratio of recryptBootKeySwitch
+double PubKey::reCryptPreProcess(Ctxt& ctxt) const
+{
+  // check that we have bootstrapping data
+  assertTrue(recryptKeyID >= 0l, "No bootstrapping data");
+
+  long r = getContext().getAlMod().getR();
+  long p2r = getContext().getAlMod().getPPowR();
+  long ptxtSpace = ctxt.getPtxtSpace();
+
+  // the bootstrapping key is encrypted relative to plaintext space p^{e-e'+r}.
+  const RecryptData& rcData = getContext().getRcData();
+  assertTrue(rcData.e >= r, "rcData.e must be at least alMod.r");
+
 #ifdef HELIB_DEBUG
-  CheckCtxt(ctxt, "after preProcess");
+  std::cerr << "reCrypt: p=" << getContext().getP() << ", r=" << r
+            << ", e=" << rcData.e << " ePrime=" << rcData.ePrime << std::endl;
+  CheckCtxt(ctxt, "init");
 #endif
+
+  // can only bootstrap ciphertext with plaintext-space dividing p^r
+  assertEq(p2r % ptxtSpace, 0l, "ptxtSpace must divide p^r when bootstrapping");
+
+  ctxt.dropSmallAndSpecialPrimes();
+
+#ifdef HELIB_DEBUG
+  CheckCtxt(ctxt, "after mod down");
+#endif
+
+  HELIB_NTIMER_START(AAA_preProcess);
+  double noise_rat = recryptBootKeySwitch(ctxt);
   HELIB_NTIMER_STOP(AAA_preProcess);
 
-  // Move the powerful-basis coefficients to the plaintext slots
+#ifdef HELIB_DEBUG
+  CheckCtxt(ctxt, "after preProcess");
+#endif
+
+  return noise_rat;
+}
+
+// Move the powerful-basis coefficients to the plaintext slots
+static void reCryptLinearTransform1(Ctxt& ctxt)
+{
   HELIB_NTIMER_START(AAA_LinearTransform1);
   ctxt.getContext().getRcData().firstMap->apply(ctxt);
   HELIB_NTIMER_STOP(AAA_LinearTransform1);
@@ -516,21 +601,29 @@ void PubKey::reCrypt(Ctxt& ctxt) const
 #ifdef HELIB_DEBUG
   CheckCtxt(ctxt, "after LinearTransform1");
 #endif
+}
 
-  // Extract the digits e-e'+r-1,...,e-e' (from fully packed slots)
+// Extract the digits e-e'+r-1,...,e-e' (from fully packed slots)
+static void reCryptExtractDigits(Ctxt& ctxt)
+{
+  const Context& context = ctxt.getContext();
+  const RecryptData& rcData = context.getRcData();
   HELIB_NTIMER_START(AAA_extractDigitsPacked);
   extractDigitsPacked(ctxt,
-                      e - ePrime,
-                      r,
-                      ePrime,
-                      context.getRcData().unpackSlotEncoding);
+                      rcData.e - rcData.ePrime,
+                      context.getAlMod().getR(),
+                      rcData.ePrime,
+                      rcData.unpackSlotEncoding);
   HELIB_NTIMER_STOP(AAA_extractDigitsPacked);
 
 #ifdef HELIB_DEBUG
   CheckCtxt(ctxt, "after extractDigitsPacked");
 #endif
+}
 
-  // Move the slots back to powerful-basis coefficients
+// Move the slots back to powerful-basis coefficients
+static void reCryptLinearTransform2(Ctxt& ctxt)
+{
   HELIB_NTIMER_START(AAA_LinearTransform2);
   ctxt.getContext().getRcData().secondMap->apply(ctxt);
   HELIB_NTIMER_STOP(AAA_LinearTransform2);
@@ -538,12 +631,95 @@ void PubKey::reCrypt(Ctxt& ctxt) const
 #ifdef HELIB_DEBUG
   CheckCtxt(ctxt, "after linearTransform2");
 #endif
+}
+
+// bootstrap a ciphertext to reduce noise
+void PubKey::reCrypt(Ctxt& ctxt) const
+{
+  HELIB_TIMER_START;
+
+  if (recryptTrivial(ctxt))
+    return;
+
+  long ptxtSpace = ctxt.getPtxtSpace();
+  long intFactor = ctxt.intFactor;
+
+  checkRawModSwitchNoise(reCryptPreProcess(ctxt));
+  reCryptLinearTransform1(ctxt);
+  reCryptExtractDigits(ctxt);
+  reCryptLinearTransform2(ctxt);
 
   // restore intFactor
   if (intFactor != 1)
     ctxt.intFactor = NTL::MulMod(ctxt.intFactor, intFactor, ptxtSpace);
 }
 
+// Apply phase to the ciphertexts 0..n-1 of a batch. When there are at
+// least as many ciphertexts as threads, each thread takes its own
+// ciphertexts (and the NTL loops inside phase run serially); otherwise they
+// are processed one at a time, so that the loops inside phase get all the
+// threads.
+static void recryptPhase(long n, const std::function<void(long)>& phase)
+{
+  if (n > 1 && n >= NTL::AvailableThreads()) {
+    NTL_EXEC_RANGE(n, first, last)
+    for (long i = first; i < last; i++)
+      phase(i);
+    NTL_EXEC_RANGE_END
+  } else {
+    for (long i = 0; i < n; i++)
+      phase(i);
+  }
+}
+
+// Apply recryption phase by phase to the ciphertexts of ctxts that are
+// not trivial, and restore their intFactor at the end. The noise ratios
+// returned by preProcess are checked once the whole batch went through it,
+// so that the stats are not updated from several threads.
+void PubKey::recryptBatch(
+    std::vector<Ctxt>& ctxts,
+    const std::function<double(Ctxt&)>& preProcess,
+    const std::vector<std::function<void(Ctxt&)>>& phases) const
+{
+  std::vector<Ctxt*> batch;
+  std::vector<long> ptxtSpaces, intFactors;
+  for (Ctxt& ctxt : ctxts) {
+    if (recryptTrivial(ctxt))
+      continue;
+    batch.push_back(&ctxt);
+    ptxtSpaces.push_back(ctxt.getPtxtSpace());
+    intFactors.push_back(ctxt.intFactor);
+  }
+
+  long n = batch.size();
+
+  // all the ciphertexts go through one phase (and its constants) before
+  // any of them starts the next
+  std::vector<double> noise_rats(n);
+  recryptPhase(n, [&](long i) { noise_rats[i] = preProcess(*batch[i]); });
+  for (double noise_rat : noise_rats)
+    checkRawModSwitchNoise(noise_rat);
+
+  for (const auto& phase : phases)
+    recryptPhase(n, [&](long i) { phase(*batch[i]); });
+
+  for (long i : range(lsize(batch)))
+    if (intFactors[i] != 1)
+      batch[i]->intFactor = NTL::MulMod(batch[i]->intFactor,
+                                        intFactors[i],
+                                        ptxtSpaces[i]);
+}
+
+void PubKey::reCryptBatch(std::vector<Ctxt>& ctxts) const
+{
+  HELIB_TIMER_START;
+  recryptBatch(ctxts,
+               [this](Ctxt& ctxt) { return reCryptPreProcess(ctxt); },
+               {reCryptLinearTransform1,
+                reCryptExtractDigits,
+                reCryptLinearTransform2});
+}
+
 #ifdef HELIB_BOOT_THREADS
 
 // Extract digits from fully packed slots, multithreaded version
@@ -734,10 +910,9 @@ void packedRecrypt(const CtPtrs& cPtrs,
 
   repack(CtPtrs_vectorCt(cts), cPtrs, ea); // pack ciphertexts
   //  cout << "@"<< lsize(cts)<<std::flush;
-  for (Ctxt& c : cts) {   // then recrypt them
+  for (Ctxt& c : cts)     // then recrypt them
     c.reducePtxtSpace(2); // we only have recryption data for binary ctxt
-    pKey.reCrypt(c);
-  }
+  pKey.reCryptBatch(cts);
   unpack(cPtrs, CtPtrs_vectorCt(cts), ea, unpackConsts);
 }
 
@@ -786,6 +961,24 @@ void ThinRecryptData::init(const Context& context,
                                               build_cache);
 }
 
+void ThinRecryptData::writeTo(std::ostream& str) const
+{
+  RecryptData::writeTo(str);
+  coeffToSlot->writeTo(str);
+  slotToCoeff->writeTo(str);
+}
+
+void ThinRecryptData::readFrom(std::istream& str,
+                               const Context& context,
+                               const NTL::Vec<long>& mvec_,
+                               bool alsoThick,
+                               bool build_cache_)
+{
+  RecryptData::readFrom(str, context, mvec_, alsoThick, build_cache_);
+  coeffToSlot = std::make_shared<ThinEvalMap>(*ea, str);
+  slotToCoeff = std::make_shared<ThinEvalMap>(context.getEA(), str);
+}
+
 // Extract digits from thinly packed slots
 
 long fhe_force_chen_han = 0;
@@ -936,43 +1129,21 @@ struct PubKeyHack
   Ctxt recryptEkey;  // the key itself, encrypted under key #0
 };
 
-// bootstrap a ciphertext to reduce noise
-void PubKey::thinReCrypt(Ctxt& ctxt) const
+// Everything up to the coeffToSlot map of thin recryption, returns the
+// raw mod-switch noise ratio of recryptBootKeySwitch
+double PubKey::thinReCryptPreProcess(Ctxt& ctxt) const
 {
-  HELIB_TIMER_START;
-
-  // Some sanity checks for dummy ciphertext
-  long ptxtSpace = ctxt.getPtxtSpace();
-  if (ctxt.isEmpty())
-    return;
-
-  if (ctxt.parts.size() == 1 && ctxt.parts[0].skHandle.isOne()) {
-    // Dummy encryption, just ensure that it is reduced mod p
-    NTL::ZZX poly = to_ZZX(ctxt.parts[0]);
-    for (long i = 0; i < poly.rep.length(); i++)
-      poly[i] = NTL::to_ZZ(rem(poly[i], ptxtSpace));
-    poly.normalize();
-    ctxt.DummyEncrypt(poly);
-    return;
-  }
-
   // check that we have bootstrapping data
   assertTrue(recryptKeyID >= 0l, "Bootstrapping data not present");
 
-  long p = ctxt.getContext().getP();
   long r = ctxt.getContext().getAlMod().getR();
   long p2r = ctxt.getContext().getAlMod().getPPowR();
-
-  long intFactor = ctxt.intFactor;
+  long ptxtSpace = ctxt.getPtxtSpace();
 
   const ThinRecryptData& trcData = ctxt.getContext().getRcData();
 
   // the bootstrapping key is encrypted relative to plaintext space p^{e-e'+r}.
-  long e = trcData.e;
-  long ePrime = trcData.ePrime;
-  long p2ePrime = NTL::power_long(p, ePrime);
-  long q = NTL::power_long(p, e) + 1;
-  assertTrue(e >= r, "trcData.e must be at least alMod.r");
+  assertTrue(trcData.e >= r, "trcData.e must be at least alMod.r");
 
   // can only bootstrap ciphertext with plaintext-space dividing p^r
   assertEq(p2r % ptxtSpace,
@@ -1010,123 +1181,74 @@ void PubKey::thinReCrypt(Ctxt& ctxt) const
 #endif
 
   HELIB_NTIMER_START(AAA_bootKeySwitch);
-
-  // Make sure that this ciphertext is in canonical form
-  if (!ctxt.inCanonicalForm())
-    ctxt.reLinearize();
-
-  // Mod-switch down if needed
-  IndexSet s = ctxt.getPrimeSet() / context.getSpecialPrimes();
-  assertTrue(s <= context.getCtxtPrimes(), "prime set is messed up");
-  if (s.card() > 3) { // leave only first three ciphertext primes
-    long first = s.first();
-    IndexSet s3(first, first + 2);
-    s.retain(s3);
-  }
-  ctxt.modDownToSet(s);
-
-  // key-switch to the bootstrapping key
-  ctxt.reLinearize(recryptKeyID);
-
-#ifdef HELIB_DEBUG
-  CheckCtxt(ctxt, "after key switching");
-#endif
-
-  // "raw mod-switch" to the bootstrapping mosulus q=p^e+1.
-  std::vector<NTL::ZZX> zzParts; // the mod-switched parts, in ZZX format
-
-  double mfac = ctxt.getContext().getZMStar().getNormBnd();
-  double noise_est = ctxt.rawModSwitch(zzParts, q) * mfac;
-  // noise_est is an upper bound on the L-infty norm of the scaled noise
-  // in the pwrfl basis
-  double noise_bnd =
-      HELIB_MIN_CAP_FRAC * p2r * ctxt.getContext().boundForRecryption();
-  // noise_bnd is the bound assumed in selecting the parameters
-  double noise_rat = noise_est / noise_bnd;
-
-  HELIB_STATS_UPDATE("raw-mod-switch-noise", noise_rat);
-
-  if (noise_rat > 1) {
-    // TODO: Turn the following preprocessor logics into a warnOrThrow function
-    std::string message =
-        "rawModSwitch scaled noise exceeds bound: " + std::to_string(noise_rat);
-#ifdef HELIB_DEBUG
-    Warning(message);
-#else
-    throw LogicError(message);
-#endif
-  }
-
-  assertEq(zzParts.size(),
-           (std::size_t)2,
-           "Exactly 2 parts required for mod-switching in thin bootstrapping");
-
-#ifdef HELIB_DEBUG
-  if (dbgKey) {
-    checkRecryptBounds(zzParts, dbgKey->getRecryptKey(), ctxt.getContext(), q);
-  }
-#endif
-
-  std::vector<NTL::ZZX> v;
-  v.resize(2);
-
-  // Add multiples of q to make the zzParts divisible by p^{e'}
-  for (long i : range(2)) {
-    // make divisible by p^{e'}
-
-    newMakeDivisible(zzParts[i], p2ePrime, q, ctxt.getContext(), v[i]);
-  }
-
-#ifdef HELIB_DEBUG
-  if (dbgKey) {
-    checkRecryptBounds_v(v, dbgKey->getRecryptKey(), ctxt.getContext(), q);
-    checkCriticalValue(zzParts,
-                       dbgKey->getRecryptKey(),
-                       ctxt.getContext().getRcData(),
-                       q);
-  }
-#endif
-
-  for (long i : range(zzParts.size())) {
-    zzParts[i] /= p2ePrime; // divide by p^{e'}
-  }
-
-  // NOTE: here we lose the intFactor associated with ctxt.
-  // We will restore it below.
-  ctxt = recryptEkey;
-
-  ctxt.multByConstant(zzParts[1]);
-  ctxt.addConstant(zzParts[0]);
+  double noise_rat = recryptBootKeySwitch(ctxt);
+  HELIB_NTIMER_STOP(AAA_bootKeySwitch);
 
 #ifdef HELIB_DEBUG
   CheckCtxt(ctxt, "after bootKeySwitch");
 #endif
 
-  HELIB_NTIMER_STOP(AAA_bootKeySwitch);
+  return noise_rat;
+}
 
-  // Move the powerful-basis coefficients to the plaintext slots
+// Move the powerful-basis coefficients to the plaintext slots
+static void thinReCryptCoeffToSlot(Ctxt& ctxt)
+{
   HELIB_NTIMER_START(AAA_coeffToSlot);
-  trcData.coeffToSlot->apply(ctxt);
+  ctxt.getContext().getRcData().coeffToSlot->apply(ctxt);
   HELIB_NTIMER_STOP(AAA_coeffToSlot);
 
 #ifdef HELIB_DEBUG
   CheckCtxt(ctxt, "after coeffToSlot");
 #endif
+}
 
-  // Extract the digits e-e'+r-1,...,e-e' (from fully packed slots)
+// Extract the digits e-e'+r-1,...,e-e' (from thinly packed slots)
+static void thinReCryptExtractDigits(Ctxt& ctxt)
+{
+  const Context& context = ctxt.getContext();
+  const ThinRecryptData& trcData = context.getRcData();
   HELIB_NTIMER_START(AAA_extractDigitsThin);
-  extractDigitsThin(ctxt, e - ePrime, r, ePrime);
+  extractDigitsThin(ctxt,
+                    trcData.e - trcData.ePrime,
+                    context.getAlMod().getR(),
+                    trcData.ePrime);
   HELIB_NTIMER_STOP(AAA_extractDigitsThin);
 
 #ifdef HELIB_DEBUG
   CheckCtxt(ctxt, "after extractDigitsThin");
 #endif
+}
+
+// bootstrap a ciphertext to reduce noise
+void PubKey::thinReCrypt(Ctxt& ctxt) const
+{
+  HELIB_TIMER_START;
+
+  if (recryptTrivial(ctxt))
+    return;
+
+  long ptxtSpace = ctxt.getPtxtSpace();
+  long intFactor = ctxt.intFactor;
+
+  checkRawModSwitchNoise(thinReCryptPreProcess(ctxt));
+  thinReCryptCoeffToSlot(ctxt);
+  thinReCryptExtractDigits(ctxt);
 
   // restore intFactor
   if (intFactor != 1)
     ctxt.intFactor = NTL::MulMod(ctxt.intFactor, intFactor, ptxtSpace);
 }
 
+void PubKey::thinReCryptBatch(std::vector<Ctxt>& ctxts) const
+{
+  HELIB_TIMER_START;
+  recryptBatch(ctxts,
+               [this](Ctxt& ctxt) { return thinReCryptPreProcess(ctxt); },
+               {thinReCryptCoeffToSlot,
+                thinReCryptExtractDigits});
+}
+
 #ifdef HELIB_DEBUG
 
 static void checkCriticalValue(const std::vector<NTL::ZZX>& zzParts,
@@ -13,6 +13,8 @@
 #include <utility>
 #include <cstring>
 #include <ctime>
+#include <memory>
+#include <unordered_map>
 #include <helib/timing.h>
 
 namespace helib {
@@ -57,27 +59,383 @@ void registerTimer(FHEtimer* timer)
   timerMap.push_back(timer);
 }
 
+/********************************************************************/
+/*********************** Hierarchical profiler **********************/
+
+HELIB_atomic_long profiler_on(0);
+static HELIB_atomic_long profiler_events(0);
+
+static const long PROFILE_HIST_SIZE = 8 * sizeof(unsigned long);
+
+namespace {
+
+// A node in the call tree of one thread, the path from the root to
+// a node is the chain of enclosing timed scopes
+struct ProfileNode
+{
+  const FHEtimer* timer; // null for the root
+  long parent;
+  unsigned long total = 0;
+  long calls = 0;
+  std::vector<long> histogram;
+  std::vector<std::pair<const FHEtimer*, long>> children;
+
+  ProfileNode(const FHEtimer* _timer, long _parent) :
+      timer(_timer), parent(_parent), histogram(PROFILE_HIST_SIZE, 0)
+  {}
+};
+
+struct ProfileEvent
+{
+  long node;
+  unsigned long start;
+  unsigned long end;
+};
+
+// A call tree, with the scopes that are open in it and their events
+struct ProfileTree
+{
+  std::vector<ProfileNode> nodes;
+  std::vector<long> stack; // the currently open scopes
+  std::vector<ProfileEvent> events;
+
+  ProfileTree() { clear(); }
+
+  void clear()
+  {
+    nodes.clear();
+    nodes.emplace_back(nullptr, -1);
+    stack.assign(1, 0);
+    events.clear();
+  }
+
+  long child(long parent, const FHEtimer* timer)
+  {
+    for (const auto& c : nodes[parent].children)
+      if (c.first == timer)
+        return c.second;
+    long idx = nodes.size();
+    nodes.emplace_back(timer, parent);
+    nodes[parent].children.emplace_back(timer, idx);
+    return idx;
+  }
+};
+
+// The totals of one timer over all its call paths
+struct TimerTotals
+{
+  unsigned long total = 0;
+  long calls = 0;
+  std::vector<long> histogram = std::vector<long>(PROFILE_HIST_SIZE, 0);
+};
+
+// The profile of one thread. It is written by its thread and read or
+// cleared by the others, always under its mutex (so the owner thread
+// only waits while the profile is being read). It is kept alive after the
+// thread exits (by profiles below).
+struct ThreadProfile
+{
+  const long tid;
+  HELIB_MUTEX_TYPE mx;
+  // Incremented by every reset, so that a scope opened before the reset
+  // does not update the node that has its index afterwards
+  long generation = 0;
+  ProfileTree tree;
+  // Per timer, so that FHEtimer::getTime does not visit the tree
+  std::unordered_map<const FHEtimer*, TimerTotals> totals;
+
+  explicit ThreadProfile(long _tid) : tid(_tid) {}
+};
+
+} // namespace
+
+static std::vector<std::shared_ptr<ThreadProfile>> profiles;
+static HELIB_MUTEX_TYPE profilesMx;
+
+static ThreadProfile& getThreadProfile()
+{
+  thread_local std::shared_ptr<ThreadProfile> profile;
+  if (!profile) {
+    HELIB_MUTEX_GUARD(profilesMx);
+    profile = std::make_shared<ThreadProfile>(long(profiles.size()));
+    profiles.push_back(profile);
+  }
+  return *profile;
+}
+
+// The profiles of all the threads, each one is then locked separately
+static std::vector<std::shared_ptr<ThreadProfile>> allProfiles()
+{
+  HELIB_MUTEX_GUARD(profilesMx);
+  return profiles;
+}
+
+static long histogramBucket(unsigned long duration)
+{
+  long b = 0;
+  while (duration > 1 && b < PROFILE_HIST_SIZE - 1) {
+    duration >>= 1;
+    b++;
+  }
+  return b;
+}
+
+long profilerEnter(FHEtimer* timer, long& generation)
+{
+  ThreadProfile& tp = getThreadProfile();
+  HELIB_MUTEX_GUARD(tp.mx);
+  generation = tp.generation;
+  long node = tp.tree.child(tp.tree.stack.back(), timer);
+  tp.tree.stack.push_back(node);
+  return node;
+}
+
+void profilerExit(long node,
+                  long generation,
+                  unsigned long start,
+                  unsigned long end)
+{
+  ThreadProfile& tp = getThreadProfile();
+  HELIB_MUTEX_GUARD(tp.mx);
+  // the profile was reset while this scope was open
+  if (generation != tp.generation)
+    return;
+  ProfileTree& tree = tp.tree;
+  ProfileNode& pn = tree.nodes[node];
+  unsigned long duration = end - start;
+  long bucket = histogramBucket(duration);
+  pn.total += duration;
+  pn.calls++;
+  pn.histogram[bucket]++;
+  TimerTotals& tt = tp.totals[pn.timer];
+  tt.total += duration;
+  tt.calls++;
+  tt.histogram[bucket]++;
+  if (profiler_events)
+    tree.events.push_back({node, start, end});
+
+  // Usually node is on top of the stack, but explicit STOPs may close
+  // the scopes out of order: close node and everything opened after it
+  for (long i = tree.stack.size() - 1; i > 0; i--) {
+    if (tree.stack[i] == node) {
+      tree.stack.resize(i);
+      break;
+    }
+  }
+}
+
+void setProfilerOn(bool recordEvents)
+{
+  profiler_events = recordEvents;
+  profiler_on = 1;
+}
+
+void setProfilerOff() { profiler_on = 0; }
+
+bool isProfilerOn() { return profiler_on != 0; }
+
+void resetProfile()
+{
+  for (const auto& tp : allProfiles()) {
+    HELIB_MUTEX_GUARD(tp->mx);
+    tp->tree.clear();
+    tp->totals.clear();
+    tp->generation++;
+  }
+}
+
+// Merge the subtree of tree rooted at idx into the subtree of merged rooted
+// at midx
+static void mergeProfile(ProfileTree& merged,
+                         long midx,
+                         const ProfileTree& tree,
+                         long idx)
+{
+  const ProfileNode& src = tree.nodes[idx];
+  {
+    ProfileNode& dst = merged.nodes[midx];
+    dst.total += src.total;
+    dst.calls += src.calls;
+    for (long i = 0; i < PROFILE_HIST_SIZE; i++)
+      dst.histogram[i] += src.histogram[i];
+  }
+  for (const auto& c : src.children)
+    mergeProfile(merged, merged.child(midx, c.first), tree, c.second);
+}
+
+static ProfileTree mergedProfile()
+{
+  ProfileTree merged;
+  for (const auto& tp : allProfiles()) {
+    HELIB_MUTEX_GUARD(tp->mx);
+    mergeProfile(merged, 0, tp->tree, 0);
+  }
+  return merged;
+}
+
+// Totals over all the call paths of timer
+static void profiledTotals(const FHEtimer* timer,
+                           unsigned long& total,
+                           long& calls,
+                           std::vector<long>* histogram = nullptr)
+{
+  total = 0;
+  calls = 0;
+  for (const auto& tp : allProfiles()) {
+    HELIB_MUTEX_GUARD(tp->mx);
+    auto it = tp->totals.find(timer);
+    if (it == tp->totals.end())
+      continue;
+    const TimerTotals& tt = it->second;
+    total += tt.total;
+    calls += tt.calls;
+    if (histogram)
+      for (long i = 0; i < PROFILE_HIST_SIZE; i++)
+        (*histogram)[i] += tt.histogram[i];
+  }
+}
+
+// Drop the totals of timer (its nodes in the call trees are kept)
+static void resetProfiledTotals(const FHEtimer* timer)
+{
+  for (const auto& tp : allProfiles()) {
+    HELIB_MUTEX_GUARD(tp->mx);
+    tp->totals.erase(timer);
+  }
+}
+
+std::vector<long> getProfileHistogram(const FHEtimer* timer)
+{
+  std::vector<long> histogram(PROFILE_HIST_SIZE, 0);
+  unsigned long total;
+  long calls;
+  profiledTotals(timer, total, calls, &histogram);
+  return histogram;
+}
+
+static void printProfileNode(std::ostream& str,
+                             const ProfileTree& tree,
+                             long idx,
+                             long depth)
+{
+  const ProfileNode& pn = tree.nodes[idx];
+  if (idx > 0 && pn.calls > 0) {
+    double t = double(pn.total) / CLOCK_SCALE;
+    str << std::string(2 * depth, ' ') << pn.timer->name << ": " << t << " / "
+        << pn.calls << " = " << (t / pn.calls) << "\n";
+  }
+
+  // children in decreasing order of total time
+  std::vector<long> kids;
+  for (const auto& c : pn.children)
+    kids.push_back(c.second);
+  std::sort(kids.begin(), kids.end(), [&tree](long a, long b) {
+    return tree.nodes[a].total > tree.nodes[b].total;
+  });
+  for (long k : kids)
+    printProfileNode(str, tree, k, depth + 1);
+}
+
+void printProfile(std::ostream& str)
+{
+  ProfileTree merged = mergedProfile();
+  printProfileNode(str, merged, 0, 0);
+}
+
+static double toMicroseconds(unsigned long ticks)
+{
+  return double(ticks) * 1e6 / CLOCK_SCALE;
+}
+
+static void writeCollapsedNode(std::ostream& str,
+                               const ProfileTree& tree,
+                               long idx,
+                               const std::string& path)
+{
+  const ProfileNode& pn = tree.nodes[idx];
+  std::string mypath = path;
+  if (idx > 0) {
+    if (!mypath.empty())
+      mypath += ";";
+    mypath += pn.timer->name;
+
+    unsigned long self = pn.total;
+    for (const auto& c : pn.children)
+      self -= std::min(self, tree.nodes[c.second].total);
+    if (pn.calls > 0)
+      str << mypath << " " << long(toMicroseconds(self)) << "\n";
+  }
+  for (const auto& c : pn.children)
+    writeCollapsedNode(str, tree, c.second, mypath);
+}
+
+void writeCollapsedStacks(std::ostream& str)
+{
+  ProfileTree merged = mergedProfile();
+  writeCollapsedNode(str, merged, 0, "");
+}
+
+void writeChromeTrace(std::ostream& str)
+{
+  str << "{\"traceEvents\":[";
+  bool first = true;
+  for (const auto& tp : allProfiles()) {
+    // Copied out, so the thread is not held up while writing
+    std::vector<std::pair<const FHEtimer*, ProfileEvent>> events;
+    {
+      HELIB_MUTEX_GUARD(tp->mx);
+      for (const ProfileEvent& ev : tp->tree.events)
+        events.emplace_back(tp->tree.nodes[ev.node].timer, ev);
+    }
+    for (const auto& entry : events) {
+      const FHEtimer* timer = entry.first;
+      const ProfileEvent& ev = entry.second;
+      str << (first ? "\n" : ",\n") << "{\"name\":\"" << timer->name
+          << "\",\"cat\":\"helib\",\"ph\":\"X\",\"ts\":"
+          << toMicroseconds(ev.start)
+          << ",\"dur\":" << toMicroseconds(ev.end - ev.start)
+          << ",\"pid\":0,\"tid\":" << tp->tid << ",\"args\":{\"loc\":\""
+          << timer->loc << "\"}}";
+      first = false;
+    }
+  }
+  str << "\n]}\n";
+}
+
+/********************************************************************/
+
 // Reset a timer for some label to zero
 void FHEtimer::reset()
 {
   numCalls = 0;
   counter = 0;
+  resetProfiledTotals(this);
 }
 
-// Read the value of a timer (in seconds)
+// Read the value of a timer (in seconds), including the time recorded
+// by the profiler
 double FHEtimer::getTime() const // returns time in seconds
 {
-  // If the counter is currently counting, add the clock() value
-  return ((double)counter) / CLOCK_SCALE;
+  unsigned long profiled;
+  long calls;
+  profiledTotals(this, profiled, calls);
+  return ((double)(counter + profiled)) / CLOCK_SCALE;
 }
 
 // Returns number of calls for that timer
-long FHEtimer::getNumCalls() const { return numCalls; }
+long FHEtimer::getNumCalls() const
+{
+  unsigned long profiled;
+  long calls;
+  profiledTotals(this, profiled, calls);
+  return numCalls + calls;
+}
 
 void resetAllTimers()
 {
   for (long i = 0; i < long(timerMap.size()); i++)
     timerMap[i]->reset();
+  resetProfile();
 }
 
 // Print the value of all timers to stream
@@ -347,6 +347,48 @@ TEST_P(GTestFatboot, correctlyPerformsFatboot)
     helib::print_stats(std::cout);
 }
 
+TEST_P(GTestFatboot, reCryptBatchMatchesReCrypt)
+{
+  context.buildModChain(bits,
+                        c,
+                        /*willBeBootstrappable=*/true,
+                        /*t=*/skHwt);
+  context.enableBootStrapping(mvec, useCache);
+  helib::setDryRun(helib_test::dry);
+
+  long p2r = context.getAlMod().getPPowR();
+
+  helib::SecKey secretKey(context);
+  helib::PubKey& publicKey = secretKey;
+  secretKey.GenSecKey();
+  helib::addSome1DMatrices(secretKey);
+  helib::addFrbMatrices(secretKey);
+  secretKey.genRecryptData();
+  helib::setupDebugGlobals(&secretKey, context.shareEA());
+
+  // a batch with more ciphertexts than threads, and an empty one
+  const long n = std::max(3l, 2 * NTL::AvailableThreads());
+  NTL::zz_p::init(p2r);
+  std::vector<NTL::ZZX> expected(n);
+  std::vector<helib::Ctxt> ctxts(n + 1, helib::Ctxt(publicKey));
+  for (long i = 0; i < n; i++) {
+    NTL::zz_pX poly_p = NTL::random_zz_pX(context.getPhiM());
+    NTL::ZZX ptxt_poly =
+        helib::convert<NTL::ZZX>(helib::balanced_zzX(poly_p));
+    helib::PolyRed(expected[i], ptxt_poly, p2r, true);
+    secretKey.Encrypt(ctxts[i], ptxt_poly, p2r);
+  }
+
+  publicKey.reCryptBatch(ctxts);
+
+  EXPECT_TRUE(ctxts[n].isEmpty());
+  for (long i = 0; i < n; i++) {
+    NTL::ZZX decrypted;
+    secretKey.Decrypt(decrypted, ctxts[i]);
+    EXPECT_EQ(decrypted, expected[i]) << " index: " << i;
+  }
+}
+
 // LEGACY TEST DEFAULT PARAMETERS:
 // long p=2;
 // long r=1;
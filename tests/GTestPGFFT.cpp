@@ -308,6 +308,44 @@ static void TestIt(long n)
   }
 }
 
+// apply_many on count vectors, stride apart, must give the results of apply
+static void TestMany(long n, long count, long stride)
+{
+  helib::PGFFT pgfft(n);
+
+  vector<cmplx_t> v(count * stride);
+  for (auto& x : v)
+    x = RandomBnd(20) - 10;
+
+  vector<cmplx_t> w(v.size()), u(v);
+  pgfft.apply_many(v.data(), w.data(), count, stride);
+  pgfft.apply_many(u.data(), count, stride);
+
+  for (long j = 0; j < count; j++) {
+    vector<cmplx_t> x(v.begin() + j * stride, v.begin() + j * stride + n);
+    pgfft.apply(x.data());
+    for (long i = 0; i < n; i++) {
+      EXPECT_EQ(w[j * stride + i], x[i]);
+      EXPECT_EQ(u[j * stride + i], x[i]);
+    }
+    // the padding between the vectors is not touched by the transforms
+    for (long i = n; i < stride; i++) {
+      EXPECT_EQ(w[j * stride + i], cmplx_t(0));
+      EXPECT_EQ(u[j * stride + i], v[j * stride + i]);
+    }
+  }
+}
+
+TEST(GTestPGFFT, PGFFTApplyManyIsLikeApply)
+{
+  SetSeed();
+
+  for (long n : {1, 2, 3, 8, 17, 64, 100, 1024, 1536})
+    for (long count : {0, 1, 3, 8})
+      for (long stride : {n, n + 5})
+        TestMany(n, count, stride);
+}
+
 TEST(GTestPGFFT, PGFFTWorksInRange1to100Points)
 {
   SetSeed();
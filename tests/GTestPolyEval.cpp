@@ -11,6 +11,7 @@
  */
 
 #include <NTL/ZZ.h>
+#include <NTL/BasicThreadPool.h>
 #include <helib/polyEval.h>
 #include <helib/EncryptedArray.h>
 #include <helib/debugging.h>
@@ -176,6 +177,35 @@ TEST_P(GTestPolyEval, evaluatePolynomialOnCiphertext)
   }
 }
 
+TEST_P(GTestPolyEval, parallelEvaluationIsLikePolyEval)
+{
+  std::vector<long> x;
+  ea->random(x);
+  helib::Ctxt inCtxt(publicKey);
+  ea->encrypt(inCtxt, publicKey, x);
+
+  NTL::ZZX poly;
+  for (long i = d; i >= 0; i--)
+    SetCoeff(poly, i, NTL::RandomBnd(p2r));
+  if (isMonic)
+    SetCoeff(poly, d);
+
+  long savedThreads = NTL::AvailableThreads();
+  for (long nThreads : {1l, 4l}) {
+    NTL::SetNumThreads(nThreads);
+    helib::Ctxt outCtxt(publicKey);
+    helib::polyEvalParallel(outCtxt, poly, inCtxt);
+
+    std::vector<long> y;
+    ea->decrypt(outCtxt, secretKey, y);
+    for (long i = 0; i < ea->size(); i++) {
+      EXPECT_EQ(helib::polyEvalMod(poly, x[i], p2r), y[i])
+          << "plaintext poly MISMATCH, threads " << nThreads;
+    }
+  }
+  NTL::SetNumThreads(savedThreads);
+}
+
 std::vector<Parameters> getParameters()
 {
   std::vector<Parameters> allParams;
@@ -0,0 +1,149 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+
+#include <cmath>
+#include <vector>
+
+#include <helib/helib.h>
+#include <helib/BaseConverter.h>
+
+#include "test_common.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class TestBaseConverter : public ::testing::Test
+{
+protected:
+  helib::Context context;
+  helib::IndexSet from, to;
+
+  TestBaseConverter() :
+      context(helib::ContextBuilder<helib::BGV>()
+                  .m(45)
+                  .p(17)
+                  .r(2)
+                  .bits(300)
+                  .build())
+  {
+    // split the ciphertext primes in two
+    long half = context.getCtxtPrimes().card() / 2;
+    for (long i : context.getCtxtPrimes())
+      (from.card() < half ? from : to).insert(i);
+  }
+};
+
+TEST_F(TestBaseConverter, extendsTheBalancedLift)
+{
+  const helib::BaseConverter& conv = context.getBaseConverter(from, to);
+  NTL::ZZ Q = context.productOfPrimes(from);
+  long k = from.card();
+  long l = to.card();
+  const long n = 50;
+
+  std::vector<NTL::ZZ> x(n);
+  std::vector<long> in(k * n), out(l * n), outAux(n);
+  std::vector<double> frac(n);
+  for (long h : helib::range(n)) {
+    if (h == 0)
+      x[h] = 0;
+    else if (h == 1)
+      x[h] = -1;
+    else {
+      NTL::RandomBnd(x[h], Q);
+      x[h] -= Q / 2; // in (-Q/2, Q/2)
+    }
+    long r = 0;
+    for (long i : from)
+      in[(r++) * n + h] = rem(x[h], context.ithPrime(i));
+  }
+
+  const long t = 17 * 17;
+  helib::BaseConverter::AuxModulus aux = conv.auxModulus(t);
+  conv.convert(out.data(),
+               n,
+               in.data(),
+               n,
+               n,
+               frac.data(),
+               &aux,
+               outAux.data());
+
+  for (long h : helib::range(n)) {
+    long r = 0;
+    for (long i : to) {
+      EXPECT_EQ(out[r * n + h], rem(x[h], context.ithPrime(i)))
+          << " h=" << h << " prime " << i;
+      r++;
+    }
+    EXPECT_EQ(outAux[h], rem(x[h], t)) << " h=" << h;
+    double expected = NTL::conv<double>(NTL::conv<NTL::xdouble>(x[h]) /
+                                        NTL::conv<NTL::xdouble>(Q));
+    EXPECT_NEAR(frac[h], expected, 1e-12) << " h=" << h;
+  }
+}
+
+TEST_F(TestBaseConverter, contextCachesTheConverters)
+{
+  const helib::BaseConverter& conv1 = context.getBaseConverter(from, to);
+  const helib::BaseConverter& conv2 = context.getBaseConverter(from, to);
+  const helib::BaseConverter& conv3 = context.getBaseConverter(to, from);
+  EXPECT_EQ(&conv1, &conv2);
+  EXPECT_NE(&conv1, &conv3);
+  EXPECT_EQ(conv3.getFrom(), to);
+  EXPECT_EQ(conv3.getTo(), from);
+}
+
+TEST_F(TestBaseConverter, throwsOnOverlappingSets)
+{
+  EXPECT_THROW(helib::BaseConverter(context, from, from), helib::LogicError);
+}
+
+TEST_F(TestBaseConverter, addPrimesMatchesTheZZXRoute)
+{
+  helib::DoubleCRT rns(context, from);
+  rns.randomize();
+  helib::DoubleCRT zzx = rns;
+
+  NTL::ZZX poly;
+  rns.addPrimes(to);
+  zzx.addPrimes(to, &poly);
+  EXPECT_EQ(rns, zzx);
+}
+
+TEST_F(TestBaseConverter, scaleDownToSetMatchesTheZZXRoute)
+{
+  helib::IndexSet all = from | to;
+  const long ptxtSpaces[] = {1, 17 * 17, 2};
+  for (long ptxtSpace : ptxtSpaces) {
+    helib::DoubleCRT rns(context, all);
+    rns.randomize();
+    helib::DoubleCRT zzx = rns;
+
+    std::vector<double> fdelta;
+    NTL::ZZX delta;
+    rns.scaleDownToSet(from, ptxtSpace, fdelta);
+    zzx.scaleDownToSet(from, ptxtSpace, delta);
+    EXPECT_EQ(rns, zzx) << " ptxtSpace=" << ptxtSpace;
+
+    NTL::xdouble prod = NTL::conv<NTL::xdouble>(context.productOfPrimes(to));
+    ASSERT_EQ(helib::lsize(fdelta), context.getPhiM());
+    for (long h : helib::range(context.getPhiM())) {
+      double expected =
+          NTL::conv<double>(NTL::conv<NTL::xdouble>(coeff(delta, h)) / prod);
+      EXPECT_NEAR(fdelta[h], expected, 1e-9) << " ptxtSpace=" << ptxtSpace;
+      EXPECT_LE(std::fabs(fdelta[h]), ptxtSpace / 2.0 + 0.0001);
+    }
+  }
+}
+
+} // namespace
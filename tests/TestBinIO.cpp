@@ -9,8 +9,12 @@
  * See the License for the specific language governing permissions and
  * limitations under the License. See accompanying LICENSE file.
  */
+#include <algorithm>
 #include <cmath> // isinf
+#include <cstdio>
 #include <cstring>
+#include <fstream>
+#include <memory>
 #include <sstream>
 #include <helib/helib.h>
 #include <helib/debugging.h>
@@ -244,6 +248,37 @@ TEST_P(TestBinIO_BGV, throwsWhenPostContextEyeCatcherNotFound)
   EXPECT_THROW(context.readFrom(ss), helib::IOError);
 }
 
+TEST_P(TestBinIO_BGV, keySwitchingMatricesWithOlderSeedsAreRejected)
+{
+  ASSERT_FALSE(publicKey.keySWlist().empty());
+  const helib::KeySwitch& ksm = publicKey.keySWlist().front();
+
+  std::stringstream ss;
+  ksm.writeTo(ss);
+  EXPECT_EQ(helib::KeySwitch::readFrom(ss, context), ksm);
+
+  // Older versions wrote the matrices with another begin eye catcher
+  std::string s = ss.str();
+  std::size_t pos = s.find(eyeCatcherToStr(helib::EyeCatcher::SKM1_BEGIN));
+  ASSERT_NE(pos, std::string::npos);
+  s.replace(pos,
+            helib::EyeCatcher::SIZE,
+            eyeCatcherToStr(helib::EyeCatcher::SKM_BEGIN));
+  std::stringstream old(s);
+  EXPECT_THROW(helib::KeySwitch::readFrom(old, context), helib::IOError);
+
+  std::stringstream js;
+  ksm.writeToJSON(js);
+  s = js.str();
+  const std::string tag = "\"seedDerivation\":1";
+  pos = s.find(tag);
+  ASSERT_NE(pos, std::string::npos);
+  s.replace(pos, tag.size(), "\"seedDerivation\":0");
+  std::stringstream oldJson(s);
+  EXPECT_THROW(helib::KeySwitch::readFromJSON(oldJson, context),
+               helib::IOError);
+}
+
 TEST_P(TestBinIO_BGV, readContextFromDeserializeCorrectly)
 {
   std::stringstream str;
@@ -266,6 +301,104 @@ TEST_P(TestBinIO_BGV, readContextPtrFromDeserializeCorrectly)
   EXPECT_EQ(context, *deserialized_contextp);
 }
 
+void expectSameTables(const helib::Context& context,
+                      const helib::Context& deserialized_context)
+{
+  const helib::PAlgebra& zMStar = context.getZMStar();
+  const helib::PAlgebraMod& alMod = context.getAlMod();
+  EXPECT_EQ(zMStar.getPhimX(), deserialized_context.getZMStar().getPhimX());
+  EXPECT_EQ(zMStar.getPolyNormBnd(),
+            deserialized_context.getZMStar().getPolyNormBnd());
+  EXPECT_EQ(alMod.getFactorsOverZZ(),
+            deserialized_context.getAlMod().getFactorsOverZZ());
+  for (long i : helib::range(zMStar.numOfGens()))
+    for (long j : helib::range(zMStar.OrderOf(i) + 1))
+      EXPECT_EQ(alMod.getMask_zzX(i, j),
+                deserialized_context.getAlMod().getMask_zzX(i, j));
+  for (long i : helib::range(context.numPrimes()))
+    EXPECT_EQ(context.ithModulus(i).getRoot(),
+              deserialized_context.ithModulus(i).getRoot());
+}
+
+TEST_P(TestBinIO_BGV, readContextSnapshotRestoresTheTables)
+{
+  std::stringstream str;
+
+  EXPECT_NO_THROW(context.writeSnapshotTo(str));
+
+  helib::Context deserialized_context = helib::Context::readSnapshotFrom(str);
+
+  EXPECT_EQ(context, deserialized_context);
+  expectSameTables(context, deserialized_context);
+}
+
+TEST(TestBinIO_BGV, readContextSnapshotRestoresTheLiftedTables)
+{
+  helib::Context context = helib::ContextBuilder<helib::BGV>()
+                               .m(45)
+                               .p(17)
+                               .r(2)
+                               .bits(30)
+                               .build();
+  std::stringstream str;
+  context.writeSnapshotTo(str);
+
+  std::unique_ptr<helib::Context> deserialized_context(
+      helib::Context::readSnapshotPtrFrom(str));
+
+  EXPECT_EQ(context, *deserialized_context);
+  expectSameTables(context, *deserialized_context);
+}
+
+TEST_P(TestBinIO_BGV, readContextSnapshotRecomputesDamagedTables)
+{
+  std::stringstream ss;
+
+  context.writeSnapshotTo(ss);
+
+  // Flip a byte of the tables, after the checksum
+  std::string s = ss.str();
+  std::size_t pos = s.find(eyeCatcherToStr(helib::EyeCatcher::SNAP_BEGIN));
+  ASSERT_NE(pos, std::string::npos);
+  s[pos + helib::EyeCatcher::SIZE + 8 + 32 + 4] ^= 1;
+  ss.str(s);
+
+  helib::Context deserialized_context = helib::Context::readSnapshotFrom(ss);
+
+  EXPECT_EQ(context, deserialized_context);
+  expectSameTables(context, deserialized_context);
+}
+
+TEST_P(TestBinIO_BGV, readContextSnapshotRecomputesTablesOfACorruptSize)
+{
+  std::stringstream ss;
+
+  context.writeSnapshotTo(ss);
+
+  // Overwrite the size of the tables with a huge value
+  std::string s = ss.str();
+  std::size_t pos = s.find(eyeCatcherToStr(helib::EyeCatcher::SNAP_BEGIN));
+  ASSERT_NE(pos, std::string::npos);
+  std::fill_n(s.begin() + pos + helib::EyeCatcher::SIZE, 8, '\x7f');
+  ss.str(s);
+
+  helib::Context deserialized_context = helib::Context::readSnapshotFrom(ss);
+
+  EXPECT_EQ(context, deserialized_context);
+  expectSameTables(context, deserialized_context);
+}
+
+TEST_P(TestBinIO_BGV, readContextSnapshotAcceptsAContextWithoutTables)
+{
+  std::stringstream str;
+
+  context.writeTo(str);
+
+  helib::Context deserialized_context = helib::Context::readSnapshotFrom(str);
+
+  EXPECT_EQ(context, deserialized_context);
+}
+
 TEST(TestBinIO_BGV, readContextFromDeserializeCorrectlyBootstrappable)
 {
   // clang-format off
@@ -291,6 +424,116 @@ TEST(TestBinIO_BGV, readContextFromDeserializeCorrectlyBootstrappable)
   EXPECT_TRUE(deserialized_context.isBootstrappable());
 }
 
+// Two contexts with the same bootstrappable parameters, but no recryption
+// data yet
+struct BootstrappableContextPair
+{
+  helib::Context first;
+  helib::Context second;
+
+  BootstrappableContextPair() :
+      first(builder().build()), second(builder().build())
+  {
+    first.buildModChain(300, 3, /*willBeBootstrappable=*/true);
+    second.buildModChain(300, 3, /*willBeBootstrappable=*/true);
+  }
+
+  static helib::ContextBuilder<helib::BGV> builder()
+  {
+    // clang-format off
+    return helib::ContextBuilder<helib::BGV>()
+        .m(1271)
+        .p(2)
+        .r(1)
+        .gens({1026, 249})
+        .ords({30, -2})
+        .buildModChain(false);
+    // clang-format on
+  }
+};
+
+TEST(TestBinIO_BGV, recryptDataIsReadBackInsteadOfRebuilt)
+{
+  const NTL::Vec<long> mvec =
+      helib::convert<NTL::Vec<long>>(std::vector<long>({31, 41}));
+  BootstrappableContextPair contexts;
+  contexts.first.enableBootStrapping(mvec);
+
+  std::stringstream str;
+  contexts.first.writeRecryptDataTo(str);
+
+  // the data is tagged with the arguments of enableBootStrapping
+  std::stringstream copy(str.str());
+  EXPECT_THROW(contexts.second.readRecryptDataFrom(copy,
+                                                   mvec,
+                                                   /*build_cache=*/true),
+               helib::IOError);
+  EXPECT_FALSE(contexts.second.isBootstrappable());
+
+  contexts.second.readRecryptDataFrom(str, mvec);
+  EXPECT_TRUE(contexts.second.isBootstrappable());
+  EXPECT_EQ(contexts.first, contexts.second);
+
+  std::stringstream again;
+  contexts.second.writeRecryptDataTo(again);
+  EXPECT_EQ(again.str(), str.str());
+}
+
+TEST(TestBinIO_BGV, recryptDataIsNotReadForOtherParameters)
+{
+  const NTL::Vec<long> mvec =
+      helib::convert<NTL::Vec<long>>(std::vector<long>({31, 41}));
+  BootstrappableContextPair contexts;
+  contexts.first.enableBootStrapping(mvec);
+
+  helib::Context other = BootstrappableContextPair::builder().build();
+  other.buildModChain(400, 3, /*willBeBootstrappable=*/true);
+
+  std::stringstream str;
+  contexts.first.writeRecryptDataTo(str);
+  EXPECT_THROW(other.readRecryptDataFrom(str, mvec), helib::IOError);
+  EXPECT_FALSE(other.isBootstrappable());
+}
+
+TEST(TestBinIO_BGV, enableBootStrappingWithCacheWritesThenReadsTheFile)
+{
+  const std::string path = "TestBinIO_recryptData.bin";
+  const NTL::Vec<long> mvec =
+      helib::convert<NTL::Vec<long>>(std::vector<long>({31, 41}));
+  std::remove(path.c_str());
+  BootstrappableContextPair contexts;
+
+  EXPECT_FALSE(contexts.first.enableBootStrappingWithCache(mvec, path));
+  EXPECT_TRUE(contexts.second.enableBootStrappingWithCache(mvec, path));
+  EXPECT_EQ(contexts.first, contexts.second);
+  std::remove(path.c_str());
+}
+
+TEST(TestBinIO_BGV, enableBootStrappingWithCacheRebuildsACorruptFile)
+{
+  const std::string path = "TestBinIO_corruptRecryptData.bin";
+  const NTL::Vec<long> mvec =
+      helib::convert<NTL::Vec<long>>(std::vector<long>({31, 41}));
+  BootstrappableContextPair contexts;
+  contexts.first.enableBootStrapping(mvec);
+
+  // keep the header and digest, cut the file short and fill the tables
+  // with bytes that read as huge counts
+  std::stringstream str;
+  contexts.first.writeRecryptDataTo(str);
+  std::string data = str.str().substr(0, str.str().size() / 2);
+  std::fill(data.begin() + data.size() / 4, data.end(), '\x7f');
+  {
+    std::ofstream out(path, std::ios::binary);
+    out << data;
+  }
+
+  EXPECT_FALSE(contexts.second.enableBootStrappingWithCache(mvec, path));
+  EXPECT_TRUE(contexts.second.isBootstrappable());
+  EXPECT_EQ(contexts.first, contexts.second);
+  std::remove(path.c_str());
+}
+
 TEST_P(TestBinIO_BGV, canPerformOperationWithDeserializedContext)
 {
   std::stringstream ss;
@@ -600,6 +843,96 @@ TEST_P(TestBinIO_BGV, readCiphertextAndReadCiphertextInPlaceAreEquivalent)
   EXPECT_EQ(inplace_ctxt, deserialized_ctxt);
 }
 
+TEST_P(TestBinIO_BGV, compressedSymmetricCiphertextIsSmallerAndDecrypts)
+{
+  helib::Ptxt<helib::BGV> ptxt(context);
+  ptxt.random();
+  helib::Ctxt ctxt(secretKey);
+  secretKey.Encrypt(ctxt, ptxt);
+  EXPECT_TRUE(ctxt.isCompressible());
+
+  std::stringstream full, compressed;
+  ctxt.writeTo(full);
+  ctxt.writeTo(compressed, /*compressed=*/true);
+  EXPECT_LT(compressed.str().size(), full.str().size());
+
+  helib::Ctxt deserialized_ctxt = helib::Ctxt::readFrom(compressed, publicKey);
+  EXPECT_EQ(ctxt, deserialized_ctxt);
+
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, deserialized_ctxt);
+  EXPECT_EQ(result, ptxt);
+}
+
+TEST_P(TestBinIO_BGV, compressedCiphertextRoundTripsThroughJSON)
+{
+  helib::Ptxt<helib::BGV> ptxt(context);
+  ptxt.random();
+  helib::Ctxt ctxt(secretKey);
+  secretKey.Encrypt(ctxt, ptxt);
+
+  std::stringstream str;
+  ctxt.writeToJSON(str, /*compressed=*/true);
+  helib::Ctxt deserialized_ctxt = helib::Ctxt::readFromJSON(str, publicKey);
+  EXPECT_EQ(ctxt, deserialized_ctxt);
+}
+
+TEST_P(TestBinIO_BGV, ciphertextsThatAreNotFreshAreWrittenInFull)
+{
+  helib::Ptxt<helib::BGV> ptxt(context);
+  ptxt.random();
+  helib::Ctxt publicCtxt(publicKey), ctxt(secretKey);
+  publicKey.Encrypt(publicCtxt, ptxt);
+  secretKey.Encrypt(ctxt, ptxt);
+  ctxt += publicCtxt;
+  EXPECT_FALSE(publicCtxt.isCompressible());
+  EXPECT_FALSE(ctxt.isCompressible());
+
+  std::stringstream full, compressed;
+  ctxt.writeTo(full);
+  ctxt.writeTo(compressed, /*compressed=*/true);
+  EXPECT_EQ(compressed.str(), full.str());
+}
+
+TEST_P(TestBinIO_BGV, compressedPublicKeyIsSmallerAndEncrypts)
+{
+  std::stringstream full, compressed;
+  publicKey.writeTo(full);
+  publicKey.writeTo(compressed, /*compressed=*/true);
+  EXPECT_LT(compressed.str().size(), full.str().size());
+
+  helib::PubKey deserialized_pk = helib::PubKey::readFrom(compressed, context);
+  EXPECT_EQ(publicKey, deserialized_pk);
+
+  helib::Ptxt<helib::BGV> ptxt(context);
+  ptxt.random();
+  helib::Ctxt ctxt(deserialized_pk);
+  deserialized_pk.Encrypt(ctxt, ptxt);
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(result, ptxt);
+}
+
+TEST_P(TestBinIO_BGV, compressedPublicKeyRoundTripsThroughJSON)
+{
+  std::stringstream full, compressed;
+  publicKey.writeToJSON(full);
+  publicKey.writeToJSON(compressed, /*compressed=*/true);
+  EXPECT_LT(compressed.str().size(), full.str().size());
+
+  helib::PubKey deserialized_pk =
+      helib::PubKey::readFromJSON(compressed, context);
+  EXPECT_EQ(publicKey, deserialized_pk);
+
+  helib::Ptxt<helib::BGV> ptxt(context);
+  ptxt.random();
+  helib::Ctxt ctxt(deserialized_pk);
+  deserialized_pk.Encrypt(ctxt, ptxt);
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(result, ptxt);
+}
+
 TEST_P(TestBinIO_BGV, canPerformOperationsOnDeserializedCiphertext)
 {
   std::stringstream ss1, ss2;
@@ -697,6 +1030,19 @@ TEST_P(TestBinIO_CKKS, readContextPtrFromDeserializeCorrectly)
   EXPECT_EQ(context, *deserialized_contextp);
 }
 
+TEST_P(TestBinIO_CKKS, readContextSnapshotDeserializeCorrectly)
+{
+  std::stringstream str;
+
+  EXPECT_NO_THROW(context.writeSnapshotTo(str));
+
+  helib::Context deserialized_context = helib::Context::readSnapshotFrom(str);
+
+  EXPECT_EQ(context, deserialized_context);
+  EXPECT_EQ(context.getZMStar().getPhimX(),
+            deserialized_context.getZMStar().getPhimX());
+}
+
 TEST_P(TestBinIO_CKKS, canPerformOperationWithDeserializedContext)
 {
   std::stringstream ss;
@@ -10,12 +10,14 @@
  * limitations under the License. See accompanying LICENSE file.
  */
 #include <NTL/ZZ.h>
+#include <NTL/BasicThreadPool.h>
 #include <algorithm>
 #include <complex>
 
 #include <helib/norms.h>
 #include <helib/helib.h>
 #include <helib/debugging.h>
+#include <helib/polyEval.h>
 
 #include "gtest/gtest.h"
 #include "test_common.h"
@@ -618,6 +620,63 @@ TEST_P(TestCKKS, multiplyBySmallNegativeConstantFollowedByOperationWorks)
       << std::endl;
 }
 
+TEST_P(TestCKKS, batchEncodingAndDecodingIsLikeOneAtATime)
+{
+  // more than one batch of transforms, and a partial one
+  std::vector<std::vector<std::complex<double>>> arrays(11);
+  for (auto& array : arrays)
+    ea.random(array);
+
+  std::vector<helib::zzX> polys;
+  std::vector<double> factors = ea.encode(polys, arrays, /*size=*/-1);
+  ASSERT_EQ(polys.size(), arrays.size());
+  ASSERT_EQ(factors.size(), arrays.size());
+
+  std::vector<std::vector<std::complex<double>>> decoded;
+  ea.decode(decoded, polys, factors);
+  ASSERT_EQ(decoded.size(), arrays.size());
+
+  for (std::size_t i = 0; i < arrays.size(); i++) {
+    helib::zzX poly;
+    double factor = ea.encode(poly, arrays[i], /*size=*/-1);
+    EXPECT_EQ(factor, factors[i]);
+    EXPECT_EQ(poly, polys[i]);
+
+    std::vector<std::complex<double>> array;
+    ea.decode(array, poly, factor);
+    EXPECT_TRUE(cx_equals(decoded[i], array, 1e-12));
+    EXPECT_TRUE(cx_equals(decoded[i], arrays[i], epsilon));
+  }
+}
+
+TEST_P(TestCKKS, parallelPolynomialEvaluationWorks)
+{
+  helib::Ctxt ctxt(publicKey);
+  std::vector<std::complex<double>> vd1, vd2;
+  ea.random(vd1);
+  ea.encrypt(ctxt, publicKey, vd1);
+
+  // Degree 5: depth 3, the constant block is only a constant
+  const std::vector<double> poly{0.5, 0.0, -1.25, 0.75, 0.0, 0.5};
+  std::vector<std::complex<double>> expected(vd1.size(), poly.back());
+  for (long i = poly.size() - 2; i >= 0; i--) {
+    mul(expected, vd1);
+    add(expected, poly[i]);
+  }
+
+  long savedThreads = NTL::AvailableThreads();
+  for (long nThreads : {1l, 4l}) {
+    NTL::SetNumThreads(nThreads);
+    helib::Ctxt result(publicKey);
+    helib::polyEvalParallel(result, poly, ctxt);
+    ea.decrypt(result, secretKey, vd2);
+    EXPECT_TRUE(cx_equals(vd2, expected, epsilon))
+        << "  threads " << nThreads
+        << ", maxDiff=" << calcMaxDiff(vd2, expected) << std::endl;
+  }
+  NTL::SetNumThreads(savedThreads);
+}
+
 TEST(TestCKKS, buildingCKKSContextWithMAsNotAPowerOfTwoThrows)
 {
   EXPECT_THROW(
@@ -0,0 +1,214 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+
+#include <NTL/BasicThreadPool.h>
+
+#include <helib/helib.h>
+#include <helib/Circuit.h>
+
+#include "test_common.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+struct Parameters
+{
+  Parameters(long m, long p) : m(m), p(p){};
+
+  const long m;
+  const long p;
+
+  friend std::ostream& operator<<(std::ostream& os, const Parameters& params)
+  {
+    return os << "{m = " << params.m << ", p = " << params.p << "}";
+  }
+};
+
+class TestCircuit : public ::testing::TestWithParam<Parameters>
+{
+protected:
+  helib::Context context;
+  helib::SecKey secretKey;
+  const helib::PubKey& publicKey;
+  const helib::EncryptedArray& ea;
+
+  TestCircuit() :
+      context(helib::ContextBuilder<helib::BGV>()
+                  .m(GetParam().m)
+                  .p(GetParam().p)
+                  .r(1)
+                  .bits(500)
+                  .build()),
+      secretKey(context),
+      publicKey((secretKey.GenSecKey(),
+                 helib::addSome1DMatrices(secretKey),
+                 secretKey)),
+      ea(context.getEA())
+  {}
+
+  helib::PtxtArray randomPtxt() const
+  {
+    helib::PtxtArray ptxt(context);
+    ptxt.random();
+    return ptxt;
+  }
+
+  helib::Ctxt encrypt(const helib::PtxtArray& ptxt) const
+  {
+    helib::Ctxt ctxt(publicKey);
+    ptxt.encrypt(ctxt);
+    return ctxt;
+  }
+
+  helib::PtxtArray decrypt(const helib::Ctxt& ctxt) const
+  {
+    helib::PtxtArray ptxt(context);
+    ptxt.decrypt(ctxt, secretKey);
+    return ptxt;
+  }
+};
+
+TEST_P(TestCircuit, evaluatesLikeTheEagerOperations)
+{
+  helib::PtxtArray px = randomPtxt(), py = randomPtxt(), pc = randomPtxt();
+  std::vector<helib::Ctxt> inputs{encrypt(px), encrypt(py)};
+
+  helib::Circuit circuit(publicKey);
+  helib::Circuit::Node x = circuit.input();
+  helib::Circuit::Node y = circuit.input();
+  helib::Circuit::Constant c = circuit.constant(pc);
+  helib::Circuit::Node z =
+      circuit.add(circuit.mult(x, y), circuit.rotate(circuit.rotate(x, 1), 2));
+  helib::Circuit::Node w =
+      circuit.multByConstant(circuit.sub(z, circuit.negate(y)), c);
+  helib::Circuit::Node v =
+      circuit.addConstant(circuit.multByInteger(circuit.rotate(x, 5), 3), c);
+  helib::Circuit::Node sq = circuit.mult(v, v);
+
+  // z = x*y + rot(x, 3), w = (z + y)*c, v = 3*rot(x, 5) + c, sq = v^2
+  helib::PtxtArray pz = px;
+  pz *= py;
+  helib::PtxtArray rx = px;
+  rotate(rx, 3);
+  pz += rx;
+  helib::PtxtArray pw = pz;
+  pw += py;
+  pw *= pc;
+  helib::PtxtArray pv = px;
+  rotate(pv, 5);
+  pv *= helib::PtxtArray(context, 3l);
+  pv += pc;
+  helib::PtxtArray psq = pv;
+  psq *= pv;
+
+  long savedThreads = NTL::AvailableThreads();
+  for (long nThreads : {1l, 4l}) {
+    NTL::SetNumThreads(nThreads);
+    std::vector<helib::Ctxt> results;
+    circuit.evaluate(results, inputs, {w, v, x, sq, w});
+    ASSERT_EQ(results.size(), 5u);
+    EXPECT_EQ(decrypt(results[0]), pw) << " threads " << nThreads;
+    EXPECT_EQ(decrypt(results[1]), pv) << " threads " << nThreads;
+    EXPECT_EQ(results[2], inputs[0]) << " threads " << nThreads;
+    EXPECT_EQ(decrypt(results[3]), psq) << " threads " << nThreads;
+    EXPECT_EQ(decrypt(results[4]), pw) << " threads " << nThreads;
+  }
+  NTL::SetNumThreads(savedThreads);
+}
+
+TEST_P(TestCircuit, evaluatesWideWavesInParallel)
+{
+  helib::PtxtArray px = randomPtxt();
+  std::vector<helib::Ctxt> inputs{encrypt(px)};
+
+  // rotations of the same node, hoisted for a single dimension
+  helib::Circuit circuit(publicKey);
+  helib::Circuit::Node x = circuit.input();
+  helib::Circuit::Node sum = x;
+  helib::PtxtArray expected = px;
+  for (long k = 1; k <= 6; k++) {
+    sum = circuit.add(sum, circuit.rotate(x, k));
+    helib::PtxtArray rx = px;
+    rotate(rx, k);
+    expected += rx;
+  }
+
+  long savedThreads = NTL::AvailableThreads();
+  NTL::SetNumThreads(4);
+  std::vector<helib::Ctxt> results;
+  circuit.evaluate(results, inputs, {sum});
+  NTL::SetNumThreads(savedThreads);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(decrypt(results[0]), expected);
+}
+
+TEST_P(TestCircuit, findsCommonSubexpressions)
+{
+  helib::Circuit circuit(publicKey);
+  helib::Circuit::Node x = circuit.input();
+  helib::Circuit::Node y = circuit.input();
+
+  EXPECT_EQ(circuit.add(x, y), circuit.add(y, x));
+  EXPECT_EQ(circuit.mult(x, y), circuit.mult(y, x));
+  EXPECT_NE(circuit.sub(x, y), circuit.sub(y, x));
+  EXPECT_EQ(circuit.rotate(circuit.rotate(x, 2), 3), circuit.rotate(x, 5));
+  EXPECT_EQ(circuit.rotate(circuit.rotate(x, 1), -1), x);
+  EXPECT_EQ(circuit.rotate(x, ea.size()), x);
+  EXPECT_EQ(circuit.negate(circuit.negate(x)), x);
+  EXPECT_EQ(circuit.multByInteger(x, 1), x);
+  EXPECT_EQ(circuit.op(circuit.rotate(x, 5)), helib::Circuit::Op::ROTATE);
+
+  // x, y, add, mult, two subs, rot(x,2), rot(x,5), rot(x,1), negate
+  EXPECT_EQ(circuit.size(), 10);
+}
+
+TEST_P(TestCircuit, analyzeCountsTheOperationsThatAreNeeded)
+{
+  helib::Circuit circuit(publicKey);
+  helib::Circuit::Node x = circuit.input();
+  helib::Circuit::Node y = circuit.input();
+  helib::Circuit::Node xy = circuit.mult(x, y);
+  helib::Circuit::Node left = circuit.mult(xy, circuit.rotate(x, 1));
+  helib::Circuit::Node right = circuit.mult(circuit.rotate(y, 2), y);
+  helib::Circuit::Node out = circuit.add(left, right);
+  circuit.mult(out, out); // not needed
+
+  helib::Circuit::Stats stats = circuit.analyze({out});
+  EXPECT_EQ(stats.operations, 6);
+  EXPECT_EQ(stats.multiplications, 3);
+  EXPECT_EQ(stats.rotations, 2);
+  EXPECT_EQ(stats.recryptions, 0);
+  EXPECT_EQ(stats.keySwitches, 5);
+  EXPECT_EQ(stats.depth, 2);
+  EXPECT_EQ(stats.waves, 3);
+}
+
+TEST_P(TestCircuit, throwsOnBadArguments)
+{
+  helib::Circuit circuit(publicKey);
+  helib::Circuit::Node x = circuit.input();
+  EXPECT_THROW(circuit.add(x, 7), helib::InvalidArgument);
+  EXPECT_THROW(circuit.multByConstant(x, 0), helib::InvalidArgument);
+
+  std::vector<helib::Ctxt> results;
+  EXPECT_THROW(circuit.evaluate(results, {}, {x}), helib::InvalidArgument);
+}
+
+INSTANTIATE_TEST_SUITE_P(variousParameters,
+                         TestCircuit,
+                         ::testing::Values(
+                             // several dimensions
+                             Parameters(45, 19),
+                             // a single dimension, rotations are hoisted
+                             Parameters(127, 2)));
+
+} // namespace
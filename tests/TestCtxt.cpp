@@ -15,8 +15,11 @@
 // The older tests with more extensive coverage can be found in the files
 // with names matching "GTest*".
 
+#include <map>
+
 #include <helib/helib.h>
 #include <helib/debugging.h>
+#include <helib/HoistedCtxt.h>
 
 #include "test_common.h"
 #include "gtest/gtest.h"
@@ -141,6 +144,199 @@ TEST_P(TestCtxt, timesEqualsWithEncodedPtxtWorks)
   EXPECT_EQ(decrypted_result, expected_result);
 }
 
+TEST_P(TestCtxt, binaryOperatorsWithTemporariesWork)
+{
+  helib::Ptxt<helib::BGV> ptxt1(context), ptxt2(context), ptxt3(context);
+  ptxt1.random();
+  ptxt2.random();
+  ptxt3.random();
+  helib::Ctxt ctxt1(publicKey), ctxt2(publicKey), ctxt3(publicKey);
+  publicKey.Encrypt(ctxt1, ptxt1);
+  publicKey.Encrypt(ctxt2, ptxt2);
+  publicKey.Encrypt(ctxt3, ptxt3);
+  const helib::Ctxt copy1 = ctxt1;
+
+  // (ptxt1 * ptxt2 + ptxt3) - ptxt1 and ptxt3 - (ptxt1 + ptxt2)
+  helib::Ctxt result1 = ctxt1 * ctxt2 + ctxt3 - ctxt1;
+  helib::Ctxt result2 = ctxt3 - (ctxt1 + ctxt2);
+  EXPECT_EQ(ctxt1, copy1); // lvalue operands are not modified
+
+  helib::Ptxt<helib::BGV> expected1 = ptxt1;
+  expected1 *= ptxt2;
+  expected1 += ptxt3;
+  expected1 -= ptxt1;
+  helib::Ptxt<helib::BGV> expected2 = ptxt3;
+  expected2 -= ptxt1;
+  expected2 -= ptxt2;
+
+  helib::Ptxt<helib::BGV> decrypted(context);
+  secretKey.Decrypt(decrypted, result1);
+  EXPECT_EQ(decrypted, expected1);
+  secretKey.Decrypt(decrypted, result2);
+  EXPECT_EQ(decrypted, expected2);
+
+  // moving takes over the parts
+  helib::Ctxt moved(std::move(result2));
+  EXPECT_TRUE(result2.isEmpty());
+  EXPECT_EQ(result2.getPrimeSet().card(), 0);
+  secretKey.Decrypt(decrypted, moved);
+  EXPECT_EQ(decrypted, expected2);
+  result2 = std::move(moved);
+  EXPECT_EQ(moved.getPrimeSet().card(), 0);
+  secretKey.Decrypt(decrypted, result2);
+  EXPECT_EQ(decrypted, expected2);
+}
+
+TEST_P(TestCtxt, noiseEstimationPoliciesAllDecryptCorrectly)
+{
+  helib::Ptxt<helib::BGV> ptxt(context);
+  ptxt.random();
+  helib::Ctxt fresh(publicKey);
+  publicKey.Encrypt(fresh, ptxt);
+  helib::Ptxt<helib::BGV> expected = ptxt;
+  expected *= ptxt;
+
+  std::map<helib::NoiseEstimation, NTL::xdouble> noise;
+  for (helib::NoiseEstimation policy : {helib::NoiseEstimation::EXACT,
+                                        helib::NoiseEstimation::BOUND,
+                                        helib::NoiseEstimation::OFF}) {
+    context.setNoiseEstimation(policy);
+    helib::Ctxt ctxt = fresh;
+    ctxt.multiplyBy(ctxt); // key switching and modulus switching
+    ctxt.dropSmallAndSpecialPrimes();
+
+    helib::Ptxt<helib::BGV> result(context);
+    secretKey.Decrypt(result, ctxt);
+    EXPECT_EQ(result, expected);
+    noise[policy] = ctxt.getNoiseBound();
+  }
+  context.setNoiseEstimation(helib::NoiseEstimation::EXACT);
+
+  EXPECT_LT(noise[helib::NoiseEstimation::OFF],
+            noise[helib::NoiseEstimation::EXACT]);
+  EXPECT_LT(noise[helib::NoiseEstimation::OFF],
+            noise[helib::NoiseEstimation::BOUND]);
+}
+
+TEST_P(TestCtxt, lazyRelinearizationDefersTheKeySwitching)
+{
+  const long n = 4;
+  std::vector<helib::Ptxt<helib::BGV>> a, b;
+  for (long i = 0; i < n; i++) {
+    a.emplace_back(context);
+    a.back().random();
+    b.emplace_back(context);
+    b.back().random();
+  }
+  std::vector<helib::Ctxt> ca, cb;
+  publicKey.encryptBatch(ca, a);
+  publicKey.encryptBatch(cb, b);
+
+  context.setLazyRelinearization(true);
+  helib::Ctxt sum(publicKey);
+  helib::Ptxt<helib::BGV> expected(context);
+  for (long i = 0; i < n; i++) {
+    helib::Ctxt prod = ca[i];
+    prod.multiplyBy(cb[i]);
+    EXPECT_FALSE(prod.inCanonicalForm());
+    sum += prod;
+    helib::Ptxt<helib::BGV> p = a[i];
+    p *= b[i];
+    expected += p;
+  }
+  EXPECT_FALSE(sum.inCanonicalForm());
+
+  // a rotation and a further multiplication re-linearize their input
+  helib::Ctxt rotated = sum;
+  helib::rotate(rotated, 1);
+  EXPECT_TRUE(rotated.inCanonicalForm());
+  helib::Ctxt squared = sum;
+  squared.multiplyBy(sum);
+  context.setLazyRelinearization(false);
+
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, sum);
+  EXPECT_EQ(result, expected);
+  sum.cleanUp();
+  EXPECT_TRUE(sum.inCanonicalForm());
+  secretKey.Decrypt(result, sum);
+  EXPECT_EQ(result, expected);
+
+  helib::Ptxt<helib::BGV> expectedRotated = expected;
+  expectedRotated.rotate(1);
+  secretKey.Decrypt(result, rotated);
+  EXPECT_EQ(result, expectedRotated);
+
+  expected *= expected;
+  secretKey.Decrypt(result, squared);
+  EXPECT_EQ(result, expected);
+}
+
+TEST_P(TestCtxt, encryptBatchAndDecryptBatchRoundTrip)
+{
+  std::vector<helib::Ptxt<helib::BGV>> ptxts;
+  for (long i = 0; i < 7; i++) {
+    helib::Ptxt<helib::BGV> ptxt(context);
+    ptxt.random();
+    ptxts.push_back(ptxt);
+  }
+
+  std::vector<helib::Ctxt> ctxts;
+  publicKey.encryptBatch(ctxts, ptxts);
+  ASSERT_EQ(ctxts.size(), ptxts.size());
+
+  std::vector<helib::Ptxt<helib::BGV>> decrypted;
+  secretKey.decryptBatch(decrypted, ctxts);
+  ASSERT_EQ(decrypted.size(), ptxts.size());
+  for (std::size_t i = 0; i < ptxts.size(); i++)
+    EXPECT_EQ(decrypted[i], ptxts[i]) << " index: " << i;
+}
+
+TEST_P(TestCtxt, decryptBatchMatchesDecryptForMixedKeyPowers)
+{
+  std::vector<helib::Ptxt<helib::BGV>> ptxts;
+  for (long i = 0; i < 4; i++) {
+    helib::Ptxt<helib::BGV> ptxt(context);
+    ptxt.random();
+    ptxts.push_back(ptxt);
+  }
+
+  std::vector<helib::Ctxt> ctxts;
+  secretKey.encryptBatch(ctxts, ptxts);
+
+  // Parts that refer to s(X^p) and s^2, next to the plain s
+  ctxts[1].automorph(p);
+  ctxts[2].multLowLvl(ctxts[3]);
+
+  std::vector<NTL::ZZX> polys;
+  secretKey.decryptBatch(polys, ctxts);
+  ASSERT_EQ(polys.size(), ctxts.size());
+  for (std::size_t i = 0; i < ctxts.size(); i++) {
+    NTL::ZZX expected;
+    secretKey.Decrypt(expected, ctxts[i]);
+    EXPECT_EQ(polys[i], expected) << " index: " << i;
+  }
+}
+
+TEST_P(TestCtxt, encryptBatchOfPtxtArraysRoundTrips)
+{
+  std::vector<helib::PtxtArray> ptxts;
+  for (long i = 0; i < 5; i++) {
+    helib::PtxtArray ptxt(context);
+    ptxt.random();
+    ptxts.push_back(ptxt);
+  }
+
+  std::vector<helib::Ctxt> ctxts;
+  helib::encryptBatch(ctxts, ptxts, publicKey);
+
+  std::vector<helib::PtxtArray> decrypted;
+  helib::decryptBatch(decrypted, ctxts, secretKey);
+  ASSERT_EQ(decrypted.size(), ptxts.size());
+  for (std::size_t i = 0; i < ptxts.size(); i++)
+    EXPECT_EQ(decrypted[i], ptxts[i]) << " index: " << i;
+}
+
 TEST_P(TestCtxt, mapTo01WorksCorrectlyForConstantInputs)
 {
   std::vector<long> data(ea.size());
@@ -211,6 +407,39 @@ TEST_P(TestCtxtWithBadDimensions,
   }
 }
 
+TEST_P(TestCtxt, keySwitchingMatricesDoNotDependOnTheNumberOfThreads)
+{
+  auto generate = [this](long nThreads) {
+    NTL::SetNumThreads(nThreads);
+    NTL::SetSeed(NTL::ZZ(17));
+    helib::SecKey sk(context);
+    sk.GenSecKey();
+    helib::addSome1DMatrices(sk);
+    helib::addFrbMatrices(sk);
+    return sk.keySWlist();
+  };
+  long savedThreads = NTL::AvailableThreads();
+  std::vector<helib::KeySwitch> matrices1 = generate(1);
+  std::vector<helib::KeySwitch> matrices4 = generate(4);
+  NTL::SetNumThreads(savedThreads);
+
+  ASSERT_EQ(matrices1.size(), matrices4.size());
+  for (std::size_t i = 0; i < matrices1.size(); ++i)
+    EXPECT_EQ(matrices1[i], matrices4[i]) << " matrix " << i;
+
+  // the fixture's matrices were generated the same way, check they work
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+  helib::rotate(ctxt, 1);
+  ptxt.rotate(1);
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(ptxt, result);
+}
+
 TEST_P(TestCtxt, frobeniusAutomorphWorksCorrectly)
 {
   std::vector<long> data(ea.size());
@@ -253,6 +482,77 @@ TEST_P(TestCtxtWithBadDimensions, rotate1DRotatesCorrectlyWithBadDimensions)
   }
 }
 
+TEST_P(TestCtxtWithBadDimensions, hoistedRotate1DMatchesRotate1D)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+
+  helib::HoistedCtxt hoisted(ctxt);
+  for (long i = 0; i < context.getZMStar().numOfGens(); ++i) {
+    for (long k : {-1l, 1l, 3l}) {
+      helib::Ctxt tmp(helib::ZeroCtxtLike, ctxt);
+      ea.rotate1D(tmp, hoisted, i, k);
+      helib::Ptxt<helib::BGV> expected_result(ptxt);
+      expected_result.rotate1D(i, k);
+      helib::Ptxt<helib::BGV> result(context);
+      secretKey.Decrypt(result, tmp);
+
+      EXPECT_EQ(expected_result, result);
+    }
+  }
+}
+
+TEST_P(TestCtxt, hoistedAutomorphMatchesSmartAutomorph)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+  ctxt.multiplyBy(ctxt); // make sure there is something to key-switch
+
+  helib::HoistedCtxt hoisted(ctxt);
+  for (long i = 0; i < context.getZMStar().numOfGens(); ++i) {
+    long k = context.getZMStar().genToPow(i, 1);
+    helib::Ctxt expected(ctxt);
+    expected.smartAutomorph(k);
+    std::shared_ptr<helib::Ctxt> result = hoisted.automorph(k);
+
+    helib::Ptxt<helib::BGV> expected_result(context);
+    helib::Ptxt<helib::BGV> decrypted_result(context);
+    secretKey.Decrypt(expected_result, expected);
+    secretKey.Decrypt(decrypted_result, *result);
+
+    EXPECT_EQ(expected_result, decrypted_result);
+  }
+}
+
+TEST_P(TestCtxt, addConstantProductMatchesMultByConstantAndAdd)
+{
+  std::vector<long> data(ea.size());
+  std::iota(data.begin(), data.end(), 0);
+  helib::Ptxt<helib::BGV> ptxt(context, data);
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+
+  // The constant polynomial 3 encodes 3 in every slot
+  helib::DoubleCRT dcrt(NTL::ZZX(3l), context, context.fullPrimes());
+
+  helib::Ctxt acc(ctxt);
+  acc.addConstantProduct(dcrt, ctxt);
+  acc.addConstantProduct(dcrt, ctxt);
+
+  helib::Ptxt<helib::BGV> expected_result(ptxt);
+  expected_result *= 7l;
+  helib::Ptxt<helib::BGV> decrypted_result(context);
+  secretKey.Decrypt(decrypted_result, acc);
+
+  EXPECT_EQ(decrypted_result, expected_result);
+}
+
 // Use this when thoroughly exploring an (m, p) grid of parameters.
 // std::vector<BGVParameters> getParameters(bool good)
 // {
@@ -0,0 +1,295 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <helib/helib.h>
+#include <helib/MappedArchive.h>
+
+#include "test_common.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+class TestMappedArchive : public ::testing::Test
+{
+protected:
+  const std::string path = "TestMappedArchive.bin";
+
+  helib::Context context;
+  helib::SecKey secretKey;
+  helib::PubKey publicKey;
+
+  TestMappedArchive() :
+      context(helib::ContextBuilder<helib::BGV>()
+                  .m(45)
+                  .p(443)
+                  .r(1)
+                  .bits(300)
+                  .build()),
+      secretKey(context),
+      publicKey((secretKey.GenSecKey(), secretKey))
+  {}
+
+  ~TestMappedArchive() override { std::remove(path.c_str()); }
+
+  helib::Ptxt<helib::BGV> randomPtxt() const
+  {
+    helib::Ptxt<helib::BGV> ptxt(context);
+    ptxt.random();
+    return ptxt;
+  }
+
+  // The 64-bit word at offset in the archive file
+  long readWord(long offset) const
+  {
+    std::ifstream str(path, std::ios::binary);
+    str.seekg(offset);
+    long w = 0;
+    str.read(reinterpret_cast<char*>(&w), sizeof(w));
+    return w;
+  }
+
+  void overwriteWord(long offset, long w) const
+  {
+    std::fstream str(path, std::ios::in | std::ios::out | std::ios::binary);
+    str.seekp(offset);
+    str.write(reinterpret_cast<const char*>(&w), sizeof(w));
+  }
+
+  // The offset of the first block of residues, which follows the header
+  // and the primes
+  long firstBlockOffset() const
+  {
+    const long align = helib::ResidueMatrix::ALIGNMENT;
+    return ((align + 8 * context.numPrimes() + align - 1) / align) * align;
+  }
+};
+
+TEST_F(TestMappedArchive, ciphertextsAreReadBackAsViews)
+{
+  std::vector<helib::Ptxt<helib::BGV>> ptxts;
+  std::vector<helib::Ctxt> ctxts;
+  for (long i = 0; i < 3; i++)
+    ptxts.push_back(randomPtxt());
+  publicKey.encryptBatch(ctxts, ptxts);
+  ctxts[1].square(); // a ciphertext with three parts
+
+  {
+    helib::ArchiveWriter writer(path, context);
+    for (const auto& ctxt : ctxts)
+      writer.append(ctxt);
+    EXPECT_EQ(writer.size(), 3);
+  }
+
+  helib::MappedArchive archive(path, context);
+  ASSERT_EQ(archive.size(), 3);
+  for (long i = 0; i < archive.size(); i++) {
+    EXPECT_EQ(archive.kind(i), helib::MappedArchive::ItemKind::CTXT);
+    helib::Ctxt ctxt(publicKey);
+    archive.get(ctxt, i);
+    EXPECT_EQ(ctxt, ctxts[i]) << " item " << i;
+  }
+}
+
+TEST_F(TestMappedArchive, viewsCanBeUsedAfterTheArchiveIsClosed)
+{
+  helib::Ptxt<helib::BGV> ptxt = randomPtxt();
+  helib::Ctxt ctxt(publicKey);
+  publicKey.Encrypt(ctxt, ptxt);
+  {
+    helib::ArchiveWriter writer(path, context);
+    writer.append(ctxt);
+  }
+
+  helib::Ctxt view(publicKey);
+  {
+    helib::MappedArchive archive(path, context);
+    archive.get(view, 0);
+  }
+  view.multiplyBy(view);
+  ptxt *= ptxt;
+
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, view);
+  EXPECT_EQ(result, ptxt);
+
+  // the file is not modified by operations on the views
+  helib::MappedArchive archive(path, context);
+  helib::Ctxt again(publicKey);
+  archive.get(again, 0);
+  EXPECT_EQ(again, ctxt);
+}
+
+TEST_F(TestMappedArchive, keySwitchingMatricesAreReadBack)
+{
+  const helib::KeySwitch& ksm = publicKey.keySWlist().at(0);
+  {
+    helib::ArchiveWriter writer(path, context);
+    writer.append(ksm);
+  }
+
+  helib::MappedArchive archive(path, context);
+  ASSERT_EQ(archive.size(), 1);
+  EXPECT_EQ(archive.kind(0), helib::MappedArchive::ItemKind::KEY_SWITCH);
+  helib::KeySwitch readBack;
+  archive.get(readBack, 0);
+  EXPECT_EQ(readBack, ksm);
+}
+
+TEST_F(TestMappedArchive, keyStoreServesTheKeySwitchingMatrices)
+{
+  helib::addSome1DMatrices(secretKey);
+  const helib::PubKey& fullKey = secretKey;
+  std::stringstream ss;
+  fullKey.writeTo(ss, /*compressed=*/false, /*withMatrices=*/false);
+  fullKey.writeKeyStore(path);
+
+  helib::PubKey pk = helib::PubKey::readFrom(ss, context);
+  EXPECT_TRUE(pk.keySWlist().empty());
+  pk.openKeyStore(path, /*maxResident=*/2);
+  ASSERT_NE(pk.getKeyStore(), nullptr);
+  EXPECT_EQ(pk.getKeyStore()->numResident(), 0);
+  EXPECT_EQ(pk, fullKey);
+
+  // Rotations use more than two matrices, so some are released and read
+  // again from the file
+  const helib::EncryptedArray& ea = context.getEA();
+  helib::Ptxt<helib::BGV> ptxt = randomPtxt();
+  helib::Ctxt ctxt(pk);
+  pk.Encrypt(ctxt, ptxt);
+  for (long k = 1; k < 4; k++) {
+    for (long i = 0; i < ea.dimension(); i++) {
+      ea.rotate1D(ctxt, i, k);
+      ptxt.rotate1D(i, k);
+    }
+    EXPECT_LE(pk.getKeyStore()->numResident(), 2);
+  }
+  ctxt.multiplyBy(ctxt);
+  ptxt *= ptxt;
+
+  helib::Ptxt<helib::BGV> result(context);
+  secretKey.Decrypt(result, ctxt);
+  EXPECT_EQ(result, ptxt);
+
+  // copies share the store
+  helib::PubKey copy(pk);
+  EXPECT_EQ(copy.getKeyStore(), pk.getKeyStore());
+  EXPECT_EQ(copy, fullKey);
+}
+
+TEST_F(TestMappedArchive, keyStoreThrowsOnAnArchiveWithCiphertexts)
+{
+  {
+    helib::ArchiveWriter writer(path, context);
+    helib::Ctxt ctxt(publicKey);
+    publicKey.Encrypt(ctxt, randomPtxt());
+    writer.append(ctxt);
+  }
+  EXPECT_THROW(helib::KeySwitchStore(path, context), helib::IOError);
+}
+
+TEST_F(TestMappedArchive, throwsOnAContextMismatch)
+{
+  {
+    helib::ArchiveWriter writer(path, context);
+    helib::Ctxt ctxt(publicKey);
+    publicKey.Encrypt(ctxt, randomPtxt());
+    writer.append(ctxt);
+  }
+
+  helib::Context other = helib::ContextBuilder<helib::BGV>()
+                             .m(45)
+                             .p(443)
+                             .r(1)
+                             .bits(200)
+                             .build();
+  EXPECT_THROW(helib::MappedArchive(path, other), helib::IOError);
+}
+
+TEST_F(TestMappedArchive, throwsOnAResidueOutOfRange)
+{
+  {
+    helib::ArchiveWriter writer(path, context);
+    helib::Ctxt ctxt(publicKey);
+    publicKey.Encrypt(ctxt, randomPtxt());
+    writer.append(ctxt);
+  }
+  overwriteWord(firstBlockOffset(), -1);
+
+  helib::MappedArchive archive(path, context);
+  helib::Ctxt view(publicKey);
+  EXPECT_THROW(archive.get(view, 0), helib::IOError);
+}
+
+TEST_F(TestMappedArchive, throwsOnAPrimeIndexOutOfRange)
+{
+  {
+    helib::ArchiveWriter writer(path, context);
+    helib::Ctxt ctxt(publicKey);
+    publicKey.Encrypt(ctxt, randomPtxt());
+    writer.append(ctxt);
+  }
+
+  // The header ends with the offset of the table of contents, whose first
+  // entry gives the offset of the record of the ciphertext. The record
+  // starts with its length, ptxtSpace, intFactor and three xdoubles, then
+  // the prime set: its size and the indexes.
+  long tocOffset = readWord(56);
+  long recordOffset = readWord(tocOffset + 16);
+  overwriteWord(recordOffset + 80, context.numPrimes());
+
+  helib::MappedArchive archive(path, context);
+  helib::Ctxt view(publicKey);
+  EXPECT_THROW(archive.get(view, 0), helib::IOError);
+}
+
+TEST_F(TestMappedArchive, keyStoreChecksTheResiduesOnFirstUse)
+{
+  publicKey.writeKeyStore(path);
+  overwriteWord(firstBlockOffset(), -1);
+
+  helib::KeySwitchStore store(path, context);
+  helib::KeySwitch ksm;
+  EXPECT_NO_THROW(store.get(ksm, 0));
+  EXPECT_THROW(store.touch(0), helib::IOError);
+
+  helib::MappedArchive archive(path, context);
+  EXPECT_THROW(archive.get(ksm, 0), helib::IOError);
+}
+
+TEST_F(TestMappedArchive, keyStoreChecksTheResiduesBeforeListingTheMatrices)
+{
+  std::stringstream ss;
+  publicKey.writeTo(ss, /*compressed=*/false, /*withMatrices=*/false);
+  publicKey.writeKeyStore(path);
+  overwriteWord(firstBlockOffset(), -1);
+
+  helib::PubKey pk = helib::PubKey::readFrom(ss, context);
+  pk.openKeyStore(path);
+  EXPECT_THROW(pk.keySWlist(), helib::IOError);
+  EXPECT_THROW(pk.writeTo(ss), helib::IOError);
+  EXPECT_THROW((void)(pk == publicKey), helib::IOError);
+}
+
+TEST_F(TestMappedArchive, throwsOnAFileThatIsNotAnArchive)
+{
+  {
+    std::ofstream str(path);
+    str << std::string(200, 'x');
+  }
+  EXPECT_THROW(helib::MappedArchive(path, context), helib::IOError);
+}
+
+} // namespace
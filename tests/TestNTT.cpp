@@ -0,0 +1,171 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+
+#include <NTL/ZZ.h>
+#include <NTL/ZZX.h>
+
+#include <helib/helib.h>
+#include <helib/CModulus.h>
+#include <helib/NTT.h>
+#include "test_common.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+struct NTTParameters
+{
+  NTTParameters(long m, long bits) : m(m), bits(bits){};
+
+  const long m;
+  const long bits;
+
+  friend std::ostream& operator<<(std::ostream& os, const NTTParameters& params)
+  {
+    return os << "{"
+              << "m = " << params.m << ", "
+              << "bits = " << params.bits << "}";
+  }
+};
+
+// Find a prime q = 1 (mod m) with the given number of bits
+long findPrime(long m, long bits)
+{
+  for (long t = (1L << (bits - 1)) / m + 1;; t++) {
+    long q = t * m + 1;
+    if (NTL::ProbPrime(q))
+      return q;
+  }
+}
+
+class TestNTT : public ::testing::TestWithParam<NTTParameters>
+{
+protected:
+  const long m;
+  const long phim;
+  const long q;
+  helib::PAlgebra zMStar;
+  helib::Cmodulus native;
+  helib::Cmodulus ntl;
+
+  TestNTT() :
+      m(GetParam().m),
+      phim(m / 2),
+      q(findPrime(m, GetParam().bits)),
+      zMStar(m, -1),
+      native(zMStar, q, 0, /*nativeNTT=*/true),
+      ntl(zMStar, q, 0, /*nativeNTT=*/false)
+  {}
+};
+
+TEST_P(TestNTT, usesTheRequestedTransform)
+{
+  EXPECT_TRUE(native.usesNativeNTT());
+  EXPECT_FALSE(ntl.usesNativeNTT());
+}
+
+TEST_P(TestNTT, forwardTransformMatchesNTLTransform)
+{
+  helib::zzX poly(NTL::INIT_SIZE, phim);
+  for (long i = 0; i < phim; i++)
+    poly[i] = NTL::RandomBnd(2001) - 1000;
+
+  NTL::vec_long y_native, y_ntl;
+  native.FFT(y_native, poly);
+  ntl.FFT(y_ntl, poly);
+
+  EXPECT_EQ(y_native, y_ntl);
+}
+
+TEST_P(TestNTT, inverseTransformMatchesNTLTransform)
+{
+  NTL::vec_long y;
+  y.SetLength(phim);
+  for (long i = 0; i < phim; i++)
+    y[i] = NTL::RandomBnd(q);
+
+  NTL::zz_pBak bak;
+  bak.save();
+  native.restoreModulus();
+
+  NTL::zz_pX x_native, x_ntl;
+  native.iFFT(x_native, y);
+  ntl.iFFT(x_ntl, y);
+  EXPECT_EQ(x_native, x_ntl);
+
+  // and back again
+  NTL::ZZX poly;
+  NTL::conv(poly, x_native);
+  NTL::vec_long y_again;
+  native.FFT(y_again, poly);
+  EXPECT_EQ(y_again, y);
+}
+
+TEST_P(TestNTT, transformEvaluatesAtOddPowersOfARoot)
+{
+  long n = phim;
+  long logn = NTL::NumBits(n) - 1;
+
+  // find a primitive m-th root of unity
+  NTL::zz_pPush push(q);
+  NTL::zz_p g;
+  do {
+    g = NTL::random_zz_p();
+    g = NTL::power(g, (q - 1) / m);
+  } while (NTL::power(g, n) != -1);
+  long psi = NTL::rep(g);
+
+  helib::NegacyclicNTT ntt(q, psi, logn);
+  std::vector<long> x(n), y(n);
+  for (long i = 0; i < n; i++)
+    x[i] = NTL::RandomBnd(q);
+  ntt.forward(y.data(), x.data());
+
+  NTL::zz_pX poly;
+  for (long i = 0; i < n; i++)
+    SetCoeff(poly, i, x[i]);
+  for (long j = 0; j < std::min(n, 16L); j++) {
+    NTL::zz_p pt = NTL::power(g, 2 * j + 1);
+    EXPECT_EQ(NTL::rep(NTL::eval(poly, pt)), y[j]) << " index: " << j;
+  }
+
+  std::vector<long> back(n);
+  ntt.inverse(back.data(), y.data());
+  EXPECT_EQ(back, x);
+}
+
+TEST(TestNTTContext, contextBuilderSelectsTheTransform)
+{
+  helib::Context defaultContext =
+      helib::ContextBuilder<helib::CKKS>().m(128).bits(100).build();
+  helib::Context ntlContext = helib::ContextBuilder<helib::CKKS>()
+                                  .m(128)
+                                  .bits(100)
+                                  .nativeNTT(false)
+                                  .build();
+
+  EXPECT_TRUE(defaultContext.usesNativeNTT());
+  EXPECT_FALSE(ntlContext.usesNativeNTT());
+  for (long i = 0; i < defaultContext.numPrimes(); i++)
+    EXPECT_TRUE(defaultContext.ithModulus(i).usesNativeNTT());
+  for (long i = 0; i < ntlContext.numPrimes(); i++)
+    EXPECT_FALSE(ntlContext.ithModulus(i).usesNativeNTT());
+}
+
+INSTANTIATE_TEST_SUITE_P(variousParameters,
+                         TestNTT,
+                         ::testing::Values(NTTParameters(4, 30),
+                                           NTTParameters(16, 40),
+                                           NTTParameters(1024, 45),
+                                           NTTParameters(1024, 60),
+                                           NTTParameters(8192, 55)));
+
+} // namespace
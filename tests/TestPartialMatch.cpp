@@ -11,6 +11,7 @@
  */
 
 #include <bitset>
+#include <cstdio>
 
 #include <helib/helib.h>
 #include <helib/partialMatch.h>
@@ -978,6 +979,107 @@ TEST_P(TestPartialMatch, scoringWorksWithEncryptedDatabaseAndQueryAPIs)
     }
 }
 
+TEST_P(TestPartialMatch, streamingDatabaseEmitsTheResultOfEachBlock)
+{
+  // 5 rows, 3 columns
+  helib::Matrix<helib::Ptxt<helib::BGV>> plaintext_database_data(5l, 3l);
+  for (long i = 0; i < 5; ++i)
+    for (long j = 0; j < 3; ++j)
+      plaintext_database_data(i, j) = helib::Ptxt<helib::BGV>(
+          context,
+          std::vector<long>{(i * j) % 3, i % 2, j, 1});
+  helib::Database<helib::Ptxt<helib::BGV>> database(plaintext_database_data,
+                                                    context);
+
+  helib::Matrix<helib::Ptxt<helib::BGV>> plaintext_query(1l, 3l);
+  for (long j = 0; j < 3; ++j)
+    plaintext_query(0, j) =
+        helib::Ptxt<helib::BGV>(context, std::vector<long>{j % 3, 1, j, 1});
+
+  std::vector<std::vector<long>> Fs = {{0, 1, 2}, {1, 2}};
+  std::vector<long> mus = {0, 1};
+  std::vector<helib::Matrix<long>> taus = {{{1}, {2}, {3}}, {{1}, {1}}};
+  helib::Query_t weighted_query(Fs, mus, taus, false);
+  helib::QueryBuilder qb(helib::makeQueryExpr(0) &&
+                         (helib::makeQueryExpr(1) || helib::makeQueryExpr(2)));
+  helib::Query_t lookup_query(qb.build(3));
+
+  auto expected_scores = database.getScore(weighted_query, plaintext_query);
+  auto expected_lookup = database.contains(lookup_query, plaintext_query);
+
+  // Blocks of 2 rows from the matrix: rows 0-1, 2-3 and 4
+  helib::StreamingDatabase<helib::Ptxt<helib::BGV>> plaintext_stream(
+      std::make_shared<helib::MatrixRowSource<helib::Ptxt<helib::BGV>>>(
+          plaintext_database_data),
+      context,
+      /*blockRows=*/2);
+  EXPECT_EQ(plaintext_stream.rows(), 5);
+  EXPECT_EQ(plaintext_stream.columns(), 3);
+
+  std::vector<long> firsts;
+  plaintext_stream.getScore<helib::Ptxt<helib::BGV>>(
+      weighted_query,
+      plaintext_query,
+      [&](long first, helib::Matrix<helib::Ptxt<helib::BGV>>& scores) {
+        firsts.push_back(first);
+        ASSERT_EQ(scores.dims(0), std::min(2ul, 5ul - first));
+        ASSERT_EQ(scores.dims(1), 1ul);
+        for (std::size_t i = 0; i < scores.dims(0); ++i)
+          EXPECT_EQ(scores(i, 0), expected_scores(first + i, 0));
+      });
+  EXPECT_EQ(firsts, (std::vector<long>{0, 2, 4}));
+
+  long rows = 0;
+  plaintext_stream.contains<helib::Ptxt<helib::BGV>>(
+      lookup_query,
+      plaintext_query,
+      [&](long first, helib::Matrix<helib::Ptxt<helib::BGV>>& result) {
+        EXPECT_EQ(first, rows);
+        for (std::size_t i = 0; i < result.dims(0); ++i)
+          EXPECT_EQ(result(i, 0), expected_lookup(first + i, 0));
+        rows += result.dims(0);
+      });
+  EXPECT_EQ(rows, 5);
+
+  // An encrypted database read from an archive, with the default blocks
+  const std::string path = "TestPartialMatch.bin";
+  {
+    helib::ArchiveWriter writer(path, context);
+    helib::Ctxt ctxt(publicKey);
+    for (long i = 0; i < 5; ++i)
+      for (long j = 0; j < 3; ++j) {
+        publicKey.Encrypt(ctxt, plaintext_database_data(i, j));
+        writer.append(ctxt);
+      }
+    writer.close();
+  }
+  helib::Matrix<helib::Ctxt> encrypted_query(helib::Ctxt(publicKey), 1l, 3l);
+  for (long j = 0; j < 3; ++j)
+    publicKey.Encrypt(encrypted_query(0, j), plaintext_query(0, j));
+
+  helib::StreamingDatabase<helib::Ctxt> encrypted_stream(
+      std::make_shared<helib::ArchiveRowSource>(path, publicKey, 3),
+      context);
+  EXPECT_EQ(encrypted_stream.rows(), 5);
+  EXPECT_THROW(helib::ArchiveRowSource(path, publicKey, 2), helib::IOError);
+
+  rows = 0;
+  encrypted_stream.getScore<helib::Ctxt>(
+      weighted_query,
+      encrypted_query,
+      [&](long first, helib::Matrix<helib::Ctxt>& scores) {
+        EXPECT_EQ(first, rows);
+        for (std::size_t i = 0; i < scores.dims(0); ++i) {
+          helib::Ptxt<helib::BGV> score(context);
+          secretKey.Decrypt(score, scores(i, 0));
+          EXPECT_EQ(score, expected_scores(first + i, 0));
+        }
+        rows += scores.dims(0);
+      });
+  EXPECT_EQ(rows, 5);
+  std::remove(path.c_str());
+}
+
 INSTANTIATE_TEST_SUITE_P(variousParameters,
                          TestPartialMatch,
                          ::testing::Values(BGVParameters(1024, 1087, 1, 700)));
@@ -13,6 +13,7 @@
 /* TestPermutations.cpp - Applying plaintext permutation to encrypted vector
  */
 #include <NTL/ZZ.h>
+#include <NTL/BasicThreadPool.h>
 
 #include <helib/NumbTh.h>
 #include <helib/timing.h>
@@ -229,6 +230,49 @@ TEST_P(TestPermutationsBGV, ciphertextPermutations)
   }
 }
 
+TEST_P(TestPermutationsBGV, compiledNetworkPermutesLikeTheNetwork)
+{
+  NTL::Vec<helib::GenDescriptor> gens;
+  gens.SetLength(ea.dimension());
+  for (long i = 0; i < ea.dimension(); ++i) {
+    gens[i] = helib::GenDescriptor(/*order=*/ea.sizeOfDimension(i),
+                                   /*good=*/ea.nativeDimension(i),
+                                   /*genIdx=*/i);
+  }
+  helib::GeneratorTrees trees;
+  trees.buildOptimalTrees(gens, depth);
+
+  helib::Permut pi;
+  helib::randomPerm(pi, trees.getSize());
+  helib::PermNetwork net;
+  net.buildNetwork(pi, trees);
+  addMatrices4Network(secretKey, net);
+
+  helib::PermNetworkExec exec(net, ea);
+  long identityLayers = 0;
+  for (long i = 0; i < net.depth(); ++i)
+    identityLayers += net.getLayer(i).isIdentity();
+  EXPECT_EQ(exec.depth(), net.depth() - identityLayers);
+
+  // The same compiled network for several ciphertexts and thread counts
+  long savedThreads = NTL::AvailableThreads();
+  for (long nThreads : {1l, 4l}) {
+    NTL::SetNumThreads(nThreads);
+    std::vector<long> in(ea.size());
+    for (std::size_t i = 0; i < in.size(); ++i)
+      in[i] = (i * nThreads) % p;
+    std::vector<long> expected(ea.size()), out(ea.size());
+    helib::applyPermToVec(expected, in, pi);
+
+    helib::Ctxt ctxt(publicKey);
+    ea.encrypt(ctxt, publicKey, in);
+    exec.apply(ctxt);
+    ea.decrypt(ctxt, secretKey, out);
+    EXPECT_EQ(out, expected) << "threads " << nThreads;
+  }
+  NTL::SetNumThreads(savedThreads);
+}
+
 TEST_P(TestPermutationsBGV, ciphertextPermutationsWithNewAPI)
 {
   helib::PermIndepPrecomp pip(context, depth);
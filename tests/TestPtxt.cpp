@@ -12,6 +12,8 @@
 
 #include <numeric>
 
+#include <NTL/BasicThreadPool.h>
+
 #include <helib/Ptxt.h>
 #include <helib/helib.h>
 #include <helib/replicate.h>
@@ -1698,6 +1700,106 @@ TEST_P(TestPtxtBGV, mapTo01MapsSlotsCorrectly)
   }
 }
 
+TEST_P(TestPtxtBGV, operationsMatchThePolyModOperationsOnEachSlot)
+{
+  // When d = 1 the slots are kept as residues mod p^r, which must give the
+  // same results as the PolyMod arithmetic
+  helib::Ptxt<helib::BGV> a(context), b(context);
+  a.random();
+  b.random();
+  std::vector<helib::PolyMod> expected(a.getSlotRepr());
+  std::vector<helib::PolyMod> other(b.getSlotRepr());
+  const long n = expected.size();
+
+  a *= b;
+  a += 3;
+  a -= b;
+  a.negate();
+  a.power(3);
+  a *= -2l;
+  a.rotate(2);
+  for (long i = 0; i < n; ++i) {
+    expected[i] *= other[i];
+    expected[i] += 3;
+    expected[i] -= other[i];
+    expected[i].negate();
+    expected[i] *= expected[i] * expected[i];
+    expected[i] *= -2l;
+  }
+  std::rotate(expected.begin(), expected.end() - (2 % n), expected.end());
+  for (long i = 0; i < n; ++i)
+    EXPECT_EQ(a[i], expected[i]);
+
+  // Writing through operator[], then operating again
+  a[0] = 5;
+  expected[0] = 5;
+  a += b;
+  a.runningSums();
+  for (long i = 0; i < n; ++i)
+    expected[i] += other[i];
+  for (long i = 1; i < n; ++i)
+    expected[i] += expected[i - 1];
+  EXPECT_EQ(a, helib::Ptxt<helib::BGV>(context, expected));
+
+  std::stringstream ss;
+  ss << a;
+  helib::Ptxt<helib::BGV> c(context);
+  ss >> c;
+  EXPECT_EQ(c, a);
+
+  a.mapTo01();
+  for (long i = 0; i < n; ++i)
+    EXPECT_EQ(a[i], expected[i] == 0l ? 0l : 1l);
+}
+
+TEST_P(TestPtxtBGV, automorphMatchesThePolynomialAutomorphism)
+{
+  // When d = 1 automorph permutes the residues instead
+  helib::Ptxt<helib::BGV> a(context);
+  a.random();
+  const helib::PAlgebra& zMStar = context.getZMStar();
+  long m = zMStar.getM();
+  long k = zMStar.ith_rep(zMStar.getNSlots() - 1);
+
+  // b(X) = a(X^k) mod Phi_m(X)
+  NTL::ZZX poly = a.getPolyRepr();
+  NTL::ZZX b;
+  for (long j = 0; j <= deg(poly); ++j)
+    NTL::SetCoeff(b, NTL::MulMod(j, k, m), coeff(poly, j));
+  NTL::rem(b, b, zMStar.getPhimX());
+  helib::Ptxt<helib::BGV> expected(context);
+  expected.decodeSetData(b);
+
+  a.automorph(k);
+  EXPECT_EQ(a, expected);
+}
+
+TEST_P(TestPtxtBGV, constMethodsCanBeCalledConcurrently)
+{
+  // With d = 1, the const getSlotRepr builds the PolyMod slots of a shared
+  // object without modifying it
+  helib::Ptxt<helib::BGV> a(context);
+  a.random();
+  a += 1;
+  const helib::Ptxt<helib::BGV>& shared = a;
+  const helib::Ptxt<helib::BGV> expected(shared);
+
+  long savedThreads = NTL::AvailableThreads();
+  NTL::SetNumThreads(4);
+  std::vector<long> same(8, 0); // not vector<bool>, written concurrently
+  NTL_EXEC_RANGE(8, first, last)
+  for (long i = first; i < last; ++i) {
+    if (i % 2 == 0)
+      same[i] = (shared.getSlotRepr() == expected.getSlotRepr());
+    else
+      same[i] = (helib::Ptxt<helib::BGV>(shared) == expected);
+  }
+  NTL_EXEC_RANGE_END
+  NTL::SetNumThreads(savedThreads);
+  for (long i = 0; i < 8; ++i)
+    EXPECT_TRUE(same[i]) << "task " << i;
+}
+
 TEST(TestPtxtBGV, automorphWorksCorrectly)
 {
   const helib::Context context = helib::ContextBuilder<helib::BGV>()
@@ -0,0 +1,195 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include <helib/ResidueMatrix.h>
+#include <helib/ResiduePool.h>
+#include "test_common.h"
+#include "gtest/gtest.h"
+
+namespace {
+
+void fillRow(long* row, long len, long val)
+{
+  for (long j = 0; j < len; ++j)
+    row[j] = val + j;
+}
+
+bool rowIs(const long* row, long len, long val)
+{
+  for (long j = 0; j < len; ++j)
+    if (row[j] != val + j)
+      return false;
+  return true;
+}
+
+TEST(TestResidueMatrix, rowsAreCacheAligned)
+{
+  helib::ResidueMatrix mat(17);
+  mat.insert(helib::IndexSet(0, 4));
+  for (long i : mat.getIndexSet())
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(mat[i]) %
+                  helib::ResidueMatrix::ALIGNMENT,
+              0u);
+}
+
+TEST(TestResidueMatrix, accessingMissingIndexThrows)
+{
+  helib::ResidueMatrix mat(8);
+  mat.insert(2);
+  EXPECT_THROW(mat[3], helib::LogicError);
+}
+
+TEST(TestResidueMatrix, removeAndInsertReusesRowsWithoutReallocating)
+{
+  const long len = 33;
+  helib::ResidueMatrix mat(len);
+  mat.insert(helib::IndexSet(0, 5));
+  for (long i : mat.getIndexSet())
+    fillRow(mat[i], len, 100 * i);
+
+  long cap = mat.capacity();
+  const long* keep = mat[0];
+
+  mat.remove(helib::IndexSet(3, 5));
+  mat.insert(helib::IndexSet(7, 9));
+
+  EXPECT_EQ(mat.capacity(), cap);
+  EXPECT_EQ(mat[0], keep);
+  for (long i : helib::IndexSet(0, 2))
+    EXPECT_TRUE(rowIs(mat[i], len, 100 * i));
+}
+
+TEST(TestResidueMatrix, growingKeepsTheContent)
+{
+  const long len = 5;
+  helib::ResidueMatrix mat(len);
+  for (long i = 0; i < 20; ++i) {
+    mat.insert(i);
+    fillRow(mat[i], len, 10 * i);
+  }
+  for (long i = 0; i < 20; ++i)
+    EXPECT_TRUE(rowIs(mat[i], len, 10 * i));
+}
+
+TEST(TestResidueMatrix, copyAndMovePreserveContent)
+{
+  const long len = 12;
+  helib::ResidueMatrix mat(len);
+  mat.insert(helib::IndexSet(1, 3));
+  mat.insert(6);
+  for (long i : mat.getIndexSet())
+    fillRow(mat[i], len, 7 * i);
+
+  helib::ResidueMatrix copy(mat);
+  EXPECT_EQ(copy, mat);
+
+  fillRow(copy[6], len, 0);
+  EXPECT_NE(copy, mat);
+
+  helib::ResidueMatrix moved(std::move(copy));
+  EXPECT_TRUE(rowIs(moved[6], len, 0));
+  EXPECT_TRUE(rowIs(moved[2], len, 14));
+  EXPECT_TRUE(helib::empty(copy.getIndexSet()));
+
+  moved = mat;
+  EXPECT_EQ(moved, mat);
+}
+
+TEST(TestResidueMatrix, attachedRowsAreUsedInPlaceUntilGrowing)
+{
+  const long len = 10;
+  helib::ResidueMatrix mat(len);
+  const long stride = mat.getStride();
+  const std::size_t bytes = 3 * stride * sizeof(long);
+  long* buffer = static_cast<long*>(helib::ResiduePool::allocate(bytes));
+  std::shared_ptr<long> owner(buffer, [bytes](long* p) {
+    helib::ResiduePool::deallocate(p, bytes);
+  });
+  for (long r = 0; r < 3; ++r)
+    fillRow(buffer + r * stride, len, 10 * r);
+
+  mat.attach(helib::IndexSet(2, 4), buffer, owner);
+  EXPECT_TRUE(mat.isView());
+  EXPECT_EQ(mat[2], buffer);
+  EXPECT_TRUE(rowIs(mat[3], len, 10));
+  EXPECT_EQ(owner.use_count(), 2);
+
+  mat.insert(7);
+  EXPECT_FALSE(mat.isView());
+  EXPECT_EQ(owner.use_count(), 1);
+  for (long i : helib::IndexSet(2, 4))
+    EXPECT_TRUE(rowIs(mat[i], len, 10 * (i - 2)));
+}
+
+TEST(TestResidueMatrix, buffersOfDestroyedMatricesAreReused)
+{
+  helib::ResiduePool::clear();
+  const long* first;
+  {
+    helib::ResidueMatrix mat(100);
+    mat.insert(helib::IndexSet(0, 3));
+    first = mat[0];
+  }
+  helib::ResiduePool::Counters before = helib::ResiduePool::getCounters();
+  EXPECT_GT(before.bytesCached, 0u);
+
+  helib::ResidueMatrix mat(100);
+  mat.insert(helib::IndexSet(0, 3));
+  helib::ResiduePool::Counters after = helib::ResiduePool::getCounters();
+
+  EXPECT_EQ(mat[0], first);
+  EXPECT_EQ(after.hits, before.hits + 1);
+  EXPECT_EQ(after.allocations, before.allocations);
+  EXPECT_EQ(after.bytesCached, 0u);
+}
+
+TEST(TestResidueMatrix, zeroPoolLimitDisablesCaching)
+{
+  std::size_t limit = helib::ResiduePool::getLimit();
+  helib::ResiduePool::clear();
+  helib::ResiduePool::setLimit(0);
+  {
+    helib::ResidueMatrix mat(100);
+    mat.insert(helib::IndexSet(0, 3));
+  }
+  EXPECT_EQ(helib::ResiduePool::getCounters().bytesCached, 0u);
+  helib::ResiduePool::setLimit(limit);
+}
+
+TEST(TestResidueMatrix, poolLimitIsSharedByAllThreads)
+{
+  std::size_t limit = helib::ResiduePool::getLimit();
+  helib::ResiduePool::clear();
+  const std::size_t bytes = 1024;
+  helib::ResiduePool::setLimit(bytes);
+
+  // The buffer cached by this thread fills the limit, so the one released
+  // by another thread is freed
+  helib::ResiduePool::deallocate(helib::ResiduePool::allocate(bytes), bytes);
+  EXPECT_EQ(helib::ResiduePool::getCounters().bytesCached, bytes);
+  std::size_t otherCached = bytes;
+  std::thread other([&otherCached, bytes]() {
+    helib::ResiduePool::deallocate(helib::ResiduePool::allocate(bytes), bytes);
+    otherCached = helib::ResiduePool::getCounters().bytesCached;
+  });
+  other.join();
+  EXPECT_EQ(otherCached, 0u);
+
+  helib::ResiduePool::clear();
+  helib::ResiduePool::setLimit(limit);
+}
+
+} // namespace
@@ -0,0 +1,144 @@
+/* Copyright (C) 2020 IBM Corp.
+ * This program is Licensed under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License. See accompanying LICENSE file.
+ */
+
+#include <atomic>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <helib/timing.h>
+#include "gtest/gtest.h"
+
+namespace {
+
+void profiledInner() { HELIB_NTIMER_START(profiledInner); }
+
+void profiledOuter()
+{
+  HELIB_NTIMER_START(profiledOuter);
+  profiledInner();
+  profiledInner();
+}
+
+class TestTiming : public ::testing::Test
+{
+protected:
+  TestTiming() { helib::resetProfile(); }
+
+  ~TestTiming() override
+  {
+    helib::setProfilerOff();
+    helib::resetProfile();
+  }
+};
+
+TEST_F(TestTiming, profilerAttributesNestedScopesToTheirParent)
+{
+  helib::setProfilerOn();
+  profiledOuter();
+  profiledInner();
+  helib::setProfilerOff();
+
+  std::ostringstream ss;
+  helib::writeCollapsedStacks(ss);
+  const std::string stacks = ss.str();
+  EXPECT_NE(stacks.find("profiledOuter;profiledInner "), std::string::npos)
+      << stacks;
+  EXPECT_NE(stacks.find("\nprofiledInner "), std::string::npos) << stacks;
+}
+
+TEST_F(TestTiming, profiledCallsAreCountedByTheTimer)
+{
+  profiledOuter(); // make sure the timers are registered
+  const helib::FHEtimer* inner = helib::getTimerByName("profiledInner");
+  ASSERT_NE(inner, nullptr);
+  long before = inner->getNumCalls();
+
+  helib::setProfilerOn();
+  profiledOuter();
+  helib::setProfilerOff();
+
+  EXPECT_EQ(inner->getNumCalls(), before + 2);
+  std::vector<long> histogram = helib::getProfileHistogram(inner);
+  long calls = 0;
+  for (long c : histogram)
+    calls += c;
+  EXPECT_EQ(calls, 2);
+}
+
+TEST_F(TestTiming, chromeTraceContainsTheRecordedEvents)
+{
+  helib::setProfilerOn(/*recordEvents=*/true);
+  profiledOuter();
+  helib::setProfilerOff();
+
+  std::ostringstream ss;
+  helib::writeChromeTrace(ss);
+  const std::string trace = ss.str();
+  EXPECT_EQ(trace.find("{\"traceEvents\":["), 0u);
+  EXPECT_NE(trace.find("\"name\":\"profiledOuter\""), std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"profiledInner\""), std::string::npos);
+}
+
+TEST_F(TestTiming, scopesOpenAcrossAResetAreNotCounted)
+{
+  profiledInner(); // make sure the timer is registered
+  const helib::FHEtimer* inner = helib::getTimerByName("profiledInner");
+  ASSERT_NE(inner, nullptr);
+
+  helib::setProfilerOn();
+  {
+    HELIB_NTIMER_START(openAcrossReset);
+    helib::resetProfile();
+    profiledInner(); // has the index that openAcrossReset had before
+  }
+  helib::setProfilerOff();
+
+  const helib::FHEtimer* open = helib::getTimerByName("openAcrossReset");
+  ASSERT_NE(open, nullptr);
+  EXPECT_EQ(open->getNumCalls(), 0);
+  std::vector<long> histogram = helib::getProfileHistogram(inner);
+  long calls = 0;
+  for (long c : histogram)
+    calls += c;
+  EXPECT_EQ(calls, 1);
+}
+
+TEST_F(TestTiming, profileCanBeReadWhileOtherThreadsAreProfiled)
+{
+  profiledOuter(); // make sure the timers are registered
+  const helib::FHEtimer* inner = helib::getTimerByName("profiledInner");
+  ASSERT_NE(inner, nullptr);
+
+  helib::setProfilerOn();
+  std::atomic<bool> done(false);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < 4; i++)
+    workers.emplace_back([&done]() {
+      while (!done)
+        profiledOuter();
+    });
+  for (int i = 0; i < 100; i++) {
+    EXPECT_GE(inner->getNumCalls(), 0);
+    std::ostringstream ss;
+    helib::writeCollapsedStacks(ss);
+    if (i % 10 == 0)
+      helib::resetProfile();
+  }
+  done = true;
+  for (auto& w : workers)
+    w.join();
+  helib::setProfilerOff();
+}
+
+} // namespace
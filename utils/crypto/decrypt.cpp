@@ -100,13 +100,11 @@ void decryptFromTo(const CmdLineOpts& cmdLineOpts,
         threadReader.readDatum(ctxts[i], qr.quot, qr.rem);
       }
     }
-
-    // Decrypt using NTL threads
-    for (long i = first; i < last; ++i) {
-      sk.Decrypt(ptxts[i], ctxts[i]);
-    }
     NTL_EXEC_RANGE_END
 
+    // Decrypt the whole batch using NTL threads
+    sk.decryptBatch(ptxts, ctxts);
+
     // Write out to stream
     for (const auto& ptxt : ptxts)
       *out << ptxt << std::endl;
@@ -98,16 +98,20 @@ void encryptFromTo(const CmdLineOpts& cmdLineOpts,
       std::getline(dataFile, ptxt_strings[j], '\n');
     }
 
-    // Spread across n threads
+    // Parse across n threads
     NTL_EXEC_RANGE(ctxts.size(), first, last)
-    Writer<helib::Ctxt> threadWriter(writer);
     for (long i = first; i < last; ++i) {
       std::istringstream istr(ptxt_strings[i]);
       istr >> ptxts[i];
-      pk.Encrypt(ctxts[i], ptxts[i]);
     }
+    NTL_EXEC_RANGE_END
+
+    // Encrypt the whole batch, this is also spread across n threads
+    pk.encryptBatch(ctxts, ptxts);
 
     // Write to file
+    NTL_EXEC_RANGE(ctxts.size(), first, last)
+    Writer<helib::Ctxt> threadWriter(writer);
     for (long i = first; i < last; ++i) {
       if (dims.second == 1) {
         threadWriter.writeByLocation(ctxts[i],